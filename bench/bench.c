@@ -0,0 +1,1920 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "bench_std.h"
+#include "ss.h"
+#include "ss_inline.h"
+
+
+#define CORPUS_LEN (8 * 1024 * 1024)
+#define FOOTPRINT_COUNT (1024 * 1024)
+#define SHORT_COUNT (4096)
+
+/**
+ * @brief The memchr/memcmp loop ss_find used before the search engine.
+ *        Kept here as the baseline.
+ */
+static size_t
+naive_find(const char *s, size_t slen, const char *cs, size_t len)
+{
+    if (len && slen)
+    {
+        size_t searchlen = slen;
+        const char *cursor = s;
+        for (;;)
+        {
+            if (*cs != *cursor)
+            {
+                cursor = memchr(cursor, *cs, searchlen);
+                if (!cursor)
+                {
+                    break;
+                }
+            }
+
+            searchlen = slen - (cursor - s);
+
+            if (searchlen < len)
+            {
+                break;
+            }
+
+            if (0 == memcmp(cursor, cs, len))
+            {
+                return cursor - s;
+            }
+            else
+            {
+                ++cursor;
+                --searchlen;
+            }
+        }
+    }
+
+    return NPOS;
+}
+
+static SS
+corpus_text(void)
+{
+    static const char *words[] =
+    {
+        "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+        "request", "error", "warning", "user", "session", "timeout", "GET",
+        "POST", "status=200", "latency_ms", "host", "path", "/api/v1/items",
+    };
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    SS s = ss_new(CORPUS_LEN + 32);
+
+    while (ss_len(s) < CORPUS_LEN)
+    {
+        const char *w = words[bench_rand(&seed) % (sizeof(words)/sizeof(words[0]))];
+        ss_cat(&s, w, strlen(w));
+        ss_cat(&s, " ", 1);
+    }
+
+    return s;
+}
+
+static SS
+corpus_random(void)
+{
+    uint64_t seed = 0x2545F4914F6CDD1Dull;
+    SS s = ss_new(CORPUS_LEN);
+    size_t i;
+
+    for (i = 0; i < CORPUS_LEN; ++i)
+    {
+        s[i] = (char)(bench_rand(&seed) & 0xFF);
+    }
+    ss_setlen(s, CORPUS_LEN);
+
+    return s;
+}
+
+static SS
+corpus_repeat(void)
+{
+    SS s = ss_new(CORPUS_LEN);
+    memset(s, 'a', CORPUS_LEN);
+    ss_setlen(s, CORPUS_LEN);
+    return s;
+}
+
+static void
+bench_find_one(const char *name, SS hay, const char *needle, size_t nlen, int iters)
+{
+    uint64_t allocs;
+    double start;
+    double secs;
+    int i;
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        size_t r = naive_find(hay, ss_len(hay), needle, nlen);
+        bench_use(&r);
+    }
+    bench_report(name, "before", (double)ss_len(hay) * iters, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        size_t r = ss_find(hay, 0, needle, nlen);
+        bench_use(&r);
+    }
+    bench_report(name, "ss_find", (double)ss_len(hay) * iters, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        size_t r = ss_count(hay, 0, needle, nlen);
+        bench_use(&r);
+    }
+    bench_report(name, "ss_count", (double)ss_len(hay) * iters, bench_now() - start);
+
+    secs = bench_std_find(hay, ss_len(hay), needle, nlen, iters, 0, &allocs);
+    bench_report_std(name, "std::find", (double)ss_len(hay) * iters, secs, allocs);
+
+    secs = bench_std_find(hay, ss_len(hay), needle, nlen, iters, 1, &allocs);
+    bench_report_std(name, "std::count", (double)ss_len(hay) * iters, secs, allocs);
+}
+
+static void
+bench_find(void)
+{
+    SS text = corpus_text();
+    SS rnd = corpus_random();
+    SS rep = corpus_repeat();
+
+    char longneedle[65];
+    memset(longneedle, 'a', 64);
+    longneedle[63] = 'b';
+    longneedle[64] = 0;
+
+    /* Every position passes the first/last byte filter. */
+    char evilneedle[65];
+    memset(evilneedle, 'a', 64);
+    evilneedle[62] = 'c';
+    evilneedle[64] = 0;
+
+    bench_find_one("find/text/short", text, "req_id=", 7, 10);
+    bench_find_one("find/text/long", text, "status=500 latency_ms host path error", 37, 10);
+    bench_find_one("find/random/short", rnd, "\x01\x02\x03\x04", 4, 10);
+    bench_find_one("find/random/long", rnd, longneedle, 64, 10);
+    bench_find_one("find/repeat/short", rep, "aaaaaab", 7, 2);
+    bench_find_one("find/repeat/long", rep, longneedle, 64, 2);
+    /* Quadratic for the baseline, keep it small. */
+    bench_find_one("find/repeat/evil", rep, evilneedle, 64, 1);
+
+    ss_free(&text);
+    ss_free(&rnd);
+    ss_free(&rep);
+}
+
+/*
+ * Footprint accounting, the global allocator is swapped for one that
+ * keeps track of what was requested.
+ */
+typedef struct footprint_s
+{
+    size_t live;
+} footprint_t;
+
+static void *
+footprint_alloc(void *ctx, size_t size)
+{
+    size_t *p = malloc(sizeof(size_t) + size);
+    if (p)
+    {
+        ((footprint_t *)ctx)->live += size;
+        *p = size;
+        ++p;
+    }
+    return p;
+}
+
+static void *
+footprint_realloc(void *ctx, void *mem, size_t size)
+{
+    size_t *p = ((size_t *)mem) - 1;
+    size_t old = *p;
+    p = realloc(p, sizeof(size_t) + size);
+    if (p)
+    {
+        ((footprint_t *)ctx)->live += size - old;
+        *p = size;
+        ++p;
+    }
+    return p;
+}
+
+static void
+footprint_free(void *ctx, void *mem)
+{
+    size_t *p = ((size_t *)mem) - 1;
+    ((footprint_t *)ctx)->live -= *p;
+    free(p);
+}
+
+/**
+ * @brief Bytes requested for many small strings, the way a symbol table
+ *        or parsed row would hold them.
+ *        The "before" line is the fixed 20 byte header every string used
+ *        to carry.
+ */
+static void
+bench_footprint_one(const char *name, size_t minlen, size_t maxlen)
+{
+    footprint_t fp = { 0 };
+    ss_allocator_t a = { footprint_alloc, footprint_realloc, footprint_free, NULL, &fp };
+    SS *all = malloc(FOOTPRINT_COUNT * sizeof(SS));
+    uint64_t state = 88172645463325252ULL;
+    size_t before = 0;
+    size_t data = 0;
+    char buf[1024];
+    size_t i;
+
+    memset(buf, 'x', sizeof(buf));
+    const ss_allocator_t *prev = ss_getglobalallocator();
+    ss_setglobalallocator(&a);
+
+    double start = bench_start();
+    for (i = 0; i < FOOTPRINT_COUNT; ++i)
+    {
+        size_t len = minlen + (bench_rand(&state) % (maxlen - minlen + 1));
+        all[i] = ss_newfrom(0, buf, len);
+        before += (sizeof(size_t) * 2) + sizeof(uint32_t) + len + 1;
+        data += len;
+    }
+    double secs = bench_now() - start;
+
+    bench_report_value(name, "payload", (double)data / FOOTPRINT_COUNT, "bytes/string");
+    bench_report_value(name, "before", (double)before / FOOTPRINT_COUNT, "bytes/string");
+    bench_report_value(name, "ss_newfrom", (double)fp.live / FOOTPRINT_COUNT, "bytes/string");
+    bench_report_ops(name, "ss_newfrom", FOOTPRINT_COUNT, secs);
+
+    for (i = 0; i < FOOTPRINT_COUNT; ++i)
+    {
+        ss_free(&all[i]);
+    }
+    ss_setglobalallocator(prev);
+    free(all);
+}
+
+static void
+bench_footprint(void)
+{
+    bench_footprint_one("footprint/0-16", 0, 16);
+    bench_footprint_one("footprint/8-64", 8, 64);
+    bench_footprint_one("footprint/100-1000", 100, 1000);
+}
+
+/**
+ * @brief Short string equality, comparison, and search over pairs of
+ *        equal strings (the worst case, every byte is looked at).
+ */
+static void
+bench_short_one(const char *variant, SS (*make)(size_t, const char *, size_t),
+                size_t minlen, size_t maxlen)
+{
+    SS *a = malloc(SHORT_COUNT * sizeof(SS));
+    SS *b = malloc(SHORT_COUNT * sizeof(SS));
+    uint64_t state = 88172645463325252ULL;
+    char name[64];
+    char buf[64];
+    int iters = 2000;
+    size_t i;
+    int r;
+
+    for (i = 0; i < SHORT_COUNT; ++i)
+    {
+        size_t len = minlen + (bench_rand(&state) % (maxlen - minlen + 1));
+        size_t j;
+        for (j = 0; j < len; ++j)
+        {
+            buf[j] = 'a' + (bench_rand(&state) % 26);
+        }
+        a[i] = make(0, buf, len);
+        b[i] = make(0, buf, len);
+    }
+
+    double start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        size_t n = 0;
+        for (i = 0; i < SHORT_COUNT; ++i)
+        {
+            n += ss_equal(a[i], b[i]);
+        }
+        bench_use(&n);
+    }
+    double secs = bench_now() - start;
+    snprintf(name, sizeof(name), "equal/%zu-%zu", minlen, maxlen);
+    bench_report_ops(name, variant, (double)iters * SHORT_COUNT, secs);
+
+    start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        int n = 0;
+        for (i = 0; i < SHORT_COUNT; ++i)
+        {
+            n += ss_compare(a[i], b[i]);
+        }
+        bench_use(&n);
+    }
+    secs = bench_now() - start;
+    snprintf(name, sizeof(name), "compare/%zu-%zu", minlen, maxlen);
+    bench_report_ops(name, variant, (double)iters * SHORT_COUNT, secs);
+
+    start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        size_t n = 0;
+        for (i = 0; i < SHORT_COUNT; ++i)
+        {
+            n += ss_find(a[i], 0, "zz", 2);
+        }
+        bench_use(&n);
+    }
+    secs = bench_now() - start;
+    snprintf(name, sizeof(name), "find/%zu-%zu", minlen, maxlen);
+    bench_report_ops(name, variant, (double)iters * SHORT_COUNT, secs);
+
+    for (i = 0; i < SHORT_COUNT; ++i)
+    {
+        ss_free(&a[i]);
+        ss_free(&b[i]);
+    }
+    free(a);
+    free(b);
+}
+
+static void
+bench_short(void)
+{
+    bench_short_one("unaligned", ss_newfrom, 4, 16);
+    bench_short_one("aligned", ss_newfrom_aligned, 4, 16);
+    bench_short_one("unaligned", ss_newfrom, 16, 48);
+    bench_short_one("aligned", ss_newfrom_aligned, 16, 48);
+}
+
+/**
+ * @brief The loop _ss_catf used before, one byte of growth and a full
+ *        reformat per pass when the string doesn't grow on its own.
+ */
+static void
+naive_catf(SS *s, const char *fmt, const char *arg)
+{
+    if (0 == ss_cap(*s))
+    {
+        ss_addcap(s, strlen(fmt) + 1);
+    }
+
+    for (;;)
+    {
+        size_t len = ss_len(*s);
+        size_t cap = ss_cap(*s);
+        int n = snprintf(*s + len, cap - len + 1, fmt, arg);
+        if ((size_t)n < cap - len)
+        {
+            ss_setlen(*s, len + (size_t)n);
+            break;
+        }
+        ss_addcap(s, 1);
+    }
+}
+
+/**
+ * @brief Format a line of the given size into a fresh string.
+ */
+static void
+bench_catf_one(const char *name, size_t size, int iters, int naiveiters)
+{
+    char *arg = malloc(size + 1);
+    memset(arg, 'v', size);
+    arg[size] = 0;
+    double start;
+    int i;
+
+    start = bench_start();
+    for (i = 0; i < naiveiters; ++i)
+    {
+        SS s = ss_empty();
+        ss_setgrow(&s, SS_GROW0);
+        naive_catf(&s, "%s", arg);
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report(name, "before", (double)size * naiveiters, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        SS s = ss_empty();
+        ss_setgrow(&s, SS_GROW0);
+        ss_catf(&s, "%s", arg);
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report(name, "ss_catf", (double)size * iters, bench_now() - start);
+
+    free(arg);
+}
+
+static void
+bench_catf(void)
+{
+    bench_catf_one("catf/16B", 16, 1000000, 100000);
+    bench_catf_one("catf/256B", 256, 200000, 2000);
+    /* Quadratic for the baseline, keep it small. */
+    bench_catf_one("catf/64KB", 64 * 1024, 5000, 1);
+}
+
+/**
+ * @brief Fixed-shape protocol header, format parsed per call vs compiled.
+ */
+static void
+bench_pack(void)
+{
+    const int iters = 10000000;
+    ss_packplan_t *plan = ss_packplan_compile("HIQ?");
+    SS s = ss_new(64);
+    double bytes = (double)ss_packplan_size(plan) * iters;
+    double start;
+    int i;
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_packBE(&s, "HIQ?", i & 0xFFFF, (uint32_t)i, (uint64_t)i * 3, i & 1);
+        bench_use(s);
+    }
+    bench_report("pack/HIQ?", "ss_packBE", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_packplan_exec(&s, plan, i & 0xFFFF, (uint32_t)i, (uint64_t)i * 3, i & 1);
+        bench_use(s);
+    }
+    bench_report("pack/HIQ?", "packplan", bytes, bench_now() - start);
+
+    uint16_t h;
+    uint32_t v;
+    uint64_t q;
+    bool b;
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_unpackBE(s, "HIQ?", &h, &v, &q, &b);
+        bench_use(&q);
+    }
+    bench_report("unpack/HIQ?", "ss_unpackBE", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_unpackplan_exec(s, plan, &h, &v, &q, &b);
+        bench_use(&q);
+    }
+    bench_report("unpack/HIQ?", "unpackplan", bytes, bench_now() - start);
+
+    ss_free(&s);
+    ss_packplan_free(&plan);
+}
+
+/**
+ * @brief Bulk array packing, one pointer per array instead of a
+ *        va_arg per element.
+ */
+static void
+bench_pack_array(void)
+{
+    const size_t n = 1024;
+    const int iters = 100000;
+    uint32_t *w = malloc(n * sizeof(uint32_t));
+    uint64_t *q = malloc(n * sizeof(uint64_t));
+    SS s = ss_new(n * 8);
+    double start;
+    size_t i;
+    int r;
+
+    for (i = 0; i < n; ++i)
+    {
+        w[i] = (uint32_t)i * 2654435761u;
+        q[i] = (uint64_t)i * 0x9E3779B97F4A7C15ull;
+    }
+
+    start = bench_start();
+    for (r = 0; r < iters / 10; ++r)
+    {
+        ss_clear(s);
+        for (i = 0; i < n; ++i)
+        {
+            ss_catpackBE(&s, "I", w[i]);
+        }
+        bench_use(s);
+    }
+    bench_report("pack/1024I", "per-element", (double)n * 4 * (iters / 10), bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        ss_packBE(&s, "1024I", w);
+        bench_use(s);
+    }
+    bench_report("pack/1024I", "BE array", (double)n * 4 * iters, bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        ss_packLE(&s, "1024I", w);
+        bench_use(s);
+    }
+    bench_report("pack/1024I", "LE array", (double)n * 4 * iters, bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        ss_packBE(&s, "1024Q", q);
+        bench_use(s);
+    }
+    bench_report("pack/1024Q", "BE array", (double)n * 8 * iters, bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < iters; ++r)
+    {
+        ss_unpackBE(s, "1024Q", q);
+        bench_use(q);
+    }
+    bench_report("unpack/1024Q", "BE array", (double)n * 8 * iters, bench_now() - start);
+
+    ss_free(&s);
+    free(w);
+    free(q);
+}
+
+/**
+ * Template expansion with 40 tokens, ss_replace per token vs. one ss_replacemany.
+ */
+static void
+bench_replacemany(void)
+{
+    enum { NTOK = 40 };
+    char fbuf[NTOK][16];
+    char tbuf[NTOK][16];
+    const char *from[NTOK];
+    const char *to[NTOK];
+    size_t flen[NTOK];
+    size_t tlen[NTOK];
+    size_t i;
+
+    for (i = 0; i < NTOK; ++i)
+    {
+        flen[i] = (size_t)snprintf(fbuf[i], sizeof(fbuf[i]), "{tok%zu}", i);
+        tlen[i] = (size_t)snprintf(tbuf[i], sizeof(tbuf[i]), "value-%zu", i * 7);
+        from[i] = fbuf[i];
+        to[i] = tbuf[i];
+    }
+
+    uint64_t seed = 0x853C49E6748FEA9Bull;
+    SS tmpl = ss_empty();
+    while (ss_len(tmpl) < 64 * 1024)
+    {
+        i = (size_t)(bench_rand(&seed) % NTOK);
+        ss_cat(&tmpl, "some text ", 10);
+        ss_cat(&tmpl, from[i], flen[i]);
+    }
+
+    int iters = 50;
+    double bytes = (double)ss_len(tmpl) * iters;
+    double start;
+    int k;
+
+    start = bench_start();
+    for (k = 0; k < iters; ++k)
+    {
+        SS s = ss_dup(tmpl);
+        for (i = 0; i < NTOK; ++i)
+        {
+            ss_replace(&s, 0, from[i], flen[i], to[i], tlen[i]);
+        }
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report("replace/40tok", "ss_replace", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < iters; ++k)
+    {
+        SS s = ss_dup(tmpl);
+        ss_replacemany(&s, from, flen, to, tlen, NTOK);
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report("replace/40tok", "replacemany", bytes, bench_now() - start);
+
+    ss_free(&tmpl);
+}
+
+/**
+ * Build a 64MB string from 64 byte pieces, ss_cat vs. builder and finish.
+ */
+static void
+bench_builder(void)
+{
+    const size_t total = 64 * 1024 * 1024;
+    char piece[64];
+    size_t i;
+    double start;
+
+    memset(piece, 'p', sizeof(piece));
+
+    start = bench_start();
+    SS s = ss_empty();
+    for (i = 0; i < total; i += sizeof(piece))
+    {
+        ss_cat(&s, piece, sizeof(piece));
+    }
+    bench_use(s);
+    ss_free(&s);
+    bench_report("build/64MB", "ss_cat", (double)total, bench_now() - start);
+
+    start = bench_start();
+    ss_builder_t *b = ss_builder_new(0);
+    for (i = 0; i < total; i += sizeof(piece))
+    {
+        ss_builder_append(b, piece, sizeof(piece));
+    }
+    s = ss_builder_finish(b);
+    bench_use(s);
+    ss_free(&s);
+    ss_builder_free(&b);
+    bench_report("build/64MB", "ss_builder", (double)total, bench_now() - start);
+}
+
+/**
+ * Split CSV lines, ss_newfrom per field vs. views from ss_split_next.
+ */
+static void
+bench_split(void)
+{
+    const char line[] = "1042,alice,alice@example.com,2019-03-14,97.5,true,,US";
+    size_t llen = strlen(line);
+    int iters = 1000000;
+    double bytes = (double)llen * iters;
+    double start;
+    int i;
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        size_t pos = 0;
+        for (;;)
+        {
+            const char *comma = memchr(line + pos, ',', llen - pos);
+            size_t end = comma ? (size_t)(comma - line) : llen;
+            SS f = ss_newfrom(0, line + pos, end - pos);
+            bench_use(f);
+            ss_free(&f);
+            if (!comma)
+            {
+                break;
+            }
+            pos = end + 1;
+        }
+    }
+    bench_report("split/csv", "ss_newfrom", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_split_t it;
+        ss_view_t f;
+        ss_split_init(&it, ss_view_of(line, llen));
+        while (ss_split_next(&it, ",", 1, &f))
+        {
+            bench_use(f.ptr);
+        }
+    }
+    bench_report("split/csv", "ss_split_next", bytes, bench_now() - start);
+}
+
+/**
+ * Rehash 64KiB of 64 byte keys, hashing the bytes each time vs. the cache.
+ */
+static void
+bench_hash(void)
+{
+    enum { NKEYS = 1024 };
+    SS keys[NKEYS];
+    uint64_t seed = 0xD1B54A32D192ED03ull;
+    uint64_t acc = 0;
+    int iters = 2000;
+    double bytes = 64.0 * NKEYS * iters;
+    double start;
+    size_t i;
+    int k;
+
+    for (i = 0; i < NKEYS; ++i)
+    {
+        char key[64];
+        size_t j;
+        for (j = 0; j < sizeof(key); ++j)
+        {
+            key[j] = (char)('a' + bench_rand(&seed) % 26);
+        }
+        /* Room past the sentinel for the cached hash. */
+        keys[i] = ss_newfrom(sizeof(key) + 8, key, sizeof(key));
+    }
+
+    start = bench_start();
+    for (k = 0; k < iters; ++k)
+    {
+        for (i = 0; i < NKEYS; ++i)
+        {
+            acc += ss_hash_view(ss_view(keys[i]));
+        }
+    }
+    bench_report("hash/64B", "uncached", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < iters; ++k)
+    {
+        for (i = 0; i < NKEYS; ++i)
+        {
+            acc += ss_hash(keys[i]);
+        }
+    }
+    bench_report("hash/64B", "ss_hash", bytes, bench_now() - start);
+
+    bench_use(&acc);
+    for (i = 0; i < NKEYS; ++i)
+    {
+        ss_free(&keys[i]);
+    }
+}
+
+/**
+ * Repeated tag names, a copy per occurrence vs. ss_intern.
+ */
+static void
+bench_intern(void)
+{
+    enum { NTAGS = 4096, NOCC = 1000000 };
+    static char tags[NTAGS][24];
+    size_t tlen[NTAGS];
+    uint64_t seed = 0x94D049BB133111EBull;
+    double bytes = 0;
+    double start;
+    size_t i;
+
+    for (i = 0; i < NTAGS; ++i)
+    {
+        tlen[i] = (size_t)snprintf(tags[i], sizeof(tags[i]), "svc.metric.%zu", i * 2654435761u);
+    }
+    for (i = 0; i < NOCC; ++i)
+    {
+        bytes += (double)tlen[i % NTAGS];
+    }
+
+    start = bench_start();
+    for (i = 0; i < NOCC; ++i)
+    {
+        size_t k = (size_t)(bench_rand(&seed) % NTAGS);
+        SS s = ss_newfrom(0, tags[k], tlen[k]);
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report("intern/4096", "ss_newfrom", bytes, bench_now() - start);
+
+    ss_intern_table_t *it = ss_intern_new(0);
+    start = bench_start();
+    for (i = 0; i < NOCC; ++i)
+    {
+        size_t k = (size_t)(bench_rand(&seed) % NTAGS);
+        bench_use(ss_intern(it, tags[k], tlen[k]));
+    }
+    bench_report("intern/4096", "ss_intern", bytes, bench_now() - start);
+    ss_intern_free(&it);
+}
+
+/**
+ * HTTP header names, byte-wise locale folding vs. the vector kernels,
+ * and a lowered copy plus ss_find vs. ss_casefind.
+ */
+static void
+bench_case(void)
+{
+    static const char *names[] =
+    {
+        "Content-Type", "Content-Length", "Accept-Encoding", "User-Agent",
+        "X-Forwarded-For", "Cache-Control", "Authorization", "Host",
+    };
+    enum { NNAMES = sizeof(names) / sizeof(names[0]), ITERS = 500000 };
+    SS hdr[NNAMES];
+    double bytes = 0;
+    double start;
+    size_t found = 0;
+    size_t i;
+    int k;
+
+    for (i = 0; i < NNAMES; ++i)
+    {
+        hdr[i] = ss_newfrom(0, names[i], strlen(names[i]));
+        bytes += (double)ss_len(hdr[i]) * ITERS;
+    }
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        for (i = 0; i < NNAMES; ++i)
+        {
+            ssc_lower(hdr[i]);
+            ssc_upper(hdr[i]);
+        }
+    }
+    bench_report("case/headers", "ssc_lower", 2 * bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        for (i = 0; i < NNAMES; ++i)
+        {
+            ss_lower(hdr[i]);
+            ss_upper(hdr[i]);
+        }
+    }
+    bench_report("case/headers", "ss_lower", 2 * bytes, bench_now() - start);
+
+    SS hay = ss_new(64 * 1024);
+    uint64_t seed = 0xA0761D6478BD642Full;
+    for (i = 0; i < 64 * 1024; ++i)
+    {
+        char c = (char)('a' + bench_rand(&seed) % 26);
+        ss_cat(&hay, &c, 1);
+    }
+    ss_cat(&hay, "CONTENT-LENGTH", 14);
+    bytes = (double)ss_len(hay) * 200;
+
+    start = bench_start();
+    for (k = 0; k < 200; ++k)
+    {
+        SS low = ss_dup(hay);
+        ss_lower(low);
+        found += ss_find(low, 0, "content-length", 14);
+        ss_free(&low);
+    }
+    bench_report("casefind/64K", "lower+find", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < 200; ++k)
+    {
+        found += ss_casefind(hay, 0, "content-length", 14);
+    }
+    bench_report("casefind/64K", "ss_casefind", bytes, bench_now() - start);
+
+    bench_use(&found);
+    ss_free(&hay);
+    for (i = 0; i < NNAMES; ++i)
+    {
+        ss_free(&hdr[i]);
+    }
+}
+
+/**
+ * Validating a 1MB mostly ASCII body, a ssu8_seqtocp loop vs. ssu8_validate,
+ * and counting code points.
+ */
+static void
+bench_utf8(void)
+{
+    enum { SIZE = 1024 * 1024, ITERS = 50 };
+    static const char *pieces[] =
+    {
+        "{\"name\": \"value\", ", "\"caf\xC3\xA9\": 1, ", "\"price\": \"\xE2\x82\xAC" "12\", ",
+        "\"emoji\": \"\xF0\x9F\x98\x80\"}, ", "\"id\": 12345678, \"ok\": true, ",
+    };
+    uint64_t seed = 0xE7037ED1A0B428DBull;
+    SS body = ss_new(SIZE + 64);
+    double bytes;
+    double start;
+    size_t acc = 0;
+    int k;
+
+    while (ss_len(body) < SIZE)
+    {
+        const char *p = pieces[bench_rand(&seed) % (sizeof(pieces) / sizeof(pieces[0]))];
+        ss_cat(&body, p, strlen(p));
+    }
+    bytes = (double)ss_len(body) * ITERS;
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        size_t i = 0;
+        size_t len = ss_len(body);
+        while (i < len)
+        {
+            unicode_t cp;
+            int n = ssu8_seqtocp(body + i, &cp);
+            if (!n)
+            {
+                break;
+            }
+            acc += cp;
+            i += (size_t)n;
+        }
+        acc += i;
+    }
+    bench_report("utf8/1MB", "ssu8_seqtocp", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        acc += ssu8_validate(body);
+    }
+    bench_report("utf8/1MB", "ssu8_validate", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        acc += ssu8_len(body);
+    }
+    bench_report("utf8/1MB", "ssu8_len", bytes, bench_now() - start);
+
+    bench_use(&acc);
+    ss_free(&body);
+}
+
+/**
+ * UTF-8 to UTF-16 and back, one code point at a time through
+ * ssu8_seqtocp/ssu8_cptoseq vs. the bulk transcoders.
+ */
+static void
+bench_transcode_one(const char *name, SS text)
+{
+    enum { ITERS = 20 };
+    size_t units = ssu8_utf16len(text);
+    uint16_t *u16 = malloc(units * sizeof(*u16));
+    double bytes = (double)ss_len(text) * ITERS;
+    SS back = ss_empty();
+    size_t acc = 0;
+    double start;
+    int k;
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        size_t i = 0;
+        size_t n = 0;
+        while (i < ss_len(text))
+        {
+            unicode_t cp;
+            i += (size_t)ssu8_seqtocp(text + i, &cp);
+            if (cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                u16[n++] = (uint16_t)(0xD800 | (cp >> 10));
+                u16[n++] = (uint16_t)(0xDC00 | (cp & 0x3FF));
+            }
+            else
+            {
+                u16[n++] = (uint16_t)cp;
+            }
+        }
+        acc += n;
+    }
+    bench_report(name, "to16 seqtocp", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        acc += ssu8_to_utf16(text, u16);
+    }
+    bench_report(name, "ssu8_to_utf16", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        char seq[SS_UTF8_SEQ_MAX];
+        size_t i = 0;
+        ss_clear(back);
+        while (i < units)
+        {
+            unicode_t cp = u16[i++];
+            if (cp >= 0xD800 && cp < 0xDC00)
+            {
+                cp = 0x10000 + ((cp & 0x3FF) << 10) + (u16[i++] & 0x3FF);
+            }
+            ss_cat(&back, seq, (size_t)ssu8_cptoseq(cp, seq));
+        }
+        acc += ss_len(back);
+    }
+    bench_report(name, "to8 cptoseq", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (k = 0; k < ITERS; ++k)
+    {
+        acc += ssu16_to_utf8(&back, u16, units);
+    }
+    bench_report(name, "ssu16_to_utf8", bytes, bench_now() - start);
+
+    bench_use(&acc);
+    ss_free(&back);
+    free(u16);
+}
+
+static void
+bench_transcode(void)
+{
+    enum { SIZE = 1024 * 1024 };
+    static const char *kinds[][2] =
+    {
+        { "utf16/ascii", "The quick brown fox jumps over the lazy dog. " },
+        { "utf16/latin", "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xD0\xBC\xD0\xB8\xD1\x80 " },
+        { "utf16/cjk", "\xE4\xBD\xA0\xE5\xA5\xBD\xE4\xB8\x96\xE7\x95\x8C" },
+    };
+
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); ++k)
+    {
+        SS text = ss_new(SIZE + 64);
+        while (ss_len(text) < SIZE)
+        {
+            ss_cat(&text, kinds[k][1], strlen(kinds[k][1]));
+        }
+        bench_transcode_one(kinds[k][0], text);
+        ss_free(&text);
+    }
+}
+
+static void
+bench_cache(void)
+{
+    enum { NOPS = 4000000, LIVE = 64 };
+    SS live[LIVE];
+    uint64_t seed = 0xD6E8FEB86659FD93ull;
+    double bytes = 0;
+    double start;
+    size_t i;
+    int pass;
+
+    for (pass = 0; pass < 2; ++pass)
+    {
+        ss_cache_setdepth(pass ? 32 : 0);
+        memset(live, 0, sizeof(live));
+        bytes = 0;
+        start = bench_start();
+        for (i = 0; i < NOPS; ++i)
+        {
+            size_t k = (size_t)(bench_rand(&seed) % LIVE);
+            size_t len = 16 + (size_t)(bench_rand(&seed) % 496);
+            if (live[k])
+            {
+                ss_free(&live[k]);
+            }
+            live[k] = ss_new(len);
+            bytes += (double)len;
+        }
+        for (i = 0; i < LIVE; ++i)
+        {
+            ss_free(&live[i]);
+        }
+        bench_report("churn/16-512", pass ? "ss_cache" : "malloc", bytes, bench_now() - start);
+    }
+    ss_cache_setdepth(0);
+}
+
+/**
+ * @brief Append a batch of metric values with snprintf and with the direct paths.
+ */
+static void
+bench_number(void)
+{
+    enum { COUNT = 4096, ROUNDS = 500 };
+    static const char *names[] = { "number/int64", "number/double", "number/hex" };
+    static const char *fmts[] = { "%lld ", "%.17g ", "%llX " };
+    static int64_t ints[COUNT];
+    static double reals[COUNT];
+    uint64_t seed = 0xA0761D6478BD642Full;
+    char buf[64];
+    double start;
+    int kind, r;
+    size_t i;
+
+    for (i = 0; i < COUNT; ++i)
+    {
+        uint64_t v = bench_rand(&seed);
+        /* Mostly small counters, some large and negative values. */
+        ints[i] = (int64_t)(v >> (v & 0x3F));
+        reals[i] = (double)(int64_t)(v % 1000000) / (double)(1 + (v >> 40) % 1000);
+    }
+
+    for (kind = 0; kind < 3; ++kind)
+    {
+        SS s = ss_new(COUNT * 24);
+        double bytes = 0;
+
+        start = bench_start();
+        for (r = 0; r < ROUNDS; ++r)
+        {
+            ss_clear(s);
+            for (i = 0; i < COUNT; ++i)
+            {
+                int n = 1 == kind ? snprintf(buf, sizeof(buf), fmts[kind], reals[i])
+                      : snprintf(buf, sizeof(buf), fmts[kind], (long long)ints[i]);
+                ss_cat(&s, buf, (size_t)n);
+            }
+            bench_use(s);
+            bytes += (double)ss_len(s);
+        }
+        bench_report(names[kind], "snprintf", bytes, bench_now() - start);
+
+        bytes = 0;
+        start = bench_start();
+        for (r = 0; r < ROUNDS; ++r)
+        {
+            ss_clear(s);
+            for (i = 0; i < COUNT; ++i)
+            {
+                if (0 == kind)
+                {
+                    ss_catint64(&s, ints[i]);
+                }
+                else if (1 == kind)
+                {
+                    ss_catdouble(&s, reals[i]);
+                }
+                else
+                {
+                    ss_cathex(&s, (uint64_t)ints[i]);
+                }
+                ss_cat(&s, " ", 1);
+            }
+            bench_use(s);
+            bytes += (double)ss_len(s);
+        }
+        bench_report(names[kind], 0 == kind ? "ss_catint64" : 1 == kind ? "ss_catdouble" : "ss_cathex",
+                     bytes, bench_now() - start);
+
+        ss_free(&s);
+    }
+}
+
+/**
+ * @brief The ssc_esc loop before the escape kernels, one ss_cat per byte.
+ */
+static void
+naive_esc(SS *s)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    SS t = ss_new(ss_len(*s) * 2);
+    ss_setgrow(&t, SS_GROW100);
+    const char *p = *s;
+
+    for (; *p; ++p)
+    {
+        const char *named = strchr("\a\b\x1B\f\n\r\t\v\\\'\"", *p);
+        if (named)
+        {
+            char buf[2] = { '\\', "abefnrtv\\\'\""[named - "\a\b\x1B\f\n\r\t\v\\\'\""] };
+            ss_cat(&t, buf, 2);
+        }
+        else if ((unsigned char)*p < 0x20 || 0x7F == *p)
+        {
+            char buf[4] = { '\\', 'x', hex[(unsigned char)*p >> 4], hex[*p & 0x0F] };
+            ss_cat(&t, buf, 4);
+        }
+        else
+        {
+            ss_cat(&t, p, 1);
+        }
+    }
+
+    ss_copy(s, t, ss_len(t));
+    ss_free(&t);
+}
+
+/**
+ * @brief Escape log fields where about one byte in a hundred needs it.
+ */
+static void
+bench_esc_one(const char *name, size_t size, int iters)
+{
+    static const char specials[] = "\"\\\n\t'";
+    uint64_t seed = 0x51AFD7ED558CCD1Dull;
+    SS field = ss_new(size);
+    SS s = ss_new(size * 2);
+    double start;
+    size_t i;
+    int n;
+
+    for (i = 0; i < size; ++i)
+    {
+        uint64_t r = bench_rand(&seed);
+        char c = (r % 100) ? (char)('a' + (r >> 8) % 26) : specials[(r >> 8) % 5];
+        ss_cat(&field, &c, 1);
+    }
+
+    start = bench_start();
+    for (n = 0; n < iters / 10; ++n)
+    {
+        ss_copy(&s, field, size);
+        naive_esc(&s);
+        bench_use(s);
+    }
+    bench_report(name, "before", (double)size * (iters / 10), bench_now() - start);
+
+    start = bench_start();
+    for (n = 0; n < iters; ++n)
+    {
+        ss_copy(&s, field, size);
+        ssc_esc(&s);
+        bench_use(s);
+    }
+    bench_report(name, "ssc_esc", (double)size * iters, bench_now() - start);
+
+    start = bench_start();
+    for (n = 0; n < iters; ++n)
+    {
+        ss_copy(&s, field, size);
+        ss_esc_json(&s);
+        bench_use(s);
+    }
+    bench_report(name, "ss_esc_json", (double)size * iters, bench_now() - start);
+
+    ss_free(&field);
+    ss_free(&s);
+}
+
+static void
+bench_esc(void)
+{
+    bench_esc_one("esc/64B", 64, 2000000);
+    bench_esc_one("esc/4KB", 4096, 50000);
+}
+
+/**
+ * @brief Byte at a time table codecs, the usual portable versions.
+ */
+static void
+naive_hexencode(char *dst, const unsigned char *src, size_t len)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+    {
+        dst[2 * i] = hex[src[i] >> 4];
+        dst[2 * i + 1] = hex[src[i] & 0x0F];
+    }
+}
+
+static void
+naive_b64encode(char *dst, const unsigned char *src, size_t len)
+{
+    static const char digits[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t i;
+
+    for (i = 0; i + 3 <= len; i += 3)
+    {
+        uint32_t v = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1] << 8) | src[i + 2];
+        *dst++ = digits[v >> 18];
+        *dst++ = digits[(v >> 12) & 0x3F];
+        *dst++ = digits[(v >> 6) & 0x3F];
+        *dst++ = digits[v & 0x3F];
+    }
+}
+
+/**
+ * @brief Encode and decode a 1MB binary payload.
+ */
+static void
+bench_codec(void)
+{
+    enum { SIZE = 1024 * 1024 - 1024 % 3, ITERS = 200 };
+    uint64_t seed = 0xC2B2AE3D27D4EB4Full;
+    char *raw = malloc(SIZE);
+    char *out = malloc(2 * SIZE);
+    SS hex = ss_empty();
+    SS b64 = ss_empty();
+    SS s = ss_new(2 * SIZE);
+    double start;
+    int i;
+
+    for (i = 0; i < SIZE; ++i)
+    {
+        raw[i] = (char)bench_rand(&seed);
+    }
+    ss_hexencode(&hex, raw, SIZE);
+    ss_b64encode(&b64, raw, SIZE);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        naive_hexencode(out, (const unsigned char *)raw, SIZE);
+        bench_use(out);
+    }
+    bench_report("hex/encode", "table", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        ss_clear(s);
+        ss_hexencode(&s, raw, SIZE);
+        bench_use(s);
+    }
+    bench_report("hex/encode", "ss_hexencode", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        ss_clear(s);
+        ss_hexdecode(&s, hex, ss_len(hex));
+        bench_use(s);
+    }
+    bench_report("hex/decode", "ss_hexdecode", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        naive_b64encode(out, (const unsigned char *)raw, SIZE);
+        bench_use(out);
+    }
+    bench_report("b64/encode", "table", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        ss_clear(s);
+        ss_b64encode(&s, raw, SIZE);
+        bench_use(s);
+    }
+    bench_report("b64/encode", "ss_b64encode", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        ss_clear(s);
+        ss_b64decode(&s, b64, ss_len(b64));
+        bench_use(s);
+    }
+    bench_report("b64/decode", "ss_b64decode", (double)SIZE * ITERS, bench_now() - start);
+
+    ss_free(&hex);
+    ss_free(&b64);
+    ss_free(&s);
+    free(raw);
+    free(out);
+}
+
+/**
+ * @brief The byte loops ss_rfind and ss_reverse used before the reverse
+ *        kernels. Kept here as the baselines.
+ */
+static const char *
+naive_memrchar(const char *buf, char find, size_t len)
+{
+    const char *end = buf + len;
+
+    while (buf < end)
+    {
+        if (find == *--end)
+        {
+            return end;
+        }
+    }
+
+    return NULL;
+}
+
+static size_t
+naive_rfind(const char *s, size_t slen, const char *cs, size_t len)
+{
+    size_t last = len - 1;
+    size_t searchlen = slen;
+    const char *cursor = s + slen - 1;
+
+    for (;;)
+    {
+        if (cs[last] != *cursor)
+        {
+            cursor = naive_memrchar(s, cs[last], searchlen - 1);
+            if (!cursor)
+            {
+                break;
+            }
+        }
+
+        searchlen = (cursor - s) + 1;
+
+        if (searchlen < len)
+        {
+            break;
+        }
+
+        if (0 == memcmp(cursor - last, cs, len))
+        {
+            return (cursor - last) - s;
+        }
+
+        --cursor;
+        --searchlen;
+    }
+
+    return NPOS;
+}
+
+static void
+naive_reverse(char *s, size_t len)
+{
+    char *end = s + len - 1;
+
+    while (s < end)
+    {
+        char tmp = *s;
+        *s++ = *end;
+        *end-- = tmp;
+    }
+}
+
+/**
+ * @brief Find the last delimiter and the last record in a 4MB log, and
+ *        reverse it in place.
+ */
+static void
+bench_reverse(void)
+{
+    enum { SIZE = 4 * 1024 * 1024, ITERS = 100 };
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    SS s = ss_new(SIZE);
+    double start;
+    size_t found = 0;
+    int i;
+
+    /* One '|' near the front, then lowercase text with the record at the start. */
+    ss_cat(&s, "BEGIN|", 6);
+    while (ss_len(s) < SIZE)
+    {
+        char c = (char)('a' + bench_rand(&seed) % 26);
+        ss_cat(&s, &c, 1);
+    }
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        found += (size_t)(naive_memrchar(s, '|', ss_len(s)) - s);
+    }
+    bench_report("rfind/char", "byte loop", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        found += ss_rfind(s, NPOS, "|", 1);
+    }
+    bench_report("rfind/char", "ss_rfind", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        found += naive_rfind(s, ss_len(s), "BEGIN", 5);
+    }
+    bench_report("rfind/word", "byte loop", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        found += ss_rfind(s, NPOS, "BEGIN", 5);
+    }
+    bench_report("rfind/word", "ss_rfind", (double)SIZE * ITERS, bench_now() - start);
+    bench_use(&found);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        naive_reverse(s, ss_len(s));
+        bench_use(s);
+    }
+    bench_report("reverse", "byte swap", (double)SIZE * ITERS, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < ITERS; ++i)
+    {
+        ss_reverse(s);
+        bench_use(s);
+    }
+    bench_report("reverse", "ss_reverse", (double)SIZE * ITERS, bench_now() - start);
+
+    ss_free(&s);
+}
+
+/**
+ * @brief Append chunks until the string is 256MB under one growth option.
+ */
+static void
+bench_grow_one(const char *variant, enum ss_grow_opt opt, size_t chunklen)
+{
+    enum { TOTAL = 256 * 1024 * 1024 };
+    static char chunk[64 * 1024];
+    char name[32];
+    SS s = ss_new(0);
+    size_t cap = 0;
+    size_t reallocs = 0;
+    double start;
+
+    memset(chunk, 'g', sizeof(chunk));
+    ss_setgrow(&s, opt);
+    snprintf(name, sizeof(name), "grow/256MB/%zuB", chunklen);
+
+    start = bench_start();
+    while (ss_len(s) < TOTAL)
+    {
+        ss_cat(&s, chunk, chunklen);
+        if (ss_cap(s) != cap)
+        {
+            cap = ss_cap(s);
+            ++reallocs;
+        }
+    }
+    bench_use(s);
+    bench_report(name, variant, TOTAL, bench_now() - start);
+    bench_report_value(name, variant, (double)reallocs, "reallocs");
+
+    ss_free(&s);
+}
+
+/**
+ * @brief Append the same chunks to a std::string, see bench_grow_one.
+ */
+static void
+bench_grow_std(size_t chunklen)
+{
+    char name[32];
+    size_t reallocs;
+    uint64_t allocs;
+
+    snprintf(name, sizeof(name), "grow/256MB/%zuB", chunklen);
+    double secs = bench_std_cat(256 * 1024 * 1024, chunklen, &reallocs, &allocs);
+    bench_report_std(name, "std::string", 256 * 1024 * 1024, secs, allocs);
+    bench_report_value(name, "std::string", (double)reallocs, "reallocs");
+}
+
+static void
+bench_grow(void)
+{
+    static const struct
+    {
+        const char *variant;
+        enum ss_grow_opt opt;
+    } opts[] =
+    {
+        { "growfit", SS_GROWFIT },
+        { "grow25", SS_GROW25 },
+        { "grow50", SS_GROW50 },
+        { "grow100", SS_GROW100 },
+        { "growclass", SS_GROWCLASS },
+        { "growpage", SS_GROWPAGE },
+        { "growhuge", SS_GROWHUGE },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(opts) / sizeof(opts[0]); ++i)
+    {
+        bench_grow_one(opts[i].variant, opts[i].opt, 64 * 1024);
+    }
+    bench_grow_std(64 * 1024);
+    /* Small appends, where the fixed growth options realloc the most. */
+    for (i = 1; i < sizeof(opts) / sizeof(opts[0]); ++i)
+    {
+        bench_grow_one(opts[i].variant, opts[i].opt, 100);
+    }
+    bench_grow_std(100);
+}
+
+/**
+ * @brief Build short strings on the stack, some spilling onto the heap,
+ *        against building them on the heap.
+ */
+static void
+bench_stack(void)
+{
+    enum { ITERS = 2000000 };
+    const char piece[] = "0123456789abcdef";
+    static const size_t lens[] = { 32, 64, 128 };
+    char name[32];
+    size_t k;
+    int i;
+
+    for (k = 0; k < sizeof(lens) / sizeof(lens[0]); ++k)
+    {
+        size_t len = lens[k];
+        double start;
+
+        snprintf(name, sizeof(name), "stack/%zuB-in-64B", len);
+
+        start = bench_start();
+        for (i = 0; i < ITERS; ++i)
+        {
+            SS s = ss_empty();
+            size_t n;
+            for (n = 0; n < len; n += 16)
+            {
+                ss_cat(&s, piece, 16);
+            }
+            bench_use(s);
+            ss_free(&s);
+        }
+        bench_report(name, "heap", (double)len * ITERS, bench_now() - start);
+
+        start = bench_start();
+        for (i = 0; i < ITERS; ++i)
+        {
+            ss_stack(s, 64);
+            size_t n;
+            for (n = 0; n < len; n += 16)
+            {
+                ss_cat(&s, piece, 16);
+            }
+            bench_use(s);
+            ss_free(&s);
+        }
+        bench_report(name, "ss_stack", (double)len * ITERS, bench_now() - start);
+    }
+}
+
+/**
+ * @brief Replace every match of a needle on the text and random corpora.
+ */
+static void
+bench_replace(void)
+{
+    SS text = corpus_text();
+    SS rnd = corpus_random();
+    double start;
+    int i;
+
+    start = bench_start();
+    for (i = 0; i < 4; ++i)
+    {
+        SS s = ss_dup(text);
+        ss_replace(&s, 0, "req_id=", 7, "request=", 8);
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report("replace/text", "ss_replace", (double)ss_len(text) * 4, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < 4; ++i)
+    {
+        SS s = ss_dup(rnd);
+        ss_replace(&s, 0, "\x01\x02", 2, "\x03", 1);
+        bench_use(s);
+        ss_free(&s);
+    }
+    bench_report("replace/random", "ss_replace", (double)ss_len(rnd) * 4, bench_now() - start);
+
+    ss_free(&text);
+    ss_free(&rnd);
+}
+
+/**
+ * @brief Pack then unpack the same fields, as a protocol round trip would.
+ */
+static void
+bench_roundtrip(void)
+{
+    const int iters = 5000000;
+    ss_packplan_t *plan = ss_packplan_compile("HIQ?");
+    double bytes = (double)ss_packplan_size(plan) * iters;
+    SS s = ss_new(64);
+    uint16_t h;
+    uint32_t v;
+    uint64_t q;
+    bool b;
+    double start;
+    int i;
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_packBE(&s, "HIQ?", i & 0xFFFF, (uint32_t)i, (uint64_t)i * 3, i & 1);
+        ss_unpackBE(s, "HIQ?", &h, &v, &q, &b);
+        bench_use(&q);
+    }
+    bench_report("roundtrip/HIQ?", "ss_packBE", bytes, bench_now() - start);
+
+    start = bench_start();
+    for (i = 0; i < iters; ++i)
+    {
+        ss_packplan_exec(&s, plan, i & 0xFFFF, (uint32_t)i, (uint64_t)i * 3, i & 1);
+        ss_unpackplan_exec(s, plan, &h, &v, &q, &b);
+        bench_use(&q);
+    }
+    bench_report("roundtrip/HIQ?", "packplan", bytes, bench_now() - start);
+
+    ss_free(&s);
+    ss_packplan_free(&plan);
+}
+
+/**
+ * @brief Header queries over many short strings, calls into the library
+ *        against the ss_inline.h versions.
+ */
+static void
+bench_inline(void)
+{
+    enum { ITERS = 20000 };
+    SS *all = malloc(SHORT_COUNT * sizeof(SS));
+    uint64_t state = 0x2545F4914F6CDD1Dull;
+    char buf[300];
+    double start;
+    size_t n = 0;
+    size_t i;
+    int r;
+
+    memset(buf, 'q', sizeof(buf));
+    for (i = 0; i < SHORT_COUNT; ++i)
+    {
+        all[i] = ss_newfrom(0, buf, bench_rand(&state) % sizeof(buf));
+    }
+
+    start = bench_start();
+    for (r = 0; r < ITERS; ++r)
+    {
+        for (i = 0; i < SHORT_COUNT; ++i)
+        {
+            n += ss_len(all[i]);
+        }
+        bench_use(&n);
+    }
+    bench_report_ops("len/4096", "ss_len", (double)ITERS * SHORT_COUNT, bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < ITERS; ++r)
+    {
+        for (i = 0; i < SHORT_COUNT; ++i)
+        {
+            n += ssi_len(all[i]);
+        }
+        bench_use(&n);
+    }
+    bench_report_ops("len/4096", "ssi_len", (double)ITERS * SHORT_COUNT, bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < ITERS / 10; ++r)
+    {
+        for (i = 1; i < SHORT_COUNT; ++i)
+        {
+            n += ss_equal(all[i - 1], all[i]);
+        }
+        bench_use(&n);
+    }
+    bench_report_ops("equal/4096", "ss_equal", (double)(ITERS / 10) * SHORT_COUNT, bench_now() - start);
+
+    start = bench_start();
+    for (r = 0; r < ITERS / 10; ++r)
+    {
+        for (i = 1; i < SHORT_COUNT; ++i)
+        {
+            n += ssi_equal(all[i - 1], all[i]);
+        }
+        bench_use(&n);
+    }
+    bench_report_ops("equal/4096", "ssi_equal", (double)(ITERS / 10) * SHORT_COUNT, bench_now() - start);
+
+    for (i = 0; i < SHORT_COUNT; ++i)
+    {
+        ss_free(&all[i]);
+    }
+    free(all);
+}
+
+static int
+bench_compare_ss(const void *a, const void *b)
+{
+    return ss_compare(*(const SS *)a, *(const SS *)b);
+}
+
+/**
+ * @brief Sort a million log keys sharing "svc.<name>." prefixes,
+ *        qsort with ss_compare against ss_sort.
+ */
+static void
+bench_sort(void)
+{
+    enum { N = 1000000 };
+    static const char *svcs[] = { "auth", "billing", "gateway", "search" };
+    uint64_t seed = 0xBF58476D1CE4E5B9ull;
+    SS *keys = malloc(N * sizeof(SS));
+    SS *work = malloc(N * sizeof(SS));
+    char buf[64];
+    double start;
+    size_t i;
+
+    for (i = 0; i < N; ++i)
+    {
+        int n = snprintf(buf, sizeof(buf), "svc.%s.host%02u.%016llx",
+                         svcs[bench_rand(&seed) % 4], (unsigned)(bench_rand(&seed) % 32),
+                         (unsigned long long)bench_rand(&seed));
+        keys[i] = ss_newfrom(0, buf, (size_t)n);
+    }
+
+    memcpy(work, keys, N * sizeof(SS));
+    start = bench_start();
+    qsort(work, N, sizeof(SS), bench_compare_ss);
+    bench_report_ops("sort/1M", "qsort", N, bench_now() - start);
+
+    memcpy(work, keys, N * sizeof(SS));
+    start = bench_start();
+    ss_sort(work, N);
+    bench_report_ops("sort/1M", "ss_sort", N, bench_now() - start);
+    bench_use(work);
+
+    for (i = 0; i < N; ++i)
+    {
+        ss_free(&keys[i]);
+    }
+    free(keys);
+    free(work);
+}
+
+/**
+ * @brief Count and find "ERROR" in a 256MB log, ss_count against the pool.
+ */
+static void
+bench_parallel(void)
+{
+    enum { SIZE = 256 * 1024 * 1024, MAXPOS = 1 << 20 };
+    uint64_t seed = 0xD1B54A32D192ED03ull;
+    SS s = ss_new(SIZE);
+    size_t *pos = malloc(MAXPOS * sizeof(size_t));
+    size_t found = 0;
+    double start;
+
+    while (ss_len(s) < SIZE)
+    {
+        char line[96];
+        int n = snprintf(line, sizeof(line), "2024-01-01T00:00:00 %s request id=%016llx\n",
+                         bench_rand(&seed) % 64 ? "INFO " : "ERROR",
+                         (unsigned long long)bench_rand(&seed));
+        ss_cat(&s, line, (size_t)n);
+    }
+
+    start = bench_start();
+    found += ss_count(s, 0, "ERROR", 5);
+    bench_report("count/256MB", "ss_count", (double)ss_len(s), bench_now() - start);
+
+    start = bench_start();
+    found += ss_count_parallel(s, 0, "ERROR", 5);
+    bench_report("count/256MB", "ss_count_parallel", (double)ss_len(s), bench_now() - start);
+
+    start = bench_start();
+    found += ss_find_all_parallel(s, 0, "ERROR", 5, pos, MAXPOS);
+    bench_report("count/256MB", "ss_find_all_parallel", (double)ss_len(s), bench_now() - start);
+    bench_use(&found);
+    bench_use(pos);
+
+    free(pos);
+    ss_free(&s);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    bench_begin(argc, argv);
+    bench_find();
+    bench_replace();
+    bench_footprint();
+    bench_short();
+    bench_inline();
+    bench_stack();
+    bench_catf();
+    bench_number();
+    bench_pack();
+    bench_pack_array();
+    bench_roundtrip();
+    bench_replacemany();
+    bench_builder();
+    bench_split();
+    bench_hash();
+    bench_intern();
+    bench_cache();
+    bench_case();
+    bench_utf8();
+    bench_transcode();
+    bench_esc();
+    bench_codec();
+    bench_reverse();
+    bench_grow();
+    bench_sort();
+    bench_parallel();
+    bench_end();
+    return 0;
+}
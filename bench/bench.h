@@ -0,0 +1,315 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file bench.h
+ * @author Craig Jacobson
+ * @brief Tiny helpers for the micro-benchmarks.
+ */
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "ss.h"
+
+/**
+ * @return Monotonic time in seconds.
+ */
+static inline double
+bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Deterministic xorshift so runs are reproducible.
+ */
+static inline uint64_t
+bench_rand(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+/**
+ * @brief Keep the optimizer from discarding a result.
+ */
+static inline void
+bench_use(const void *p)
+{
+    __asm__ __volatile__("" : : "g"(p) : "memory");
+}
+
+/*
+ * Results are printed as aligned text, JSON, or CSV, see bench_begin.
+ * The global allocator is replaced by one counting its calls, each row
+ * carries the calls since bench_start. Cycles are TSC ticks, calibrated
+ * against the monotonic clock; reported as zero where there is no TSC.
+ */
+typedef enum bench_format_e
+{
+    BENCH_TEXT,
+    BENCH_JSON,
+    BENCH_CSV,
+} bench_format_t;
+
+static struct
+{
+    bench_format_t format;
+    /* TSC ticks per second; zero if unknown. */
+    double tsc_hz;
+    /* Allocator calls so far and at bench_start. */
+    uint64_t allocs;
+    uint64_t mark;
+    size_t rows;
+} g_bench;
+
+static void *
+bench_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    ++g_bench.allocs;
+    return malloc(size);
+}
+
+static void *
+bench_realloc(void *ctx, void *mem, size_t size)
+{
+    (void)ctx;
+    ++g_bench.allocs;
+    return realloc(mem, size);
+}
+
+static void
+bench_free(void *ctx, void *mem)
+{
+    (void)ctx;
+    free(mem);
+}
+
+#ifdef __GLIBC__
+static size_t
+bench_usable(void *ctx, void *mem)
+{
+    (void)ctx;
+    return malloc_usable_size(mem);
+}
+#define BENCH_USABLE bench_usable
+#else
+#define BENCH_USABLE NULL
+#endif
+
+static const ss_allocator_t g_bench_allocator =
+{
+    bench_alloc,
+    bench_realloc,
+    bench_free,
+    BENCH_USABLE,
+    NULL,
+};
+
+/**
+ * @return TSC ticks per second, zero where there is no TSC.
+ */
+static inline double
+bench_calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    double start = bench_now();
+    uint64_t t0 = __rdtsc();
+    while (bench_now() - start < 0.05)
+    {
+    }
+    return (double)(__rdtsc() - t0) / (bench_now() - start);
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Parse the options and print the header.
+ * @note `--json` and `--csv` choose the format, text otherwise.
+ */
+static inline void
+bench_begin(int argc, char **argv)
+{
+    int i;
+
+    for (i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--json"))
+        {
+            g_bench.format = BENCH_JSON;
+        }
+        else if (!strcmp(argv[i], "--csv"))
+        {
+            g_bench.format = BENCH_CSV;
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--json | --csv]\n", argv[0]);
+            exit(2);
+        }
+    }
+
+    g_bench.tsc_hz = bench_calibrate();
+    ss_setglobalallocator(&g_bench_allocator);
+
+    if (BENCH_JSON == g_bench.format)
+    {
+        printf("[\n");
+    }
+    else if (BENCH_CSV == g_bench.format)
+    {
+        printf("name,variant,seconds,bytes,ops,value,unit,gbps,cycles_per_byte,ns_per_op,allocs\n");
+    }
+}
+
+/**
+ * @brief Close the output.
+ */
+static inline void
+bench_end(void)
+{
+    ss_setglobalallocator(NULL);
+
+    if (BENCH_JSON == g_bench.format)
+    {
+        printf("\n]\n");
+    }
+}
+
+/**
+ * @return Monotonic time in seconds, and marks the allocator calls.
+ */
+static inline double
+bench_start(void)
+{
+    g_bench.mark = g_bench.allocs;
+    return bench_now();
+}
+
+/**
+ * @brief Print one row.
+ * @param bytes - Bytes processed; zero if not a throughput.
+ * @param ops - Operations done; zero if not a latency.
+ * @param unit - Unit of value, NULL for a timed row.
+ */
+static inline void
+bench_row(const char *name, const char *variant, double secs, double bytes, double ops,
+          double value, const char *unit)
+{
+    uint64_t allocs = g_bench.allocs - g_bench.mark;
+    double gbps = bytes && secs ? (bytes / secs) / 1e9 : 0;
+    double cpb = bytes ? (secs * g_bench.tsc_hz) / bytes : 0;
+    double nsop = ops ? (secs / ops) * 1e9 : 0;
+
+    switch (g_bench.format)
+    {
+        case BENCH_JSON:
+            printf("%s  {\"name\": \"%s\", \"variant\": \"%s\", \"seconds\": %.9g, "
+                   "\"bytes\": %.17g, \"ops\": %.17g, \"value\": %.9g, \"unit\": \"%s\", "
+                   "\"gbps\": %.6g, \"cycles_per_byte\": %.6g, \"ns_per_op\": %.6g, "
+                   "\"allocs\": %llu}",
+                   g_bench.rows ? ",\n" : "", name, variant, secs, bytes, ops, value,
+                   unit ? unit : "", gbps, cpb, nsop, (unsigned long long)allocs);
+            break;
+        case BENCH_CSV:
+            printf("%s,%s,%.9g,%.17g,%.17g,%.9g,%s,%.6g,%.6g,%.6g,%llu\n",
+                   name, variant, secs, bytes, ops, value, unit ? unit : "",
+                   gbps, cpb, nsop, (unsigned long long)allocs);
+            break;
+        default:
+            if (unit)
+            {
+                printf("%-24s %-12s %10.2f %s\n", name, variant, value, unit);
+            }
+            else if (bytes)
+            {
+                printf("%-24s %-12s %10.3f GB/s %8.3f c/B %10llu allocs\n",
+                       name, variant, gbps, cpb, (unsigned long long)allocs);
+            }
+            else
+            {
+                printf("%-24s %-12s %10.2f ns/op %10llu allocs\n",
+                       name, variant, nsop, (unsigned long long)allocs);
+            }
+            break;
+    }
+    ++g_bench.rows;
+}
+
+/**
+ * @brief Print a throughput row.
+ */
+static inline void
+bench_report(const char *name, const char *variant, double bytes, double secs)
+{
+    bench_row(name, variant, secs, bytes, 0, 0, NULL);
+}
+
+/**
+ * @brief Print a throughput row timed in bench_std.cpp.
+ * @param allocs - Calls to operator new, there are none to the SS allocator.
+ */
+static inline void
+bench_report_std(const char *name, const char *variant, double bytes, double secs,
+                 uint64_t allocs)
+{
+    g_bench.mark = g_bench.allocs - allocs;
+    bench_row(name, variant, secs, bytes, 0, 0, NULL);
+}
+
+/**
+ * @brief Print a latency row.
+ */
+static inline void
+bench_report_ops(const char *name, const char *variant, double ops, double secs)
+{
+    bench_row(name, variant, secs, 0, ops, 0, NULL);
+}
+
+/**
+ * @brief Print a row that isn't timed, e.g. a size.
+ */
+static inline void
+bench_report_value(const char *name, const char *variant, double value, const char *unit)
+{
+    bench_row(name, variant, 0, 0, 0, value, unit);
+}
+
+#endif /* BENCH_H_ */
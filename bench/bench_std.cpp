@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file bench_std.cpp
+ * @author Craig Jacobson
+ * @brief std::string baselines for the micro-benchmarks, see bench_std.h.
+ */
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "bench_std.h"
+
+static uint64_t g_std_allocs = 0;
+
+void *
+operator new(std::size_t size)
+{
+    ++g_std_allocs;
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void
+operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+static double
+std_now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Keep the optimizer from discarding a result, like bench_use. */
+static void
+std_use(const void *p)
+{
+    __asm__ __volatile__("" : : "g"(p) : "memory");
+}
+
+double
+bench_std_find(const char *hay, size_t hlen, const char *needle, size_t nlen, int iters,
+               int count, uint64_t *allocs)
+{
+    const std::string h(hay, hlen);
+    const std::string n(needle, nlen);
+    uint64_t mark = g_std_allocs;
+    double start = std_now();
+
+    for (int i = 0; i < iters; ++i)
+    {
+        size_t found = 0;
+        size_t at = h.find(n);
+        while (count && std::string::npos != at)
+        {
+            ++found;
+            at = h.find(n, at + nlen);
+        }
+        found += std::string::npos != at;
+        std_use(&found);
+    }
+
+    double secs = std_now() - start;
+    *allocs = g_std_allocs - mark;
+    return secs;
+}
+
+double
+bench_std_cat(size_t total, size_t chunklen, size_t *reallocs, uint64_t *allocs)
+{
+    const std::string chunk(chunklen, 'g');
+    uint64_t mark = g_std_allocs;
+    double start = std_now();
+    size_t cap = 0;
+    size_t changes = 0;
+
+    std::string s;
+
+    while (s.size() < total)
+    {
+        s.append(chunk);
+        if (s.capacity() != cap)
+        {
+            cap = s.capacity();
+            ++changes;
+        }
+    }
+    std_use(s.data());
+
+    /* Freed after timing, like ss_free in bench_grow_one. */
+    double secs = std_now() - start;
+    *reallocs = changes;
+    *allocs = g_std_allocs - mark;
+    return secs;
+}
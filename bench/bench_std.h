@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file bench_std.h
+ * @author Craig Jacobson
+ * @brief std::string baselines for the micro-benchmarks.
+ *
+ * bench.c reports the rows, these only time the workloads. std::string
+ * allocates with operator new rather than the global SS allocator, so the
+ * calls to it are handed back to be added to the row.
+ */
+#ifndef BENCH_STD_H_
+#define BENCH_STD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Search a copy of hay with std::string::find iters times.
+ * @param count - Count every non-overlapping match, like ss_count;
+ *                otherwise stop at the first, like ss_find.
+ * @param allocs - Set to the calls to operator new while timed.
+ * @return Seconds spent searching.
+ */
+double
+bench_std_find(const char *hay, size_t hlen, const char *needle, size_t nlen, int iters,
+               int count, uint64_t *allocs);
+
+/**
+ * @brief Append chunklen bytes at a time to a std::string until it holds total.
+ * @param reallocs - Set to the number of capacity changes.
+ * @param allocs - Set to the calls to operator new while timed.
+ * @return Seconds spent appending.
+ */
+double
+bench_std_cat(size_t total, size_t chunklen, size_t *reallocs, uint64_t *allocs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_STD_H_ */
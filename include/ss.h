@@ -29,6 +29,8 @@
  * - ssc_ is for manipulating ss buffers assumed to be c strings (US ASCII/UTF8).
  * - ssu_ is for Unicode code-point operations.
  * - ssu8_ is for UTF8 operations.
+ * - ssu16_ and ssu32_ are for UTF16 and UTF32 operations.
+ * - ssi_ is for the static inline queries in ss_inline.h.
  * - sse_ is for exporting internal functions primarily for testing.
  */
 #ifndef SS_H_
@@ -41,6 +43,7 @@ extern "C" {
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 
 #ifndef NPOS
@@ -48,6 +51,11 @@ extern "C" {
 #define NPOS ((size_t)-1)
 #endif
 
+#ifndef SS_CACHE_MAX_DEPTH
+/** @brief Bound on the depth of the thread cache, see ss_cache_setdepth. */
+#define SS_CACHE_MAX_DEPTH (256)
+#endif
+
 /**
  * @brief Definition of SS.
  *        This should help it work with c-string functions
@@ -73,8 +81,135 @@ enum ss_grow_opt
     SS_GROW50  = 2,
     /** @brief Grow the buffer by 100% on reallocation. */
     SS_GROW100 = 3,
+    /**
+     * @brief Round the buffer up to the next allocator size class,
+     *        four classes per doubling, so growth is still geometric.
+     */
+    SS_GROWCLASS = 4,
+    /**
+     * @brief Grow the buffer by 50% rounded up to whole pages,
+     *        without the `SS_MAX_REALLOC` limit.
+     */
+    SS_GROWPAGE = 5,
+    /**
+     * @brief Grow like `SS_GROWPAGE` in a mapping of the string's own,
+     *        mremap resizes it so growing never copies.
+     * @note Meant for strings reaching many megabytes, even a short one
+     *       takes a whole page.
+     */
+    SS_GROWHUGE = 6,
 };
 
+/**
+ * @brief Pluggable allocator for string storage.
+ * @note Each function receives `ctx` as its first argument.
+ * @note Returning NULL from alloc/realloc aborts like the default allocator.
+ */
+typedef struct ss_allocator_s
+{
+    /** @brief Allocate size bytes. */
+    void *(*alloc)(void *ctx, size_t size);
+    /** @brief Resize the block, moving it if needed. */
+    void *(*realloc)(void *ctx, void *mem, size_t size);
+    /** @brief Free the block. */
+    void (*free)(void *ctx, void *mem);
+    /** @brief Optional, usable size of the block; may be NULL. */
+    size_t (*usable)(void *ctx, void *mem);
+    /** @brief User data passed to each function. */
+    void *ctx;
+} ss_allocator_t;
+
+/** @brief Buckets of the ss_stats_t histograms, enough for any capacity. */
+#define SS_STATS_BUCKETS (33)
+
+/**
+ * @brief Counters of a library built with SS_STATS, see ss_stats_snapshot.
+ */
+typedef struct ss_stats_s
+{
+    /** @brief Heap strings allocated. */
+    uint64_t allocs;
+    /** @brief Heap strings freed. */
+    uint64_t frees;
+    /** @brief Empty, stack, mapped, and shared strings moved to the heap. */
+    uint64_t promotions;
+    /** @brief Resizes to an exact capacity. */
+    uint64_t reallocs;
+    /** @brief Resizes applying the growth option. */
+    uint64_t grows;
+    /** @brief Bytes of string data copied to new storage, moving reallocs included. */
+    uint64_t bytes_copied;
+    /** @brief Capacity left unused by heap strings when freed. */
+    uint64_t bytes_wasted;
+    /** @brief Freed heap strings by bit width of their final length. */
+    uint64_t len_hist[SS_STATS_BUCKETS];
+    /** @brief Freed heap strings by bit width of their final capacity. */
+    uint64_t cap_hist[SS_STATS_BUCKETS];
+} ss_stats_t;
+
+/**
+ * @brief Called after a string is reallocated, see ss_stats_sethook.
+ */
+typedef void (*ss_realloc_hook_t)(void *ctx, const char *s, size_t oldcap, size_t newcap);
+
+/**
+ * @brief Arena for request-scoped strings, see ss_arena_new.
+ */
+typedef struct ss_arena_s ss_arena_t;
+
+/**
+ * @brief Compiled pack format, see ss_packplan_compile.
+ */
+typedef struct ss_packplan_s ss_packplan_t;
+
+/**
+ * @brief Position in an array of strings or in the chunks of a builder,
+ *        for resuming ss_writev or ss_builder_writev.
+ */
+typedef struct ss_wcursor_s
+{
+    /** @brief Index of the string or chunk being written. */
+    size_t index;
+    /** @brief Bytes of that string already written. */
+    size_t offset;
+} ss_wcursor_t;
+
+/**
+ * @brief Non-owning view of bytes, see ss_view.
+ */
+typedef struct ss_view_s
+{
+    /** @brief Start of the bytes; not terminated. */
+    const char *ptr;
+    /** @brief Number of bytes. */
+    size_t len;
+} ss_view_t;
+
+/**
+ * @brief Iterator over the fields of a view, see ss_split_next.
+ */
+typedef struct ss_split_s
+{
+    /** @brief Bytes being split. */
+    const char *ptr;
+    /** @brief Number of bytes. */
+    size_t len;
+    /** @brief Start of the next field. */
+    size_t pos;
+    /** @brief True once the last field was given. */
+    bool done;
+} ss_split_t;
+
+/**
+ * @brief Table of canonical strings, see ss_intern_new.
+ */
+typedef struct ss_intern_table_s ss_intern_table_t;
+
+/**
+ * @brief Chunked string builder, see ss_builder_new.
+ */
+typedef struct ss_builder_s ss_builder_t;
+
 /// @cond DOXYGEN_IGNORE
 
 /* Constructors */
@@ -85,11 +220,31 @@ ss_new(size_t);
 SS
 ss_newfrom(size_t, const char *, size_t);
 SS
+ss_newfrom_allocator(const ss_allocator_t *, size_t, const char *, size_t);
+SS
 ss_dup(SS);
+ss_arena_t *
+ss_arena_new(size_t);
+void
+ss_arena_reset(ss_arena_t *);
+void
+ss_arena_free(ss_arena_t **);
+SS
+ss_new_aligned(size_t);
+SS
+ss_newfrom_aligned(size_t, const char *, size_t);
+SS
+ss_new_arena(ss_arena_t *, size_t);
+SS
+ss_newfrom_arena(ss_arena_t *, size_t, const char *, size_t);
+SS
+ss_share(SS *);
+void
+ss_unshare(SS *);
 void
 ss_free(SS *);
 
-#define SS_HEADER_SIZE ((sizeof(size_t)*2) + (sizeof(uint32_t)))
+#define SS_HEADER_SIZE ((sizeof(size_t)*2) + sizeof(uint32_t) + sizeof(uint8_t))
 
 /**
  * @brief Internal use only.
@@ -127,19 +282,91 @@ ss_isstacktype(const SS);
 bool
 ss_isheaptype(const SS);
 bool
+ss_isarenatype(const SS);
+bool
+ss_ismappedtype(const SS);
+bool
+ss_issharedtype(const SS);
+bool
+ss_isaligned(const SS);
+bool
 ss_equal(const SS, const SS);
 int
 ss_compare(const SS, const SS);
+bool
+ss_caseequal(const SS, const SS);
+int
+ss_casecompare(const SS, const SS);
 size_t
 ss_find(const SS, size_t, const char *, size_t);
 size_t
+ss_casefind(const SS, size_t, const char *, size_t);
+size_t
 ss_rfind(const SS, size_t, const char *, size_t);
 size_t
 ss_count(const SS, size_t, const char *, size_t);
+uint64_t
+ss_hash(const SS);
+
+/* Views */
+ss_view_t
+ss_view(const SS);
+ss_view_t
+ss_view_of(const char *, size_t);
+ss_view_t
+ss_view_sub(ss_view_t, size_t, size_t);
+size_t
+ss_find_view(ss_view_t, size_t, const char *, size_t);
+size_t
+ss_rfind_view(ss_view_t, size_t, const char *, size_t);
+size_t
+ss_count_view(ss_view_t, size_t, const char *, size_t);
+bool
+ss_equal_view(ss_view_t, ss_view_t);
+int
+ss_compare_view(ss_view_t, ss_view_t);
+uint64_t
+ss_hash_view(ss_view_t);
+
+/* Bulk */
+void
+ss_sort(SS *, size_t);
+void
+ss_parallel_setchunk(size_t);
+size_t
+ss_count_parallel(const SS, size_t, const char *, size_t);
+size_t
+ss_find_all_parallel(const SS, size_t, const char *, size_t, size_t *, size_t);
+
+/* Interning */
+ss_intern_table_t *
+ss_intern_new(size_t);
+void
+ss_intern_free(ss_intern_table_t **);
+SS
+ss_intern(ss_intern_table_t *, const char *, size_t);
+SS
+ss_intern_ss(ss_intern_table_t *, const SS);
+SS
+ss_intern_find(const ss_intern_table_t *, const char *, size_t);
+size_t
+ss_intern_count(const ss_intern_table_t *);
+void
+ss_split_init(ss_split_t *, ss_view_t);
+bool
+ss_split_next(ss_split_t *, const char *, size_t, ss_view_t *);
 size_t
 ss_unpackBE(const SS, const char *, ...);
 size_t
 ssb_unpackBE(size_t blen, unsigned char *buf, const char *fmt, ...);
+size_t
+ss_unpackLE(const SS, const char *, ...);
+size_t
+ssb_unpackLE(size_t blen, unsigned char *buf, const char *fmt, ...);
+size_t
+ss_unpackplan_exec(const SS, const ss_packplan_t *, ...);
+size_t
+ssb_unpackplan_exec(size_t blen, const unsigned char *buf, const ss_packplan_t *, ...);
 
 /* Adjust Length */
 void
@@ -153,6 +380,14 @@ ss_setgrow(SS *, enum ss_grow_opt);
 void
 ss_heapify(SS *);
 void
+ss_setallocator(SS *, const ss_allocator_t *);
+const ss_allocator_t *
+ss_getallocator(const SS);
+void
+ss_setglobalallocator(const ss_allocator_t *);
+const ss_allocator_t *
+ss_getglobalallocator(void);
+void
 ss_swap(SS *, SS *);
 void
 ss_reserve(SS *, size_t);
@@ -163,6 +398,20 @@ ss_resize(SS *, size_t);
 void
 ss_addcap(SS *, size_t);
 
+/* Thread Cache */
+void
+ss_cache_setdepth(size_t);
+void
+ss_cache_flush(void);
+
+/* Statistics */
+bool
+ss_stats_snapshot(ss_stats_t *);
+bool
+ss_stats_thread(ss_stats_t *);
+bool
+ss_stats_sethook(ss_realloc_hook_t, void *);
+
 
 /* Modify without Realloc */
 void
@@ -183,6 +432,10 @@ ss_trimrange(SS, size_t, size_t, const char *, size_t);
 void
 ssc_trim(SS, const char *);
 void
+ss_upper(SS);
+void
+ss_lower(SS);
+void
 ssc_upper(SS);
 void
 ssc_lower(SS);
@@ -199,6 +452,8 @@ ss_lcat(SS *, const char *, size_t);
 void
 ss_replace(SS *, size_t, const char *, size_t, const char *, size_t);
 void
+ss_replacemany(SS *, const char **, size_t *, const char **, size_t *, size_t);
+void
 ss_replacerange(SS *, size_t, size_t, const char *, size_t);
 void
 ss_insert(SS *, size_t, const char *, size_t);
@@ -221,13 +476,85 @@ void
 ss_catint64(SS *, int64_t);
 void
 ss_catuint64(SS *, uint64_t);
+void
+ss_cathex(SS *, uint64_t);
+void
+ss_catdouble(SS *, double);
+void
+ss_hexencode(SS *, const char *, size_t);
+bool
+ss_hexdecode(SS *, const char *, size_t);
+void
+ss_b64encode(SS *, const char *, size_t);
+bool
+ss_b64decode(SS *, const char *, size_t);
 size_t
 ss_packBE(SS *, const char *, ...);
 size_t
 ss_catpackBE(SS *, const char *, ...);
+size_t
+ss_packLE(SS *, const char *, ...);
+size_t
+ss_catpackLE(SS *, const char *, ...);
+ss_packplan_t *
+ss_packplan_compile(const char *);
+void
+ss_packplan_free(ss_packplan_t **);
+size_t
+ss_packplan_size(const ss_packplan_t *);
+size_t
+ss_packplan_exec(SS *, const ss_packplan_t *, ...);
+size_t
+ss_catpackplan_exec(SS *, const ss_packplan_t *, ...);
 
 void
 ssc_esc(SS *);
+void
+ssc_esc_json(SS *);
+void
+ss_esc_json(SS *);
+
+/* Builder */
+ss_builder_t *
+ss_builder_new(size_t);
+void
+ss_builder_free(ss_builder_t **);
+void
+ss_builder_reset(ss_builder_t *);
+size_t
+ss_builder_len(const ss_builder_t *);
+void
+ss_builder_append(ss_builder_t *, const char *, size_t);
+#ifdef __GNU_LIBRARY__
+int
+ss_builder_appendf(ss_builder_t *, const char *fmt, ...)
+                   __attribute__((format(printf, 2, 3)));
+#else
+int
+ss_builder_appendf(ss_builder_t *, const char *fmt, ...);
+#endif
+void
+ss_builder_appendint(ss_builder_t *, int64_t);
+void
+ss_builder_appenduint(ss_builder_t *, uint64_t);
+SS
+ss_builder_finish(ss_builder_t *);
+int
+ss_builder_writev(const ss_builder_t *, int, ss_wcursor_t *);
+
+/* I/O */
+ssize_t
+ss_catread(SS *, int, size_t);
+ssize_t
+ss_catrecv(SS *, int, size_t, int);
+int
+ss_readfd(SS *, int);
+SS
+ss_mapfile(const char *);
+int
+ss_writefd(const SS, int, size_t *);
+int
+ss_writev(const SS *, size_t, int, ss_wcursor_t *);
 
 /* Unicode UTF-8 */
 #define SS_UTF8_SEQ_MAX (5)
@@ -243,6 +570,22 @@ int
 ssu8_cptoseq(unicode_t, char *);
 int
 ssu8_seqtocp(const char *, unicode_t *);
+bool
+ssu8_validate(const SS);
+size_t
+ssu8_len(const SS);
+size_t
+ssu8_index(const SS, size_t);
+size_t
+ssu8_utf16len(const SS);
+size_t
+ssu8_to_utf16(const SS, uint16_t *);
+size_t
+ssu8_to_utf32(const SS, uint32_t *);
+bool
+ssu16_to_utf8(SS *, const uint16_t *, size_t);
+bool
+ssu32_to_utf8(SS *, const uint32_t *, size_t);
 
 /* Exports */
 int
@@ -0,0 +1,246 @@
+/********************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file ss.hpp
+ * @author Craig Jacobson
+ * @brief C++17 owning wrappers for SS.
+ *
+ * ss::string owns a heap string and frees it when destroyed, it moves by
+ * taking the pointer and can't be copied (see clone). ss::stack_string<N>
+ * is the ss_stack macro as a type, it spills onto the heap past N bytes.
+ * Both convert to std::string_view without copying.
+ * @warning Functions taking `SS *` may move the string, call them through
+ *          ptr() so the wrapper keeps the new pointer.
+ */
+#ifndef SS_HPP_
+#define SS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+#include "ss.h"
+#include "ss_inline.h"
+
+namespace ss
+{
+
+namespace detail
+{
+
+/**
+ * @brief Accessors shared by the owning types.
+ */
+class base
+{
+public:
+    /** @return The string for ss_ functions taking `SS`. */
+    SS get() const noexcept { return s_; }
+    /** @return The string for ss_ functions taking `SS *`. */
+    SS *ptr() noexcept { return &s_; }
+
+    std::size_t size() const noexcept { return ssi_len(s_); }
+    std::size_t length() const noexcept { return ssi_len(s_); }
+    std::size_t capacity() const noexcept { return ssi_cap(s_); }
+    bool empty() const noexcept { return ssi_isempty(s_); }
+    /**
+     * @return The bytes, for writing in place.
+     * @note Drops the cached hash, so == and hash() see the writes.
+     * @warning Writes after a later hash() or == leave it stale again,
+     *          call ssi_unhash(get()) after them.
+     */
+    char *data() noexcept { ssi_unhash(s_); return s_; }
+    const char *data() const noexcept { return s_; }
+    const char *c_str() const noexcept { return s_; }
+    /** @note Drops the cached hash, see data(). */
+    char &operator[](std::size_t i) noexcept { ssi_unhash(s_); return s_[i]; }
+    const char &operator[](std::size_t i) const noexcept { return s_[i]; }
+
+    /** @return A view of the bytes, O(1) and without copying. */
+    operator std::string_view() const noexcept { return std::string_view(s_, ssi_len(s_)); }
+    std::string_view view() const noexcept { return *this; }
+
+    /**
+     * @return The hash cached by ss_hash.
+     * @note Writes the cache, with atomics, so concurrent calls on one const string are safe.
+     */
+    std::uint64_t hash() const noexcept { return ss_hash(s_); }
+
+    void clear() noexcept { ss_clear(s_); }
+    void reserve(std::size_t n) { ss_reserve(&s_, n); }
+    void append(std::string_view v) { ss_cat(&s_, v.data(), v.size()); }
+    void append(char c) { ss_cat(&s_, &c, 1); }
+
+    std::size_t find(std::string_view v, std::size_t index = 0) const noexcept
+    {
+        return ss_find(s_, index, v.data(), v.size());
+    }
+
+protected:
+    explicit base(SS s) noexcept : s_(s) {}
+    ~base() { ss_free(&s_); }
+
+    SS s_;
+};
+
+/**
+ * @brief Bytes of a stack_string, a base so they exist before the string.
+ */
+template <std::size_t N>
+struct storage
+{
+    char buf_[SS_HEADER_SIZE + N + 1];
+};
+
+/** @return a and b hold the same bytes, cached hashes reject early. */
+inline bool
+equal(const base &a, const base &b) noexcept
+{
+    return ssi_equal(a.get(), b.get());
+}
+
+} /* namespace detail */
+
+/**
+ * @brief Owning, move-only string.
+ * @note A moved-from string is empty, moving never allocates.
+ */
+class string : public detail::base
+{
+public:
+    string() noexcept : base(ss_empty()) {}
+    explicit string(std::string_view v) : base(ss_newfrom(0, v.data(), v.size())) {}
+    string(std::size_t cap, std::string_view v) : base(ss_newfrom(cap, v.data(), v.size())) {}
+
+    string(string &&o) noexcept : base(std::exchange(o.s_, ss_empty())) {}
+
+    string &
+    operator=(string &&o) noexcept
+    {
+        if (this != &o)
+        {
+            ss_free(&s_);
+            s_ = std::exchange(o.s_, ss_empty());
+        }
+        return *this;
+    }
+
+    string(const string &) = delete;
+    string &operator=(const string &) = delete;
+
+    /** @brief Take ownership of s, which the caller must not free. */
+    static string adopt(SS s) noexcept { return string(s, adopt_tag()); }
+
+    /** @return The string, now the caller's to free; this becomes empty. */
+    SS release() noexcept { return std::exchange(s_, ss_empty()); }
+
+    /** @return A copy, the only way to duplicate. */
+    string clone() const { return adopt(ss_dup(s_)); }
+
+    string &
+    operator+=(std::string_view v)
+    {
+        append(v);
+        return *this;
+    }
+
+    string &
+    operator+=(char c)
+    {
+        append(c);
+        return *this;
+    }
+
+    void swap(string &o) noexcept { std::swap(s_, o.s_); }
+
+private:
+    struct adopt_tag {};
+    string(SS s, adopt_tag) noexcept : base(s) {}
+};
+
+/**
+ * @brief String with N bytes of storage in the object, like ss_stack.
+ * @note Neither copied nor moved, the string points into the object.
+ *       Growing past N moves the string onto the heap, the destructor
+ *       frees it then.
+ */
+template <std::size_t N>
+class stack_string : private detail::storage<N>, public detail::base
+{
+public:
+    stack_string() noexcept : base(ss_stack_init(this->buf_, N)) {}
+    explicit stack_string(std::string_view v) : stack_string() { append(v); }
+
+    stack_string(const stack_string &) = delete;
+    stack_string &operator=(const stack_string &) = delete;
+
+    /** @return True while the bytes still fit in the object. */
+    bool on_stack() const noexcept { return ss_isstacktype(s_); }
+
+    stack_string &
+    operator+=(std::string_view v)
+    {
+        append(v);
+        return *this;
+    }
+
+    stack_string &
+    operator+=(char c)
+    {
+        append(c);
+        return *this;
+    }
+};
+
+inline bool operator==(const detail::base &a, const detail::base &b) noexcept { return detail::equal(a, b); }
+inline bool operator!=(const detail::base &a, const detail::base &b) noexcept { return !detail::equal(a, b); }
+inline bool operator==(const detail::base &a, std::string_view b) noexcept { return a.view() == b; }
+inline bool operator!=(const detail::base &a, std::string_view b) noexcept { return a.view() != b; }
+inline bool operator==(std::string_view a, const detail::base &b) noexcept { return a == b.view(); }
+inline bool operator!=(std::string_view a, const detail::base &b) noexcept { return a != b.view(); }
+inline bool operator<(const detail::base &a, const detail::base &b) noexcept { return ss_compare(a.get(), b.get()) < 0; }
+
+} /* namespace ss */
+
+namespace std
+{
+
+/**
+ * @brief Hashes with ss_hash, so the value is cached in the string.
+ * @note Safe on a string shared between threads, see ss::detail::base::hash.
+ */
+template <>
+struct hash<ss::string>
+{
+    size_t operator()(const ss::string &s) const noexcept { return static_cast<size_t>(s.hash()); }
+};
+
+template <size_t N>
+struct hash<ss::stack_string<N>>
+{
+    size_t operator()(const ss::stack_string<N> &s) const noexcept { return static_cast<size_t>(s.hash()); }
+};
+
+} /* namespace std */
+
+#endif /* SS_HPP_ */
@@ -0,0 +1,182 @@
+/********************************************************************************
+ * Copyright (c) 2019 Craig Jacobson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ ******************************************************************************/
+/**
+ * @file ss_inline.h
+ * @author Craig Jacobson
+ * @brief Static inline versions of the queries that only read the header.
+ *
+ * The ssi_ functions match ss_len, ss_cap, ss_isempty, ss_isaligned, and
+ * ss_equal, without the call into the library. Use them in hot loops.
+ * ssi_unhash drops the cached hash after the bytes are written in place.
+ * @note The header layout is mirrored from ss.c. Only use this file with
+ *       the library version it shipped with.
+ */
+#ifndef SS_INLINE_H_
+#define SS_INLINE_H_
+
+#include <string.h>
+#include "ss.h"
+
+/// @cond DOXYGEN_IGNORE
+
+/*
+ * The byte before the data holds the header class in its low bits.
+ * Compact headers are {cap, len, class} of 8, 16, or 32 bit fields, the
+ * full header is {size_t cap, size_t len, uint32_t type, class}, all packed.
+ */
+#define _SSI_HDR_MASK (0x03)
+#define _SSI_HDR_ALIGNED (0x20)
+#define _SSI_HDR_HASHED (0x40)
+
+static inline size_t
+_ssi_field(const char *at, size_t width)
+{
+    uint8_t v8;
+    uint16_t v16;
+    uint32_t v32;
+    size_t v;
+
+    switch (width)
+    {
+        case 1:
+            memcpy(&v8, at, 1);
+            return v8;
+        case 2:
+            memcpy(&v16, at, 2);
+            return v16;
+        case 4:
+            memcpy(&v32, at, 4);
+            return v32;
+        default:
+            memcpy(&v, at, sizeof(v));
+            return v;
+    }
+}
+
+/* Width of the cap and len fields by header class. */
+static inline size_t
+_ssi_width(const char *s)
+{
+    static const unsigned char widths[] = { sizeof(size_t), 1, 2, 4 };
+    return widths[((const uint8_t *)s)[-1] & _SSI_HDR_MASK];
+}
+
+/* The full header has the type between len and the class byte. */
+static inline size_t
+_ssi_gap(const char *s)
+{
+    return (((const uint8_t *)s)[-1] & _SSI_HDR_MASK) ? 1 : 1 + sizeof(uint32_t);
+}
+
+/// @endcond
+
+/**
+ * @return Length of the string, see ss_len.
+ */
+static inline size_t
+ssi_len(const char *s)
+{
+    size_t w = _ssi_width(s);
+    return _ssi_field(s - _ssi_gap(s) - w, w);
+}
+
+/**
+ * @return Capacity of the string, see ss_cap.
+ */
+static inline size_t
+ssi_cap(const char *s)
+{
+    size_t w = _ssi_width(s);
+    return _ssi_field(s - _ssi_gap(s) - 2 * w, w);
+}
+
+/**
+ * @return True if the length is zero, see ss_isempty.
+ */
+static inline bool
+ssi_isempty(const char *s)
+{
+    return !ssi_len(s);
+}
+
+/**
+ * @return True if the data starts on an SS_ALIGN byte boundary, see ss_isaligned.
+ */
+static inline bool
+ssi_isaligned(const char *s)
+{
+    return !!(((const uint8_t *)s)[-1] & _SSI_HDR_ALIGNED);
+}
+
+/**
+ * @return True if both strings are equal, see ss_equal.
+ */
+static inline bool
+ssi_equal(const char *s1, const char *s2)
+{
+    if (s1 == s2)
+    {
+        return true;
+    }
+
+    size_t len = ssi_len(s1);
+    if (len != ssi_len(s2))
+    {
+        return false;
+    }
+
+    /* Both cached hashes current, see ss_hash, which may be storing them. */
+    if ((__atomic_load_n((const uint8_t *)s1 - 1, __ATOMIC_ACQUIRE)
+         & __atomic_load_n((const uint8_t *)s2 - 1, __ATOMIC_ACQUIRE) & _SSI_HDR_HASHED)
+        && ssi_cap(s1) - len >= sizeof(uint64_t) && ssi_cap(s2) - len >= sizeof(uint64_t))
+    {
+        const uint8_t *h1 = (const uint8_t *)s1 + len + 1;
+        const uint8_t *h2 = (const uint8_t *)s2 + len + 1;
+
+        for (size_t i = 0; i < sizeof(uint64_t); ++i)
+        {
+            if (__atomic_load_n(&h1[i], __ATOMIC_RELAXED) != __atomic_load_n(&h2[i], __ATOMIC_RELAXED))
+            {
+                return false;
+            }
+        }
+    }
+
+    return 0 == memcmp(s1, s2, len);
+}
+
+/**
+ * @brief Drop the hash cached by ss_hash, call it when writing the bytes
+ *        in place without changing the length.
+ * @note Only writes when a hash is cached, so the shared empty strings
+ *       are left alone.
+ */
+static inline void
+ssi_unhash(char *s)
+{
+    if (((const uint8_t *)s)[-1] & _SSI_HDR_HASHED)
+    {
+        ((uint8_t *)s)[-1] &= (uint8_t)~_SSI_HDR_HASHED;
+    }
+}
+
+#endif /* SS_INLINE_H_ */
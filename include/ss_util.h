@@ -27,6 +27,9 @@
  * These can be replaced if there are better implementations that the user
  * prefers.
  * For example, maybe you prefer to use SSE instructions for memchr.
+ * The default ss_memmem is the library's own vector search engine.
+ * The ss_raw* functions back the default allocator, see ss_setglobalallocator
+ * to swap allocators at runtime.
  */
 #ifndef SS_UTIL_H_
 #define SS_UTIL_H_
@@ -42,19 +45,24 @@ extern "C" {
 #define ss_rawalloc _ss_rawalloc_impl
 #define ss_rawrealloc _ss_rawrealloc_impl
 #define ss_rawfree _ss_rawfree_impl
+#define ss_rawusable _ss_rawusable_impl
 
 #define ss_cstrlen strlen
 #define ss_cstrchar strchr
 #define ss_memcopy memcpy
 #define ss_memmove memmove
+#define ss_memset memset
 #define ss_memchar memchr
 #define ss_mmemchar memchr
 #define ss_memrchar _ss_memrchar
 #define ss_memcompare memcmp
+#define ss_memmem _ss_memmem
 #define ss_vsnprintf vsnprintf
 
-/* Maximum growth rate ~1MB (2**20). */
+/* Maximum growth rate of SS_GROW25 to SS_GROW100 ~1MB (2**20). */
+#ifndef SS_MAX_REALLOC
 #define SS_MAX_REALLOC (0x100000)
+#endif
 
 /// @endcond
 
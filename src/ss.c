@@ -32,15 +32,30 @@
  * - sse_ is for exporting internal functions primarily for testing.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+/* For mremap, see SS_GROWHUGE. */
+#define _GNU_SOURCE
+#endif
 #include "ss_util.h"
 #include "ss.h"
+#include "ss_inline.h"
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <features.h>
 #include <limits.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 #ifndef LIKELY
 #ifdef __GNUC__
@@ -74,11 +89,30 @@
 #endif
 #endif
 
-#define _SS_GROW_MAX (4)
+#define _SS_GROW_MAX (7)
 #define _SS_GROW_SHIFT (16)
 #define _SS_TYPE_MASK (0x0000FFFF)
+#define _SS_KIND_MASK (0x000000FF)
 #define _SS_GROW_MASK (0xFFFF0000)
 #define _SS_HEAP_ALLOCATED (0x00000100)
+#define _SS_CUSTOM_ALLOC (0x00000200)
+#define _SS_ALIGNED (0x00000400)
+
+/*
+ * Aligned strings start their data on an SS_ALIGN byte boundary.
+ * Build with SS_ALIGN_ALL to make every plain heap string aligned.
+ */
+#ifndef SS_ALIGN
+#define SS_ALIGN (16)
+#endif
+#if SS_ALIGN != 16 && SS_ALIGN != 32
+#error "SS_ALIGN must be 16 or 32"
+#endif
+#ifdef SS_ALIGN_ALL
+#define _SS_ALIGN_DEFAULT (_SS_ALIGNED)
+#else
+#define _SS_ALIGN_DEFAULT (0)
+#endif
 
 
 static void
@@ -128,22 +162,145 @@ _ss_rawfree_impl(void *mem)
     free(mem);
 }
 
+/**
+ * @internal
+ * @return Usable size of the block, zero if unknown.
+ */
+INLINE static size_t
+_ss_rawusable_impl(void *mem)
+{
+#ifdef __GLIBC__
+    return malloc_usable_size(mem);
+#else
+    (void)mem;
+    return 0;
+#endif
+}
+
+static void *
+_ss_default_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return ss_rawalloc(size);
+}
+
+static void *
+_ss_default_realloc(void *ctx, void *mem, size_t size)
+{
+    (void)ctx;
+    return ss_rawrealloc(mem, size);
+}
+
+static void
+_ss_default_free(void *ctx, void *mem)
+{
+    (void)ctx;
+    ss_rawfree(mem);
+}
+
+static size_t
+_ss_default_usable(void *ctx, void *mem)
+{
+    (void)ctx;
+    return ss_rawusable(mem);
+}
+
+static const ss_allocator_t g_ss_default_allocator =
+{
+    _ss_default_alloc,
+    _ss_default_realloc,
+    _ss_default_free,
+    _ss_default_usable,
+    NULL,
+};
+
+/* Used by every heap string that wasn't given its own allocator. */
+static const ss_allocator_t *g_ss_allocator = &g_ss_default_allocator;
+
 enum _sstring_type
 {
     _SSTRING_EMPTY = 0,
     _SSTRING_STACK = 1,
     _SSTRING_NORM  = 2,
+    _SSTRING_ARENA = 3,
+    _SSTRING_MAPPED = 4,
+    _SSTRING_SHARED = 5,
 };
 
 /// @cond DOXYGEN_IGNORE
 
+/*
+ * Header classes.
+ * The byte just before the string data (the last byte of every header)
+ * holds the class in its low bits, so the rest of the header can be found.
+ *
+ * The full header is used by the empty, stack, arena, and custom allocator
+ * strings.
+ * Plain heap strings use the smallest compact header that can hold their
+ * capacity, those are always heap allocated by the global allocator,
+ * only the growth option needs storing.
+ */
+#define _SS_HDR_FULL (0)
+#define _SS_HDR_8    (1)
+#define _SS_HDR_16   (2)
+#define _SS_HDR_32   (3)
+#define _SS_HDR_MASK (0x03)
+/* Growth option of compact headers. */
+#define _SS_HDR_GROW_SHIFT (2)
+#define _SS_HDR_GROW_MASK (0x1C)
+/*
+ * Data of a compact header is aligned to SS_ALIGN.
+ * The byte before the header then holds the distance back to the block,
+ * and the block is sized so whole SS_ALIGN chunks of the data can be read.
+ */
+#define _SS_HDR_ALIGNED (0x20)
+/*
+ * The hash cached past the sentinel is current, see ss_hash.
+ * Setting the length clears it, as does any write that keeps the length.
+ */
+#define _SS_HDR_HASHED (0x40)
+/*
+ * The block is a whole thread cache class, see _ss_cache_alloc.
+ * Only set on fresh blocks, anything that reallocates rewrites the header.
+ */
+#define _SS_HDR_CACHED (0x80)
+
 typedef struct _sstring_s
 {
     size_t cap;
     size_t len;
     uint32_t type;
+    uint8_t hdr;
 } __attribute__((packed)) _sstring_t;
 
+typedef struct _sstring8_s
+{
+    uint8_t cap;
+    uint8_t len;
+    uint8_t hdr;
+} __attribute__((packed)) _sstring8_t;
+
+typedef struct _sstring16_s
+{
+    uint16_t cap;
+    uint16_t len;
+    uint8_t hdr;
+} __attribute__((packed)) _sstring16_t;
+
+typedef struct _sstring32_s
+{
+    uint32_t cap;
+    uint32_t len;
+    uint8_t hdr;
+} __attribute__((packed)) _sstring32_t;
+
+/* ss_inline.h reads the headers on its own. */
+_Static_assert(_SSI_HDR_MASK == _SS_HDR_MASK && _SSI_HDR_ALIGNED == _SS_HDR_ALIGNED
+               && _SSI_HDR_HASHED == _SS_HDR_HASHED, "ss_inline.h header bits");
+_Static_assert(sizeof(_sstring_t) == 2 * sizeof(size_t) + sizeof(uint32_t) + 1
+               && sizeof(_sstring8_t) == 3 && sizeof(_sstring16_t) == 5
+               && sizeof(_sstring32_t) == 9, "ss_inline.h header layout");
+
 typedef struct _sstring_empty_s
 {
     _sstring_t m;
@@ -152,1853 +309,10523 @@ typedef struct _sstring_empty_s
 
 static _sstring_empty_t g_ss_empty[_SS_GROW_MAX] =
 {
-    { { 0, 0, SS_GROW0   << _SS_GROW_SHIFT }, 0 },
-    { { 0, 0, SS_GROW25  << _SS_GROW_SHIFT }, 0 },
-    { { 0, 0, SS_GROW50  << _SS_GROW_SHIFT }, 0 },
-    { { 0, 0, SS_GROW100 << _SS_GROW_SHIFT }, 0 },
+    { { 0, 0, SS_GROW0   << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
+    { { 0, 0, SS_GROW25  << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
+    { { 0, 0, SS_GROW50  << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
+    { { 0, 0, SS_GROW100 << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
+    { { 0, 0, SS_GROWCLASS << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
+    { { 0, 0, SS_GROWPAGE << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
+    { { 0, 0, SS_GROWHUGE << _SS_GROW_SHIFT, _SS_HDR_FULL }, 0 },
 };
 
 /// @endcond
 
-INLINE static _sstring_t *
-_ss_meta(SS s)
+/**
+ * @internal
+ * @return The header class of the string.
+ */
+INLINE static unsigned int
+_ss_hdr(const SS s)
 {
-    _sstring_t *m = (_sstring_t *)s;
-    return m - 1;
+    return ((const uint8_t *)s)[-1] & _SS_HDR_MASK;
 }
 
-INLINE static const _sstring_t *
-_ss_cmeta(const SS s)
+/**
+ * @internal
+ * @return True if the data is aligned to SS_ALIGN.
+ */
+INLINE static bool
+_ss_isaligned(const SS s)
 {
-    const _sstring_t *m = (const _sstring_t *)s;
-    return m - 1;
+    return !!(((const uint8_t *)s)[-1] & _SS_HDR_ALIGNED);
 }
 
 /**
  * @internal
- * @brief Convert metadata ref to SS.
+ * @return Size of the header for the class.
  */
-INLINE static SS
-_ss_string(_sstring_t *m)
+INLINE static size_t
+_ss_hdr_size(unsigned int hdr)
 {
-    return (SS)(m + 1);
+    static const unsigned char map[] =
+    {
+        sizeof(_sstring_t),
+        sizeof(_sstring8_t),
+        sizeof(_sstring16_t),
+        sizeof(_sstring32_t),
+    };
+    return map[hdr];
 }
 
 /**
  * @internal
- * @return Length of string.
+ * @return Largest capacity the class can hold.
  */
 INLINE static size_t
-_ss_len(const SS s)
+_ss_hdr_max(unsigned int hdr)
 {
-    return _ss_cmeta(s)->len;
+    switch (hdr)
+    {
+        case _SS_HDR_8:
+            return UINT8_MAX;
+        case _SS_HDR_16:
+            return UINT16_MAX;
+        default:
+            return ((size_t)UINT_MAX) - 2 - sizeof(_sstring_t);
+    }
 }
 
 /**
  * @internal
- * @return Type field of string.
+ * @return Smallest compact class that holds the capacity.
  */
-INLINE static uint32_t
-_ss_type(SS s)
+INLINE static unsigned int
+_ss_hdr_for(size_t cap)
 {
-    return _ss_meta(s)->type;
+    if (cap <= UINT8_MAX)
+    {
+        return _SS_HDR_8;
+    }
+    else if (cap <= UINT16_MAX)
+    {
+        return _SS_HDR_16;
+    }
+    return _SS_HDR_32;
 }
 
 /**
  * @internal
- * @return True if string is of the given type.
+ * @warning Only valid for the full header class.
  */
-INLINE static bool
-_ss_is_type(SS s, enum _sstring_type t)
+INLINE static _sstring_t *
+_ss_meta(SS s)
 {
-    return (_ss_meta(s)->type & _SS_TYPE_MASK) == (uint32_t)t;
+    _sstring_t *m = (_sstring_t *)s;
+    return m - 1;
 }
 
 /**
  * @internal
- * @return The maximum capacity.
+ * @warning Only valid for the full header class.
  */
-INLINE static size_t
-_ss_cap_max(void)
+INLINE static const _sstring_t *
+_ss_cmeta(const SS s)
 {
-    return ((size_t)UINT_MAX) - 2 - sizeof(_sstring_t);
+    const _sstring_t *m = (const _sstring_t *)s;
+    return m - 1;
 }
 
+#define _SS_COMPACT(T, S) (((T *)(S)) - 1)
+
 /**
  * @internal
- * @return True if the given capacity is in the valid range.
+ * @brief Convert metadata ref to SS.
  */
-INLINE static bool
-_ss_valid_cap(size_t cap)
+INLINE static SS
+_ss_string(_sstring_t *m)
 {
-    return !!(cap <= _ss_cap_max());
+    return (SS)(m + 1);
 }
 
 /**
  * @internal
- * @brief Adjust the capacity of the string to that given.
+ * @return Length of string.
  */
-INLINE static _sstring_t *
-_ss_realloc(_sstring_t *m, size_t cap)
+INLINE static size_t
+_ss_len(const SS s)
 {
-    _sstring_t *m2;
-
-    if (m->type & _SS_HEAP_ALLOCATED)
-    {
-        m2 = ss_rawrealloc(m, sizeof(_sstring_t) + cap + 1);
-        if (cap < m2->cap)
-        {
-            _ss_string(m2)[cap] = 0;
-        }
-        m2->cap = cap;
-    }
-    else
+    switch (_ss_hdr(s))
     {
-        m2 = ss_rawalloc(sizeof(_sstring_t) + cap + 1);
-        m2->cap = cap;
-        m2->len = m->len;
-        m2->type =
-            (m->type & _SS_GROW_MASK)
-            | _SS_HEAP_ALLOCATED
-            | _SSTRING_NORM;
-        ss_memcopy((SS)(m2 + 1), (SS)(m + 1), m->len + 1);
+        case _SS_HDR_8:
+            return _SS_COMPACT(_sstring8_t, s)->len;
+        case _SS_HDR_16:
+            return _SS_COMPACT(_sstring16_t, s)->len;
+        case _SS_HDR_32:
+            return _SS_COMPACT(_sstring32_t, s)->len;
+        default:
+            return _ss_cmeta(s)->len;
     }
-
-    return m2;
 }
 
-INLINE static int
-_ss_getgrow(uint32_t type)
+/**
+ * @internal
+ * @return Capacity of string.
+ */
+INLINE static size_t
+_ss_cap(const SS s)
 {
-    return (int)(type >> _SS_GROW_SHIFT);
+    switch (_ss_hdr(s))
+    {
+        case _SS_HDR_8:
+            return _SS_COMPACT(_sstring8_t, s)->cap;
+        case _SS_HDR_16:
+            return _SS_COMPACT(_sstring16_t, s)->cap;
+        case _SS_HDR_32:
+            return _SS_COMPACT(_sstring32_t, s)->cap;
+        default:
+            return _ss_cmeta(s)->cap;
+    }
 }
 
 /**
  * @internal
- * @brief Adjust capactiy of the string applying growth values.
+ * @brief Drop the cached hash after writing in place.
+ * @note Only writes when the bit is set, the empty strings are shared and
+ *       never hashed, so callers may pass them from any thread.
  */
-INLINE static _sstring_t *
-_ss_realloc_grow(_sstring_t *m, size_t cap)
+INLINE static void
+_ss_unhash(SS s)
 {
-    if (m->type & _SS_GROW_MASK)
+    if (UNLIKELY(((const uint8_t *)s)[-1] & _SS_HDR_HASHED))
     {
-        size_t growcap = 0;
-
-        switch (_ss_getgrow(m->type))
-        {
-            case SS_GROW25:
-                growcap = cap/4;
-                break;
-            case SS_GROW50:
-                growcap = cap/2;
-                break;
-            case SS_GROW100:
-                growcap = cap;
-                break;
-            default:
-                break;
-        }
-
+        ((uint8_t *)s)[-1] &= (uint8_t)~_SS_HDR_HASHED;
+    }
+}
 
-        if (growcap > SS_MAX_REALLOC)
-        {
-            growcap = SS_MAX_REALLOC;
-        }
+/**
+ * @internal
+ * @brief Store the length, the sentinel is left to the caller.
+ * @param len - Must fit the capacity.
+ */
+INLINE static void
+_ss_setlen(SS s, size_t len)
+{
+    _ss_unhash(s);
 
-        if ((growcap + cap) < cap || !_ss_valid_cap(growcap + cap))
-        {
-            cap = _ss_cap_max();
-        }
-        else
-        {
-            cap = cap + growcap;
-        }
+    switch (_ss_hdr(s))
+    {
+        case _SS_HDR_8:
+            _SS_COMPACT(_sstring8_t, s)->len = (uint8_t)len;
+            break;
+        case _SS_HDR_16:
+            _SS_COMPACT(_sstring16_t, s)->len = (uint16_t)len;
+            break;
+        case _SS_HDR_32:
+            _SS_COMPACT(_sstring32_t, s)->len = (uint32_t)len;
+            break;
+        default:
+            _ss_meta(s)->len = len;
+            break;
     }
-
-    return _ss_realloc(m, cap);
 }
 
-INLINE static const char *
-_ss_memrchar(const char *buf, char find, size_t searchlen)
+/**
+ * @internal
+ * @brief Store the capacity.
+ * @param cap - Must fit the header class.
+ */
+INLINE static void
+_ss_setcap(SS s, size_t cap)
 {
-    const char *end = buf + searchlen;
-    while (buf <= end)
+    switch (_ss_hdr(s))
     {
-        if (*end == find)
-        {
-            return end;
-        }
-        --end;
+        case _SS_HDR_8:
+            _SS_COMPACT(_sstring8_t, s)->cap = (uint8_t)cap;
+            break;
+        case _SS_HDR_16:
+            _SS_COMPACT(_sstring16_t, s)->cap = (uint16_t)cap;
+            break;
+        case _SS_HDR_32:
+            _SS_COMPACT(_sstring32_t, s)->cap = (uint32_t)cap;
+            break;
+        default:
+            _ss_meta(s)->cap = cap;
+            break;
     }
-
-    return NULL;
 }
 
 /**
- * The empty string is great if you want to avoid NULL checks but have
- * O(1) time and space cost.
- * This reference is not allocated, but will become allocated once you 
- * add to it using the library functions.
- * @warning While you can duplicate the empty string reference safely, don't.
- * @return Empty string reference.
+ * @internal
+ * @return True if the cached hash is current.
+ * @note A capacity shrunk in place can cut into the cache, so the room is
+ *       checked again.
  */
-SS
-ss_empty(void)
+INLINE static bool
+_ss_hashed(const SS s)
 {
-    return _ss_string((_sstring_t *)&g_ss_empty[0]);
+    return (__atomic_load_n((const uint8_t *)s - 1, __ATOMIC_ACQUIRE) & _SS_HDR_HASHED)
+           && _ss_cap(s) - _ss_len(s) >= sizeof(uint64_t);
 }
 
 /**
- * @return String with capacity as specified.
+ * @internal
+ * @return The cached hash, see _ss_hashed.
+ * @note Read bytewise with atomics, another ss_hash may be storing the same
+ *       value, see _ss_sethashval.
  */
-SS
-ss_new(size_t cap)
+INLINE static uint64_t
+_ss_hashval(const SS s)
 {
-    if (!cap || NPOS == cap)
-    {
-        return ss_empty();
-    }
-
-    if (!_ss_valid_cap(cap))
-    {
-        cap = _ss_cap_max();
-    }
-
-    _sstring_t *m = ss_rawalloc(sizeof(_sstring_t) + cap + 1);
-    SS s = NULL;
+    const uint8_t *p = (const uint8_t *)s + _ss_len(s) + 1;
+    uint8_t b[sizeof(uint64_t)];
+    uint64_t h;
 
-    if (m)
+    for (size_t i = 0; i < sizeof(b); ++i)
     {
-        m->cap = cap;
-        m->len = 0;
-        m->type = _SS_HEAP_ALLOCATED | _SSTRING_NORM;
-        s = _ss_string(m);
-        s[0] = 0;
+        b[i] = __atomic_load_n(&p[i], __ATOMIC_RELAXED);
     }
-
-    return s;
+    ss_memcopy(&h, b, sizeof(h));
+    return h;
 }
 
 /**
- * @return New string with the given capacity and copy of the given string.
+ * @internal
+ * @brief Cache the hash and mark it current.
+ * @note Concurrent callers on one string store the same bytes, so the bytes
+ *       are stored with atomics and the bit is published after them.
+ * @param h - Must fit, see _ss_hashed.
  */
-SS
-ss_newfrom(size_t cap, const char *cs, size_t len)
+INLINE static void
+_ss_sethashval(SS s, uint64_t h)
 {
-    cap = cap > len ? cap : len;
-    _sstring_t *m = ss_rawalloc(sizeof(_sstring_t) + cap + 1);
-    SS s = NULL;
+    uint8_t *p = (uint8_t *)s + _ss_len(s) + 1;
+    uint8_t b[sizeof(uint64_t)];
 
-    if (m)
+    ss_memcopy(b, &h, sizeof(b));
+    for (size_t i = 0; i < sizeof(b); ++i)
     {
-        m->cap = cap;
-        m->len = len;
-        m->type = _SS_HEAP_ALLOCATED | _SSTRING_NORM;
-        s = _ss_string(m);
-        if (len)
-        {
-            ss_memcopy(s, cs, len);
-        }
-        s[len] = 0;
+        __atomic_store_n(&p[i], b[i], __ATOMIC_RELAXED);
     }
-
-    return s;
+    __atomic_fetch_or((uint8_t *)s - 1, (uint8_t)_SS_HDR_HASHED, __ATOMIC_RELEASE);
 }
 
 /**
- * @return Duplicate of the given string.
+ * @internal
+ * @return Type field of string.
+ *         Compact headers report a heap allocated normal string.
  */
-SS
-ss_dup(SS s)
+INLINE static uint32_t
+_ss_type(SS s)
 {
-    return ss_newfrom(0, s, ss_len(s));
+    if (_ss_hdr(s))
+    {
+        uint8_t hdr = ((const uint8_t *)s)[-1];
+        uint32_t grow = (hdr & _SS_HDR_GROW_MASK) >> _SS_HDR_GROW_SHIFT;
+        return _SS_HEAP_ALLOCATED | _SSTRING_NORM | (grow << _SS_GROW_SHIFT)
+               | ((hdr & _SS_HDR_ALIGNED) ? _SS_ALIGNED : 0);
+    }
+    return _ss_meta(s)->type;
 }
 
 /**
- * @brief Free the given string.
- * @note Will properly check for empty and stack string types.
- * @param s
+ * @internal
+ * @brief Store the growth option.
  */
-void
-ss_free(SS *s) 
+INLINE static void
+_ss_setgrowbits(SS s, uint32_t opt)
 {
-    /* Empty string and stack string will not have flag set. */
-    if ((_ss_type(*s)) & _SS_HEAP_ALLOCATED)
+    if (_ss_hdr(s))
     {
-        ss_rawfree(_ss_meta(*s));
+        uint8_t *hdr = &((uint8_t *)s)[-1];
+        *hdr = (uint8_t)((*hdr & ~_SS_HDR_GROW_MASK) | (opt << _SS_HDR_GROW_SHIFT));
+    }
+    else
+    {
+        _sstring_t *m = _ss_meta(s);
+        m->type = (opt << _SS_GROW_SHIFT) | (m->type & ~_SS_GROW_MASK);
     }
-    (*s) = NULL;
 }
 
 /**
- * @brief Exposed method for internal
- * @warning Users should not use this function.
- * @param b - The buffer to initialize and turn into a stack string.
- * @return Initialized stack string.
- */
-SS
-ss_stack_init(void *b, size_t cap)
-{
-    _sstring_t *m = (_sstring_t *)b;
-    m->cap = cap;
-    m->len = 0;
-    m->type = _SSTRING_STACK;
-
-    SS s = _ss_string(m);
-    s[0] = 0;
-
-    return s;
-}
-
-/**
- * @warning Your system and available memory may restrict this more.
- * @note The value is adjusted for the metadata and NULL sentinel.
- * @return The maximum capacity value.
+ * @internal
+ * @return True if string is of the given type.
  */
-size_t
-ss_maxcap(void)
+INLINE static bool
+_ss_is_type(SS s, enum _sstring_type t)
 {
-    return _ss_cap_max();
+    return (_ss_type(s) & _SS_KIND_MASK) == (uint32_t)t;
 }
 
 /**
- * @note If you have a c-string you're using and have modified the string
- *       so the end is different than before, call ssc_setlen before using.
- * @return Length of the string in O(1) time.
+ * @internal
+ * @return The maximum capacity.
  */
-size_t
-ss_len(const SS s)
+INLINE static size_t
+_ss_cap_max(void)
 {
-    return _ss_len(s);
+    return ((size_t)UINT_MAX) - 2 - sizeof(_sstring_t);
 }
 
 /**
- * @note The length will always be less than or equal to capacity.
- * @return The capacity of the string.
+ * @internal
+ * @return True if the given capacity is in the valid range.
  */
-size_t
-ss_cap(const SS s)
+INLINE static bool
+_ss_valid_cap(size_t cap)
 {
-    return _ss_cmeta(s)->cap;
+    return !!(cap <= _ss_cap_max());
 }
 
 /**
- * @return True if the length is zero.
+ * @internal
+ * @brief Strings with an owner store it just before the header.
+ *        The owner is the per-string allocator or the arena,
+ *        shared strings keep their count of references there.
  */
-bool
-ss_isempty(const SS s)
-{
-    return !(_ss_len(s));
-}
+#define _SS_PREFIX_SIZE (sizeof(void *))
 
 /**
- * @return True if this was a string returned from ss_empty.
+ * @internal
+ * @return Size of the prefix in front of the header.
  */
-bool
-ss_isemptytype(const SS s)
+INLINE static size_t
+_ss_prefix_size(uint32_t type)
 {
-    return _ss_is_type(s, _SSTRING_EMPTY);
+    return ((type & _SS_CUSTOM_ALLOC)
+            || (type & _SS_KIND_MASK) == _SSTRING_ARENA
+            || (type & _SS_KIND_MASK) == _SSTRING_SHARED) ? _SS_PREFIX_SIZE : 0;
 }
 
 /**
- * @return True if this string is on the heap (malloc'd).
+ * @internal
+ * @return Reference to the owner slot.
  */
-bool
-ss_isheaptype(const SS s)
+INLINE static void **
+_ss_prefix(const _sstring_t *m)
 {
-    return ((_ss_type(s)) & _SS_HEAP_ALLOCATED);
+    return (void **)((char *)m - _SS_PREFIX_SIZE);
 }
 
 /**
- * @return True if this string is on the stack.
+ * @internal
+ * @return The allocator owning the heap string.
  */
-bool
-ss_isstacktype(const SS s)
+INLINE static const ss_allocator_t *
+_ss_allocator(const SS s)
 {
-    return _ss_is_type(s, _SSTRING_STACK);
+    if (!_ss_hdr(s) && (_ss_cmeta(s)->type & _SS_CUSTOM_ALLOC))
+    {
+        return (const ss_allocator_t *)*_ss_prefix(_ss_cmeta(s));
+    }
+    return g_ss_allocator;
 }
 
 /**
- * @return True if both strings are equal (capacity can differ); false othewise.
+ * @internal
+ * @return Start of the block the string lives in.
  */
-bool
-ss_equal(const SS s1, const SS s2)
+INLINE static void *
+_ss_block(SS s)
 {
-    if (s1 == s2)
-    {
-        return true;
-    }
-
-    const _sstring_t *m1 = _ss_cmeta(s1);
-    const _sstring_t *m2 = _ss_cmeta(s2);
+    unsigned int hdr = _ss_hdr(s);
+    char *h = s - _ss_hdr_size(hdr);
 
-    if (m1->len != m2->len)
+    if (_ss_isaligned(s))
     {
-        return false;
+        return h - ((uint8_t *)h)[-1];
     }
 
-    return 0 == ss_memcompare(s1, s2, m1->len);
+    return h - (hdr ? 0 : _ss_prefix_size(_ss_meta(s)->type));
 }
 
 /**
- * @note Uses memcmp by default. Make your own for local specific strings.
- * @return <1 if s1 < s2, >1 if s2 < s1, zero if equal.
+ * @internal
+ * @return Allocation size of a compact string.
  */
-int
-ss_compare(const SS s1, const SS s2)
+INLINE static size_t
+_ss_compact_size(size_t hdrsize, size_t cap, bool aligned)
 {
-    const _sstring_t *m1 = _ss_meta(s1);
-    const _sstring_t *m2 = _ss_meta(s2);
-    size_t len = m1->len < m2->len ? m1->len : m2->len;
-
-    if (!len)
+    if (aligned)
     {
-        if (m1->len < m2->len)
-        {
-            return -1;
-        }
-        else if (m1->len > m2->len)
-        {
-            return 1;
-        }
-        else
-        {
-            return 0;
-        }
+        /* Room for the offset byte and padding, then whole chunks. */
+        return SS_ALIGN + hdrsize + ((cap + SS_ALIGN) & ~((size_t)SS_ALIGN - 1));
     }
-
-    return ss_memcompare(s1, s2, len);
+    return hdrsize + cap + 1;
 }
 
 /**
- * @return The index of the string to find; NPOS if not found.
+ * @internal
+ * @return Offset of the data from the start of the block.
  */
-size_t
-ss_find(const SS s, size_t index, const char *cs, size_t len)
+INLINE static size_t
+_ss_compact_offset(const char *block, size_t hdrsize, bool aligned)
 {
-    const _sstring_t *m = _ss_meta(s);
-
-    if (len && m->len && index < m->len)
+    if (aligned)
     {
-        size_t searchlen = m->len - index;
-        const char *cursor = s + index;
-        for (;;)
-        {
-            if (*cs != *cursor)
-            {
-                cursor = ss_memchar(cursor, *cs, searchlen);
-                if (!cursor)
-                {
-                    break;
-                }
-            }
-
-            searchlen = m->len - (cursor - s);
-
-            if (searchlen < len)
-            {
-                break;
-            }
-
-            if (0 == ss_memcompare(cursor, cs, len))
-            {
-                return cursor - s;
-            }
-            else
-            {
-                ++cursor;
-                --searchlen;
-            }
-        }
+        uintptr_t data = (uintptr_t)block + hdrsize + 1;
+        data = (data + SS_ALIGN - 1) & ~((uintptr_t)SS_ALIGN - 1);
+        return data - (uintptr_t)block;
     }
-
-    return NPOS;
+    return hdrsize;
 }
 
 /**
- * @return The right-most index of the string to find; NPOS if not found.
+ * @internal
+ * @brief Set up a compact header in front of the data.
+ * @param grow - Growth bits, and _SS_ALIGNED if the data is aligned.
  */
-size_t
-ss_rfind(const SS s, size_t index, const char *cs, size_t len)
+INLINE static SS
+_ss_compact_init(char *block, unsigned int hdr, size_t cap, uint32_t grow)
 {
-    const _sstring_t *m = _ss_meta(s);
-
-    if (index > m->len)
-    {
-        /* If m->len is zero is caught in the next statement. */
-        index = m->len - 1;
-    }
+    bool aligned = !!(grow & _SS_ALIGNED);
+    size_t hdrsize = _ss_hdr_size(hdr);
+    size_t off = _ss_compact_offset(block, hdrsize, aligned);
+    SS s = block + off;
 
-    if (len && m->len && index < m->len)
+    if (aligned)
     {
-        size_t last = len - 1;
-        size_t searchlen = index + 1;
-        const char *cursor = s + index;
-        for (;;)
-        {
-            if (cs[last] != *cursor)
-            {
-                cursor = ss_memrchar(s, cs[last], searchlen - 1);
-                if (!cursor)
-                {
-                    break;
-                }
-            }
-
-            searchlen = (cursor - s) + 1;
-
-            if (searchlen < len)
-            {
-                break;
-            }
-
-            if (0 == ss_memcompare(cursor - last, cs, len))
-            {
-                return (cursor - last) - s;
-            }
-            else
-            {
-                --cursor;
-                --searchlen;
-            }
-        }
+        s[-1 - (ptrdiff_t)hdrsize] = (char)(off - hdrsize);
+        hdr |= _SS_HDR_ALIGNED;
     }
-
-    return NPOS;
+    s[-1] = (char)(hdr | (((grow & _SS_GROW_MASK) >> _SS_GROW_SHIFT) << _SS_HDR_GROW_SHIFT));
+    _ss_setcap(s, cap);
+    _ss_setlen(s, 0);
+    return s;
 }
 
 /**
- * @return The count of the number of sub-strings found.
+ * @internal
+ * @return Zeroed memory from the global allocator.
  */
-size_t
-ss_count(const SS s, size_t index, const char *cs, size_t len)
+static void *
+_ss_zalloc(size_t size)
 {
-    size_t count = 0;
-
-    if (len)
+    const ss_allocator_t *a = g_ss_allocator;
+    void *mem = a->alloc(a->ctx, size);
+    if (UNLIKELY(!mem))
     {
-        const _sstring_t *m = _ss_meta(s);
-
-        if (index >= m->len)
-        {
-            return count;
-        }
-
-        size_t searchlen = m->len - index;
-        const char *cursor = s + index;
-        for (;;)
-        {
-            if (*cs != *cursor)
-            {
-                cursor = ss_memchar(cursor, *cs, searchlen);
-                if (!cursor)
-                {
-                    break;
-                }
-            }
-
-            searchlen = m->len - (cursor - s);
-
-            if (searchlen < len)
-            {
-                break;
-            }
-
-            if (0 == ss_memcompare(cursor, cs, len))
-            {
-                ++count;
-                cursor += len;
-                searchlen -= len;
-                
-                if (searchlen < len)
-                {
-                    break;
-                }
-            }
-            else
-            {
-                ++cursor;
-                --searchlen;
-            }
-        }
+        _ss_abort(true, size);
     }
-
-    return count;
+    ss_memset(mem, 0, size);
+    return mem;
 }
 
-
 /**
- * For all of Bee J's code.
- * @see https://beej.us/guide/bgnet/html/#serialization
- * @see https://beej.us/guide/bgnet/examples/pack2.c
+ * @internal
+ * @brief Free memory from _ss_zalloc.
  */
-
-/** @brief Pack 16-bit uint. */
-#define packu16(BUF, I) (packi16((BUF), (I)))
-/** @brief Pack 16-bit int. */
 static void
-packi16(unsigned char *buf, unsigned int i)
+_ss_zfree(void *mem)
 {
-    *buf++ = i >> 8;
-    *buf = i;
+    const ss_allocator_t *a = g_ss_allocator;
+    a->free(a->ctx, mem);
 }
 
-/** @brief Pack 32-bit uint. */
-#define packu32(BUF, I) (packi32((BUF), (I)))
-/** @brief Pack 32-bit int. */
-static void
-packi32(unsigned char *buf, uint32_t i)
+/*
+ * Statistics.
+ * Built with SS_STATS each thread counts into its own block, the counters
+ * are only written by their thread so they are bumped with plain relaxed
+ * stores. Blocks are linked into a list for ss_stats_snapshot, a thread's
+ * counts fold into the retired totals when it exits.
+ * Without SS_STATS the counting macros are empty.
+ */
+#ifdef SS_STATS
+
+typedef struct _ss_stats_block_s
 {
-    *buf++ = i >> 24;
-    *buf++ = i >> 16;
-    *buf++ = i >> 8;
-    *buf = i;
-}
+    ss_stats_t counts;
+    struct _ss_stats_block_s *next;
+    struct _ss_stats_block_s **prev;
+    bool linked;
+} _ss_stats_block_t;
+
+static __thread _ss_stats_block_t g_ss_stats __attribute__((tls_model("initial-exec")));
+static _ss_stats_block_t *g_ss_stats_threads;
+static ss_stats_t g_ss_stats_retired;
+static pthread_mutex_t g_ss_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t g_ss_stats_key;
+static pthread_once_t g_ss_stats_once = PTHREAD_ONCE_INIT;
+static ss_realloc_hook_t g_ss_stats_hook;
+static void *g_ss_stats_hookctx;
 
-/** @brief Pack 64-bit uint. */
-#define packu64(BUF, I) (packi64((BUF), (I)))
-/** @brief Pack 64-bit int. */
+/**
+ * @internal
+ * @brief Add every counter of from into to.
+ */
 static void
-packi64(unsigned char *buf, uint64_t i)
+_ss_stats_add(ss_stats_t *to, const ss_stats_t *from)
 {
-    *buf++ = i >> 56;
-    *buf++ = i >> 48;
-    *buf++ = i >> 40;
-    *buf++ = i >> 32;
-    *buf++ = i >> 24;
-    *buf++ = i >> 16;
-    *buf++ = i >> 8;
-    *buf = i;
+    uint64_t *t = (uint64_t *)to;
+    const uint64_t *f = (const uint64_t *)from;
+
+    for (size_t i = 0; i < sizeof(ss_stats_t) / sizeof(uint64_t); ++i)
+    {
+        t[i] += __atomic_load_n(&f[i], __ATOMIC_RELAXED);
+    }
 }
 
-/** @return Unpack signed 16-bit int. */
-static int16_t
-unpacki16(const unsigned char *buf)
+static void
+_ss_stats_exit(void *arg)
 {
-    unsigned int i2 = ((uint16_t)buf[0] << 8) | (uint16_t)buf[1];
-    int i;
+    _ss_stats_block_t *b = arg;
 
-    /* Restore sign. */
-    if (i2 <= 0x7fffu)
-    {
-        i = i2;
-    }
-    else
+    pthread_mutex_lock(&g_ss_stats_lock);
+    _ss_stats_add(&g_ss_stats_retired, &b->counts);
+    *b->prev = b->next;
+    if (b->next)
     {
-        i = -1 - (unsigned int)(0xffffu - i2);
+        b->next->prev = b->prev;
     }
-
-    return (int16_t)i;
+    b->linked = false;
+    ss_memset(&b->counts, 0, sizeof(b->counts));
+    pthread_mutex_unlock(&g_ss_stats_lock);
 }
 
-/** @return Unpack signed 16-bit uint. */
-static uint16_t
-unpacku16(const unsigned char *buf)
+static void
+_ss_stats_key_init(void)
 {
-    return ((uint16_t)buf[0] << 8) | (uint16_t)buf[1];
+    if (pthread_key_create(&g_ss_stats_key, _ss_stats_exit))
+    {
+        _ss_abort(true, sizeof(g_ss_stats_key));
+    }
 }
 
-/** @return Unpack signed 32-bit int. */
-static int32_t
-unpacki32(const unsigned char *buf)
+/**
+ * @internal
+ * @brief Link the calling thread's block on its first count.
+ */
+static NOINLINE _ss_stats_block_t *
+_ss_stats_link(void)
 {
-    uint32_t i2 = ((uint32_t)buf[0] << 24) |
-                           ((uint32_t)buf[1] << 16) |
-                           ((uint32_t)buf[2] << 8)  |
-                           (uint32_t)buf[3];
-    int32_t i;
+    _ss_stats_block_t *b = &g_ss_stats;
 
-    /* Restore sign. */
-    if (i2 <= 0x7fffffffu)
-    {
-        i = i2;
-    }
-    else
+    pthread_once(&g_ss_stats_once, _ss_stats_key_init);
+    pthread_mutex_lock(&g_ss_stats_lock);
+    b->next = g_ss_stats_threads;
+    b->prev = &g_ss_stats_threads;
+    if (b->next)
     {
-        i = -1 - (int32_t)(0xffffffffu - i2);
+        b->next->prev = &b->next;
     }
+    g_ss_stats_threads = b;
+    b->linked = true;
+    pthread_mutex_unlock(&g_ss_stats_lock);
+    pthread_setspecific(g_ss_stats_key, b);
 
-    return i;
+    return b;
 }
 
-/** @return Unpack signed 32-bit uint. */
-static uint32_t
-unpacku32(const unsigned char *buf)
+/**
+ * @internal
+ * @return The calling thread's counters.
+ */
+INLINE static ss_stats_t *
+_ss_stats(void)
 {
-    return ((uint32_t)buf[0] << 24) |
-           ((uint32_t)buf[1] << 16) |
-           ((uint32_t)buf[2] << 8)  |
-           (uint32_t)buf[3];
+    _ss_stats_block_t *b = &g_ss_stats;
+    return &(LIKELY(b->linked) ? b : _ss_stats_link())->counts;
 }
 
-/** @return Unpack signed 64-bit int. */
-static int64_t
-unpacki64(const unsigned char *buf)
-{
-    uint64_t i2 = ((uint64_t)buf[0] << 56) |
-                                ((uint64_t)buf[1] << 48) |
-                                ((uint64_t)buf[2] << 40) |
-                                ((uint64_t)buf[3] << 32) |
-                                ((uint64_t)buf[4] << 24) |
-                                ((uint64_t)buf[5] << 16) |
-                                ((uint64_t)buf[6] << 8)  |
-                                buf[7];
-    int64_t i;
-
-    /* Restore sign. */
-    if (i2 <= 0x7fffffffffffffffu)
-    {
-        i = i2;
-    }
-    else
-    {
-        i = -1 -(int64_t)(0xffffffffffffffffu - i2);
-    }
+#define _SS_STAT_ADD(field, n) \
+    do \
+    { \
+        uint64_t *_c = &_ss_stats()->field; \
+        __atomic_store_n(_c, __atomic_load_n(_c, __ATOMIC_RELAXED) + (uint64_t)(n), __ATOMIC_RELAXED); \
+    } while (0)
 
-    return i;
+/**
+ * @internal
+ * @return Histogram bucket of the value, its bit width.
+ */
+INLINE static size_t
+_ss_stats_bucket(size_t v)
+{
+    size_t b = v ? (size_t)(64 - __builtin_clzll((unsigned long long)v)) : 0;
+    return b < SS_STATS_BUCKETS ? b : SS_STATS_BUCKETS - 1;
 }
 
-/** @return Unpack signed 64-bit uint. */
-static uint64_t
-unpacku64(const unsigned char *buf)
+/**
+ * @internal
+ * @brief Count a heap string as it is freed.
+ */
+INLINE static void
+_ss_stats_free(SS s)
 {
-    return ((uint64_t)buf[0] << 56) |
-           ((uint64_t)buf[1] << 48) |
-           ((uint64_t)buf[2] << 40) |
-           ((uint64_t)buf[3] << 32) |
-           ((uint64_t)buf[4] << 24) |
-           ((uint64_t)buf[5] << 16) |
-           ((uint64_t)buf[6] << 8)  |
-           (uint64_t)buf[7];
+    size_t len = _ss_len(s);
+    size_t cap = _ss_cap(s);
+
+    _SS_STAT_ADD(frees, 1);
+    _SS_STAT_ADD(bytes_wasted, cap - len);
+    _SS_STAT_ADD(len_hist[_ss_stats_bucket(len)], 1);
+    _SS_STAT_ADD(cap_hist[_ss_stats_bucket(cap)], 1);
 }
 
 /**
  * @internal
- * @see https://wiki.sei.cmu.edu/confluence/display/c/MSC39-C.+Do+not+call+va_arg()+on+a+va_list+that+has+an+indeterminate+value
- * @see https://stackoverflow.com/questions/7084857/what-are-the-automatic-type-promotions-of-variadic-function-arguments
- * @see https://stackoverflow.com/questions/63849830/default-argument-promotion-in-a-variadic-function
- * @return Number of bytes written; NPOS on error.
+ * @brief Run the hook after a reallocation.
+ * @note Not inlined, so it is a stable place for a uprobe.
  */
-static size_t
-_ss_packBE(size_t *caplen, unsigned char *buf, const char *fmt, va_list *argp)
+static NOINLINE void
+_ss_stats_realloc(SS s, size_t oldcap, size_t newcap)
 {
-    va_list ap;
-    va_copy(ap, *argp);
+    ss_realloc_hook_t hook = __atomic_load_n(&g_ss_stats_hook, __ATOMIC_ACQUIRE);
 
-    /* char, short, int */
-    unsigned int h;
-    uint32_t i;
-    uint64_t q;
-
-    size_t len = 0;
-    size_t blen = *caplen;
-    *caplen = 0;
-
-    for (; fmt[0]; ++fmt)
+    if (hook)
     {
-        switch (fmt[0])
-        {
-            case 'c':
-            case 'b':
-            case 'B':
-                ++len;
-                if (len > blen)
-                {
-                    *caplen = 1;
-                    len = NPOS;
-                    goto _pack_end;
-                }
-                h = va_arg(ap, unsigned int);
-                *buf = (unsigned char)h;
-                ++buf;
-                break;
-            case '?':
-                ++len;
-                if (len > blen)
-                {
-                    *caplen = 1;
-                    len = NPOS;
-                    goto _pack_end;
-                }
-                h = va_arg(ap, unsigned int);
-                *buf = (h) ? 1 : 0;
-                ++buf;
-                break;
-            case 'h':
-            case 'H':
-                len += 2;
-                if (len > blen)
-                {
-                    *caplen = len - blen;
-                    len = NPOS;
-                    goto _pack_end;
-                }
-                h = va_arg(ap, unsigned int);
-                packi16(buf, h);
-                buf += 2;
-                break;
-            case 'i':
-            case 'I':
-                len += 4;
-                if (len > blen)
-                {
-                    *caplen = len - blen;
-                    len = NPOS;
-                    goto _pack_end;
-                }
-                i = va_arg(ap, uint32_t);
-                packi32(buf, i);
-                buf += 4;
-                break;
-            case 'q':
-            case 'Q':
-                len += 8;
-                if (len > blen)
-                {
-                    *caplen = len - blen;
-                    len = NPOS;
-                    goto _pack_end;
-                }
-                q = va_arg(ap, uint64_t);
-                packi64(buf, q);
-                buf += 8;
-                break;
-            default:
-                len = NPOS;
-                goto _pack_end;
-                break;
-        }
+        hook(__atomic_load_n(&g_ss_stats_hookctx, __ATOMIC_RELAXED), s, oldcap, newcap);
     }
+    __asm__ __volatile__("" : : "g"(s), "g"(oldcap), "g"(newcap) : "memory");
+}
 
-    _pack_end:
-    va_end(ap);
+#define _SS_STAT_FREE(s) _ss_stats_free(s)
+#define _SS_STAT_REALLOC(s, oldcap) _ss_stats_realloc((s), (oldcap), _ss_cap(s))
 
-    return len;
-}
+#else
 
-/**
- * @brief Packs/serializes to a buffer using a Python inspired pack format.
- * @see https://docs.python.org/3/library/struct.html
- * @warning Floats are excluded and there are requirements for byte sequences.
- * @warning Allocate enough space or set a growth flag; otherwise this may be a slow method to execute.
- * @param s
- * @param fmt - The packing format string.
- * @return Number of bytes written; NPOS on error.
- *
- * #### Format Specification
- * Note that you need to provide pointers to all of the following.
- * c - char
- * b - signed char
- * B - unsigned char
- * ? - bool
- * h - int16_t
- * H - uint16_t
- * i - int32_t
- * I - uint32_t
- * q - int64_t
- * Q - uint64_t
- */
-size_t
-ss_packBE(SS *s, const char *fmt, ...)
-{
-    va_list argp;
+#define _SS_STAT_ADD(field, n) do { (void)(n); } while (0)
+#define _SS_STAT_FREE(s) do { (void)(s); } while (0)
+#define _SS_STAT_REALLOC(s, oldcap) do { (void)(oldcap); } while (0)
 
-    ss_clear(*s);
+#endif /* SS_STATS */
 
-    _sstring_t *m = _ss_meta(*s);
+/*
+ * Thread cache.
+ * Freed compact heap strings are kept per thread in power of two size
+ * classes and handed to the next allocation of the class, so churn of
+ * short strings stays off the allocator. A thread opts in by setting a
+ * depth with ss_cache_setdepth, blocks are linked through their first
+ * bytes and freed when the thread exits.
+ */
+#define _SS_CACHE_MIN_SHIFT (5)
+#define _SS_CACHE_MAX_SHIFT (10)
+#define _SS_CACHE_CLASSES (_SS_CACHE_MAX_SHIFT - _SS_CACHE_MIN_SHIFT + 1)
 
-    size_t cap = 0;
-    size_t written = 0;
+typedef struct _ss_cache_s
+{
+    /* Allocator the cached blocks came from. */
+    const ss_allocator_t *alloc;
+    void *head[_SS_CACHE_CLASSES];
+    uint32_t count[_SS_CACHE_CLASSES];
+    /* Most blocks kept per class; zero when off. */
+    uint32_t depth;
+} _ss_cache_t;
+
+static __thread _ss_cache_t g_ss_cache __attribute__((tls_model("initial-exec")));
+static pthread_key_t g_ss_cache_key;
+static pthread_once_t g_ss_cache_once = PTHREAD_ONCE_INIT;
 
-    do
+/**
+ * @internal
+ * @brief Free every cached block.
+ */
+static void
+_ss_cache_flush(_ss_cache_t *c)
+{
+    for (unsigned int i = 0; i < _SS_CACHE_CLASSES; ++i)
     {
-        if (cap)
+        while (c->head[i])
         {
-            m = _ss_realloc_grow(m, m->cap + cap);
+            void *block = c->head[i];
+            c->head[i] = *(void **)block;
+            c->alloc->free(c->alloc->ctx, block);
         }
-        cap = m->cap;
-
-        va_start(argp, fmt);
-        written = _ss_packBE(&cap, (unsigned char *)(_ss_string(m)), fmt, &argp);
-        va_end(argp);
-    } while (NPOS == written && cap);
-
-    if (LIKELY(NPOS != written))
-    {
-        m->len = written;
-    }
-    else
-    {
-        m->len = 0;
+        c->count[i] = 0;
     }
-    *s = _ss_string(m);
-    (*s)[m->len] = 0;
-
-    return written;
 }
 
 /**
- * @brief Packs/serializes to a buffer.
- * @warning Allocate enough space or set a growth flag; otherwise this may be a slow method to execute.
- * @param s
- * @param fmt - The packing format string.
- * @return Number of bytes written; NPOS on error.
+ * @internal
+ * @brief Point the cache at the global allocator, flushing blocks from
+ *        a previous one.
  */
-size_t
-ss_catpackBE(SS *s, const char *fmt, ...)
+INLINE static void
+_ss_cache_bind(_ss_cache_t *c)
 {
-    va_list argp;
-
-    _sstring_t *m = _ss_meta(*s);
-
-    size_t cap = 0;
-    size_t olen = m->len;
-    size_t written = 0;
-
-    do
+    if (UNLIKELY(c->alloc != g_ss_allocator))
     {
-        if (cap)
+        if (c->alloc)
         {
-            m = _ss_realloc_grow(m, m->cap + cap);
+            _ss_cache_flush(c);
         }
-        cap = m->cap - olen;
+        c->alloc = g_ss_allocator;
+    }
+}
 
-        va_start(argp, fmt);
-        written = _ss_packBE(&cap, &((unsigned char *)(_ss_string(m)))[olen], fmt, &argp);
-        va_end(argp);
-    } while (NPOS == written && cap);
+static void
+_ss_cache_exit(void *arg)
+{
+    _ss_cache_t *c = arg;
+    _ss_cache_flush(c);
+    c->depth = 0;
+}
 
-    if (NPOS != written)
+static void
+_ss_cache_key_init(void)
+{
+    if (pthread_key_create(&g_ss_cache_key, _ss_cache_exit))
     {
-        m->len = olen + written;
+        _ss_abort(true, sizeof(g_ss_cache_key));
     }
-    *s = _ss_string(m);
-    (*s)[m->len] = 0;
-
-    return written;
 }
 
-
-
 /**
- * @return Number of bytes processed; NPOS on error.
+ * @internal
+ * @return Index of the smallest class holding size.
  */
-static size_t
-_ss_unpackBE(size_t blen, const unsigned char *buf, const char *fmt, va_list *argp)
+INLINE static unsigned int
+_ss_cache_class(size_t size)
 {
-	va_list ap;
-    va_copy(ap, *argp);
-
-    /* 8-bit */
-    char *c;
-	signed char *b;
-	unsigned char *B;
-
-    /* bool */
-    bool *qmark;
-
-    /* 16-bit */
-	int16_t *h;
-	uint16_t *H;
-
-    /* 32-bit */
-	int32_t *i;
-	uint32_t *I;
-
-    /* 64-bit */
-	int64_t *q;
-	uint64_t *Q;
-
-	size_t len = 0;
-
-	for(; fmt[0]; fmt++)
-    {
-		switch (fmt[0])
-        {
-            case 'c':
-                len++;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                c = va_arg(ap, char *);
-                *c = *((char *)buf);
-                buf++;
-                break;
-            case 'b':
-                len++;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                b = va_arg(ap, signed char *);
-                *b = *((signed char *)buf);
-                buf++;
-                break;
-            case 'B':
-                len++;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                B = va_arg(ap, unsigned char *);
-                *B = *buf;
-                buf++;
-                break;
-            case '?':
-                len++;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                qmark = va_arg(ap, bool *);
-                *qmark = (*buf) ? true : false;
-                buf++;
-                break;
-            case 'h':
-                len += 2;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                h = va_arg(ap, int16_t *);
-                *h = unpacki16(buf);
-                buf += 2;
-                break;
-            case 'H':
-                len += 2;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                H = va_arg(ap, uint16_t *);
-                *H = unpacku16(buf);
-                buf += 2;
-                break;
-            case 'i':
-                len += 4;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                i = va_arg(ap, int32_t *);
-                *i = unpacki32(buf);
-                buf += 4;
-                break;
-            case 'I':
-                len += 4;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                I = va_arg(ap, uint32_t *);
-                *I = unpacku32(buf);
-                buf += 4;
-                break;
-            case 'q':
-                len += 8;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                q = va_arg(ap, int64_t *);
-                *q = unpacki64(buf);
-                buf += 8;
-                break;
-            case 'Q':
-                len += 8;
-                if (len > blen)
-                {
-                    len = NPOS;
-                    goto _unpack_end;
-                }
-                Q = va_arg(ap, uint64_t *);
-                *Q = unpacku64(buf);
-                buf += 8;
-                break;
-            default:
-                len = NPOS;
-                goto _unpack_end;
-                break;
-		}
-	}
-
-    _unpack_end:
-	va_end(ap);
-
-    return len;
+    unsigned int shift = size <= ((size_t)1 << _SS_CACHE_MIN_SHIFT)
+                         ? _SS_CACHE_MIN_SHIFT
+                         : 64 - (unsigned int)__builtin_clzll(size - 1);
+    return shift - _SS_CACHE_MIN_SHIFT;
 }
 
 /**
- * @brief Unpacks/deserializes a buffer. See ss_packBE documentation for more details.
- * @note The incoming bytes must be Big-Endian (network byte order).
- * @param s
- * @param fmt - The unpacking format string.
- * @return Number of bytes processed; NPOS on error.
+ * @internal
+ * @brief Allocate a compact heap string block out of the thread cache.
+ *        The block is the full size class and the capacity fills it,
+ *        so it goes back to the same class when freed.
+ * @param size - Block size needed, at most the largest class.
  */
-size_t
-ss_unpackBE(const SS s, const char *fmt, ...)
+static SS
+_ss_cache_alloc(unsigned int hdr, size_t size, uint32_t grow)
 {
-    _sstring_t *m = _ss_meta(s);
-    va_list argp;
-    size_t n;
+    _ss_cache_t *c = &g_ss_cache;
+    unsigned int i = _ss_cache_class(size);
+    size_t csize = (size_t)1 << (i + _SS_CACHE_MIN_SHIFT);
+    size_t hdrsize = _ss_hdr_size(hdr);
+    size_t cap;
+    char *block;
 
-    if (!ss_isempty(s))
+    _ss_cache_bind(c);
+    if (c->head[i])
     {
-        va_start(argp, fmt);
-        n = _ss_unpackBE(ss_len(s), s, fmt, &argp);
-        va_end(argp);
+        block = c->head[i];
+        c->head[i] = *(void **)block;
+        --c->count[i];
+    }
+    else
+    {
+        block = c->alloc->alloc(c->alloc->ctx, csize);
+        if (UNLIKELY(!block))
+        {
+            _ss_abort(true, csize);
+        }
+    }
 
-        return n;
+    if (grow & _SS_ALIGNED)
+    {
+        cap = ((csize - SS_ALIGN - hdrsize) & ~((size_t)SS_ALIGN - 1)) - 1;
     }
     else
     {
-        return 0;
+        cap = csize - hdrsize - 1;
     }
+    if (cap > _ss_hdr_max(hdr))
+    {
+        cap = _ss_hdr_max(hdr);
+    }
+
+    SS s = _ss_compact_init(block, hdr, cap, grow);
+    ((uint8_t *)s)[-1] |= _SS_HDR_CACHED;
+    return s;
 }
 
 /**
- * @brief Unpacks/deserializes a buffer. See ss_packBE documentation for more details.
- * @param blen - The length of the input buffer.
- * @param buf - The non-NULL buffer reference.
- * @param fmt - The unpacking format string.
- * @return Number of bytes processed; NPOS on error.
+ * @internal
+ * @brief Keep the block of a compact heap string in the thread cache.
+ * @return True if cached; false if the caller must free it.
  */
-size_t
-ssb_unpackBE(size_t blen, unsigned char *buf, const char *fmt, ...)
+static bool
+_ss_cache_free(SS s)
 {
-    va_list argp;
-    size_t n;
-
-    if (blen)
+    _ss_cache_t *c = &g_ss_cache;
+    void *block = _ss_block(s);
+    unsigned int i;
+    size_t size;
+
+    _ss_cache_bind(c);
+    size = _ss_compact_size(_ss_hdr_size(_ss_hdr(s)), _ss_cap(s), _ss_isaligned(s));
+    if (((const uint8_t *)s)[-1] & _SS_HDR_CACHED)
     {
-        va_start(argp, fmt);
-        n = _ss_unpackBE(blen, buf, fmt, &argp);
-        va_end(argp);
-
-        return n;
+        /*
+         * The capacity filled the class at alloc, so it still needs more
+         * than half of it and rounds up to the same class.
+         */
+        i = _ss_cache_class(size);
     }
     else
     {
-        return 0;
+        /*
+         * The block holds at least the compact size, unless the capacity
+         * was claimed from an aligned block's padding, where the compact
+         * size counts the worst case offset. Ask the allocator for those.
+         */
+        if (_ss_isaligned(s) && c->alloc->usable)
+        {
+            size_t usable = c->alloc->usable(c->alloc->ctx, block);
+            size = usable ? usable : size;
+        }
+
+        if (size < ((size_t)1 << _SS_CACHE_MIN_SHIFT)
+            || size >= ((size_t)2 << _SS_CACHE_MAX_SHIFT))
+        {
+            return false;
+        }
+
+        /* File it under the largest class it holds. */
+        i = 63 - (unsigned int)__builtin_clzll(size) - _SS_CACHE_MIN_SHIFT;
+    }
+
+    if (c->count[i] >= c->depth)
+    {
+        return false;
     }
+
+    *(void **)block = c->head[i];
+    c->head[i] = block;
+    ++c->count[i];
+    return true;
 }
 
-/**
- * @brief Safely set the length of the string. Cannot exceed capacity.
- * @param s
- * @param len - The length to set the string to.
+/*
+ * Huge strings.
+ * SS_GROWHUGE strings are given this allocator, each block is a mapping of
+ * its own and mremap resizes it by moving page tables rather than bytes.
+ * The first bytes of the mapping hold its size.
  */
-void
-ss_setlen(SS s, size_t len)
-{
-    _sstring_t *m = _ss_meta(s);
+#define _SS_HUGE_HEAD (16)
 
-    /* Empty string will have cap of 0. */
-    if (len <= m->cap)
-    {
-        s[len] = 0;
-        m->len = len;
-    }
+INLINE static size_t
+_ss_pagesize(void)
+{
+    return (size_t)sysconf(_SC_PAGESIZE);
 }
 
 /**
- * @brief Call to use strlen to set the length.
- * @note As a precaution the NULL sentinel is reset.
- * @param s
+ * @internal
+ * @return Size rounded up to whole pages; zero on overflow.
  */
-void
-ssc_setlen(SS s)
+INLINE static size_t
+_ss_pageround(size_t size)
 {
-    _sstring_t *m = _ss_meta(s);
+    size_t page = _ss_pagesize();
+    return (size + page - 1) & ~(page - 1);
+}
 
-    /* Don't modify empty string. */
-    if (m->cap)
+static void *
+_ss_huge_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    size_t mapsize = _ss_pageround(size + _SS_HUGE_HEAD);
+    if (UNLIKELY(mapsize < size))
     {
-        s[m->cap] = 0;
+        return NULL;
     }
 
-    size_t len = ss_cstrlen(s);
-
-    if (len <= m->cap)
+    char *map = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (UNLIKELY(MAP_FAILED == map))
     {
-        m->len = len;
-        s[len] = 0;
+        return NULL;
     }
+
+    ss_memcopy(map, &mapsize, sizeof(mapsize));
+    return map + _SS_HUGE_HEAD;
 }
 
-/**
- * @brief Set the growth rate option in the string's metadata.
- * @note It might seem odd to pass string by reference.
- *       This is done because of how empty string is implemented.
- * @param s
- * @param opt - The chosen growth rate.
- */
-void
-ss_setgrow(SS *s, enum ss_grow_opt opt)
+static void
+_ss_huge_free(void *ctx, void *mem)
 {
-    if (!_ss_is_type(*s, _SSTRING_EMPTY))
-    {
-        /* Stack string is mutable, so this is okay to set. */
-        switch (opt)
-        {
-            case SS_GROW0:
-            case SS_GROW25:
-            case SS_GROW50:
-            case SS_GROW100:
-                {
-                    uint32_t t = _ss_type(*s);
-                    _ss_meta(*s)->type = (opt << _SS_GROW_SHIFT) | ((t) & ~_SS_GROW_MASK);
-                }
-                break;
-        }
-    }
-    else
-    {
-        *s = _ss_string(((_sstring_t *)&g_ss_empty[opt]));
-    }
+    (void)ctx;
+    char *map = (char *)mem - _SS_HUGE_HEAD;
+    size_t mapsize;
+
+    ss_memcopy(&mapsize, map, sizeof(mapsize));
+    munmap(map, mapsize);
 }
 
-/**
- * @brief Forces the string to be allocated onto the heap.
- * @param s
- */
-void
-ss_heapify(SS *s)
+static void *
+_ss_huge_realloc(void *ctx, void *mem, size_t size)
 {
-    if (!(_ss_type(*s) & _SS_HEAP_ALLOCATED))
+    if (!mem)
     {
-        const _sstring_t *m = _ss_cmeta(*s);
-        _sstring_t *m2 = ss_rawalloc(sizeof(_sstring_t) + m->len + 1);
-
-        SS s2 = _ss_string(m2);
-        ss_memcopy(s2, *s, m->len + 1);
-        m2->cap = m->len;
-        m2->len = m->len;
-        m2->type =
-            _SS_HEAP_ALLOCATED
-            | _SSTRING_NORM
-            | (_SS_GROW_MASK & m->type);
-        *s = s2;
+        return _ss_huge_alloc(ctx, size);
     }
-}
 
-/**
- * @brief Swaps the two references.
- * @param s1
- * @param s2
- */
-void
-ss_swap(SS *s1, SS *s2)
-{
-    SS tmp = *s1;
-    *s1 = *s2;
-    *s2 = tmp;
-}
+    char *map = (char *)mem - _SS_HUGE_HEAD;
+    size_t oldsize;
+    size_t mapsize = _ss_pageround(size + _SS_HUGE_HEAD);
 
-/**
- * @brief Make sure the string can hold at least the given amount.
- * @note Growth disabled.
- * @param s
- * @param res - The amount to ensure the string can hold.
- */
-void
-ss_reserve(SS *s, size_t res)
-{
-    _sstring_t *m = _ss_meta(*s);
+    ss_memcopy(&oldsize, map, sizeof(oldsize));
+    if (UNLIKELY(mapsize < size))
+    {
+        return NULL;
+    }
+    else if (mapsize == oldsize)
+    {
+        return mem;
+    }
 
-    /* Empty string will realloc. */
-    if (m->cap < res)
+#ifdef MREMAP_MAYMOVE
+    map = mremap(map, oldsize, mapsize, MREMAP_MAYMOVE);
+    if (UNLIKELY(MAP_FAILED == map))
     {
-        m = _ss_realloc(m, res);
-        *s = _ss_string(m);
+        return NULL;
     }
+    ss_memcopy(map, &mapsize, sizeof(mapsize));
+    return map + _SS_HUGE_HEAD;
+#else
+    char *mem2 = _ss_huge_alloc(ctx, size);
+    if (mem2)
+    {
+        size_t keep = (oldsize < mapsize ? oldsize : mapsize) - _SS_HUGE_HEAD;
+        ss_memcopy(mem2, mem, keep);
+        _ss_huge_free(ctx, mem);
+    }
+    return mem2;
+#endif
 }
 
-/**
- * @brief Reallocate to get rid of excess capacity.
- * @note Growth disabled.
- * @param s
- */
-void
-ss_fit(SS *s)
+static size_t
+_ss_huge_usable(void *ctx, void *mem)
 {
-    _sstring_t *m = _ss_meta(*s);
+    (void)ctx;
+    size_t mapsize;
 
-    /* We don't want to fit empty.
-     * We don't want to fit stack allocated.
-     */
-    if (m->cap != m->len && (_ss_type(*s) & _SS_HEAP_ALLOCATED))
-    {
-        m = _ss_realloc(m, m->len);
-        *s = _ss_string(m);
-    }
+    ss_memcopy(&mapsize, (char *)mem - _SS_HUGE_HEAD, sizeof(mapsize));
+    return mapsize - _SS_HUGE_HEAD;
 }
 
+static const ss_allocator_t g_ss_huge_allocator =
+{
+    _ss_huge_alloc,
+    _ss_huge_realloc,
+    _ss_huge_free,
+    _ss_huge_usable,
+    NULL,
+};
+
 /**
- * @brief Set the capacity the amount given.
- * @note Differs from `ss_reserve` in that reserve will not reallocate
- *       if there is enough capacity.
- * @note Stack allocated strings will not switch to the heap if there is space.
- * @note Growth disabled.
- * @param s
- * @param res - The amount of capacity to have.
+ * @internal
+ * @brief Allocate a heap string with the given capacity.
+ * @note The length is zero, the sentinel is left for the caller.
+ * @param a - The per-string allocator; NULL for the global allocator.
+ * @param grow - Growth bits to keep.
  */
-void
-ss_resize(SS *s, size_t res)
+static SS
+_ss_alloc(const ss_allocator_t *a, size_t cap, uint32_t grow)
 {
-    _sstring_t *m = _ss_meta(*s);
-
-    /* If stack allocated and has capacity, just return. */
-    if (!(_ss_type(*s) & _SS_HEAP_ALLOCATED))
+    if (!a && SS_GROWHUGE == (grow & _SS_GROW_MASK) >> _SS_GROW_SHIFT)
     {
-        if (m->cap >= res)
-        {
-            return;
-        }
+        a = &g_ss_huge_allocator;
     }
 
-    if (m->cap != res)
-    {
-        bool truncate = res < m->len;
+    _SS_STAT_ADD(allocs, 1);
 
-        m = _ss_realloc(m, res);
-        *s = _ss_string(m);
+    const ss_allocator_t *use = a ? a : g_ss_allocator;
+    unsigned int hdr = a ? _SS_HDR_FULL : _ss_hdr_for(cap);
+    size_t extra = a ? _SS_PREFIX_SIZE : 0;
+    size_t size;
 
-        if (truncate)
+    if (hdr)
+    {
+        grow |= _SS_ALIGN_DEFAULT;
+        size = _ss_compact_size(_ss_hdr_size(hdr), cap, !!(grow & _SS_ALIGNED));
+        if (g_ss_cache.depth && size <= ((size_t)1 << _SS_CACHE_MAX_SHIFT))
         {
-            m->len = res;
-            (*s)[res] = 0;
+            return _ss_cache_alloc(hdr, size, grow);
         }
     }
-}
+    else
+    {
+        size = extra + sizeof(_sstring_t) + cap + 1;
+    }
 
-/**
- * @brief Convenience function to add capacity to the string.
- * @note Growth disabled.
- * @param s
- * @param add - The amount to add.
- */
-void
-ss_addcap(SS *s, size_t add)
-{
-    _sstring_t *m = _ss_meta(*s);
-    
-    if (LIKELY(add))
+    char *block = use->alloc(use->ctx, size);
+    if (UNLIKELY(!block))
     {
-        size_t newcap = m->cap + add;
-        if (newcap < m->cap)
-        {
-            newcap = _ss_cap_max();
-        }
+        _ss_abort(true, size);
+    }
 
-        m = _ss_realloc(m, newcap);
-        *s = _ss_string(m);
+    if (hdr)
+    {
+        return _ss_compact_init(block, hdr, cap, grow);
     }
+
+    _sstring_t *m = (_sstring_t *)(block + extra);
+    m->cap = cap;
+    m->len = 0;
+    m->type = _SS_HEAP_ALLOCATED | _SSTRING_NORM | _SS_CUSTOM_ALLOC
+              | (grow & _SS_GROW_MASK);
+    m->hdr = _SS_HDR_FULL;
+    *_ss_prefix(m) = (void *)a;
+
+    return _ss_string(m);
 }
 
 /**
- * @brief Clear the string (length to zero and sentinel in place).
- * @param s
+ * @internal
+ * @brief Release the heap string back to its allocator.
  */
-void
-ss_clear(SS s)
+INLINE static void
+_ss_dealloc(SS s)
 {
-    if (!_ss_is_type(s, _SSTRING_EMPTY))
+    if (g_ss_cache.depth && _ss_hdr(s) && _ss_cache_free(s))
     {
-        _ss_meta(s)->len = 0;
-        s[0] = 0;
+        return;
     }
+
+    const ss_allocator_t *a = _ss_allocator(s);
+    a->free(a->ctx, _ss_block(s));
 }
 
 /**
- * @brief Remove the given substring from the string.
- * @param s
- * @param index - The place to start.
- * @param cs - The substring to remove.
- * @param len - The length of substring.
+ * @internal
+ * @brief Extend the capacity to everything the allocator handed out.
  */
-void
-ss_remove(SS s, size_t index, const char *cs, size_t len)
+INLINE static void
+_ss_claim_usable(SS s)
 {
-    _sstring_t *m = _ss_meta(s);
+    const ss_allocator_t *a = _ss_allocator(s);
 
-    if (len && m->len && index < m->len && (m->len - index) >= len)
+    if (a->usable)
     {
-        size_t newlen = m->len;
-        size_t searchlen = m->len - index;
-        char *to = NULL;
-        char *from = NULL;
-        char *cursor = s + index;
-        for (;;)
-        {
-            if (*cs != *cursor)
-            {
-                cursor = ss_mmemchar(cursor, *cs, searchlen);
-                if (!cursor)
-                {
-                    break;
-                }
-            }
-
-            searchlen = m->len - (cursor - s);
+        void *block = _ss_block(s);
+        size_t overhead = (s - (char *)block) + 1;
+        size_t usable = a->usable(a->ctx, block);
+        size_t cap = _ss_cap(s);
 
-            if (searchlen < len)
+        if (usable > overhead + cap)
+        {
+            size_t max = _ss_hdr_max(_ss_hdr(s));
+            cap = usable - overhead;
+            if (_ss_isaligned(s))
             {
-                break;
+                /* Whole chunks must stay readable. */
+                cap = ((cap + 1) & ~((size_t)SS_ALIGN - 1)) - 1;
             }
+            _ss_setcap(s, cap < max ? cap : max);
+            /* The capacity no longer tells the class, see _ss_cache_free. */
+            ((uint8_t *)s)[-1] &= (uint8_t)~_SS_HDR_CACHED;
+        }
+    }
+}
 
-            if (0 == ss_memcompare(cursor, cs, len))
-            {
-                newlen -= len;
-                if (to)
-                {
-                    size_t movelen = cursor - from;
-                    if (movelen)
-                    {
-                        ss_memmove(to, from, movelen);
-                        to += movelen;
-                    }
-                }
-                else
-                {
-                    to = cursor;
-                }
-
-                cursor += len;
-                searchlen -= len;
+/*
+ * Arena strings are bump allocated out of large blocks.
+ * The blocks are kept on reset, so a request-scoped arena stops
+ * touching the allocator once it's warmed up.
+ */
 
-                from = cursor;
+/* Default size of each arena block. */
+#define _SS_ARENA_BLOCK (64 * 1024)
+#define _SS_ARENA_ALIGN(N) (((N) + 7) & ~((size_t)7))
 
-                if (searchlen < len)
-                {
-                    break;
-                }
-            }
-            else
-            {
-                ++cursor;
-                --searchlen;
-            }
-        }
+typedef struct _ss_arena_block_s
+{
+    struct _ss_arena_block_s *next;
+    size_t size;
+} _ss_arena_block_t;
 
-        if (to)
-        {
-            ss_memmove(to, from, ((s + m->len) - from) + 1);
-        }
+struct ss_arena_s
+{
+    /* Allocator the blocks came from. */
+    const ss_allocator_t *alloc;
+    _ss_arena_block_t *head;
+    _ss_arena_block_t *cur;
+    /* Bump pointer and end of the current block. */
+    char *ptr;
+    char *end;
+    /* Start of the most recent allocation, it can grow in place. */
+    char *last;
+    size_t blocksize;
+};
 
-        m->len = newlen;
+/**
+ * @internal
+ * @return Allocated, but not linked, arena block of the given size.
+ */
+static _ss_arena_block_t *
+_ss_arena_block(const ss_allocator_t *a, size_t size)
+{
+    size_t bytes = sizeof(_ss_arena_block_t) + size;
+    _ss_arena_block_t *b = a->alloc(a->ctx, bytes);
+    if (UNLIKELY(!b))
+    {
+        _ss_abort(true, bytes);
     }
+    b->next = NULL;
+    b->size = size;
+    return b;
 }
 
 /**
- * @brief Remove a section of string.
- * @param s
- * @param start - The starting point (inclusive).
- * @param end - The ending point (exclusive).
+ * @internal
+ * @brief Make a block with at least size bytes current.
+ *        Reuses the next block in the chain if it's big enough.
  */
-void
-ss_removerange(SS s, size_t start, size_t end)
+static void
+_ss_arena_advance(ss_arena_t *ar, size_t size)
 {
-    _sstring_t *m = _ss_meta(s);
-
-    if (end > m->len)
-    {
-        end = m->len;
-    }
+    _ss_arena_block_t *next = ar->cur->next;
 
-    if (start >= end)
+    if (!next || next->size < size)
     {
-        return;
+        next = _ss_arena_block(ar->alloc, size > ar->blocksize ? size : ar->blocksize);
+        next->next = ar->cur->next;
+        ar->cur->next = next;
     }
 
-    size_t movelen = m->len - end + 1;
-    ss_memmove(s + start, s + end, movelen);
-    m->len -= (end - start);
+    ar->cur = next;
+    ar->ptr = (char *)(next + 1);
+    ar->end = ar->ptr + next->size;
 }
 
 /**
- * @brief Reverse the characters in the string.
- * @param s
+ * @internal
+ * @return 8-byte aligned memory from the arena.
  */
-void
-ss_reverse(SS s)
+static void *
+_ss_arena_alloc(ss_arena_t *ar, size_t size)
 {
-    _sstring_t *m = _ss_meta(s);
+    size = _SS_ARENA_ALIGN(size);
 
-    if (m->len)
+    if ((size_t)(ar->end - ar->ptr) < size)
     {
-        char *left = s;
-        char *right = (s - 1) + m->len;
-        while (left < right)
-        {
-            char tmp = *right;
-
-            *right = *left;
-            --right;
-
-            *left = tmp;
-            ++left;
-        }
+        _ss_arena_advance(ar, size);
     }
+
+    ar->last = ar->ptr;
+    ar->ptr += size;
+    return ar->last;
 }
 
 /**
- * @brief Chop off the end of the string.
- * @note Length is updated and sentinel is set.
- * @param s
- * @param index - The place to truncate the string.
+ * @internal
+ * @brief Allocate an arena string with the given capacity.
+ * @note The length is zero, the sentinel is left for the caller.
  */
-void
-ss_trunc(SS s, size_t index)
+static SS
+_ss_arena_new(ss_arena_t *ar, size_t cap, uint32_t grow)
 {
-    _sstring_t *m = _ss_meta(s);
+    char *block = _ss_arena_alloc(ar, _SS_PREFIX_SIZE + sizeof(_sstring_t) + cap + 1);
+    _sstring_t *m = (_sstring_t *)(block + _SS_PREFIX_SIZE);
 
-    if (index < m->len)
-    {
-        m->len = index;
-        s[index] = 0;
-    }
+    *_ss_prefix(m) = ar;
+    m->cap = cap;
+    m->len = 0;
+    m->type = _SSTRING_ARENA | (grow & _SS_GROW_MASK);
+    m->hdr = _SS_HDR_FULL;
+
+    return _ss_string(m);
 }
 
 /**
  * @internal
- * @brief Internal trim method.
- * @param rstart - VALID start index.
- * @param rend - VALID end index.
+ * @brief Resize within the arena.
+ *        Grows in place when the string was the last allocation;
+ *        otherwise the string is copied and the old space is dead
+ *        until the arena is reset.
  */
-INLINE static void
-_ss_trim(SS s, size_t rstart, size_t rend, const char *cs, size_t len)
+static SS
+_ss_arena_realloc(SS s, size_t cap)
 {
     _sstring_t *m = _ss_meta(s);
-    size_t start = rstart;
-    size_t end = rend;
+    ss_arena_t *ar = *_ss_prefix(m);
+    char *block = _ss_block(s);
+    size_t size = _SS_PREFIX_SIZE + sizeof(_sstring_t) + cap + 1;
 
-    while (start < end && ss_memchar(cs, s[start], len))
+    if (block == ar->last && (size_t)(ar->end - block) >= _SS_ARENA_ALIGN(size))
     {
-        ++start;
-    }
-    while (start < end && ss_memchar(cs, s[end -1], len))
-    {
-        --end;
+        ar->ptr = block + _SS_ARENA_ALIGN(size);
     }
-
-    size_t rmovelen = end - start;
-
-    if (start != rstart && rmovelen)
+    else if (cap > m->cap)
     {
-        ss_memmove(s + rstart, s + start, rmovelen);
+        SS s2 = _ss_arena_new(ar, cap, m->type);
+        _ss_meta(s2)->len = m->len;
+        ss_memcopy(s2, s, m->len + 1);
+        s = s2;
+        m = _ss_meta(s);
     }
 
-    if (start != rstart || end != rend)
+    if (cap < m->len)
     {
-        size_t movelen = (m->len - rend) + 1;
-        ss_memmove(s + rstart + rmovelen, s + rend, movelen);
+        m->len = cap;
     }
+    s[m->len] = 0;
+    m->cap = cap;
 
-    m->len -= (rend - rstart) - rmovelen;
+    return s;
 }
 
 /**
- * @brief Trim the characters from the beginning and end of the string.
- * @param s
- * @param cs - The substring listing the characters to trim.
- * @param len - The length of substring.
+ * @internal
+ * @brief Resize a compact heap string, switching header class if the
+ *        capacity no longer fits (or fits a smaller class).
  */
-void
-ss_trim(SS s, const char *cs, size_t len)
+static SS
+_ss_compact_realloc(SS s, size_t cap)
 {
-    if (len)
+    unsigned int to = _ss_hdr_for(cap);
+    size_t tosize = _ss_hdr_size(to);
+    size_t len = _ss_len(s);
+    uint32_t grow = _ss_type(s) & (_SS_GROW_MASK | _SS_ALIGNED);
+    bool aligned = !!(grow & _SS_ALIGNED);
+    const ss_allocator_t *a = g_ss_allocator;
+
+    if (cap < len)
     {
-        _ss_trim(s, 0, ss_len(s), cs, len);
+        len = cap;
+    }
+
+    char *block = _ss_block(s);
+    size_t size = _ss_compact_size(tosize, cap, aligned);
+    size_t off = s - block;
+    /* Lowest offset the data can have in the new block. */
+    size_t low = aligned ? tosize + 1 : tosize;
+
+    /*
+     * Data moves back before shrinking and to its new offset after
+     * reallocating, aligned strings can land anywhere in their padding.
+     */
+    if (low < off && (!aligned || cap < _ss_cap(s)))
+    {
+        ss_memmove(block + low, s, len);
+        off = low;
+    }
+
+    uintptr_t oldblock = (uintptr_t)block;
+    block = a->realloc(a->ctx, block, size);
+    if (UNLIKELY(!block))
+    {
+        _ss_abort(false, size);
+    }
+    if ((uintptr_t)block != oldblock)
+    {
+        _SS_STAT_ADD(bytes_copied, len);
+    }
+
+    size_t newoff = _ss_compact_offset(block, tosize, aligned);
+    if (newoff != off)
+    {
+        ss_memmove(block + newoff, block + off, len);
     }
+
+    s = _ss_compact_init(block, to, cap, grow);
+    _ss_setlen(s, len);
+    s[len] = 0;
+
+    return s;
 }
 
+/*
+ * Mapped strings.
+ * The file is mapped private and writable right after an anonymous page,
+ * the full header sits at the end of that page. Writes in place are
+ * copy-on-write by the kernel and never reach the file. Past the end of
+ * the file the mapping reads as zero, so the sentinel is always there.
+ */
+
 /**
- * @brief Trim the characters from the beginning and end in the range.
- * @param s
- * @param rstart - The start of the range (inclusive).
- * @param rend - The end of the range (exclusive).
- * @param cs - The substring of characters to trim.
- * @param len - The length of the substring.
+ * @internal
+ * @return Bytes mapped for a file of the given length, header page included.
  */
-void
-ss_trimrange(SS s, size_t rstart, size_t rend, const char *cs, size_t len)
+INLINE static size_t
+_ss_map_size(size_t len)
 {
-    if (len)
-    {
-        _sstring_t *m = _ss_meta(s);
+    size_t page = _ss_pagesize();
+    return page + (((len + 1) + page - 1) & ~(page - 1));
+}
 
-        if (rend > m->len)
-        {
-            rend = m->len;
-        }
+/*
+ * Shared strings.
+ * A reference counted block from the global allocator, the count is kept
+ * in the prefix slot. They aren't flagged as heap allocated, so anything
+ * writing to one first detaches it: the last reference takes the block
+ * over, others copy it. Their capacity is their length.
+ */
 
-        if (rstart >= rend)
+/**
+ * @internal
+ * @return Reference to the count of references.
+ */
+INLINE static size_t *
+_ss_refs(SS s)
+{
+    return (size_t *)_ss_prefix(_ss_meta(s));
+}
+
+/**
+ * @internal
+ * @brief Let go of the string's storage once its data has moved or it is freed.
+ * @note Unmaps mapped strings, drops a reference to shared strings.
+ *       The capacity of a mapped string is always the length of the file.
+ */
+INLINE static void
+_ss_release(SS s)
+{
+    if (_ss_is_type(s, _SSTRING_MAPPED))
+    {
+        munmap(s - _ss_pagesize(), _ss_map_size(_ss_cap(s)));
+    }
+    else if (_ss_is_type(s, _SSTRING_SHARED))
+    {
+        if (0 == __atomic_sub_fetch(_ss_refs(s), 1, __ATOMIC_ACQ_REL))
         {
-            return;
+            const ss_allocator_t *a = g_ss_allocator;
+            a->free(a->ctx, _ss_block(s));
         }
-
-        _ss_trim(s, rstart, rend, cs, len);
     }
 }
 
 /**
- * @brief Like the other trim methods, but assumes a cstring.
- * @note This is done because strchr is likely highly optimized.
- * @param s
- * @param cs - The substring of characters to trim.
- *             Using NULL will default to trimming US-ASCII whitespace.
+ * @internal
+ * @brief Adjust the capacity of the string to that given.
+ * @note If the capacity drops below the length the string is truncated.
+ * @param usable - Take any slack the allocator gives back as capacity.
  */
-void
-ssc_trim(SS s, const char *cs)
+INLINE static SS
+_ss_realloc_impl(SS s, size_t cap, bool usable)
 {
-    _sstring_t *m = _ss_meta(s);
-    size_t start = 0;
-    size_t end = m->len;
+    size_t oldcap = _ss_cap(s);
+    SS s2;
 
-    if (cs)
+    if (_ss_hdr(s))
     {
-        while (start < end && ss_cstrchar(cs, s[start]))
-        {
-            ++start;
-        }
-        while (start < end && ss_cstrchar(cs, s[end - 1]))
-        {
-            --end;
-        }
+        s2 = _ss_compact_realloc(s, cap);
     }
     else
     {
-        while (start < end && isspace(s[start]))
+        _sstring_t *m = _ss_meta(s);
+
+        if (m->type & _SS_HEAP_ALLOCATED)
         {
-            ++start;
+            const ss_allocator_t *a = _ss_allocator(s);
+            size_t extra = _ss_prefix_size(m->type);
+            size_t size = extra + sizeof(_sstring_t) + cap + 1;
+
+            uintptr_t oldblock = (uintptr_t)_ss_block(s);
+            size_t keep = m->len < cap ? m->len : cap;
+            char *block = a->realloc(a->ctx, _ss_block(s), size);
+            if (UNLIKELY(!block))
+            {
+                _ss_abort(false, size);
+            }
+            if ((uintptr_t)block != oldblock)
+            {
+                _SS_STAT_ADD(bytes_copied, keep);
+            }
+
+            m = (_sstring_t *)(block + extra);
+            if (cap < m->len)
+            {
+                m->len = cap;
+            }
+            m->cap = cap;
+            s2 = _ss_string(m);
+            s2[m->len] = 0;
         }
-        while (start < end && isspace(s[end - 1]))
+        else if ((m->type & _SS_KIND_MASK) == _SSTRING_ARENA)
         {
-            --end;
+            s2 = _ss_arena_realloc(s, cap);
+            _SS_STAT_REALLOC(s2, oldcap);
+            return s2;
         }
-    }
-
-    if (end != start)
-    {
-        m->len = end - start;
-        if (start)
+        else
         {
-            ss_memmove(s, s + start, m->len + 1);
+            size_t len = m->len < cap ? m->len : cap;
+            s2 = _ss_alloc(NULL, cap, m->type);
+            _SS_STAT_ADD(promotions, 1);
+            _SS_STAT_ADD(bytes_copied, len);
+            ss_memcopy(s2, s, len);
+            _ss_setlen(s2, len);
+            s2[len] = 0;
+            _ss_release(s);
         }
     }
-    else
+
+    if (usable)
     {
-        m->len = 0;
+        _ss_claim_usable(s2);
     }
-    s[m->len] = 0;
+
+    _SS_STAT_REALLOC(s2, oldcap);
+    return s2;
 }
 
 /**
- * @brief Convert US-ASCII characters to uppercase.
- * @param s
+ * @internal
+ * @brief Adjust the capacity of the string to exactly that given.
  */
-void
-ssc_upper(SS s)
+INLINE static SS
+_ss_realloc(SS s, size_t cap)
 {
-    while (*s)
-    {
-        *s = toupper(*s);
-        ++s;
-    }
+    _SS_STAT_ADD(reallocs, 1);
+    return _ss_realloc_impl(s, cap, false);
+}
+
+INLINE static int
+_ss_getgrow(uint32_t type)
+{
+    return (int)(type >> _SS_GROW_SHIFT);
 }
 
+/* Most bytes a heap block spends besides the capacity. */
+#define _SS_BLOCK_OVERHEAD (_SS_PREFIX_SIZE + sizeof(_sstring_t) + 1)
+
 /**
- * @brief Convert US-ASSII characters to lowercase.
- * @param s
+ * @internal
+ * @return Capacity whose block fills the size class holding cap,
+ *         classes are quarter steps between powers of two.
  */
-void
-ssc_lower(SS s)
+INLINE static size_t
+_ss_grow_class(size_t cap)
 {
-    while (*s)
+    size_t size = cap + _SS_BLOCK_OVERHEAD;
+    size_t step = 16;
+
+    if (size > 64)
     {
-        *s = tolower(*s);
-        ++s;
+        step = (size_t)1 << (61 - __builtin_clzll((unsigned long long)size - 1));
     }
+
+    return ((size + step - 1) & ~(step - 1)) - _SS_BLOCK_OVERHEAD;
 }
 
 /**
  * @internal
- * @return The numerical value of the hexidecimal US-ASCII character
- *         code point ('0'-'F', upper/lower).
- * @param c - The hex character.
+ * @return Capacity grown by half whose block fills whole pages.
  */
-INLINE static unsigned char
-_ss_tohexval(unsigned char c)
+INLINE static size_t
+_ss_grow_page(size_t cap)
 {
-    static const unsigned char map[] =
-    {
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        /* 0 starting at first item */
-        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0, 0, 0, 0, 0, 0,
-        /* A starting at second item */
-        0, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        /* a starting at second item */
-        0, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    };
-    return map[c];
+    return _ss_pageround(cap + cap / 2 + _SS_BLOCK_OVERHEAD) - _SS_BLOCK_OVERHEAD;
 }
 
 /**
  * @internal
- * @param n - The uint32_t to count bits of.
- * @return Number of bits set.
+ * @return Capacity to grow to for at least cap, applying the growth option.
  */
-INLINE static int
-_ss_pop32(uint32_t n)
+INLINE static size_t
+_ss_growcap(uint32_t type, size_t cap)
 {
-    n = n - ((n >> 1) & 0x55555555);
-    n = (n & 0x33333333) + ((n >> 2) & 0x33333333);
-    return (((n + (n >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+    size_t growcap = cap;
+
+    if (cap < _ss_cap_max())
+    {
+        switch (_ss_getgrow(type))
+        {
+            case SS_GROW25:
+                growcap = cap + (cap/4 < SS_MAX_REALLOC ? cap/4 : SS_MAX_REALLOC);
+                break;
+            case SS_GROW50:
+                growcap = cap + (cap/2 < SS_MAX_REALLOC ? cap/2 : SS_MAX_REALLOC);
+                break;
+            case SS_GROW100:
+                growcap = cap + (cap < SS_MAX_REALLOC ? cap : SS_MAX_REALLOC);
+                break;
+            case SS_GROWCLASS:
+                growcap = _ss_grow_class(cap);
+                break;
+            case SS_GROWPAGE:
+            case SS_GROWHUGE:
+                growcap = _ss_grow_page(cap);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (growcap < cap || !_ss_valid_cap(growcap))
+    {
+        return _ss_cap_max();
+    }
+
+    return growcap;
 }
 
-/*
+/**
  * @internal
- * @warning DO NOT use GCC clz impl because the result when n = 0 is undefined.
+ * @brief Adjust capactiy of the string applying growth values.
  */
-INLINE static int
-_ss_clz32_impl(uint32_t n)
+INLINE static SS
+_ss_realloc_grow(SS s, size_t cap)
 {
-    n = n | (n >> 1);
-    n = n | (n >> 2);
-    n = n | (n >> 4);
-    n = n | (n >> 8);
-    n = n | (n >>16);
-#if UINT_MAX == 4294967295U && defined __GNUC__
-    return __builtin_popcount(~n);
-#else
-    return _ss_pop32(~n);
-#endif
+    uint32_t type = _ss_type(s);
+
+    _SS_STAT_ADD(grows, 1);
+
+    if (type & _SS_GROW_MASK)
+    {
+        cap = _ss_growcap(type, cap);
+
+        /* Growing anyways, so keep what the allocator rounded up to. */
+        return _ss_realloc_impl(s, cap, true);
+    }
+
+    return _ss_realloc(s, cap);
 }
 
 /**
  * @internal
- * @note Uses de Bruijn algorithm for minimal perfect hashing.
- * @see https://en.wikipedia.org/wiki/Find_first_set
- * @return Return most significant bit index or zero if none.
+ * @brief Give a shared string storage of its own before it is written to.
+ * @note The last reference takes the block over as a heap string of the
+ *       global allocator, which the block came from. Otherwise the string
+ *       is copied, already grown to cap so the caller doesn't copy again.
+ * @param cap - Capacity the caller is about to grow to; zero if none.
  */
-INLINE static int
-_ss_msb32_impl(uint32_t c)
+INLINE static void
+_ss_detach_cap(SS *s, size_t cap)
 {
-    static char map[] =
+    if (LIKELY(_ss_hdr(*s) || !_ss_is_type(*s, _SSTRING_SHARED)))
     {
-        0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
-        8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
-    };
+        return;
+    }
 
-    if (UNLIKELY(!c))
+    _sstring_t *m = _ss_meta(*s);
+    size_t len = m->len;
+
+    if (1 == __atomic_load_n(_ss_refs(*s), __ATOMIC_ACQUIRE))
     {
-        return 0;
+        /* No other reference, so none can be made. Counted from here on. */
+        _SS_STAT_ADD(allocs, 1);
+        m->type = _SS_HEAP_ALLOCATED | _SSTRING_NORM | _SS_CUSTOM_ALLOC
+                  | (m->type & _SS_GROW_MASK);
+        *_ss_prefix(m) = (void *)g_ss_allocator;
+        return;
     }
 
-    c = c | (c >>  1);
-    c = c | (c >>  2);
-    c = c | (c >>  4);
-    c = c | (c >>  8);
-    c = c | (c >> 16);
+    if (cap > len)
+    {
+        _SS_STAT_ADD(grows, 1);
+        cap = _ss_growcap(m->type, cap);
+    }
+    else
+    {
+        cap = len;
+    }
 
-    return map[(c * 0x07C4ACDD) >> 27] + 1;
+    SS s2 = _ss_alloc(NULL, cap, m->type);
+
+    _SS_STAT_ADD(bytes_copied, len);
+    ss_memcopy(s2, *s, len + 1);
+    _ss_setlen(s2, len);
+    _ss_release(*s);
+    *s = s2;
 }
 
 /**
  * @internal
- * @brief Find the number of bytes to encode the number of bits.
- * 
- * Bytes   bits (diff)
- * 1  0- 7 bits
- * 2  8-11 bits (4)
- * 3 12-16 bits (5)
- * 4 17-21 bits (5)
- * 5 22-26 bits (5)
- * 6 27-31 bits (5)
- * 7 32-36 bits (5)
+ * @brief Give a shared string storage of its own, see _ss_detach_cap.
+ */
+INLINE static void
+_ss_detach(SS *s)
+{
+    _ss_detach_cap(s, 0);
+}
+
+/*
+ * Substring search engine.
  *
- * Add three to the number of bits to align to fives.
- * Divide by 5 to get the number of bytes to encode.
+ * Every substring search in the library funnels through ss_memmem.
+ * Single byte needles are handed to memchr.
+ * Otherwise the haystack is filtered with vector compares of the first and
+ * last byte of the needle, only candidate positions are verified with memcmp
+ * (Wojciech Muła's "generic SIMD" algorithm).
+ * The filter is quadratic on adversarial input, so once long needles spend
+ * too much time verifying false positives the search switches to the
+ * Two-Way algorithm (Crochemore-Perrin) which is linear in the worst case.
  *
- * @param c - Valid Unicode code point.
+ * The vector kernel is selected once at runtime by probing the CPU.
+ * @see http://0x80.pl/articles/simd-strfind.html
+ * @see https://en.wikipedia.org/wiki/Two-way_string-matching_algorithm
  */
-INLINE static int
-_ss_utf8len(unicode_t c)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define _SS_X86 (1)
+#include <immintrin.h>
+#endif
+
+/* Needles longer than this may fall back to Two-Way. */
+#define _SS_SEARCH_SHORT_MAX (32)
+
+/*
+ * Bytes of failed verification allowed per byte scanned (plus a constant)
+ * before a long needle falls back to Two-Way.
+ */
+#define _SS_SEARCH_BUDGET(SCANNED) (((SCANNED) * 2) + 4096)
+
+#define _SS_BITOP(A, B, OP) \
+    ((A)[(size_t)(B) / (8 * sizeof(*(A)))] OP \
+     (size_t)1 << ((size_t)(B) % (8 * sizeof(*(A)))))
+
+typedef const char *(*_ss_memmem_fn)(const char *, size_t, const char *, size_t);
+
+/**
+ * @internal
+ * @return The byte with ASCII uppercase folded to lowercase.
+ */
+INLINE static unsigned char
+_ss_fold(unsigned char c)
 {
-    return c < 128 ? 1 : ((_ss_msb32_impl(c) + 3)/5);
+    return (unsigned char)(c | ((unsigned char)(c - 'A') < 26 ? 0x20 : 0));
 }
 
-INLINE static int
-_ss_unicodetoutf8(unicode_t c, unsigned char *buf)
+/**
+ * @internal
+ * @brief Two-Way (Crochemore-Perrin) search, used for long needles.
+ * @note Combined with a last-byte shift table like the musl implementation.
+ * @param nlen - Needle length, at least two and at most hlen.
+ * @param fold - Compare ASCII letters case-insensitively, see _ss_fold.
+ * @return Pointer to the first match; NULL if not found.
+ */
+INLINE static const char *
+_ss_twoway_at(const char *hay, size_t hlen, const char *needle, size_t nlen, bool fold)
 {
-    if (c < 128)
+    const unsigned char *h = (const unsigned char *)hay;
+    const unsigned char *z = h + hlen;
+    const unsigned char *n = (const unsigned char *)needle;
+    size_t byteset[32 / sizeof(size_t)] = { 0 };
+    size_t shift[256];
+    size_t i, ip, jp, k, p, ms, p0, mem, mem0;
+
+#define _SS_TW(C) (fold ? _ss_fold(C) : (C))
+
+    for (i = 0; i < nlen; ++i)
     {
-        *buf = c;
-        return 1;
-#if 0
-        /* If we want to support technically invalid utf8 output.
-         * Only listed here as a form of documentation.
-         * Stuff like this does exist in the wild.
-         */
-        if (c)
+        _SS_BITOP(byteset, _SS_TW(n[i]), |=);
+        shift[_SS_TW(n[i])] = i + 1;
+    }
+
+    /* Maximal suffix for the "less than" ordering. */
+    ip = NPOS;
+    jp = 0;
+    k = p = 1;
+    while (jp + k < nlen)
+    {
+        if (_SS_TW(n[ip + k]) == _SS_TW(n[jp + k]))
         {
-            *buf = c;
-            return 1;
+            if (k == p)
+            {
+                jp += p;
+                k = 1;
+            }
+            else
+            {
+                ++k;
+            }
+        }
+        else if (_SS_TW(n[ip + k]) > _SS_TW(n[jp + k]))
+        {
+            jp += k;
+            k = 1;
+            p = jp - ip;
         }
         else
         {
-            /* Basically, null is output as multibyte so it
-             * can be included in normal string processing stuff.
-             */
-            buf[0] = 0xC0;
-            buf[1] = 0x80;
-            return 2;
+            ip = jp++;
+            k = p = 1;
         }
-#endif
     }
-    else if (UNLIKELY(!ssu_isvalid(c)))
+    ms = ip;
+    p0 = p;
+
+    /* Maximal suffix for the "greater than" ordering. */
+    ip = NPOS;
+    jp = 0;
+    k = p = 1;
+    while (jp + k < nlen)
     {
-        return 0;
+        if (_SS_TW(n[ip + k]) == _SS_TW(n[jp + k]))
+        {
+            if (k == p)
+            {
+                jp += p;
+                k = 1;
+            }
+            else
+            {
+                ++k;
+            }
+        }
+        else if (_SS_TW(n[ip + k]) < _SS_TW(n[jp + k]))
+        {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        }
+        else
+        {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+
+    /* The critical factorization is the longer of the two suffixes. */
+    if (ip + 1 > ms + 1)
+    {
+        ms = ip;
     }
     else
     {
-        int len = _ss_utf8len(c);
-        int i = len - 1;
-        do
+        p = p0;
+    }
+
+    for (i = 0; i < ms + 1 && _SS_TW(n[i]) == _SS_TW(n[i + p]); ++i)
+    {
+    }
+    if (i < ms + 1)
+    {
+        /* Not periodic, matches in the left half can't overlap. */
+        mem0 = 0;
+        p = (ms > nlen - ms - 1 ? ms : nlen - ms - 1) + 1;
+    }
+    else
+    {
+        mem0 = nlen - p;
+    }
+    mem = 0;
+
+    for (;;)
+    {
+        if ((size_t)(z - h) < nlen)
         {
-            buf[i] = (unsigned char)(c & 0x0000003F) | 0x80;
-            c >>= 6;
-            --i;
-        } while (i);
+            return NULL;
+        }
+
+        /* Check the last byte first, the shift table may skip ahead. */
+        if (_SS_BITOP(byteset, _SS_TW(h[nlen - 1]), &))
+        {
+            k = nlen - shift[_SS_TW(h[nlen - 1])];
+            if (k)
+            {
+                if (k < mem)
+                {
+                    k = mem;
+                }
+                h += k;
+                mem = 0;
+                continue;
+            }
+        }
+        else
+        {
+            h += nlen;
+            mem = 0;
+            continue;
+        }
+
+        /* Right half. */
+        for (k = (ms + 1 > mem ? ms + 1 : mem); k < nlen && _SS_TW(n[k]) == _SS_TW(h[k]); ++k)
+        {
+        }
+        if (k < nlen)
+        {
+            h += k - ms;
+            mem = 0;
+            continue;
+        }
+
+        /* Left half. */
+        for (k = ms + 1; k > mem && _SS_TW(n[k - 1]) == _SS_TW(h[k - 1]); --k)
+        {
+        }
+        if (k <= mem)
+        {
+            return (const char *)h;
+        }
+        h += p;
+        mem = mem0;
+    }
+#undef _SS_TW
+}
+
+/**
+ * @internal
+ * @brief Two-Way search, see _ss_twoway_at.
+ */
+static const char *
+_ss_twoway(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    return _ss_twoway_at(hay, hlen, needle, nlen, false);
+}
+
+/**
+ * @internal
+ * @brief Case-insensitive Two-Way search, see _ss_twoway_at.
+ */
+static const char *
+_ss_casetwoway(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    return _ss_twoway_at(hay, hlen, needle, nlen, true);
+}
+
+/**
+ * @internal
+ * @brief Scalar first byte scan, used for the tail of the vector loops.
+ * @param nlen - Needle length, at least two.
+ * @return Pointer to the first match; NULL if not found.
+ */
+static const char *
+_ss_memmem_scalar(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const char *cursor = hay;
+    const char *last = hay + (hlen - nlen);
+
+    while (cursor <= last)
+    {
+        cursor = ss_memchar(cursor, needle[0], (last - cursor) + 1);
+        if (!cursor)
+        {
+            break;
+        }
+
+        if (cursor[nlen - 1] == needle[nlen - 1]
+            && 0 == ss_memcompare(cursor + 1, needle + 1, nlen - 2))
+        {
+            return cursor;
+        }
+
+        ++cursor;
+    }
+
+    return NULL;
+}
+
+/**
+ * @internal
+ * @brief Portable search, dispatch target when no vector unit is found.
+ */
+static const char *
+_ss_memmem_generic(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    if (nlen > _SS_SEARCH_SHORT_MAX)
+    {
+        return _ss_twoway(hay, hlen, needle, nlen);
+    }
+
+    return _ss_memmem_scalar(hay, hlen, needle, nlen);
+}
+
+#ifdef _SS_X86
+
+/**
+ * @internal
+ * @brief SSE2 first/last byte filter.
+ */
+__attribute__((target("sse2")))
+static const char *
+_ss_memmem_sse2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+    size_t positions = hlen - nlen + 1;
+    size_t checked = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= positions; i += 16)
+    {
+        __m128i bfirst = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i blast = _mm_loadu_si128((const __m128i *)(hay + i + nlen - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, bfirst),
+                                   _mm_cmpeq_epi8(last, blast));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+
+        while (mask)
+        {
+            unsigned int bit = (unsigned int)__builtin_ctz(mask);
+            if (0 == ss_memcompare(hay + i + bit + 1, needle + 1, nlen - 2))
+            {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+
+            checked += nlen;
+            if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                         && checked > _SS_SEARCH_BUDGET(i)))
+            {
+                return _ss_twoway(hay + i, hlen - i, needle, nlen);
+            }
+        }
+    }
+
+    return _ss_memmem_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+/**
+ * @internal
+ * @brief AVX2 first/last byte filter.
+ */
+__attribute__((target("avx2")))
+static const char *
+_ss_memmem_avx2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[nlen - 1]);
+    size_t positions = hlen - nlen + 1;
+    size_t checked = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= positions; i += 32)
+    {
+        __m256i bfirst = _mm256_loadu_si256((const __m256i *)(hay + i));
+        __m256i blast = _mm256_loadu_si256((const __m256i *)(hay + i + nlen - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, bfirst),
+                                      _mm256_cmpeq_epi8(last, blast));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+
+        while (mask)
+        {
+            unsigned int bit = (unsigned int)__builtin_ctz(mask);
+            if (0 == ss_memcompare(hay + i + bit + 1, needle + 1, nlen - 2))
+            {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+
+            checked += nlen;
+            if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                         && checked > _SS_SEARCH_BUDGET(i)))
+            {
+                return _ss_twoway(hay + i, hlen - i, needle, nlen);
+            }
+        }
+    }
+
+    return _ss_memmem_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+#endif /* _SS_X86 */
+
+/**
+ * @internal
+ * @brief Pick the best kernel for this CPU.
+ */
+static _ss_memmem_fn
+_ss_memmem_select(void)
+{
+#ifdef _SS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return _ss_memmem_avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return _ss_memmem_sse2;
+    }
+#endif
+    return _ss_memmem_generic;
+}
+
+static const char *
+_ss_memmem_resolve(const char *, size_t, const char *, size_t);
+
+/*
+ * Starts at the resolver, which replaces itself on first use.
+ * Racing threads all store the same value; relaxed atomics keep that
+ * benign race well-defined.
+ */
+static _ss_memmem_fn g_ss_memmem = _ss_memmem_resolve;
+
+static const char *
+_ss_memmem_resolve(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    _ss_memmem_fn fn = _ss_memmem_select();
+    __atomic_store_n(&g_ss_memmem, fn, __ATOMIC_RELAXED);
+    return fn(hay, hlen, needle, nlen);
+}
+
+/**
+ * @internal
+ * @brief Find the first occurrence of the needle in the haystack.
+ * @return Pointer to the match; NULL if not found or needle is empty.
+ */
+INLINE static const char *
+_ss_memmem(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    if (UNLIKELY(!nlen || nlen > hlen))
+    {
+        return NULL;
+    }
+
+    if (1 == nlen)
+    {
+        return ss_memchar(hay, needle[0], hlen);
+    }
+
+    return __atomic_load_n(&g_ss_memmem, __ATOMIC_RELAXED)(hay, hlen, needle, nlen);
+}
+
+/*
+ * Reverse search.
+ * The mirror of the search engine: the same first/last byte filter runs
+ * back from the end of the haystack and verifies the highest candidates
+ * first. Long needles that blow the same verification budget fall back to
+ * Two-Way run from the end, so the worst case stays linear.
+ * Reversing a string swaps byte-reversed vectors from both ends.
+ */
+
+#define _SS_SWAR_ONES (0x0101010101010101ull)
+#define _SS_SWAR_HIGH (0x8080808080808080ull)
+
+/*
+ * Two-Way on the reversed problem: RN(i) is byte i of the reversed needle
+ * and RH(i) byte i of the reversed window ending at h.
+ */
+#define _SS_RN(I) (n[nlen - 1 - (I)])
+#define _SS_RH(I) (h[-1 - (ptrdiff_t)(I)])
+
+/**
+ * @internal
+ * @brief Two-Way search from the end, used for long needles.
+ * @note _ss_twoway run on the reversed needle and haystack, the window
+ *       is kept by its end and slides toward the start.
+ * @param nlen - Needle length, at least two and at most hlen.
+ * @return Pointer to the last match; NULL if not found.
+ */
+static const char *
+_ss_twoway_rev(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const unsigned char *z = (const unsigned char *)hay;
+    const unsigned char *h = z + hlen;
+    const unsigned char *n = (const unsigned char *)needle;
+    size_t byteset[32 / sizeof(size_t)] = { 0 };
+    size_t shift[256];
+    size_t i, ip, jp, k, p, ms, p0, mem, mem0;
+
+    for (i = 0; i < nlen; ++i)
+    {
+        _SS_BITOP(byteset, _SS_RN(i), |=);
+        shift[_SS_RN(i)] = i + 1;
+    }
+
+    /* Maximal suffix for the "less than" ordering. */
+    ip = NPOS;
+    jp = 0;
+    k = p = 1;
+    while (jp + k < nlen)
+    {
+        if (_SS_RN(ip + k) == _SS_RN(jp + k))
+        {
+            if (k == p)
+            {
+                jp += p;
+                k = 1;
+            }
+            else
+            {
+                ++k;
+            }
+        }
+        else if (_SS_RN(ip + k) > _SS_RN(jp + k))
+        {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        }
+        else
+        {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+    ms = ip;
+    p0 = p;
+
+    /* Maximal suffix for the "greater than" ordering. */
+    ip = NPOS;
+    jp = 0;
+    k = p = 1;
+    while (jp + k < nlen)
+    {
+        if (_SS_RN(ip + k) == _SS_RN(jp + k))
+        {
+            if (k == p)
+            {
+                jp += p;
+                k = 1;
+            }
+            else
+            {
+                ++k;
+            }
+        }
+        else if (_SS_RN(ip + k) < _SS_RN(jp + k))
+        {
+            jp += k;
+            k = 1;
+            p = jp - ip;
+        }
+        else
+        {
+            ip = jp++;
+            k = p = 1;
+        }
+    }
+
+    /* The critical factorization is the longer of the two suffixes. */
+    if (ip + 1 > ms + 1)
+    {
+        ms = ip;
+    }
+    else
+    {
+        p = p0;
+    }
+
+    /* Reversed ranges [0, ms] and [p, p + ms] are equal when these are. */
+    if (ss_memcompare(n + nlen - 1 - ms, n + nlen - 1 - ms - p, ms + 1))
+    {
+        /* Not periodic, matches in the left half can't overlap. */
+        mem0 = 0;
+        p = (ms > nlen - ms - 1 ? ms : nlen - ms - 1) + 1;
+    }
+    else
+    {
+        mem0 = nlen - p;
+    }
+    mem = 0;
+
+    for (;;)
+    {
+        if ((size_t)(h - z) < nlen)
+        {
+            return NULL;
+        }
+
+        /* Check the last byte first, the shift table may skip ahead. */
+        if (_SS_BITOP(byteset, _SS_RH(nlen - 1), &))
+        {
+            k = nlen - shift[_SS_RH(nlen - 1)];
+            if (k)
+            {
+                if (k < mem)
+                {
+                    k = mem;
+                }
+                h -= k;
+                mem = 0;
+                continue;
+            }
+        }
+        else
+        {
+            h -= nlen;
+            mem = 0;
+            continue;
+        }
+
+        /* Right half. */
+        for (k = (ms + 1 > mem ? ms + 1 : mem); k < nlen && _SS_RN(k) == _SS_RH(k); ++k)
+        {
+        }
+        if (k < nlen)
+        {
+            h -= k - ms;
+            mem = 0;
+            continue;
+        }
+
+        /* Left half. */
+        for (k = ms + 1; k > mem && _SS_RN(k - 1) == _SS_RH(k - 1); --k)
+        {
+        }
+        if (k <= mem)
+        {
+            return (const char *)(h - nlen);
+        }
+        h -= p;
+        mem = mem0;
+    }
+}
+
+#undef _SS_RN
+#undef _SS_RH
+
+typedef struct _ss_rev_ops_s
+{
+    /* Last find in the len bytes; NULL if none. */
+    const char *(*memrchar)(const char *buf, char find, size_t len);
+    /* Last match, nlen at least two and at most hlen. */
+    const char *(*memrmem)(const char *hay, size_t hlen, const char *needle, size_t nlen);
+    void (*reverse)(char *s, size_t len);
+} _ss_rev_ops_t;
+
+static const char *
+_ss_memrchar_scalar(const char *buf, char find, size_t len)
+{
+    const uint64_t pattern = _SS_SWAR_ONES * (unsigned char)find;
+
+    for (; len >= 8; len -= 8)
+    {
+        uint64_t x;
+        ss_memcopy(&x, buf + len - 8, 8);
+        x ^= pattern;
+        if ((x - _SS_SWAR_ONES) & ~x & _SS_SWAR_HIGH)
+        {
+            break;
+        }
+    }
+
+    while (len)
+    {
+        --len;
+        if (buf[len] == find)
+        {
+            return buf + len;
+        }
+    }
+
+    return NULL;
+}
+
+static const char *
+_ss_memrmem_scalar(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const char last = needle[nlen - 1];
+    /* Bytes that may hold the last byte of a match. */
+    const char *base = hay + nlen - 1;
+    size_t positions = hlen - (nlen - 1);
+    size_t left = positions;
+    size_t checked = 0;
+
+    while (left)
+    {
+        const char *cursor = _ss_memrchar_scalar(base, last, left);
+        if (!cursor)
+        {
+            break;
+        }
+
+        const char *start = cursor - (nlen - 1);
+        if (*start == needle[0] && 0 == ss_memcompare(start + 1, needle + 1, nlen - 2))
+        {
+            return start;
+        }
+
+        left = (size_t)(cursor - base);
+
+        checked += nlen;
+        if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                     && checked > _SS_SEARCH_BUDGET(positions - left)))
+        {
+            return _ss_twoway_rev(hay, left + nlen - 1, needle, nlen);
+        }
+    }
+
+    return NULL;
+}
+
+static void
+_ss_reverse_scalar(char *s, size_t len)
+{
+    char *left = s;
+    char *right = s + len;
+
+    while (right - left >= 16)
+    {
+        uint64_t a, b;
+        ss_memcopy(&a, left, 8);
+        ss_memcopy(&b, right - 8, 8);
+        a = __builtin_bswap64(a);
+        b = __builtin_bswap64(b);
+        ss_memcopy(left, &b, 8);
+        ss_memcopy(right - 8, &a, 8);
+        left += 8;
+        right -= 8;
+    }
+
+    while (right - left > 1)
+    {
+        char tmp = *--right;
+        *right = *left;
+        *left++ = tmp;
+    }
+}
+
+static const _ss_rev_ops_t g_ss_rev_scalar =
+{
+    _ss_memrchar_scalar,
+    _ss_memrmem_scalar,
+    _ss_reverse_scalar,
+};
+
+#ifdef _SS_X86
+
+__attribute__((target("ssse3")))
+static const char *
+_ss_memrchar_ssse3(const char *buf, char find, size_t len)
+{
+    const __m128i pattern = _mm_set1_epi8(find);
+
+    for (; len >= 16; len -= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + len - 16));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, pattern));
+        if (mask)
+        {
+            return buf + len - 16 + (31 - __builtin_clz(mask));
+        }
+    }
+
+    return _ss_memrchar_scalar(buf, find, len);
+}
+
+__attribute__((target("ssse3")))
+static const char *
+_ss_memrmem_ssse3(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[nlen - 1]);
+    size_t total = hlen - nlen + 1;
+    size_t positions = total;
+    size_t checked = 0;
+
+    for (; positions >= 16; positions -= 16)
+    {
+        const char *block = hay + positions - 16;
+        __m128i bfirst = _mm_loadu_si128((const __m128i *)block);
+        __m128i blast = _mm_loadu_si128((const __m128i *)(block + nlen - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, bfirst),
+                                   _mm_cmpeq_epi8(last, blast));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+
+        while (mask)
+        {
+            unsigned int bit = (unsigned int)(31 - __builtin_clz(mask));
+            if (0 == ss_memcompare(block + bit + 1, needle + 1, nlen - 2))
+            {
+                return block + bit;
+            }
+            mask ^= 1u << bit;
+
+            checked += nlen;
+            if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                         && checked > _SS_SEARCH_BUDGET(total - positions)))
+            {
+                /* Candidates above bit failed, the rest of the block didn't run. */
+                return _ss_twoway_rev(hay, positions - 16 + bit + nlen, needle, nlen);
+            }
+        }
+    }
+
+    return positions ? _ss_memrmem_scalar(hay, positions + nlen - 1, needle, nlen) : NULL;
+}
+
+__attribute__((target("ssse3")))
+static void
+_ss_reverse_ssse3(char *s, size_t len)
+{
+    const __m128i flip = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    char *left = s;
+    char *right = s + len;
+
+    while (right - left >= 32)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)left);
+        __m128i b = _mm_loadu_si128((const __m128i *)(right - 16));
+        _mm_storeu_si128((__m128i *)left, _mm_shuffle_epi8(b, flip));
+        _mm_storeu_si128((__m128i *)(right - 16), _mm_shuffle_epi8(a, flip));
+        left += 16;
+        right -= 16;
+    }
+
+    _ss_reverse_scalar(left, (size_t)(right - left));
+}
+
+static const _ss_rev_ops_t g_ss_rev_ssse3 =
+{
+    _ss_memrchar_ssse3,
+    _ss_memrmem_ssse3,
+    _ss_reverse_ssse3,
+};
+
+__attribute__((target("avx2")))
+static const char *
+_ss_memrchar_avx2(const char *buf, char find, size_t len)
+{
+    const __m256i pattern = _mm256_set1_epi8(find);
+
+    for (; len >= 32; len -= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(buf + len - 32));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, pattern));
+        if (mask)
+        {
+            return buf + len - 32 + (31 - __builtin_clz(mask));
+        }
+    }
+
+    return _ss_memrchar_scalar(buf, find, len);
+}
+
+__attribute__((target("avx2")))
+static const char *
+_ss_memrmem_avx2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[nlen - 1]);
+    size_t total = hlen - nlen + 1;
+    size_t positions = total;
+    size_t checked = 0;
+
+    for (; positions >= 32; positions -= 32)
+    {
+        const char *block = hay + positions - 32;
+        __m256i bfirst = _mm256_loadu_si256((const __m256i *)block);
+        __m256i blast = _mm256_loadu_si256((const __m256i *)(block + nlen - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, bfirst),
+                                      _mm256_cmpeq_epi8(last, blast));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+
+        while (mask)
+        {
+            unsigned int bit = (unsigned int)(31 - __builtin_clz(mask));
+            if (0 == ss_memcompare(block + bit + 1, needle + 1, nlen - 2))
+            {
+                return block + bit;
+            }
+            mask ^= 1u << bit;
+
+            checked += nlen;
+            if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                         && checked > _SS_SEARCH_BUDGET(total - positions)))
+            {
+                /* Candidates above bit failed, the rest of the block didn't run. */
+                return _ss_twoway_rev(hay, positions - 32 + bit + nlen, needle, nlen);
+            }
+        }
+    }
+
+    return positions ? _ss_memrmem_scalar(hay, positions + nlen - 1, needle, nlen) : NULL;
+}
+
+__attribute__((target("avx2")))
+static void
+_ss_reverse_avx2(char *s, size_t len)
+{
+    const __m256i flip = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                          15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    char *left = s;
+    char *right = s + len;
+
+    /* pshufb reverses each lane, swapping the lanes finishes the job. */
+    while (right - left >= 64)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)left);
+        __m256i b = _mm256_loadu_si256((const __m256i *)(right - 32));
+        a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, flip), 0x4E);
+        b = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, flip), 0x4E);
+        _mm256_storeu_si256((__m256i *)left, b);
+        _mm256_storeu_si256((__m256i *)(right - 32), a);
+        left += 32;
+        right -= 32;
+    }
+
+    _ss_reverse_scalar(left, (size_t)(right - left));
+}
+
+static const _ss_rev_ops_t g_ss_rev_avx2 =
+{
+    _ss_memrchar_avx2,
+    _ss_memrmem_avx2,
+    _ss_reverse_avx2,
+};
+
+#endif /* _SS_X86 */
+
+/* NULL until the first call picks the kernels. */
+static const _ss_rev_ops_t *g_ss_rev_ops;
+
+/**
+ * @internal
+ * @return The reverse kernels for this CPU.
+ */
+INLINE static const _ss_rev_ops_t *
+_ss_rev(void)
+{
+    const _ss_rev_ops_t *ops = __atomic_load_n(&g_ss_rev_ops, __ATOMIC_RELAXED);
+
+    if (UNLIKELY(!ops))
+    {
+        ops = &g_ss_rev_scalar;
+#ifdef _SS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            ops = &g_ss_rev_avx2;
+        }
+        else if (__builtin_cpu_supports("ssse3"))
+        {
+            ops = &g_ss_rev_ssse3;
+        }
+#endif
+        __atomic_store_n(&g_ss_rev_ops, ops, __ATOMIC_RELAXED);
+    }
+
+    return ops;
+}
+
+/**
+ * @internal
+ * @return Pointer to the last find in the len bytes; NULL if not found.
+ */
+INLINE static const char *
+_ss_memrchar(const char *buf, char find, size_t len)
+{
+    return _ss_rev()->memrchar(buf, find, len);
+}
+
+/**
+ * @internal
+ * @brief Find the last occurrence of the needle in the haystack.
+ * @return Pointer to the match; NULL if not found or needle is empty.
+ */
+INLINE static const char *
+_ss_memrmem(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    if (UNLIKELY(!nlen || nlen > hlen))
+    {
+        return NULL;
+    }
+
+    if (1 == nlen)
+    {
+        return _ss_memrchar(hay, needle[0], hlen);
+    }
+
+    return _ss_rev()->memrmem(hay, hlen, needle, nlen);
+}
+
+/*
+ * Aligned fast paths.
+ * Aligned strings can be read in whole chunks up to the end of the chunk
+ * holding the sentinel, so short strings need no scalar tail.
+ * The bytes past the length are garbage and are masked off before
+ * any branch depends on them.
+ */
+
+/* Searches longer than this use the search engine. */
+#define _SS_ALIGNED_FIND_MAX (64)
+
+#ifdef _SS_X86
+
+/**
+ * @internal
+ * @return Mask of the bytes that differ in the chunk.
+ */
+__attribute__((target("sse2")))
+INLINE static unsigned int
+_ss_chunk_diff(const char *a, const char *b)
+{
+    __m128i va = _mm_load_si128((const __m128i *)a);
+    __m128i vb = _mm_load_si128((const __m128i *)b);
+    return 0xFFFFu & ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+}
+
+/**
+ * @internal
+ * @return Mask of the first n bytes of a chunk.
+ */
+INLINE static unsigned int
+_ss_chunk_mask(size_t n)
+{
+    return n >= 16 ? 0xFFFFu : ((1u << n) - 1);
+}
+
+/**
+ * @internal
+ * @brief Equality of two aligned strings of the given length.
+ */
+__attribute__((target("sse2")))
+static bool
+_ss_equal_aligned(const char *s1, const char *s2, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += 16)
+    {
+        if (_ss_chunk_diff(s1 + i, s2 + i) & _ss_chunk_mask(len - i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @internal
+ * @return Index of the first difference in the first len bytes; len if none.
+ */
+__attribute__((target("sse2")))
+static size_t
+_ss_mismatch_aligned(const char *s1, const char *s2, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += 16)
+    {
+        unsigned int diff = _ss_chunk_diff(s1 + i, s2 + i) & _ss_chunk_mask(len - i);
+        if (diff)
+        {
+            return i + (size_t)__builtin_ctz(diff);
+        }
+    }
+
+    return len;
+}
+
+/**
+ * @internal
+ * @brief First byte filter over an aligned string.
+ * @param slen - Length of the string, short enough to not need the engine.
+ * @return Index of the needle; NPOS if not found.
+ */
+__attribute__((target("sse2")))
+static size_t
+_ss_find_aligned(const char *s, size_t slen, size_t index, const char *cs, size_t len)
+{
+    const __m128i first = _mm_set1_epi8(cs[0]);
+    size_t last = slen - len;
+    size_t i = index & ~((size_t)15);
+
+    /* Positions before index are masked off the first chunk. */
+    unsigned int skip = (unsigned int)(index - i);
+
+    for (; i <= last; i += 16)
+    {
+        __m128i chunk = _mm_load_si128((const __m128i *)(s + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(first, chunk));
+
+        mask &= _ss_chunk_mask(last - i + 1) & ~((1u << skip) - 1);
+        skip = 0;
+
+        while (mask)
+        {
+            size_t at = i + (size_t)__builtin_ctz(mask);
+            if (0 == ss_memcompare(s + at + 1, cs + 1, len - 1))
+            {
+                return at;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return NPOS;
+}
+
+#endif /* _SS_X86 */
+
+/*
+ * ASCII case folding.
+ * Only 'A'-'Z' and 'a'-'z' change, so a byte is folded by flipping bit 5
+ * when it's in range, no locale or table is involved. The vector kernels
+ * test the range with one add and a signed compare, and fold inside the
+ * compare and search loops so the input is never copied.
+ * Kernels are selected once at runtime like the search engine, and long
+ * needles fall back to Two-Way on folded bytes under the same budget.
+ * _ss_fold lives with the search engine, which shares its Two-Way.
+ */
+
+typedef struct _ss_case_ops_s
+{
+    /* Converts the ASCII letters to upper or lowercase. */
+    void (*map)(char *s, size_t len, bool upper);
+    /* Index of the first case-insensitive difference; len if none. */
+    size_t (*mismatch)(const char *a, const char *b, size_t len);
+    /* First case-insensitive match, nlen at least one and at most hlen. */
+    const char *(*find)(const char *hay, size_t hlen, const char *needle, size_t nlen);
+} _ss_case_ops_t;
+
+/**
+ * @internal
+ * @return Bit 5 set in every byte of the word from first to first + 25.
+ */
+INLINE static uint64_t
+_ss_caserange_swar(uint64_t x, unsigned char first)
+{
+    uint64_t low = x & ~_SS_SWAR_HIGH;
+    /* High bit of each byte: at least first, and past first + 25. */
+    uint64_t ge = low + _SS_SWAR_ONES * (0x80 - first);
+    uint64_t gt = low + _SS_SWAR_ONES * (0x7F - (first + 25));
+    return (((ge ^ gt) & ~x) & _SS_SWAR_HIGH) >> 2;
+}
+
+INLINE static uint64_t
+_ss_casemap_swar(uint64_t x, bool upper)
+{
+    return upper ? x & ~_ss_caserange_swar(x, 'a') : x | _ss_caserange_swar(x, 'A');
+}
+
+/*
+ * The maps set or clear the case bit rather than flip it, converting
+ * twice is harmless, so the last word of the vector kernels may overlap.
+ */
+static void
+_ss_casemap_scalar(char *s, size_t len, bool upper)
+{
+    unsigned char first = upper ? 'a' : 'A';
+    uint64_t x, tail;
+    size_t i = 0;
+
+    if (len < 4)
+    {
+        for (; i < len; ++i)
+        {
+            if ((unsigned char)(s[i] - first) < 26)
+            {
+                s[i] ^= 0x20;
+            }
+        }
+        return;
+    }
+
+    if (len < 8)
+    {
+        uint32_t head, end;
+        ss_memcopy(&head, s, 4);
+        ss_memcopy(&end, s + len - 4, 4);
+        head = (uint32_t)_ss_casemap_swar(head, upper);
+        end = (uint32_t)_ss_casemap_swar(end, upper);
+        ss_memcopy(s, &head, 4);
+        ss_memcopy(s + len - 4, &end, 4);
+        return;
+    }
+
+    /* The last word is read first, loading it after the stores would stall. */
+    ss_memcopy(&tail, s + len - 8, 8);
+    tail = _ss_casemap_swar(tail, upper);
+    for (; i + 8 <= len; i += 8)
+    {
+        ss_memcopy(&x, s + i, 8);
+        x = _ss_casemap_swar(x, upper);
+        ss_memcopy(s + i, &x, 8);
+    }
+    ss_memcopy(s + len - 8, &tail, 8);
+}
+
+static size_t
+_ss_casemismatch_scalar(const char *a, const char *b, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t x, y;
+        ss_memcopy(&x, a + i, 8);
+        ss_memcopy(&y, b + i, 8);
+        x |= _ss_caserange_swar(x, 'A');
+        y |= _ss_caserange_swar(y, 'A');
+        if (x != y)
+        {
+            break;
+        }
+    }
+
+    for (; i < len; ++i)
+    {
+        if (_ss_fold((unsigned char)a[i]) != _ss_fold((unsigned char)b[i]))
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+static const char *
+_ss_casefind_scalar(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    unsigned char first = _ss_fold((unsigned char)needle[0]);
+
+    for (size_t i = 0; i + nlen <= hlen; ++i)
+    {
+        if (_ss_fold((unsigned char)hay[i]) == first
+            && _ss_casemismatch_scalar(hay + i + 1, needle + 1, nlen - 1) == nlen - 1)
+        {
+            return hay + i;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @internal
+ * @brief Portable search, like _ss_memmem_generic.
+ */
+static const char *
+_ss_casefind_generic(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    if (nlen > _SS_SEARCH_SHORT_MAX)
+    {
+        return _ss_casetwoway(hay, hlen, needle, nlen);
+    }
+
+    return _ss_casefind_scalar(hay, hlen, needle, nlen);
+}
+
+static const _ss_case_ops_t g_ss_case_scalar =
+{
+    _ss_casemap_scalar,
+    _ss_casemismatch_scalar,
+    _ss_casefind_generic,
+};
+
+#ifdef _SS_X86
+
+/**
+ * @internal
+ * @return Mask of the bytes from first to first + 25.
+ */
+__attribute__((target("sse2")))
+INLINE static __m128i
+_ss_caserange_sse2(__m128i v, char first)
+{
+    __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - first)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(0x80 + 26)));
+}
+
+__attribute__((target("sse2")))
+INLINE static __m128i
+_ss_fold_sse2(__m128i v)
+{
+    __m128i upper = _ss_caserange_sse2(v, 'A');
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("sse2")))
+INLINE static __m128i
+_ss_casemap_vec_sse2(__m128i v, bool upper)
+{
+    const __m128i bit = _mm_set1_epi8(0x20);
+
+    if (upper)
+    {
+        return _mm_andnot_si128(_mm_and_si128(_ss_caserange_sse2(v, 'a'), bit), v);
+    }
+    return _mm_or_si128(v, _mm_and_si128(_ss_caserange_sse2(v, 'A'), bit));
+}
+
+/**
+ * @internal
+ * @brief Map 16 to 32 bytes as two overlapping chunks.
+ */
+__attribute__((target("sse2")))
+INLINE static void
+_ss_casemap_pair_sse2(char *s, size_t len, bool upper)
+{
+    __m128i head = _mm_loadu_si128((const __m128i *)s);
+    __m128i tail = _mm_loadu_si128((const __m128i *)(s + len - 16));
+    _mm_storeu_si128((__m128i *)s, _ss_casemap_vec_sse2(head, upper));
+    _mm_storeu_si128((__m128i *)(s + len - 16), _ss_casemap_vec_sse2(tail, upper));
+}
+
+__attribute__((target("sse2")))
+static void
+_ss_casemap_sse2(char *s, size_t len, bool upper)
+{
+    size_t i = 0;
+
+    if (len < 16)
+    {
+        _ss_casemap_scalar(s, len, upper);
+        return;
+    }
+
+    __m128i tail = _ss_casemap_vec_sse2(_mm_loadu_si128((const __m128i *)(s + len - 16)), upper);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(s + i), _ss_casemap_vec_sse2(v, upper));
+    }
+    _mm_storeu_si128((__m128i *)(s + len - 16), tail);
+}
+
+__attribute__((target("sse2")))
+static size_t
+_ss_casemismatch_sse2(const char *a, const char *b, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i va = _ss_fold_sse2(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m128i vb = _ss_fold_sse2(_mm_loadu_si128((const __m128i *)(b + i)));
+        unsigned int diff = 0xFFFFu & ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (diff)
+        {
+            return i + (size_t)__builtin_ctz(diff);
+        }
+    }
+
+    return i + _ss_casemismatch_scalar(a + i, b + i, len - i);
+}
+
+/**
+ * @internal
+ * @brief First/last byte filter on folded bytes, like _ss_memmem_sse2.
+ */
+__attribute__((target("sse2")))
+static const char *
+_ss_casefind_sse2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m128i first = _mm_set1_epi8((char)_ss_fold((unsigned char)needle[0]));
+    const __m128i last = _mm_set1_epi8((char)_ss_fold((unsigned char)needle[nlen - 1]));
+    size_t positions = hlen - nlen + 1;
+    size_t checked = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= positions; i += 16)
+    {
+        __m128i bfirst = _ss_fold_sse2(_mm_loadu_si128((const __m128i *)(hay + i)));
+        __m128i blast = _ss_fold_sse2(_mm_loadu_si128((const __m128i *)(hay + i + nlen - 1)));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, bfirst),
+                                   _mm_cmpeq_epi8(last, blast));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+
+        while (mask)
+        {
+            unsigned int bit = (unsigned int)__builtin_ctz(mask);
+            if (nlen <= 2
+                || _ss_casemismatch_sse2(hay + i + bit + 1, needle + 1, nlen - 2) == nlen - 2)
+            {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+
+            checked += nlen;
+            if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                         && checked > _SS_SEARCH_BUDGET(i)))
+            {
+                return _ss_casetwoway(hay + i, hlen - i, needle, nlen);
+            }
+        }
+    }
+
+    return _ss_casefind_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+static const _ss_case_ops_t g_ss_case_sse2 =
+{
+    _ss_casemap_sse2,
+    _ss_casemismatch_sse2,
+    _ss_casefind_sse2,
+};
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_caserange_avx2(__m256i v, char first)
+{
+    __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - first)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + 26)), shifted);
+}
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_fold_avx2(__m256i v)
+{
+    __m256i upper = _ss_caserange_avx2(v, 'A');
+    return _mm256_or_si256(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_casemap_vec_avx2(__m256i v, bool upper)
+{
+    const __m256i bit = _mm256_set1_epi8(0x20);
+
+    if (upper)
+    {
+        return _mm256_andnot_si256(_mm256_and_si256(_ss_caserange_avx2(v, 'a'), bit), v);
+    }
+    return _mm256_or_si256(v, _mm256_and_si256(_ss_caserange_avx2(v, 'A'), bit));
+}
+
+/*
+ * Tails stay in this function, the legacy SSE encoding of the sse2
+ * kernels stalls on the dirty upper halves of the registers.
+ */
+__attribute__((target("avx2")))
+static void
+_ss_casemap_avx2(char *s, size_t len, bool upper)
+{
+    size_t i = 0;
+
+    if (len < 32)
+    {
+        if (len < 16)
+        {
+            _ss_casemap_scalar(s, len, upper);
+        }
+        else
+        {
+            _ss_casemap_pair_sse2(s, len, upper);
+        }
+        return;
+    }
+
+    __m256i tail = _ss_casemap_vec_avx2(_mm256_loadu_si256((const __m256i *)(s + len - 32)), upper);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        _mm256_storeu_si256((__m256i *)(s + i), _ss_casemap_vec_avx2(v, upper));
+    }
+    _mm256_storeu_si256((__m256i *)(s + len - 32), tail);
+}
+
+__attribute__((target("avx2")))
+static size_t
+_ss_casemismatch_avx2(const char *a, const char *b, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i va = _ss_fold_avx2(_mm256_loadu_si256((const __m256i *)(a + i)));
+        __m256i vb = _ss_fold_avx2(_mm256_loadu_si256((const __m256i *)(b + i)));
+        uint32_t diff = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (diff)
+        {
+            return i + (size_t)__builtin_ctz(diff);
+        }
+    }
+
+    return i + _ss_casemismatch_scalar(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static const char *
+_ss_casefind_avx2(const char *hay, size_t hlen, const char *needle, size_t nlen)
+{
+    const __m256i first = _mm256_set1_epi8((char)_ss_fold((unsigned char)needle[0]));
+    const __m256i last = _mm256_set1_epi8((char)_ss_fold((unsigned char)needle[nlen - 1]));
+    size_t positions = hlen - nlen + 1;
+    size_t checked = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= positions; i += 32)
+    {
+        __m256i bfirst = _ss_fold_avx2(_mm256_loadu_si256((const __m256i *)(hay + i)));
+        __m256i blast = _ss_fold_avx2(_mm256_loadu_si256((const __m256i *)(hay + i + nlen - 1)));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, bfirst),
+                                      _mm256_cmpeq_epi8(last, blast));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(eq);
+
+        while (mask)
+        {
+            unsigned int bit = (unsigned int)__builtin_ctz(mask);
+            if (nlen <= 2
+                || _ss_casemismatch_avx2(hay + i + bit + 1, needle + 1, nlen - 2) == nlen - 2)
+            {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+
+            checked += nlen;
+            if (UNLIKELY(nlen > _SS_SEARCH_SHORT_MAX
+                         && checked > _SS_SEARCH_BUDGET(i)))
+            {
+                return _ss_casetwoway(hay + i, hlen - i, needle, nlen);
+            }
+        }
+    }
+
+    return _ss_casefind_scalar(hay + i, hlen - i, needle, nlen);
+}
+
+static const _ss_case_ops_t g_ss_case_avx2 =
+{
+    _ss_casemap_avx2,
+    _ss_casemismatch_avx2,
+    _ss_casefind_avx2,
+};
+
+#endif /* _SS_X86 */
+
+/* NULL until the first call picks the kernels. */
+static const _ss_case_ops_t *g_ss_case_ops;
+
+/**
+ * @internal
+ * @return The case kernels for this CPU.
+ */
+INLINE static const _ss_case_ops_t *
+_ss_case(void)
+{
+    const _ss_case_ops_t *ops = __atomic_load_n(&g_ss_case_ops, __ATOMIC_RELAXED);
+
+    if (UNLIKELY(!ops))
+    {
+        ops = &g_ss_case_scalar;
+#ifdef _SS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            ops = &g_ss_case_avx2;
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+            ops = &g_ss_case_sse2;
+        }
+#endif
+        __atomic_store_n(&g_ss_case_ops, ops, __ATOMIC_RELAXED);
+    }
+
+    return ops;
+}
+
+/**
+ * The empty string is great if you want to avoid NULL checks but have
+ * O(1) time and space cost.
+ * This reference is not allocated, but will become allocated once you 
+ * add to it using the library functions.
+ * @warning While you can duplicate the empty string reference safely, don't.
+ * @return Empty string reference.
+ */
+SS
+ss_empty(void)
+{
+    return _ss_string((_sstring_t *)&g_ss_empty[0]);
+}
+
+/**
+ * @return String with capacity as specified.
+ */
+SS
+ss_new(size_t cap)
+{
+    if (!cap || NPOS == cap)
+    {
+        return ss_empty();
+    }
+
+    if (!_ss_valid_cap(cap))
+    {
+        cap = _ss_cap_max();
+    }
+
+    SS s = _ss_alloc(NULL, cap, 0);
+
+    if (s)
+    {
+        s[0] = 0;
+    }
+
+    return s;
+}
+
+/**
+ * @brief Like ss_new, but the data starts on an SS_ALIGN byte boundary.
+ * @note The string stays aligned as it grows and shrinks.
+ *       Equality, comparison, and searching of short aligned strings
+ *       work in whole vector chunks.
+ * @return String with capacity as specified.
+ */
+SS
+ss_new_aligned(size_t cap)
+{
+    if (!_ss_valid_cap(cap))
+    {
+        cap = _ss_cap_max();
+    }
+
+    SS s = _ss_alloc(NULL, cap, _SS_ALIGNED);
+    s[0] = 0;
+
+    return s;
+}
+
+/**
+ * @internal
+ * @param a - The per-string allocator; NULL for the global allocator.
+ * @param flags - Type flags to keep, only _SS_ALIGNED for now.
+ */
+INLINE static SS
+_ss_newfrom(const ss_allocator_t *a, size_t cap, const char *cs, size_t len, uint32_t flags)
+{
+    cap = cap > len ? cap : len;
+    SS s = _ss_alloc(a, cap, flags);
+
+    if (s)
+    {
+        _ss_setlen(s, len);
+        if (len)
+        {
+            ss_memcopy(s, cs, len);
+        }
+        s[len] = 0;
+    }
+
+    return s;
+}
+
+/**
+ * @return New string with the given capacity and copy of the given string.
+ */
+SS
+ss_newfrom(size_t cap, const char *cs, size_t len)
+{
+    return _ss_newfrom(NULL, cap, cs, len, 0);
+}
+
+/**
+ * @brief Like ss_newfrom, but the data starts on an SS_ALIGN byte boundary.
+ * @return New string with the given capacity and copy of the given string.
+ */
+SS
+ss_newfrom_aligned(size_t cap, const char *cs, size_t len)
+{
+    return _ss_newfrom(NULL, cap, cs, len, _SS_ALIGNED);
+}
+
+/**
+ * @brief Like ss_newfrom, but the string is owned by the given allocator.
+ * @note The allocator is used for the string's whole lifetime, including
+ *       reallocation and ss_free, so it must outlive the string.
+ * @param a - The allocator; NULL for the global allocator.
+ * @return New string with the given capacity and copy of the given string.
+ */
+SS
+ss_newfrom_allocator(const ss_allocator_t *a, size_t cap, const char *cs, size_t len)
+{
+    return _ss_newfrom(a, cap, cs, len, 0);
+}
+
+/**
+ * @brief Create an arena for bump allocated strings.
+ * @note The arena's blocks come from the global allocator.
+ * @param blocksize - Size of each block; zero for the default (64KiB).
+ * @return New arena.
+ */
+ss_arena_t *
+ss_arena_new(size_t blocksize)
+{
+    const ss_allocator_t *a = g_ss_allocator;
+    ss_arena_t *ar = a->alloc(a->ctx, sizeof(ss_arena_t));
+    if (UNLIKELY(!ar))
+    {
+        _ss_abort(true, sizeof(ss_arena_t));
+    }
+
+    ar->alloc = a;
+    ar->blocksize = blocksize ? _SS_ARENA_ALIGN(blocksize) : _SS_ARENA_BLOCK;
+    ar->head = _ss_arena_block(a, ar->blocksize);
+    ar->cur = ar->head;
+    ar->ptr = (char *)(ar->head + 1);
+    ar->end = ar->ptr + ar->head->size;
+    ar->last = NULL;
+
+    return ar;
+}
+
+/**
+ * @brief Release every string in the arena in O(1).
+ * @warning All strings created from the arena become invalid.
+ * @note Blocks are kept for reuse; use ss_arena_free to return memory.
+ * @param ar
+ */
+void
+ss_arena_reset(ss_arena_t *ar)
+{
+    ar->cur = ar->head;
+    ar->ptr = (char *)(ar->head + 1);
+    ar->end = ar->ptr + ar->head->size;
+    ar->last = NULL;
+}
+
+/**
+ * @brief Free the arena and all of its blocks.
+ * @warning All strings created from the arena become invalid.
+ * @param ar
+ */
+void
+ss_arena_free(ss_arena_t **ar)
+{
+    const ss_allocator_t *a = (*ar)->alloc;
+    _ss_arena_block_t *b = (*ar)->head;
+
+    while (b)
+    {
+        _ss_arena_block_t *next = b->next;
+        a->free(a->ctx, b);
+        b = next;
+    }
+
+    a->free(a->ctx, *ar);
+    *ar = NULL;
+}
+
+/**
+ * @brief Create an empty string in the arena.
+ * @note ss_free is a no-op for arena strings (still call it),
+ *       the memory is released with the arena.
+ * @param ar
+ * @param cap - The capacity.
+ * @return New arena string.
+ */
+SS
+ss_new_arena(ss_arena_t *ar, size_t cap)
+{
+    if (!_ss_valid_cap(cap))
+    {
+        cap = _ss_cap_max();
+    }
+
+    SS s = _ss_arena_new(ar, cap, 0);
+    s[0] = 0;
+
+    return s;
+}
+
+/**
+ * @brief Like ss_newfrom, but the string lives in the arena.
+ * @note Growth stays within the arena.
+ * @param ar
+ * @param cap - The capacity.
+ * @param cs - The string to copy.
+ * @param len - Length of `cs`.
+ * @return New arena string.
+ */
+SS
+ss_newfrom_arena(ss_arena_t *ar, size_t cap, const char *cs, size_t len)
+{
+    cap = cap > len ? cap : len;
+    SS s = _ss_arena_new(ar, cap, 0);
+
+    _ss_meta(s)->len = len;
+    if (len)
+    {
+        ss_memcopy(s, cs, len);
+    }
+    s[len] = 0;
+
+    return s;
+}
+
+/**
+ * @note The duplicate keeps the allocator and alignment of the original.
+ * @return Duplicate of the given string.
+ */
+SS
+ss_dup(SS s)
+{
+    return _ss_newfrom(ss_getallocator(s), 0, s, _ss_len(s), _ss_type(s) & _SS_ALIGNED);
+}
+
+/**
+ * @brief Free the given string.
+ * @note Will properly check for empty and stack string types.
+ * @param s
+ */
+void
+ss_free(SS *s) 
+{
+    /* Empty string and stack string will not have flag set. */
+    if ((_ss_type(*s)) & _SS_HEAP_ALLOCATED)
+    {
+        _SS_STAT_FREE(*s);
+        _ss_dealloc(*s);
+    }
+    else
+    {
+        _ss_release(*s);
+    }
+    (*s) = NULL;
+}
+
+/**
+ * @brief Share the string without copying it, e.g. with other threads.
+ * @note The first share moves the string into a reference counted block
+ *       and updates s, later ones only count a reference. Every reference
+ *       is freed with ss_free, the last one frees the block.
+ * @note Functions taking `SS *` copy a shared string before changing it,
+ *       so other references never see the change. The last reference
+ *       takes the block over instead.
+ * @warning Functions taking `SS` change the string in place, use
+ *          ss_unshare first.
+ * @param s
+ * @return Another reference to the string.
+ */
+SS
+ss_share(SS *s)
+{
+    if (_ss_is_type(*s, _SSTRING_EMPTY))
+    {
+        /* Never written to, so already safe to share. */
+        return *s;
+    }
+
+    if (!_ss_is_type(*s, _SSTRING_SHARED))
+    {
+        const ss_allocator_t *a = g_ss_allocator;
+        size_t len = _ss_len(*s);
+        size_t size = _SS_PREFIX_SIZE + sizeof(_sstring_t) + len + 1;
+        char *block = a->alloc(a->ctx, size);
+        if (UNLIKELY(!block))
+        {
+            _ss_abort(true, size);
+        }
+
+        _sstring_t *m = (_sstring_t *)(block + _SS_PREFIX_SIZE);
+        m->cap = len;
+        m->len = len;
+        m->type = _SSTRING_SHARED | (_ss_type(*s) & _SS_GROW_MASK);
+        m->hdr = _SS_HDR_FULL;
+
+        SS shared = _ss_string(m);
+        *_ss_refs(shared) = 1;
+        ss_memcopy(shared, *s, len + 1);
+
+        ss_free(s);
+        *s = shared;
+    }
+
+    __atomic_add_fetch(_ss_refs(*s), 1, __ATOMIC_RELAXED);
+
+    return *s;
+}
+
+/**
+ * @brief Give this reference to a shared string a copy of its own.
+ * @note Does nothing to other strings.
+ * @param s
+ */
+void
+ss_unshare(SS *s)
+{
+    _ss_detach(s);
+}
+
+/**
+ * @brief Exposed method for internal
+ * @warning Users should not use this function.
+ * @param b - The buffer to initialize and turn into a stack string.
+ * @return Initialized stack string.
+ */
+SS
+ss_stack_init(void *b, size_t cap)
+{
+    _sstring_t *m = (_sstring_t *)b;
+    m->cap = cap;
+    m->len = 0;
+    m->type = _SSTRING_STACK;
+    m->hdr = _SS_HDR_FULL;
+
+    SS s = _ss_string(m);
+    s[0] = 0;
+
+    return s;
+}
+
+/**
+ * @warning Your system and available memory may restrict this more.
+ * @note The value is adjusted for the metadata and NULL sentinel.
+ * @return The maximum capacity value.
+ */
+size_t
+ss_maxcap(void)
+{
+    return _ss_cap_max();
+}
+
+/**
+ * @note If you have a c-string you're using and have modified the string
+ *       so the end is different than before, call ssc_setlen before using.
+ * @return Length of the string in O(1) time.
+ */
+size_t
+ss_len(const SS s)
+{
+    return _ss_len(s);
+}
+
+/**
+ * @note The length will always be less than or equal to capacity.
+ * @return The capacity of the string.
+ */
+size_t
+ss_cap(const SS s)
+{
+    return _ss_cap(s);
+}
+
+/**
+ * @return True if the length is zero.
+ */
+bool
+ss_isempty(const SS s)
+{
+    return !(_ss_len(s));
+}
+
+/**
+ * @return True if this was a string returned from ss_empty.
+ */
+bool
+ss_isemptytype(const SS s)
+{
+    return _ss_is_type(s, _SSTRING_EMPTY);
+}
+
+/**
+ * @return True if this string is on the heap (malloc'd).
+ */
+bool
+ss_isheaptype(const SS s)
+{
+    return ((_ss_type(s)) & _SS_HEAP_ALLOCATED);
+}
+
+/**
+ * @return True if the data starts on an SS_ALIGN byte boundary.
+ */
+bool
+ss_isaligned(const SS s)
+{
+    return _ss_isaligned(s);
+}
+
+/**
+ * @return True if this string lives in an arena.
+ */
+bool
+ss_isarenatype(const SS s)
+{
+    return _ss_is_type(s, _SSTRING_ARENA);
+}
+
+/**
+ * @return True if this string is shared, see ss_share.
+ */
+bool
+ss_issharedtype(const SS s)
+{
+    return _ss_is_type(s, _SSTRING_SHARED);
+}
+
+/**
+ * @return True if this string is a mapped file, see ss_mapfile.
+ */
+bool
+ss_ismappedtype(const SS s)
+{
+    return _ss_is_type(s, _SSTRING_MAPPED);
+}
+
+/**
+ * @return True if this string is on the stack.
+ */
+bool
+ss_isstacktype(const SS s)
+{
+    return _ss_is_type(s, _SSTRING_STACK);
+}
+
+/**
+ * @return True if both strings are equal (capacity can differ); false othewise.
+ */
+bool
+ss_equal(const SS s1, const SS s2)
+{
+    if (s1 == s2)
+    {
+        return true;
+    }
+
+    size_t len = _ss_len(s1);
+
+    if (len != _ss_len(s2))
+    {
+        return false;
+    }
+
+    if (_ss_hashed(s1) && _ss_hashed(s2) && _ss_hashval(s1) != _ss_hashval(s2))
+    {
+        return false;
+    }
+
+#ifdef _SS_X86
+    if (_ss_isaligned(s1) && _ss_isaligned(s2))
+    {
+        return _ss_equal_aligned(s1, s2, len);
+    }
+#endif
+
+    return 0 == ss_memcompare(s1, s2, len);
+}
+
+/**
+ * @internal
+ * @brief Order of strings equal up to the shorter length,
+ *        the shorter sorts first.
+ */
+INLINE static int
+_ss_compare_lens(size_t len1, size_t len2)
+{
+    if (len1 < len2)
+    {
+        return -1;
+    }
+    else if (len1 > len2)
+    {
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/**
+ * @note Uses memcmp by default. Make your own for local specific strings.
+ * @return <1 if s1 < s2, >1 if s2 < s1, zero if equal.
+ */
+int
+ss_compare(const SS s1, const SS s2)
+{
+    size_t len1 = _ss_len(s1);
+    size_t len2 = _ss_len(s2);
+    size_t len = len1 < len2 ? len1 : len2;
+
+    if (len)
+    {
+#ifdef _SS_X86
+        if (_ss_isaligned(s1) && _ss_isaligned(s2))
+        {
+            size_t i = _ss_mismatch_aligned(s1, s2, len);
+            if (i < len)
+            {
+                return (int)(unsigned char)s1[i] - (int)(unsigned char)s2[i];
+            }
+        }
+        else
+#endif
+        {
+            int cmp = ss_memcompare(s1, s2, len);
+            if (cmp)
+            {
+                return cmp;
+            }
+        }
+    }
+
+    return _ss_compare_lens(len1, len2);
+}
+
+/**
+ * @brief Like ss_compare, but ASCII letters compare as lowercase.
+ * @return <1 if s1 < s2, >1 if s2 < s1, zero if equal ignoring case.
+ */
+int
+ss_casecompare(const SS s1, const SS s2)
+{
+    size_t len1 = _ss_len(s1);
+    size_t len2 = _ss_len(s2);
+    size_t len = len1 < len2 ? len1 : len2;
+    size_t i = _ss_case()->mismatch(s1, s2, len);
+
+    if (i < len)
+    {
+        return (int)_ss_fold((unsigned char)s1[i]) - (int)_ss_fold((unsigned char)s2[i]);
+    }
+
+    return _ss_compare_lens(len1, len2);
+}
+
+/**
+ * @return True if both strings are equal ignoring ASCII case; false otherwise.
+ */
+bool
+ss_caseequal(const SS s1, const SS s2)
+{
+    size_t len = _ss_len(s1);
+
+    return len == _ss_len(s2) && (s1 == s2 || _ss_case()->mismatch(s1, s2, len) == len);
+}
+
+INLINE static size_t
+_ss_find(const char *s, size_t slen, size_t index, const char *cs, size_t len)
+{
+    if (len && index < slen)
+    {
+        const char *found = ss_memmem(s + index, slen - index, cs, len);
+        if (found)
+        {
+            return found - s;
+        }
+    }
+
+    return NPOS;
+}
+
+/**
+ * @return The index of the string to find; NPOS if not found.
+ */
+size_t
+ss_find(const SS s, size_t index, const char *cs, size_t len)
+{
+#ifdef _SS_X86
+    size_t slen = _ss_len(s);
+
+    if (len && index < slen && _ss_isaligned(s) && slen <= _SS_ALIGNED_FIND_MAX)
+    {
+        return len <= slen - index
+               ? _ss_find_aligned(s, slen, index, cs, len) : NPOS;
+    }
+#endif
+
+    return _ss_find(s, _ss_len(s), index, cs, len);
+}
+
+/**
+ * @brief Like ss_find, but ASCII letters match either case.
+ * @return The index of the string to find; NPOS if not found.
+ */
+size_t
+ss_casefind(const SS s, size_t index, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(s);
+
+    if (len && index < slen && len <= slen - index)
+    {
+        const char *found = _ss_case()->find(s + index, slen - index, cs, len);
+        if (found)
+        {
+            return found - s;
+        }
+    }
+
+    return NPOS;
+}
+
+INLINE static size_t
+_ss_rfind(const char *s, size_t slen, size_t index, const char *cs, size_t len)
+{
+    /* The match has to end at or before index. */
+    size_t searchlen = index < slen ? index + 1 : slen;
+    const char *found = _ss_memrmem(s, searchlen, cs, len);
+
+    return found ? (size_t)(found - s) : NPOS;
+}
+
+/**
+ * @return The right-most index of the string to find; NPOS if not found.
+ */
+size_t
+ss_rfind(const SS s, size_t index, const char *cs, size_t len)
+{
+    return _ss_rfind(s, _ss_len(s), index, cs, len);
+}
+
+INLINE static size_t
+_ss_count(const char *s, size_t slen, size_t index, const char *cs, size_t len)
+{
+    size_t count = 0;
+
+    if (len)
+    {
+        if (index >= slen)
+        {
+            return count;
+        }
+
+        const char *end = s + slen;
+        const char *cursor = s + index;
+        while ((cursor = ss_memmem(cursor, end - cursor, cs, len)))
+        {
+            ++count;
+            cursor += len;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @return The count of the number of sub-strings found.
+ */
+size_t
+ss_count(const SS s, size_t index, const char *cs, size_t len)
+{
+    return _ss_count(s, _ss_len(s), index, cs, len);
+}
+
+/*
+ * Views.
+ * A view borrows bytes from a string or any buffer, the queries on views
+ * run the same search code as the string queries without allocating.
+ */
+
+/**
+ * @return View of the whole string.
+ * @warning The view is invalid once the string is modified or freed.
+ */
+ss_view_t
+ss_view(const SS s)
+{
+    ss_view_t v = { s, _ss_len(s) };
+    return v;
+}
+
+/**
+ * @return View of the bytes.
+ */
+ss_view_t
+ss_view_of(const char *cs, size_t len)
+{
+    ss_view_t v = { cs, len };
+    return v;
+}
+
+/**
+ * @return View of the range [start, end) of the view, clamped to it.
+ */
+ss_view_t
+ss_view_sub(ss_view_t v, size_t start, size_t end)
+{
+    if (end > v.len)
+    {
+        end = v.len;
+    }
+    if (start > end)
+    {
+        start = end;
+    }
+
+    ss_view_t sub = { v.ptr + start, end - start };
+    return sub;
+}
+
+/**
+ * @return The index of the string to find; NPOS if not found.
+ */
+size_t
+ss_find_view(ss_view_t v, size_t index, const char *cs, size_t len)
+{
+    return _ss_find(v.ptr, v.len, index, cs, len);
+}
+
+/**
+ * @return The right-most index of the string to find; NPOS if not found.
+ */
+size_t
+ss_rfind_view(ss_view_t v, size_t index, const char *cs, size_t len)
+{
+    return _ss_rfind(v.ptr, v.len, index, cs, len);
+}
+
+/**
+ * @return The count of the number of sub-strings found.
+ */
+size_t
+ss_count_view(ss_view_t v, size_t index, const char *cs, size_t len)
+{
+    return _ss_count(v.ptr, v.len, index, cs, len);
+}
+
+/**
+ * @return True if both views hold the same bytes.
+ */
+bool
+ss_equal_view(ss_view_t v1, ss_view_t v2)
+{
+    return v1.len == v2.len && (v1.ptr == v2.ptr || 0 == ss_memcompare(v1.ptr, v2.ptr, v1.len));
+}
+
+/**
+ * @return <1 if v1 < v2, >1 if v2 < v1, zero if equal.
+ */
+int
+ss_compare_view(ss_view_t v1, ss_view_t v2)
+{
+    size_t len = v1.len < v2.len ? v1.len : v2.len;
+
+    if (len)
+    {
+        int cmp = ss_memcompare(v1.ptr, v2.ptr, len);
+        if (cmp)
+        {
+            return cmp;
+        }
+    }
+
+    return _ss_compare_lens(v1.len, v2.len);
+}
+
+/**
+ * @brief Start splitting the view into fields.
+ * @param it
+ * @param v - The bytes to split, they must outlive the iterator.
+ */
+void
+ss_split_init(ss_split_t *it, ss_view_t v)
+{
+    it->ptr = v.ptr;
+    it->len = v.len;
+    it->pos = 0;
+    it->done = false;
+}
+
+/**
+ * @brief Get the next field before the delimiter.
+ * @note There is always one more field than delimiters, so "a,,b" splits
+ *       into "a", "", and "b", and an empty view into one empty field.
+ *       An empty delimiter gives the rest as one field.
+ * @param it
+ * @param delim - The delimiter, it may change between calls.
+ * @param dlen - Length of the delimiter.
+ * @param field - Set to the field.
+ * @return True if a field was found; false once every field was given.
+ */
+bool
+ss_split_next(ss_split_t *it, const char *delim, size_t dlen, ss_view_t *field)
+{
+    if (it->done)
+    {
+        return false;
+    }
+
+    const char *start = it->ptr + it->pos;
+    size_t rest = it->len - it->pos;
+    const char *found = NULL;
+
+    if (dlen && dlen <= rest)
+    {
+        found = ss_memmem(start, rest, delim, dlen);
+    }
+
+    if (found)
+    {
+        field->ptr = start;
+        field->len = (size_t)(found - start);
+        it->pos += field->len + dlen;
+    }
+    else
+    {
+        field->ptr = start;
+        field->len = rest;
+        it->pos = it->len;
+        it->done = true;
+    }
+
+    return true;
+}
+
+/*
+ * Sorting.
+ * A multikey quicksort on eight byte digits. Each string gets an entry with
+ * its length and the next eight bytes as a big endian integer, so a
+ * partition pass compares integers in one array instead of following every
+ * pointer. Strings equal on a digit are partitioned again on the next one,
+ * only then are their bytes read again.
+ * @see https://www.cs.princeton.edu/~rs/strings/paper.pdf
+ */
+
+/* Runs this short are insertion sorted. */
+#define _SS_SORT_SMALL (16)
+
+typedef struct _ss_sortent_s
+{
+    uint64_t key;
+    size_t len;
+    SS s;
+} _ss_sortent_t;
+
+typedef struct _ss_sortrun_s
+{
+    size_t lo;
+    size_t n;
+    size_t depth;
+} _ss_sortrun_t;
+
+/**
+ * @internal
+ * @return Bytes [depth, depth + 8) as a big endian integer, zero padded.
+ */
+INLINE static uint64_t
+_ss_sort_key(const char *s, size_t len, size_t depth)
+{
+    uint64_t key = 0;
+
+    if (depth < len)
+    {
+        size_t n = len - depth;
+        ss_memcopy(&key, s + depth, n < 8 ? n : 8);
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+        key = __builtin_bswap64(key);
+#endif
+    }
+
+    return key;
+}
+
+/**
+ * @internal
+ * @brief Compare entries that agree on the bytes before depth.
+ * @note A string that ends inside the digit is a prefix of any string with
+ *       the same digit, its padding matched the other's bytes.
+ */
+INLINE static int
+_ss_sort_cmp(const _ss_sortent_t *a, const _ss_sortent_t *b, size_t depth)
+{
+    if (a->key != b->key)
+    {
+        return a->key < b->key ? -1 : 1;
+    }
+
+    depth += 8;
+    if (a->len <= depth || b->len <= depth)
+    {
+        return _ss_compare_lens(a->len, b->len);
+    }
+
+    size_t alen = a->len - depth;
+    size_t blen = b->len - depth;
+    int cmp = ss_memcompare(a->s + depth, b->s + depth, alen < blen ? alen : blen);
+
+    return cmp ? cmp : _ss_compare_lens(alen, blen);
+}
+
+INLINE static void
+_ss_sort_swap(_ss_sortent_t *a, _ss_sortent_t *b)
+{
+    _ss_sortent_t t = *a;
+    *a = *b;
+    *b = t;
+}
+
+INLINE static void
+_ss_sort_small(_ss_sortent_t *e, size_t n, size_t depth)
+{
+    size_t i;
+
+    for (i = 1; i < n; ++i)
+    {
+        _ss_sortent_t t = e[i];
+        size_t j = i;
+        while (j && _ss_sort_cmp(&t, &e[j - 1], depth) < 0)
+        {
+            e[j] = e[j - 1];
+            --j;
+        }
+        e[j] = t;
+    }
+}
+
+/** @return Median of the keys at the ends and middle. */
+INLINE static uint64_t
+_ss_sort_pivot(const _ss_sortent_t *e, size_t n)
+{
+    uint64_t a = e[0].key;
+    uint64_t b = e[n / 2].key;
+    uint64_t c = e[n - 1].key;
+
+    if (a > b)
+    {
+        uint64_t t = a;
+        a = b;
+        b = t;
+    }
+
+    return c < a ? a : (c > b ? b : c);
+}
+
+/**
+ * @internal
+ * @brief Sort the entries, runs wait on a stack instead of recursing so
+ *        long shared prefixes can't overflow the call stack.
+ */
+static void
+_ss_sort_entries(_ss_sortent_t *e, size_t n)
+{
+    const ss_allocator_t *a = g_ss_allocator;
+    size_t cap = 64;
+    size_t top = 0;
+    _ss_sortrun_t *runs = a->alloc(a->ctx, cap * sizeof(_ss_sortrun_t));
+
+    if (UNLIKELY(!runs))
+    {
+        _ss_abort(true, cap * sizeof(_ss_sortrun_t));
+    }
+
+    runs[top].lo = 0;
+    runs[top].n = n;
+    runs[top].depth = 0;
+    ++top;
+
+    while (top)
+    {
+        _ss_sortrun_t run = runs[--top];
+        _ss_sortent_t *r = e + run.lo;
+        size_t i;
+
+        if (run.n <= _SS_SORT_SMALL)
+        {
+            _ss_sort_small(r, run.n, run.depth);
+            continue;
+        }
+
+        /* Three way partition on the digit: [0, lt) < [lt, gt) < [gt, n). */
+        uint64_t pivot = _ss_sort_pivot(r, run.n);
+        size_t lt = 0;
+        size_t gt = run.n;
+        i = 0;
+        while (i < gt)
+        {
+            if (r[i].key < pivot)
+            {
+                _ss_sort_swap(&r[lt++], &r[i++]);
+            }
+            else if (r[i].key > pivot)
+            {
+                _ss_sort_swap(&r[i], &r[--gt]);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        /*
+         * Strings ending inside the digit are done and go first, shortest
+         * first; there are at most nine lengths so one pass per length.
+         */
+        size_t done = lt;
+        size_t end = run.depth + 8;
+        size_t len;
+        for (len = run.depth; len <= end && done < gt; ++len)
+        {
+            for (i = done; i < gt; ++i)
+            {
+                if (r[i].len == len)
+                {
+                    _ss_sort_swap(&r[done++], &r[i]);
+                }
+            }
+        }
+        for (i = done; i < gt; ++i)
+        {
+            r[i].key = _ss_sort_key(r[i].s, r[i].len, end);
+        }
+
+        if (top + 3 > cap)
+        {
+            cap *= 2;
+            runs = a->realloc(a->ctx, runs, cap * sizeof(_ss_sortrun_t));
+            if (UNLIKELY(!runs))
+            {
+                _ss_abort(true, cap * sizeof(_ss_sortrun_t));
+            }
+        }
+
+        if (lt > 1)
+        {
+            runs[top].lo = run.lo;
+            runs[top].n = lt;
+            runs[top].depth = run.depth;
+            ++top;
+        }
+        if (run.n - gt > 1)
+        {
+            runs[top].lo = run.lo + gt;
+            runs[top].n = run.n - gt;
+            runs[top].depth = run.depth;
+            ++top;
+        }
+        if (gt - done > 1)
+        {
+            runs[top].lo = run.lo + done;
+            runs[top].n = gt - done;
+            runs[top].depth = end;
+            ++top;
+        }
+    }
+
+    a->free(a->ctx, runs);
+}
+
+/**
+ * @brief Sort the strings in ss_compare order.
+ * @note Not stable, equal strings may end up in any order.
+ * @param arr
+ * @param n - Number of strings in arr.
+ */
+void
+ss_sort(SS *arr, size_t n)
+{
+    size_t i;
+
+    if (n < 2)
+    {
+        return;
+    }
+
+    _ss_sortent_t *e = _ss_zalloc(n * sizeof(_ss_sortent_t));
+    for (i = 0; i < n; ++i)
+    {
+        e[i].s = arr[i];
+        e[i].len = _ss_len(arr[i]);
+        e[i].key = _ss_sort_key(arr[i], e[i].len, 0);
+    }
+
+    _ss_sort_entries(e, n);
+
+    for (i = 0; i < n; ++i)
+    {
+        arr[i] = e[i].s;
+    }
+    _ss_zfree(e);
+}
+
+/*
+ * Parallel scans.
+ * The search range is cut into chunks that a pool of threads claims one at
+ * a time. A chunk counts the matches starting inside it, searching up to
+ * len - 1 bytes past its end so no match is lost at the seam. Matches don't
+ * overlap, so where a match runs over into the next chunk that chunk has to
+ * resume where the match ended instead of at its start; the chunks are
+ * stitched in order and such a chunk is searched again from the match end
+ * until it lands on one of its own matches, after which both agree.
+ * The pool starts on first use with a thread for each other online CPU,
+ * and is stopped and joined when the library is unloaded or the process
+ * exits, so no worker is left running in unmapped code after dlclose.
+ */
+
+/* Default bytes per chunk, smaller inputs are searched on the calling thread. */
+#define _SS_PAR_CHUNK ((size_t)1 << 20)
+/* Most chunks per call, the chunk size grows to fit. */
+#define _SS_PAR_TASKS (256)
+/* Most threads in the pool, counting the caller. */
+#define _SS_PAR_THREADS (64)
+
+typedef void (*_ss_task_fn)(void *, size_t);
+
+typedef struct _ss_pool_s
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    /* Current batch, a new one bumps gen. */
+    _ss_task_fn fn;
+    void *arg;
+    size_t ntasks;
+    size_t next;
+    unsigned long gen;
+    /* Workers inside a batch. */
+    size_t active;
+    /* Set once to make the workers return. */
+    bool stop;
+    size_t nthreads;
+    pthread_t threads[_SS_PAR_THREADS - 1];
+} _ss_pool_t;
+
+static _ss_pool_t g_ss_pool =
+{
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    NULL, NULL, 0, 0, 0, 0, false, 0, { 0 }
+};
+/* One batch runs at a time. */
+static pthread_mutex_t g_ss_pool_batch = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_ss_pool_once = PTHREAD_ONCE_INIT;
+static size_t g_ss_par_chunk = _SS_PAR_CHUNK;
+
+INLINE static void
+_ss_pool_drain(_ss_pool_t *p, _ss_task_fn fn, void *arg, size_t ntasks)
+{
+    size_t i;
+
+    while ((i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) < ntasks)
+    {
+        fn(arg, i);
+    }
+}
+
+static void *
+_ss_pool_main(void *arg)
+{
+    _ss_pool_t *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    unsigned long seen = p->gen;
+    for (;;)
+    {
+        while (p->gen == seen && !p->stop)
+        {
+            pthread_cond_wait(&p->work, &p->lock);
+        }
+        if (p->stop)
+        {
+            break;
+        }
+        seen = p->gen;
+        _ss_task_fn fn = p->fn;
+        void *fnarg = p->arg;
+        size_t ntasks = p->ntasks;
+        ++p->active;
+        pthread_mutex_unlock(&p->lock);
+
+        _ss_pool_drain(p, fn, fnarg, ntasks);
+
+        pthread_mutex_lock(&p->lock);
+        if (0 == --p->active)
+        {
+            pthread_cond_broadcast(&p->done);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+static void
+_ss_pool_init(void)
+{
+    _ss_pool_t *p = &g_ss_pool;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t want = cpus > 1 ? (size_t)cpus - 1 : 0;
+    size_t n = 0;
+
+    if (want > _SS_PAR_THREADS - 1)
+    {
+        want = _SS_PAR_THREADS - 1;
+    }
+
+    while (n < want)
+    {
+        if (pthread_create(&p->threads[n], NULL, _ss_pool_main, p))
+        {
+            break;
+        }
+        ++n;
+    }
+
+    p->nthreads = n;
+}
+
+/**
+ * @internal
+ * @brief Stop and join the workers once the library is unloaded.
+ * @note Waits for a batch in flight, later batches run on the caller.
+ */
+__attribute__((destructor))
+static void
+_ss_pool_fini(void)
+{
+    _ss_pool_t *p = &g_ss_pool;
+    size_t i;
+
+    pthread_mutex_lock(&g_ss_pool_batch);
+    if (p->nthreads)
+    {
+        pthread_mutex_lock(&p->lock);
+        p->stop = true;
+        pthread_cond_broadcast(&p->work);
+        pthread_mutex_unlock(&p->lock);
+
+        for (i = 0; i < p->nthreads; ++i)
+        {
+            pthread_join(p->threads[i], NULL);
+        }
+        p->nthreads = 0;
+    }
+    pthread_mutex_unlock(&g_ss_pool_batch);
+}
+
+/**
+ * @internal
+ * @brief Call fn(arg, i) for every i below ntasks across the pool; the
+ *        caller works too and returns once all calls have.
+ */
+static void
+_ss_pool_run(_ss_task_fn fn, void *arg, size_t ntasks)
+{
+    _ss_pool_t *p = &g_ss_pool;
+    size_t i;
+
+    if (ntasks > 1)
+    {
+        pthread_once(&g_ss_pool_once, _ss_pool_init);
+    }
+
+    if (ntasks < 2 || !p->nthreads)
+    {
+        for (i = 0; i < ntasks; ++i)
+        {
+            fn(arg, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&g_ss_pool_batch);
+    pthread_mutex_lock(&p->lock);
+    /* A worker that woke late for the last batch must leave it first. */
+    while (p->active)
+    {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    p->fn = fn;
+    p->arg = arg;
+    p->ntasks = ntasks;
+    p->next = 0;
+    ++p->gen;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+
+    _ss_pool_drain(p, fn, arg, ntasks);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->active)
+    {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    pthread_mutex_unlock(&g_ss_pool_batch);
+}
+
+typedef struct _ss_parchunk_s
+{
+    /* Where the search starts, moved past a match from the chunk before. */
+    size_t begin;
+    size_t count;
+    /* End of the last match; zero if none. */
+    size_t end;
+    /* Index into the output of the first match. */
+    size_t offset;
+} _ss_parchunk_t;
+
+typedef struct _ss_parscan_s
+{
+    const char *s;
+    size_t slen;
+    const char *cs;
+    size_t len;
+    size_t start;
+    size_t chunk;
+    size_t *out;
+    size_t max;
+    _ss_parchunk_t chunks[_SS_PAR_TASKS];
+} _ss_parscan_t;
+
+/** @return Start of the chunk. */
+INLINE static size_t
+_ss_par_lo(const _ss_parscan_t *ps, size_t k)
+{
+    return ps->start + (k * ps->chunk);
+}
+
+/** @return End of the bytes searched by the chunk, a match starts before its end. */
+INLINE static size_t
+_ss_par_wend(const _ss_parscan_t *ps, size_t k)
+{
+    size_t hi = _ss_par_lo(ps, k) + ps->chunk;
+
+    if (hi >= ps->slen || ps->slen - hi < ps->len - 1)
+    {
+        return ps->slen;
+    }
+
+    return hi + ps->len - 1;
+}
+
+/** @return Index of the next match at or after at; NPOS if none. */
+INLINE static size_t
+_ss_par_next(const _ss_parscan_t *ps, size_t at, size_t wend)
+{
+    if (at >= wend)
+    {
+        return NPOS;
+    }
+
+    const char *found = ss_memmem(ps->s + at, wend - at, ps->cs, ps->len);
+    return found ? (size_t)(found - ps->s) : NPOS;
+}
+
+static void
+_ss_par_count_task(void *arg, size_t k)
+{
+    _ss_parscan_t *ps = arg;
+    _ss_parchunk_t *c = &ps->chunks[k];
+    size_t wend = _ss_par_wend(ps, k);
+    size_t at = _ss_par_lo(ps, k);
+    size_t m;
+
+    c->begin = at;
+    c->count = 0;
+    c->end = 0;
+    while (NPOS != (m = _ss_par_next(ps, at, wend)))
+    {
+        ++c->count;
+        at = m + ps->len;
+        c->end = at;
+    }
+}
+
+static void
+_ss_par_find_task(void *arg, size_t k)
+{
+    _ss_parscan_t *ps = arg;
+    _ss_parchunk_t *c = &ps->chunks[k];
+    size_t wend = _ss_par_wend(ps, k);
+    size_t at = c->begin;
+    size_t i = c->offset;
+    size_t last = c->offset + c->count;
+    size_t m;
+
+    if (last > ps->max)
+    {
+        last = ps->max;
+    }
+
+    while (i < last && NPOS != (m = _ss_par_next(ps, at, wend)))
+    {
+        ps->out[i++] = m;
+        at = m + ps->len;
+    }
+}
+
+/**
+ * @internal
+ * @brief Search the chunk again from carry, past the start of its own run.
+ */
+static void
+_ss_par_restitch(_ss_parscan_t *ps, size_t k, size_t carry)
+{
+    _ss_parchunk_t *c = &ps->chunks[k];
+    size_t wend = _ss_par_wend(ps, k);
+    size_t own = _ss_par_next(ps, c->begin, wend);
+    size_t ownseen = 0;
+    size_t redo = _ss_par_next(ps, carry, wend);
+    size_t count = 0;
+    size_t end = 0;
+
+    c->begin = carry;
+    while (NPOS != redo)
+    {
+        while (own < redo)
+        {
+            ++ownseen;
+            own = _ss_par_next(ps, own + ps->len, wend);
+        }
+        if (own == redo)
+        {
+            /* Same match, the rest of the chunk's run is right. */
+            c->count = count + (c->count - ownseen);
+            return;
+        }
+        ++count;
+        end = redo + ps->len;
+        redo = _ss_par_next(ps, end, wend);
+    }
+
+    c->count = count;
+    c->end = end;
+}
+
+/**
+ * @internal
+ * @return Total matches, chunks hold where each starts and its share.
+ */
+static size_t
+_ss_par_scan(_ss_parscan_t *ps, size_t *ntasks)
+{
+    size_t n = ps->slen - ps->start;
+    size_t chunk = __atomic_load_n(&g_ss_par_chunk, __ATOMIC_RELAXED);
+    size_t carry = 0;
+    size_t total = 0;
+    size_t k;
+
+    if (chunk < (n + _SS_PAR_TASKS - 1) / _SS_PAR_TASKS)
+    {
+        chunk = (n + _SS_PAR_TASKS - 1) / _SS_PAR_TASKS;
+    }
+    ps->chunk = chunk;
+    *ntasks = (n + chunk - 1) / chunk;
+
+    _ss_pool_run(_ss_par_count_task, ps, *ntasks);
+
+    for (k = 0; k < *ntasks; ++k)
+    {
+        _ss_parchunk_t *c = &ps->chunks[k];
+        if (carry > c->begin)
+        {
+            _ss_par_restitch(ps, k, carry);
+        }
+        if (c->end > carry)
+        {
+            carry = c->end;
+        }
+        c->offset = total;
+        total += c->count;
+    }
+
+    return total;
+}
+
+/**
+ * @brief Set the bytes each thread searches at a time in the parallel
+ *        scans; smaller inputs don't use the pool.
+ * @param bytes - Zero for the default (1MB).
+ */
+void
+ss_parallel_setchunk(size_t bytes)
+{
+    __atomic_store_n(&g_ss_par_chunk, bytes ? bytes : _SS_PAR_CHUNK, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Like ss_count, but the string is searched by a pool of threads.
+ * @return The count of the number of sub-strings found.
+ */
+size_t
+ss_count_parallel(const SS s, size_t index, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(s);
+    size_t ntasks;
+
+    if (!len || index >= slen)
+    {
+        return 0;
+    }
+
+    _ss_parscan_t ps = { s, slen, cs, len, index, 0, NULL, 0, { { 0, 0, 0, 0 } } };
+    return _ss_par_scan(&ps, &ntasks);
+}
+
+/**
+ * @brief Find the positions ss_count counts, searched by a pool of threads.
+ * @param s
+ * @param index - Where to start searching.
+ * @param cs
+ * @param len
+ * @param out - Filled with the match indexes in order; may be NULL if max is zero.
+ * @param max - Most indexes to write.
+ * @return Number of matches, which may be more than max.
+ */
+size_t
+ss_find_all_parallel(const SS s, size_t index, const char *cs, size_t len, size_t *out, size_t max)
+{
+    size_t slen = _ss_len(s);
+    size_t ntasks;
+
+    if (!len || index >= slen)
+    {
+        return 0;
+    }
+
+    _ss_parscan_t ps = { s, slen, cs, len, index, 0, out, max, { { 0, 0, 0, 0 } } };
+    size_t total = _ss_par_scan(&ps, &ntasks);
+
+    if (total && max)
+    {
+        _ss_pool_run(_ss_par_find_task, &ps, ntasks);
+    }
+
+    return total;
+}
+
+/*
+ * Hashing.
+ * A wyhash style hash: 64x64->128 bit multiply-and-fold over 16 or 48 byte
+ * blocks. Strings cache their hash in the spare capacity just past the
+ * sentinel when there is room, _SS_HDR_HASHED marks it current.
+ * @see https://github.com/wangyi-fudan/wyhash
+ */
+
+static const uint64_t g_ss_hash_secret[4] =
+{
+    0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+    0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull,
+};
+
+/** @brief Replace a and b with the low and high halves of their product. */
+INLINE static void
+_ss_hash_mul(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)*a * *b;
+    *a = (uint64_t)r;
+    *b = (uint64_t)(r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/** @return The 128 bit product of a and b folded to 64 bits. */
+INLINE static uint64_t
+_ss_hash_mix(uint64_t a, uint64_t b)
+{
+    _ss_hash_mul(&a, &b);
+    return a ^ b;
+}
+
+INLINE static uint64_t
+_ss_hash_r8(const uint8_t *p)
+{
+    uint64_t v;
+    ss_memcopy(&v, p, sizeof(v));
+    return v;
+}
+
+INLINE static uint64_t
+_ss_hash_r4(const uint8_t *p)
+{
+    uint32_t v;
+    ss_memcopy(&v, p, sizeof(v));
+    return v;
+}
+
+/**
+ * @internal
+ * @return Hash of the bytes.
+ */
+static uint64_t
+_ss_hash(const char *key, size_t len)
+{
+    const uint64_t *secret = g_ss_hash_secret;
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t seed = _ss_hash_mix(secret[0], secret[1]);
+    uint64_t a;
+    uint64_t b;
+
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            size_t mid = (len >> 3) << 2;
+            a = (_ss_hash_r4(p) << 32) | _ss_hash_r4(p + mid);
+            b = (_ss_hash_r4(p + len - 4) << 32) | _ss_hash_r4(p + len - 4 - mid);
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = 0;
+            b = 0;
+        }
+    }
+    else
+    {
+        size_t i = len;
+
+        if (i > 48)
+        {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do
+            {
+                seed = _ss_hash_mix(_ss_hash_r8(p) ^ secret[1], _ss_hash_r8(p + 8) ^ seed);
+                see1 = _ss_hash_mix(_ss_hash_r8(p + 16) ^ secret[2], _ss_hash_r8(p + 24) ^ see1);
+                see2 = _ss_hash_mix(_ss_hash_r8(p + 32) ^ secret[3], _ss_hash_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16)
+        {
+            seed = _ss_hash_mix(_ss_hash_r8(p) ^ secret[1], _ss_hash_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        /* Last 16 bytes, overlapping what was already mixed. */
+        a = _ss_hash_r8(p + i - 16);
+        b = _ss_hash_r8(p + i - 8);
+    }
+
+    a ^= secret[1];
+    b ^= seed;
+    _ss_hash_mul(&a, &b);
+
+    return _ss_hash_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/**
+ * @brief Hash the string.
+ * @note The hash is cached in spare capacity when there are eight bytes
+ *       of it (see ss_addcap), and is recomputed after the string changes.
+ * @note Safe to call from several threads on the same string, as long as
+ *       none of them changes it, the cache is stored with atomics.
+ * @warning After writing to the string directly without changing its length,
+ *          call ss_setlen with the same length to drop the cached hash.
+ * @warning Not seeded, don't rely on it against hash flooding.
+ * @param s
+ * @return 64 bit hash of the bytes.
+ */
+uint64_t
+ss_hash(const SS s)
+{
+    if (_ss_hashed(s))
+    {
+        return _ss_hashval(s);
+    }
+
+    size_t len = _ss_len(s);
+    uint64_t h = _ss_hash(s, len);
+
+    if (_ss_cap(s) - len >= sizeof(h))
+    {
+        _ss_sethashval(s, h);
+    }
+
+    return h;
+}
+
+/**
+ * @return 64 bit hash of the bytes, the same as ss_hash of a string holding them.
+ */
+uint64_t
+ss_hash_view(ss_view_t v)
+{
+    return _ss_hash(v.ptr, v.len);
+}
+
+/*
+ * Interning.
+ * Strings are split across shards by the high bits of their hash. Each shard
+ * is an open addressed table of hashes and strings, its strings live in the
+ * shard's arena. Lookups take no lock: a slot's hash is written before its
+ * string is published with a release store, and a grown table is published
+ * the same way. Replaced tables are kept until the table is freed since a
+ * reader could still be probing them.
+ */
+
+#define _SS_INTERN_SHARDS (16)
+#define _SS_INTERN_SLOTS (64)
+#define _SS_INTERN_LINE (64)
+
+typedef struct _ss_islot_s
+{
+    uint64_t hash;
+    SS str;
+} _ss_islot_t;
+
+typedef struct _ss_itable_s
+{
+    /* Table this one replaced. */
+    struct _ss_itable_s *retired;
+    size_t mask;
+    _ss_islot_t slots[];
+} _ss_itable_t;
+
+typedef struct _ss_ishard_s
+{
+    /* Taken by inserts only. */
+    pthread_mutex_t lock;
+    _ss_itable_t *table;
+    size_t count;
+    ss_arena_t *arena;
+} __attribute__((aligned(_SS_INTERN_LINE))) _ss_ishard_t;
+
+struct ss_intern_table_s
+{
+    size_t mask;
+    _ss_ishard_t *shards;
+    /* Allocation the shards were aligned within. */
+    void *mem;
+};
+
+/**
+ * @internal
+ * @return New table with every slot empty.
+ */
+static _ss_itable_t *
+_ss_itable_new(size_t slots)
+{
+    _ss_itable_t *t = _ss_zalloc(sizeof(_ss_itable_t) + (slots * sizeof(_ss_islot_t)));
+    t->mask = slots - 1;
+    return t;
+}
+
+/**
+ * @internal
+ * @return Interned string equal to the bytes; NULL if there isn't one.
+ * @note Safe without the shard lock.
+ */
+static SS
+_ss_itable_find(const _ss_itable_t *t, uint64_t hash, const char *cs, size_t len)
+{
+    size_t i = (size_t)hash & t->mask;
+
+    for (;;)
+    {
+        SS s = __atomic_load_n(&t->slots[i].str, __ATOMIC_ACQUIRE);
+        if (!s)
+        {
+            return NULL;
+        }
+        if (t->slots[i].hash == hash && _ss_len(s) == len && 0 == ss_memcompare(s, cs, len))
+        {
+            return s;
+        }
+        i = (i + 1) & t->mask;
+    }
+}
+
+/**
+ * @internal
+ * @brief Publish the string in the first free slot for the hash.
+ * @note Shard lock held.
+ */
+static void
+_ss_itable_put(_ss_itable_t *t, uint64_t hash, SS s)
+{
+    size_t i = (size_t)hash & t->mask;
+
+    while (t->slots[i].str)
+    {
+        i = (i + 1) & t->mask;
+    }
+
+    t->slots[i].hash = hash;
+    __atomic_store_n(&t->slots[i].str, s, __ATOMIC_RELEASE);
+}
+
+INLINE static _ss_ishard_t *
+_ss_intern_shard(const ss_intern_table_t *it, uint64_t hash)
+{
+    /* Slots use the low bits. */
+    return &it->shards[(size_t)(hash >> 32) & it->mask];
+}
+
+/**
+ * @internal
+ * @return The interned string, interning it if needed.
+ */
+static SS
+_ss_intern(ss_intern_table_t *it, uint64_t hash, const char *cs, size_t len)
+{
+    _ss_ishard_t *sh = _ss_intern_shard(it, hash);
+    _ss_itable_t *t = __atomic_load_n(&sh->table, __ATOMIC_ACQUIRE);
+    SS s = _ss_itable_find(t, hash, cs, len);
+
+    if (s)
+    {
+        return s;
+    }
+
+    pthread_mutex_lock(&sh->lock);
+
+    /* Another thread may have been first. */
+    t = sh->table;
+    s = _ss_itable_find(t, hash, cs, len);
+    if (!s)
+    {
+        /* Keep the load at or under three quarters. */
+        if ((sh->count + 1) * 4 > (t->mask + 1) * 3)
+        {
+            _ss_itable_t *grown = _ss_itable_new((t->mask + 1) * 2);
+            size_t i;
+
+            for (i = 0; i <= t->mask; ++i)
+            {
+                if (t->slots[i].str)
+                {
+                    _ss_itable_put(grown, t->slots[i].hash, t->slots[i].str);
+                }
+            }
+            grown->retired = t;
+            __atomic_store_n(&sh->table, grown, __ATOMIC_RELEASE);
+            t = grown;
+        }
+
+        /* Room for the cached hash, so ss_hash and ss_equal on it are cheap. */
+        s = ss_newfrom_arena(sh->arena, len + sizeof(uint64_t), cs, len);
+        ss_hash(s);
+
+        _ss_itable_put(t, hash, s);
+        __atomic_store_n(&sh->count, sh->count + 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&sh->lock);
+
+    return s;
+}
+
+/**
+ * @brief Create a table of canonical strings, one per distinct value.
+ * @note Safe to use from many threads, finding a string takes no lock.
+ * @param shards - Number of independently locked shards, rounded up to
+ *                 a power of two; zero for the default (16).
+ * @return New intern table.
+ */
+ss_intern_table_t *
+ss_intern_new(size_t shards)
+{
+    size_t n = 1;
+    size_t i;
+
+    if (!shards)
+    {
+        shards = _SS_INTERN_SHARDS;
+    }
+    while (n < shards)
+    {
+        n *= 2;
+    }
+
+    ss_intern_table_t *it = _ss_zalloc(sizeof(ss_intern_table_t));
+    it->mask = n - 1;
+    it->mem = _ss_zalloc((n * sizeof(_ss_ishard_t)) + _SS_INTERN_LINE);
+    it->shards = (_ss_ishard_t *)(((uintptr_t)it->mem + _SS_INTERN_LINE - 1)
+                                  & ~(uintptr_t)(_SS_INTERN_LINE - 1));
+
+    for (i = 0; i < n; ++i)
+    {
+        _ss_ishard_t *sh = &it->shards[i];
+        pthread_mutex_init(&sh->lock, NULL);
+        sh->table = _ss_itable_new(_SS_INTERN_SLOTS);
+        sh->count = 0;
+        sh->arena = ss_arena_new(0);
+    }
+
+    return it;
+}
+
+/**
+ * @brief Free the table and every interned string.
+ * @warning No other thread may be using the table.
+ * @param it
+ */
+void
+ss_intern_free(ss_intern_table_t **it)
+{
+    size_t i;
+
+    for (i = 0; i <= (*it)->mask; ++i)
+    {
+        _ss_ishard_t *sh = &(*it)->shards[i];
+        _ss_itable_t *t = sh->table;
+
+        while (t)
+        {
+            _ss_itable_t *retired = t->retired;
+            _ss_zfree(t);
+            t = retired;
+        }
+        ss_arena_free(&sh->arena);
+        pthread_mutex_destroy(&sh->lock);
+    }
+
+    _ss_zfree((*it)->mem);
+    _ss_zfree(*it);
+    *it = NULL;
+}
+
+/**
+ * @brief Get the canonical string for the bytes, interning a copy if new.
+ * @warning The returned string must not be modified, ss_free is a no-op on it.
+ *          It lives until the table is freed.
+ * @note Equal values give the same pointer, so they compare with ==.
+ * @param it
+ * @param cs - The bytes.
+ * @param len - Length of `cs`.
+ * @return The interned string.
+ */
+SS
+ss_intern(ss_intern_table_t *it, const char *cs, size_t len)
+{
+    return _ss_intern(it, _ss_hash(cs, len), cs, len);
+}
+
+/**
+ * @brief Like ss_intern, but uses the string's cached hash.
+ * @param it
+ * @param s - The string to intern.
+ * @return The interned string.
+ */
+SS
+ss_intern_ss(ss_intern_table_t *it, const SS s)
+{
+    return _ss_intern(it, ss_hash(s), s, _ss_len(s));
+}
+
+/**
+ * @brief Find the canonical string without interning, takes no lock.
+ * @param it
+ * @param cs - The bytes.
+ * @param len - Length of `cs`.
+ * @return The interned string; NULL if the value was never interned.
+ */
+SS
+ss_intern_find(const ss_intern_table_t *it, const char *cs, size_t len)
+{
+    uint64_t hash = _ss_hash(cs, len);
+    const _ss_ishard_t *sh = _ss_intern_shard(it, hash);
+
+    return _ss_itable_find(__atomic_load_n(&sh->table, __ATOMIC_ACQUIRE), hash, cs, len);
+}
+
+/**
+ * @return Number of distinct strings interned.
+ */
+size_t
+ss_intern_count(const ss_intern_table_t *it)
+{
+    size_t count = 0;
+    size_t i;
+
+    for (i = 0; i <= it->mask; ++i)
+    {
+        count += __atomic_load_n(&it->shards[i].count, __ATOMIC_RELAXED);
+    }
+
+    return count;
+}
+
+/**
+ * For all of Bee J's code.
+ * The format follows Beej's pack2.c, the byte order and array counts are
+ * additions.
+ * @see https://beej.us/guide/bgnet/html/#serialization
+ * @see https://beej.us/guide/bgnet/examples/pack2.c
+ */
+
+/* Byte order of packed data. */
+#define _SS_ORDER_BE (0)
+#define _SS_ORDER_LE (1)
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define _SS_ORDER_NATIVE _SS_ORDER_BE
+#else
+#define _SS_ORDER_NATIVE _SS_ORDER_LE
+#endif
+
+/** @return Value converted between host and the given byte order. */
+INLINE static uint16_t
+_ss_order16(uint16_t v, int order)
+{
+    return _SS_ORDER_NATIVE == order ? v : __builtin_bswap16(v);
+}
+
+/** @return Value converted between host and the given byte order. */
+INLINE static uint32_t
+_ss_order32(uint32_t v, int order)
+{
+    return _SS_ORDER_NATIVE == order ? v : __builtin_bswap32(v);
+}
+
+/** @return Value converted between host and the given byte order. */
+INLINE static uint64_t
+_ss_order64(uint64_t v, int order)
+{
+    return _SS_ORDER_NATIVE == order ? v : __builtin_bswap64(v);
+}
+
+/**
+ * @internal
+ * @brief Byte swap each element of an array.
+ */
+static void
+_ss_bswap_scalar(unsigned char *dst, const unsigned char *src, size_t count, size_t width)
+{
+    size_t i;
+    uint16_t h;
+    uint32_t w;
+    uint64_t q;
+
+    switch (width)
+    {
+        case 2:
+            for (i = 0; i < count; ++i, src += 2, dst += 2)
+            {
+                ss_memcopy(&h, src, 2);
+                h = __builtin_bswap16(h);
+                ss_memcopy(dst, &h, 2);
+            }
+            break;
+        case 4:
+            for (i = 0; i < count; ++i, src += 4, dst += 4)
+            {
+                ss_memcopy(&w, src, 4);
+                w = __builtin_bswap32(w);
+                ss_memcopy(dst, &w, 4);
+            }
+            break;
+        default:
+            for (i = 0; i < count; ++i, src += 8, dst += 8)
+            {
+                ss_memcopy(&q, src, 8);
+                q = __builtin_bswap64(q);
+                ss_memcopy(dst, &q, 8);
+            }
+            break;
+    }
+}
+
+typedef void (*_ss_bswap_fn)(unsigned char *, const unsigned char *, size_t, size_t);
+
+#ifdef _SS_X86
+
+/**
+ * @internal
+ * @brief Byte swap each element of an array, 16 bytes per shuffle.
+ */
+__attribute__((target("ssse3")))
+static void
+_ss_bswap_ssse3(unsigned char *dst, const unsigned char *src, size_t count, size_t width)
+{
+    __m128i mask;
+    switch (width)
+    {
+        case 2:
+            mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+            break;
+        case 4:
+            mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+            break;
+        default:
+            mask = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+            break;
+    }
+
+    size_t bytes = count * width;
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+
+    _ss_bswap_scalar(dst + i, src + i, (bytes - i) / width, width);
+}
+
+#endif /* _SS_X86 */
+
+static void
+_ss_bswap_resolve(unsigned char *, const unsigned char *, size_t, size_t);
+
+/* Replaces itself on first use, like the search engine. */
+static _ss_bswap_fn g_ss_bswap = _ss_bswap_resolve;
+
+static void
+_ss_bswap_resolve(unsigned char *dst, const unsigned char *src, size_t count, size_t width)
+{
+    _ss_bswap_fn fn = _ss_bswap_scalar;
+#ifdef _SS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        fn = _ss_bswap_ssse3;
+    }
+#endif
+    __atomic_store_n(&g_ss_bswap, fn, __ATOMIC_RELAXED);
+    fn(dst, src, count, width);
+}
+
+/**
+ * @internal
+ * @return Width of the type in bytes; zero if not a type.
+ */
+INLINE static size_t
+_ss_pack_width(char type)
+{
+    switch (type)
+    {
+        case 'c':
+        case 'b':
+        case 'B':
+        case '?':
+            return 1;
+        case 'h':
+        case 'H':
+            return 2;
+        case 'i':
+        case 'I':
+            return 4;
+        case 'q':
+        case 'Q':
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @internal
+ * @brief Parse the next field, an optional array count then the type.
+ * @param fmt - Advanced to the type.
+ * @param count - Number of elements.
+ * @param array - Set if a count was given.
+ * @return Width of the type; zero on error.
+ */
+INLINE static size_t
+_ss_pack_next(const char **fmt, size_t *count, bool *array)
+{
+    const char *f = *fmt;
+    size_t n = 0;
+
+    *array = false;
+    while (*f >= '0' && *f <= '9')
+    {
+        if (n > (SIZE_MAX - 9) / 10)
+        {
+            return 0;
+        }
+        n = (n * 10) + (size_t)(*f - '0');
+        *array = true;
+        ++f;
+    }
+
+    *count = *array ? n : 1;
+    *fmt = f;
+
+    size_t width = _ss_pack_width(*f);
+    if (width && n > (SIZE_MAX / 2) / width)
+    {
+        return 0;
+    }
+    return width;
+}
+
+/**
+ * @internal
+ * @brief Store one value taken from the arguments.
+ * @see https://wiki.sei.cmu.edu/confluence/display/c/MSC39-C.+Do+not+call+va_arg()+on+a+va_list+that+has+an+indeterminate+value
+ * @see https://stackoverflow.com/questions/7084857/what-are-the-automatic-type-promotions-of-variadic-function-arguments
+ * @see https://stackoverflow.com/questions/63849830/default-argument-promotion-in-a-variadic-function
+ */
+INLINE static void
+_ss_pack_scalar(unsigned char *buf, char type, va_list *ap, int order)
+{
+    uint16_t h;
+    uint32_t i;
+    uint64_t q;
+
+    switch (type)
+    {
+        case '?':
+            *buf = va_arg(*ap, unsigned int) ? 1 : 0;
+            break;
+        case 'h':
+        case 'H':
+            h = _ss_order16((uint16_t)va_arg(*ap, unsigned int), order);
+            ss_memcopy(buf, &h, sizeof(h));
+            break;
+        case 'i':
+        case 'I':
+            i = _ss_order32(va_arg(*ap, uint32_t), order);
+            ss_memcopy(buf, &i, sizeof(i));
+            break;
+        case 'q':
+        case 'Q':
+            q = _ss_order64(va_arg(*ap, uint64_t), order);
+            ss_memcopy(buf, &q, sizeof(q));
+            break;
+        default:
+            *buf = (unsigned char)va_arg(*ap, unsigned int);
+            break;
+    }
+}
+
+/**
+ * @internal
+ * @brief Load one value into the pointer taken from the arguments.
+ */
+INLINE static void
+_ss_unpack_scalar(const unsigned char *buf, char type, va_list *ap, int order)
+{
+    uint16_t h;
+    uint32_t i;
+    uint64_t q;
+
+    switch (type)
+    {
+        case 'c':
+            *va_arg(*ap, char *) = (char)*buf;
+            break;
+        case 'b':
+            *va_arg(*ap, signed char *) = (signed char)*buf;
+            break;
+        case 'B':
+            *va_arg(*ap, unsigned char *) = *buf;
+            break;
+        case '?':
+            *va_arg(*ap, bool *) = !!*buf;
+            break;
+        case 'h':
+            ss_memcopy(&h, buf, sizeof(h));
+            *va_arg(*ap, int16_t *) = (int16_t)_ss_order16(h, order);
+            break;
+        case 'H':
+            ss_memcopy(&h, buf, sizeof(h));
+            *va_arg(*ap, uint16_t *) = _ss_order16(h, order);
+            break;
+        case 'i':
+            ss_memcopy(&i, buf, sizeof(i));
+            *va_arg(*ap, int32_t *) = (int32_t)_ss_order32(i, order);
+            break;
+        case 'I':
+            ss_memcopy(&i, buf, sizeof(i));
+            *va_arg(*ap, uint32_t *) = _ss_order32(i, order);
+            break;
+        case 'q':
+            ss_memcopy(&q, buf, sizeof(q));
+            *va_arg(*ap, int64_t *) = (int64_t)_ss_order64(q, order);
+            break;
+        default:
+            ss_memcopy(&q, buf, sizeof(q));
+            *va_arg(*ap, uint64_t *) = _ss_order64(q, order);
+            break;
+    }
+}
+
+/**
+ * @internal
+ * @brief Copy an array between host and the given byte order.
+ * @param type - Element type, bools are stored as 0 or 1.
+ */
+INLINE static void
+_ss_pack_array(unsigned char *dst, const unsigned char *src, size_t count,
+               char type, size_t width, int order)
+{
+    if ('?' == type)
+    {
+        size_t i;
+        for (i = 0; i < count; ++i)
+        {
+            dst[i] = ((const bool *)src)[i] ? 1 : 0;
+        }
+    }
+    else if (1 == width || _SS_ORDER_NATIVE == order)
+    {
+        ss_memcopy(dst, src, count * width);
+    }
+    else
+    {
+        __atomic_load_n(&g_ss_bswap, __ATOMIC_RELAXED)(dst, src, count, width);
+    }
+}
+
+/**
+ * @internal
+ * @brief Copy a packed array out to host byte order.
+ */
+INLINE static void
+_ss_unpack_array(unsigned char *dst, const unsigned char *src, size_t count,
+                 char type, size_t width, int order)
+{
+    if ('?' == type)
+    {
+        size_t i;
+        for (i = 0; i < count; ++i)
+        {
+            ((bool *)dst)[i] = !!src[i];
+        }
+    }
+    else
+    {
+        _ss_pack_array(dst, src, count, type, width, order);
+    }
+}
+
+/**
+ * @internal
+ * @param caplen - In, space in the buffer.
+ *                 Out, the extra space needed if it ran out.
+ * @return Number of bytes written; NPOS on error.
+ */
+static size_t
+_ss_pack(size_t *caplen, unsigned char *buf, const char *fmt, va_list *argp, int order)
+{
+    va_list ap;
+    va_copy(ap, *argp);
+
+    size_t len = 0;
+    size_t blen = *caplen;
+    *caplen = 0;
+
+    for (; fmt[0]; ++fmt)
+    {
+        size_t count;
+        bool array;
+        size_t width = _ss_pack_next(&fmt, &count, &array);
+
+        if (!width)
+        {
+            len = NPOS;
+            break;
+        }
+
+        size_t need = count * width;
+        if (len + need > blen)
+        {
+            *caplen = (len + need) - blen;
+            len = NPOS;
+            break;
+        }
+
+        if (array)
+        {
+            _ss_pack_array(buf, va_arg(ap, const void *), count, fmt[0], width, order);
+        }
+        else
+        {
+            _ss_pack_scalar(buf, fmt[0], &ap, order);
+        }
+
+        buf += need;
+        len += need;
+    }
+
+    va_end(ap);
+
+    return len;
+}
+
+/**
+ * @internal
+ * @brief Pack after the first olen bytes, growing as needed.
+ * @return Number of bytes written; NPOS on error.
+ */
+static size_t
+_ss_packat(SS *s, size_t olen, const char *fmt, va_list *argp, int order)
+{
+    size_t cap = 0;
+    size_t written = 0;
+
+    _ss_detach(s);
+    /* A failed pack leaves bytes past the sentinel, over the cached hash. */
+    _ss_unhash(*s);
+
+    do
+    {
+        if (cap)
+        {
+            *s = _ss_realloc_grow(*s, _ss_cap(*s) + cap);
+        }
+        cap = _ss_cap(*s) - olen;
+
+        written = _ss_pack(&cap, &((unsigned char *)(*s))[olen], fmt, argp, order);
+    } while (NPOS == written && cap);
+
+    size_t len = olen;
+    if (NPOS != written)
+    {
+        len += written;
+        _ss_setlen(*s, len);
+    }
+    (*s)[len] = 0;
+
+    return written;
+}
+
+/**
+ * @brief Packs/serializes to a buffer using a Python inspired pack format.
+ * @see https://docs.python.org/3/library/struct.html
+ * @warning Floats are excluded and there are requirements for byte sequences.
+ * @warning Allocate enough space or set a growth flag; otherwise this may be a slow method to execute.
+ * @param s
+ * @param fmt - The packing format string.
+ * @return Number of bytes written; NPOS on error.
+ *
+ * #### Format Specification
+ * Pass the values of the following.
+ * c - char
+ * b - signed char
+ * B - unsigned char
+ * ? - bool
+ * h - int16_t
+ * H - uint16_t
+ * i - int32_t
+ * I - uint32_t
+ * q - int64_t
+ * Q - uint64_t
+ *
+ * A decimal count before a type, like "1024I", packs an array.
+ * Pass a pointer to the first element instead of the values.
+ * Arrays already in the right byte order are copied with memcpy,
+ * others are byte swapped in bulk.
+ */
+size_t
+ss_packBE(SS *s, const char *fmt, ...)
+{
+    va_list argp;
+    size_t written;
+
+    _ss_detach(s);
+
+    ss_clear(*s);
+
+    va_start(argp, fmt);
+    written = _ss_packat(s, 0, fmt, &argp, _SS_ORDER_BE);
+    va_end(argp);
+
+    return written;
+}
+
+/**
+ * @brief Packs/serializes to a buffer.
+ * @warning Allocate enough space or set a growth flag; otherwise this may be a slow method to execute.
+ * @param s
+ * @param fmt - The packing format string.
+ * @return Number of bytes written; NPOS on error.
+ */
+size_t
+ss_catpackBE(SS *s, const char *fmt, ...)
+{
+    va_list argp;
+    size_t written;
+
+    va_start(argp, fmt);
+    written = _ss_packat(s, _ss_len(*s), fmt, &argp, _SS_ORDER_BE);
+    va_end(argp);
+
+    return written;
+}
+
+/**
+ * @brief Like ss_packBE, but little-endian.
+ * @param s
+ * @param fmt - The packing format string.
+ * @return Number of bytes written; NPOS on error.
+ */
+size_t
+ss_packLE(SS *s, const char *fmt, ...)
+{
+    va_list argp;
+    size_t written;
+
+    _ss_detach(s);
+
+    ss_clear(*s);
+
+    va_start(argp, fmt);
+    written = _ss_packat(s, 0, fmt, &argp, _SS_ORDER_LE);
+    va_end(argp);
+
+    return written;
+}
+
+/**
+ * @brief Like ss_catpackBE, but little-endian.
+ * @param s
+ * @param fmt - The packing format string.
+ * @return Number of bytes written; NPOS on error.
+ */
+size_t
+ss_catpackLE(SS *s, const char *fmt, ...)
+{
+    va_list argp;
+    size_t written;
+
+    va_start(argp, fmt);
+    written = _ss_packat(s, _ss_len(*s), fmt, &argp, _SS_ORDER_LE);
+    va_end(argp);
+
+    return written;
+}
+
+/**
+ * @internal
+ * @return Number of bytes processed; NPOS on error.
+ */
+static size_t
+_ss_unpack(size_t blen, const unsigned char *buf, const char *fmt, va_list *argp, int order)
+{
+    va_list ap;
+    va_copy(ap, *argp);
+
+    size_t len = 0;
+
+    for (; fmt[0]; ++fmt)
+    {
+        size_t count;
+        bool array;
+        size_t width = _ss_pack_next(&fmt, &count, &array);
+
+        if (!width)
+        {
+            len = NPOS;
+            break;
+        }
+
+        size_t need = count * width;
+        if (len + need > blen)
+        {
+            len = NPOS;
+            break;
+        }
+
+        if (array)
+        {
+            _ss_unpack_array(va_arg(ap, void *), buf, count, fmt[0], width, order);
+        }
+        else
+        {
+            _ss_unpack_scalar(buf, fmt[0], &ap, order);
+        }
+
+        buf += need;
+        len += need;
+    }
+
+    va_end(ap);
+
+    return len;
+}
+
+/**
+ * @brief Unpacks/deserializes the string. See ss_packBE documentation for more details.
+ * @note Pass pointers to where each value goes, and arrays as a pointer
+ *       to the first element.
+ * @param s
+ * @param fmt - The unpacking format string.
+ * @return Number of bytes processed; NPOS on error.
+ */
+size_t
+ss_unpackBE(const SS s, const char *fmt, ...)
+{
+    va_list argp;
+    size_t n;
+
+    if (!ss_isempty(s))
+    {
+        va_start(argp, fmt);
+        n = _ss_unpack(ss_len(s), (const unsigned char *)s, fmt, &argp, _SS_ORDER_BE);
+        va_end(argp);
+
+        return n;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/**
+ * @brief Unpacks/deserializes a buffer. See ss_packBE documentation for more details.
+ * @param blen - The length of the input buffer.
+ * @param buf - The non-NULL buffer reference.
+ * @param fmt - The unpacking format string.
+ * @return Number of bytes processed; NPOS on error.
+ */
+size_t
+ssb_unpackBE(size_t blen, unsigned char *buf, const char *fmt, ...)
+{
+    va_list argp;
+    size_t n;
+
+    if (blen)
+    {
+        va_start(argp, fmt);
+        n = _ss_unpack(blen, buf, fmt, &argp, _SS_ORDER_BE);
+        va_end(argp);
+
+        return n;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/**
+ * @brief Like ss_unpackBE, but little-endian.
+ * @param s
+ * @param fmt - The unpacking format string.
+ * @return Number of bytes processed; NPOS on error.
+ */
+size_t
+ss_unpackLE(const SS s, const char *fmt, ...)
+{
+    va_list argp;
+    size_t n;
+
+    if (!ss_isempty(s))
+    {
+        va_start(argp, fmt);
+        n = _ss_unpack(ss_len(s), (const unsigned char *)s, fmt, &argp, _SS_ORDER_LE);
+        va_end(argp);
+
+        return n;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/**
+ * @brief Like ssb_unpackBE, but little-endian.
+ * @param blen - The length of the input buffer.
+ * @param buf - The non-NULL buffer reference.
+ * @param fmt - The unpacking format string.
+ * @return Number of bytes processed; NPOS on error.
+ */
+size_t
+ssb_unpackLE(size_t blen, unsigned char *buf, const char *fmt, ...)
+{
+    va_list argp;
+    size_t n;
+
+    if (blen)
+    {
+        va_start(argp, fmt);
+        n = _ss_unpack(blen, buf, fmt, &argp, _SS_ORDER_LE);
+        va_end(argp);
+
+        return n;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/*
+ * Pack plans.
+ * The format is parsed once into a list of fields with their offsets,
+ * so packing a fixed-shape record is one capacity check and a run of
+ * byte swapped stores.
+ */
+
+typedef struct _ss_packfield_s
+{
+    uint32_t off;
+    /* Elements of an array field. */
+    uint32_t count;
+    char type;
+    bool array;
+} _ss_packfield_t;
+
+struct ss_packplan_s
+{
+    /* Bytes written by the whole plan. */
+    size_t size;
+    size_t count;
+    int order;
+    _ss_packfield_t fields[];
+};
+
+/**
+ * @internal
+ * @brief Write the fields, the buffer must hold the plan's size.
+ */
+static void
+_ss_packplan_write(unsigned char *buf, const ss_packplan_t *plan, va_list *argp)
+{
+    const _ss_packfield_t *f = plan->fields;
+    const _ss_packfield_t *end = f + plan->count;
+    int order = plan->order;
+
+    for (; f != end; ++f)
+    {
+        if (f->array)
+        {
+            _ss_pack_array(buf + f->off, va_arg(*argp, const void *), f->count,
+                           f->type, _ss_pack_width(f->type), order);
+        }
+        else
+        {
+            _ss_pack_scalar(buf + f->off, f->type, argp, order);
+        }
+    }
+}
+
+/**
+ * @internal
+ * @brief Read the fields, the buffer must hold the plan's size.
+ */
+static void
+_ss_packplan_read(const unsigned char *buf, const ss_packplan_t *plan, va_list *argp)
+{
+    const _ss_packfield_t *f = plan->fields;
+    const _ss_packfield_t *end = f + plan->count;
+    int order = plan->order;
+
+    for (; f != end; ++f)
+    {
+        if (f->array)
+        {
+            _ss_unpack_array(va_arg(*argp, void *), buf + f->off, f->count,
+                             f->type, _ss_pack_width(f->type), order);
+        }
+        else
+        {
+            _ss_unpack_scalar(buf + f->off, f->type, argp, order);
+        }
+    }
+}
+
+/**
+ * @brief Compile a pack format for repeated use.
+ * @note Uses the same format as ss_packBE, arrays included.
+ *       A leading '<' is little-endian, '>' or '!' big-endian, and '='
+ *       native; big-endian is the default.
+ * @note The plan is allocated with the global allocator.
+ * @param fmt - The packing format string.
+ * @return The plan; NULL if the format is invalid.
+ */
+ss_packplan_t *
+ss_packplan_compile(const char *fmt)
+{
+    int order = _SS_ORDER_BE;
+
+    switch (fmt[0])
+    {
+        case '<':
+            order = _SS_ORDER_LE;
+            ++fmt;
+            break;
+        case '>':
+        case '!':
+            ++fmt;
+            break;
+        case '=':
+            order = _SS_ORDER_NATIVE;
+            ++fmt;
+            break;
+        default:
+            break;
+    }
+
+    /* Upper bound, every field is at least one character. */
+    size_t count = ss_cstrlen(fmt);
+    size_t size = sizeof(ss_packplan_t) + (count * sizeof(_ss_packfield_t));
+    const ss_allocator_t *a = g_ss_allocator;
+
+    ss_packplan_t *plan = a->alloc(a->ctx, size);
+    if (UNLIKELY(!plan))
+    {
+        _ss_abort(true, size);
+    }
+
+    size_t off = 0;
+    size_t n = 0;
+    for (; fmt[0]; ++fmt, ++n)
+    {
+        size_t elems;
+        bool array;
+        size_t width = _ss_pack_next(&fmt, &elems, &array);
+
+        if (!width || elems > UINT32_MAX || off + (elems * width) > UINT32_MAX)
+        {
+            a->free(a->ctx, plan);
+            return NULL;
+        }
+
+        plan->fields[n].off = (uint32_t)off;
+        plan->fields[n].count = (uint32_t)elems;
+        plan->fields[n].type = fmt[0];
+        plan->fields[n].array = array;
+        off += elems * width;
+    }
+
+    plan->size = off;
+    plan->count = n;
+    plan->order = order;
+
+    return plan;
+}
+
+/**
+ * @brief Free the plan.
+ * @param plan - Reference to the plan, set to NULL.
+ */
+void
+ss_packplan_free(ss_packplan_t **plan)
+{
+    if (*plan)
+    {
+        const ss_allocator_t *a = g_ss_allocator;
+        a->free(a->ctx, *plan);
+        *plan = NULL;
+    }
+}
+
+/**
+ * @return Number of bytes the plan packs.
+ */
+size_t
+ss_packplan_size(const ss_packplan_t *plan)
+{
+    return plan->size;
+}
+
+/**
+ * @brief Like ss_packBE, but with a compiled format.
+ * @param s
+ * @param plan - The compiled format.
+ * @return Number of bytes written.
+ */
+size_t
+ss_packplan_exec(SS *s, const ss_packplan_t *plan, ...)
+{
+    va_list argp;
+    size_t size = plan->size;
+
+    _ss_detach(s);
+
+    if (size > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, size);
+    }
+
+    va_start(argp, plan);
+    _ss_packplan_write((unsigned char *)(*s), plan, &argp);
+    va_end(argp);
+
+    _ss_setlen(*s, size);
+    (*s)[size] = 0;
+
+    return size;
+}
+
+/**
+ * @brief Like ss_catpackBE, but with a compiled format.
+ * @param s
+ * @param plan - The compiled format.
+ * @return Number of bytes written.
+ */
+size_t
+ss_catpackplan_exec(SS *s, const ss_packplan_t *plan, ...)
+{
+    va_list argp;
+    size_t len = _ss_len(*s);
+    size_t size = plan->size;
+
+    _ss_detach(s);
+
+    if (len + size > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, len + size);
+    }
+
+    va_start(argp, plan);
+    _ss_packplan_write((unsigned char *)(*s) + len, plan, &argp);
+    va_end(argp);
+
+    len += size;
+    _ss_setlen(*s, len);
+    (*s)[len] = 0;
+
+    return size;
+}
+
+/**
+ * @brief Like ss_unpackBE, but with a compiled format.
+ * @param s
+ * @param plan - The compiled format.
+ * @return Number of bytes processed; NPOS if the string is too short.
+ */
+size_t
+ss_unpackplan_exec(const SS s, const ss_packplan_t *plan, ...)
+{
+    va_list argp;
+
+    if (_ss_len(s) < plan->size)
+    {
+        return NPOS;
+    }
+
+    va_start(argp, plan);
+    _ss_packplan_read((const unsigned char *)s, plan, &argp);
+    va_end(argp);
+
+    return plan->size;
+}
+
+/**
+ * @brief Like ssb_unpackBE, but with a compiled format.
+ * @param blen - The length of the input buffer.
+ * @param buf - The non-NULL buffer reference.
+ * @param plan - The compiled format.
+ * @return Number of bytes processed; NPOS if the buffer is too short.
+ */
+size_t
+ssb_unpackplan_exec(size_t blen, const unsigned char *buf, const ss_packplan_t *plan, ...)
+{
+    va_list argp;
+
+    if (blen < plan->size)
+    {
+        return NPOS;
+    }
+
+    va_start(argp, plan);
+    _ss_packplan_read(buf, plan, &argp);
+    va_end(argp);
+
+    return plan->size;
+}
+
+/**
+ * @brief Safely set the length of the string. Cannot exceed capacity.
+ * @param s
+ * @param len - The length to set the string to.
+ */
+void
+ss_setlen(SS s, size_t len)
+{
+    /* Empty string will have cap of 0. */
+    if (len <= _ss_cap(s))
+    {
+        s[len] = 0;
+        _ss_setlen(s, len);
+    }
+}
+
+/**
+ * @brief Call to use strlen to set the length.
+ * @note As a precaution the NULL sentinel is reset.
+ * @param s
+ */
+void
+ssc_setlen(SS s)
+{
+    size_t cap = _ss_cap(s);
+
+    /* Don't modify empty string. */
+    if (cap)
+    {
+        s[cap] = 0;
+    }
+
+    size_t len = ss_cstrlen(s);
+
+    if (len <= cap)
+    {
+        _ss_setlen(s, len);
+        s[len] = 0;
+    }
+}
+
+/**
+ * @brief Set the growth rate option in the string's metadata.
+ * @note It might seem odd to pass string by reference.
+ *       This is done because of how empty string is implemented.
+ * @param s
+ * @param opt - The chosen growth rate.
+ */
+void
+ss_setgrow(SS *s, enum ss_grow_opt opt)
+{
+    _ss_detach(s);
+
+    if (!_ss_is_type(*s, _SSTRING_EMPTY))
+    {
+        /* Stack string is mutable, so this is okay to set. */
+        switch (opt)
+        {
+            case SS_GROW0:
+            case SS_GROW25:
+            case SS_GROW50:
+            case SS_GROW100:
+            case SS_GROWCLASS:
+            case SS_GROWPAGE:
+                _ss_setgrowbits(*s, opt);
+                break;
+            case SS_GROWHUGE:
+                _ss_setgrowbits(*s, opt);
+                if ((_ss_type(*s) & _SS_HEAP_ALLOCATED) && !ss_getallocator(*s))
+                {
+                    ss_setallocator(s, &g_ss_huge_allocator);
+                }
+                break;
+        }
+    }
+    else if ((unsigned int)opt < _SS_GROW_MAX)
+    {
+        *s = _ss_string(((_sstring_t *)&g_ss_empty[opt]));
+    }
+}
+
+/**
+ * @brief Forces the string to be allocated onto the heap.
+ * @param s
+ */
+void
+ss_heapify(SS *s)
+{
+    if (!(_ss_type(*s) & _SS_HEAP_ALLOCATED))
+    {
+        size_t len = _ss_len(*s);
+        SS s2 = _ss_alloc(NULL, len, _ss_type(*s));
+
+        _SS_STAT_ADD(promotions, 1);
+        _SS_STAT_ADD(bytes_copied, len);
+        ss_memcopy(s2, *s, len + 1);
+        _ss_setlen(s2, len);
+        _ss_release(*s);
+        *s = s2;
+    }
+}
+
+/**
+ * @brief Move the string into storage owned by the given allocator.
+ * @note Empty, stack, mapped, and shared strings are moved to the heap.
+ * @note The allocator must outlive the string.
+ * @param s
+ * @param a - The allocator; NULL for the global allocator.
+ */
+void
+ss_setallocator(SS *s, const ss_allocator_t *a)
+{
+    uint32_t type = _ss_type(*s);
+    bool heap = !!(type & _SS_HEAP_ALLOCATED);
+    const ss_allocator_t *cur = ss_getallocator(*s);
+
+    if (heap && cur == a)
+    {
+        return;
+    }
+
+    size_t len = _ss_len(*s);
+    SS s2 = _ss_alloc(a, _ss_cap(*s), type);
+    _ss_setlen(s2, len);
+    _SS_STAT_ADD(bytes_copied, len);
+    ss_memcopy(s2, *s, len + 1);
+
+    if (heap)
+    {
+        _ss_dealloc(*s);
+    }
+    else
+    {
+        _SS_STAT_ADD(promotions, 1);
+        _ss_release(*s);
+    }
+
+    *s = s2;
+}
+
+/**
+ * @return The string's own allocator; NULL if it uses the global allocator
+ *         or isn't on the heap.
+ */
+const ss_allocator_t *
+ss_getallocator(const SS s)
+{
+    if (_ss_hdr(s))
+    {
+        return NULL;
+    }
+
+    const _sstring_t *m = _ss_cmeta(s);
+    return (m->type & _SS_CUSTOM_ALLOC)
+           ? (const ss_allocator_t *)*_ss_prefix(m) : NULL;
+}
+
+/**
+ * @brief Set the allocator used by heap strings without their own allocator.
+ * @warning Strings remember only a per-string allocator, other heap strings
+ *          are freed with whatever is global at the time.
+ *          Set this before allocating strings (or once none are live).
+ * @warning Not thread-safe, set it during startup.
+ * @param a - The allocator; NULL restores malloc/realloc/free.
+ */
+void
+ss_setglobalallocator(const ss_allocator_t *a)
+{
+    if (g_ss_cache.alloc)
+    {
+        /* The cached blocks belong to the old one. */
+        _ss_cache_flush(&g_ss_cache);
+        g_ss_cache.alloc = NULL;
+    }
+    g_ss_allocator = a ? a : &g_ss_default_allocator;
+}
+
+/**
+ * @return The allocator used by heap strings without their own allocator.
+ */
+const ss_allocator_t *
+ss_getglobalallocator(void)
+{
+    return g_ss_allocator;
+}
+
+/**
+ * @brief Keep up to depth freed heap strings per size class for reuse
+ *        by the calling thread. Covers strings whose blocks are 32 to
+ *        1024 bytes, their capacity rounds up to fill the block.
+ * @note Off by default. The cache is flushed by the call, by
+ *       ss_cache_flush, and when the thread exits.
+ * @note New strings from the cache keep their class's capacity, a
+ *       string shrunk by ss_fit is filed under a smaller class.
+ * @param depth - Blocks kept per class, at most SS_CACHE_MAX_DEPTH;
+ *                zero turns the cache off.
+ */
+void
+ss_cache_setdepth(size_t depth)
+{
+    _ss_cache_t *c = &g_ss_cache;
+
+    pthread_once(&g_ss_cache_once, _ss_cache_key_init);
+    if (c->alloc)
+    {
+        _ss_cache_flush(c);
+    }
+    c->depth = (uint32_t)(depth < SS_CACHE_MAX_DEPTH ? depth : SS_CACHE_MAX_DEPTH);
+    pthread_setspecific(g_ss_cache_key, c->depth ? c : NULL);
+}
+
+/**
+ * @brief Free the heap strings kept by the calling thread's cache.
+ */
+void
+ss_cache_flush(void)
+{
+    if (g_ss_cache.alloc)
+    {
+        _ss_cache_flush(&g_ss_cache);
+    }
+}
+
+/**
+ * @brief Sum the counters of every thread, exited ones included.
+ * @note Counters of running threads are read as they change, each is
+ *       current but they aren't taken at one instant.
+ * @param out - Receives the totals; zeroed without SS_STATS.
+ * @return True if the library was built with SS_STATS.
+ */
+bool
+ss_stats_snapshot(ss_stats_t *out)
+{
+    ss_memset(out, 0, sizeof(*out));
+#ifdef SS_STATS
+    pthread_mutex_lock(&g_ss_stats_lock);
+    _ss_stats_add(out, &g_ss_stats_retired);
+    for (const _ss_stats_block_t *b = g_ss_stats_threads; b; b = b->next)
+    {
+        _ss_stats_add(out, &b->counts);
+    }
+    pthread_mutex_unlock(&g_ss_stats_lock);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Read the calling thread's counters.
+ * @param out - Receives the counters; zeroed without SS_STATS.
+ * @return True if the library was built with SS_STATS.
+ */
+bool
+ss_stats_thread(ss_stats_t *out)
+{
+    ss_memset(out, 0, sizeof(*out));
+#ifdef SS_STATS
+    _ss_stats_add(out, &g_ss_stats.counts);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Call the hook after every reallocation of a string, e.g. to
+ *        record the caller's stack.
+ * @note The hook runs on the thread reallocating, from
+ *       _ss_stats_realloc, which also suits a uprobe without a hook.
+ * @param hook - NULL to remove the hook.
+ * @param ctx - Passed to the hook.
+ * @return True if the library was built with SS_STATS, the hook never
+ *         runs otherwise.
+ */
+bool
+ss_stats_sethook(ss_realloc_hook_t hook, void *ctx)
+{
+#ifdef SS_STATS
+    __atomic_store_n(&g_ss_stats_hookctx, ctx, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_ss_stats_hook, hook, __ATOMIC_RELEASE);
+    return true;
+#else
+    (void)hook;
+    (void)ctx;
+    return false;
+#endif
+}
+
+/**
+ * @brief Swaps the two references.
+ * @param s1
+ * @param s2
+ */
+void
+ss_swap(SS *s1, SS *s2)
+{
+    SS tmp = *s1;
+    *s1 = *s2;
+    *s2 = tmp;
+}
+
+/**
+ * @brief Make sure the string can hold at least the given amount.
+ * @note Growth disabled.
+ * @param s
+ * @param res - The amount to ensure the string can hold.
+ */
+void
+ss_reserve(SS *s, size_t res)
+{
+    /* Empty string will realloc. */
+    if (_ss_cap(*s) < res)
+    {
+        *s = _ss_realloc(*s, res);
+    }
+}
+
+/**
+ * @brief Reallocate to get rid of excess capacity.
+ * @note Growth disabled.
+ * @param s
+ */
+void
+ss_fit(SS *s)
+{
+    size_t len = _ss_len(*s);
+
+    /* We don't want to fit empty.
+     * We don't want to fit stack allocated.
+     */
+    if (_ss_cap(*s) != len && (_ss_type(*s) & _SS_HEAP_ALLOCATED))
+    {
+        *s = _ss_realloc(*s, len);
+    }
+}
+
+/**
+ * @brief Set the capacity the amount given.
+ * @note Differs from `ss_reserve` in that reserve will not reallocate
+ *       if there is enough capacity.
+ * @note Stack allocated strings will not switch to the heap if there is space.
+ * @note Growth disabled.
+ * @param s
+ * @param res - The amount of capacity to have.
+ */
+void
+ss_resize(SS *s, size_t res)
+{
+    size_t cap = _ss_cap(*s);
+
+    /* If stack allocated and has capacity, just return. */
+    if (!(_ss_type(*s) & _SS_HEAP_ALLOCATED))
+    {
+        if (cap >= res)
+        {
+            return;
+        }
+    }
+
+    /* Reallocation truncates if needed. */
+    if (cap != res)
+    {
+        *s = _ss_realloc(*s, res);
+    }
+}
+
+/**
+ * @brief Convenience function to add capacity to the string.
+ * @note Growth disabled.
+ * @param s
+ * @param add - The amount to add.
+ */
+void
+ss_addcap(SS *s, size_t add)
+{
+    if (LIKELY(add))
+    {
+        size_t cap = _ss_cap(*s);
+        size_t newcap = cap + add;
+        if (newcap < cap)
+        {
+            newcap = _ss_cap_max();
+        }
+
+        *s = _ss_realloc(*s, newcap);
+    }
+}
+
+/**
+ * @brief Clear the string (length to zero and sentinel in place).
+ * @param s
+ */
+void
+ss_clear(SS s)
+{
+    if (!_ss_is_type(s, _SSTRING_EMPTY))
+    {
+        _ss_setlen(s, 0);
+        s[0] = 0;
+    }
+}
+
+/**
+ * @brief Remove the given substring from the string.
+ * @param s
+ * @param index - The place to start.
+ * @param cs - The substring to remove.
+ * @param len - The length of substring.
+ */
+void
+ss_remove(SS s, size_t index, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(s);
+
+    if (len && index < slen)
+    {
+        char *end = s + slen;
+        char *cursor = (char *)ss_memmem(s + index, slen - index, cs, len);
+
+        if (!cursor)
+        {
+            return;
+        }
+
+        char *to = cursor;
+        char *from = cursor + len;
+        while ((cursor = (char *)ss_memmem(from, end - from, cs, len)))
+        {
+            size_t movelen = cursor - from;
+            if (movelen)
+            {
+                ss_memmove(to, from, movelen);
+                to += movelen;
+            }
+            from = cursor + len;
+        }
+
+        size_t taillen = end - from;
+        ss_memmove(to, from, taillen + 1);
+        _ss_setlen(s, (to - s) + taillen);
+    }
+}
+
+/**
+ * @brief Remove a section of string.
+ * @param s
+ * @param start - The starting point (inclusive).
+ * @param end - The ending point (exclusive).
+ */
+void
+ss_removerange(SS s, size_t start, size_t end)
+{
+    size_t len = _ss_len(s);
+
+    if (end > len)
+    {
+        end = len;
+    }
+
+    if (start >= end)
+    {
+        return;
+    }
+
+    size_t movelen = len - end + 1;
+    ss_memmove(s + start, s + end, movelen);
+    _ss_setlen(s, len - (end - start));
+}
+
+/**
+ * @brief Reverse the characters in the string.
+ * @param s
+ */
+void
+ss_reverse(SS s)
+{
+    _ss_unhash(s);
+    _ss_rev()->reverse(s, _ss_len(s));
+}
+
+/**
+ * @brief Chop off the end of the string.
+ * @note Length is updated and sentinel is set.
+ * @param s
+ * @param index - The place to truncate the string.
+ */
+void
+ss_trunc(SS s, size_t index)
+{
+    if (index < _ss_len(s))
+    {
+        _ss_setlen(s, index);
+        s[index] = 0;
+    }
+}
+
+/**
+ * @internal
+ * @brief Internal trim method.
+ * @param rstart - VALID start index.
+ * @param rend - VALID end index.
+ */
+INLINE static void
+_ss_trim(SS s, size_t rstart, size_t rend, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(s);
+    size_t start = rstart;
+    size_t end = rend;
+
+    while (start < end && ss_memchar(cs, s[start], len))
+    {
+        ++start;
+    }
+    while (start < end && ss_memchar(cs, s[end -1], len))
+    {
+        --end;
+    }
+
+    size_t rmovelen = end - start;
+
+    if (start != rstart && rmovelen)
+    {
+        ss_memmove(s + rstart, s + start, rmovelen);
+    }
+
+    if (start != rstart || end != rend)
+    {
+        size_t movelen = (slen - rend) + 1;
+        ss_memmove(s + rstart + rmovelen, s + rend, movelen);
+    }
+
+    _ss_setlen(s, slen - ((rend - rstart) - rmovelen));
+}
+
+/**
+ * @brief Trim the characters from the beginning and end of the string.
+ * @param s
+ * @param cs - The substring listing the characters to trim.
+ * @param len - The length of substring.
+ */
+void
+ss_trim(SS s, const char *cs, size_t len)
+{
+    if (len)
+    {
+        _ss_trim(s, 0, ss_len(s), cs, len);
+    }
+}
+
+/**
+ * @brief Trim the characters from the beginning and end in the range.
+ * @param s
+ * @param rstart - The start of the range (inclusive).
+ * @param rend - The end of the range (exclusive).
+ * @param cs - The substring of characters to trim.
+ * @param len - The length of the substring.
+ */
+void
+ss_trimrange(SS s, size_t rstart, size_t rend, const char *cs, size_t len)
+{
+    if (len)
+    {
+        size_t slen = _ss_len(s);
+
+        if (rend > slen)
+        {
+            rend = slen;
+        }
+
+        if (rstart >= rend)
+        {
+            return;
+        }
+
+        _ss_trim(s, rstart, rend, cs, len);
+    }
+}
+
+/**
+ * @brief Like the other trim methods, but assumes a cstring.
+ * @note This is done because strchr is likely highly optimized.
+ * @param s
+ * @param cs - The substring of characters to trim.
+ *             Using NULL will default to trimming US-ASCII whitespace.
+ */
+void
+ssc_trim(SS s, const char *cs)
+{
+    size_t len = 0;
+    size_t start = 0;
+    size_t end = _ss_len(s);
+
+    if (cs)
+    {
+        while (start < end && ss_cstrchar(cs, s[start]))
+        {
+            ++start;
+        }
+        while (start < end && ss_cstrchar(cs, s[end - 1]))
+        {
+            --end;
+        }
+    }
+    else
+    {
+        while (start < end && isspace(s[start]))
+        {
+            ++start;
+        }
+        while (start < end && isspace(s[end - 1]))
+        {
+            --end;
+        }
+    }
+
+    if (end != start)
+    {
+        len = end - start;
+        if (start)
+        {
+            ss_memmove(s, s + start, len + 1);
+        }
+    }
+    _ss_setlen(s, len);
+    s[len] = 0;
+}
+
+/**
+ * @brief Convert US-ASCII characters to uppercase.
+ * @param s
+ */
+void
+ssc_upper(SS s)
+{
+    _ss_unhash(s);
+    while (*s)
+    {
+        *s = toupper(*s);
+        ++s;
+    }
+}
+
+/**
+ * @brief Convert the US-ASCII letters of the whole string to uppercase.
+ * @note Unlike ssc_upper, doesn't stop at a NUL and ignores the locale.
+ * @param s
+ */
+void
+ss_upper(SS s)
+{
+    _ss_unhash(s);
+    _ss_case()->map(s, _ss_len(s), true);
+}
+
+/**
+ * @brief Convert the US-ASCII letters of the whole string to lowercase.
+ * @note Unlike ssc_lower, doesn't stop at a NUL and ignores the locale.
+ * @param s
+ */
+void
+ss_lower(SS s)
+{
+    _ss_unhash(s);
+    _ss_case()->map(s, _ss_len(s), false);
+}
+
+/**
+ * @brief Convert US-ASSII characters to lowercase.
+ * @param s
+ */
+void
+ssc_lower(SS s)
+{
+    _ss_unhash(s);
+    while (*s)
+    {
+        *s = tolower(*s);
+        ++s;
+    }
+}
+
+/**
+ * @internal
+ * @return The numerical value of the hexidecimal US-ASCII character
+ *         code point ('0'-'F', upper/lower).
+ * @param c - The hex character.
+ */
+INLINE static unsigned char
+_ss_tohexval(unsigned char c)
+{
+    static const unsigned char map[] =
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        /* 0 starting at first item */
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0, 0, 0, 0, 0, 0,
+        /* A starting at second item */
+        0, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        /* a starting at second item */
+        0, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    };
+    return map[c];
+}
+
+/**
+ * @internal
+ * @param n - The uint32_t to count bits of.
+ * @return Number of bits set.
+ */
+INLINE static int
+_ss_pop32(uint32_t n)
+{
+    n = n - ((n >> 1) & 0x55555555);
+    n = (n & 0x33333333) + ((n >> 2) & 0x33333333);
+    return (((n + (n >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+/*
+ * @internal
+ * @warning DO NOT use GCC clz impl because the result when n = 0 is undefined.
+ */
+INLINE static int
+_ss_clz32_impl(uint32_t n)
+{
+    n = n | (n >> 1);
+    n = n | (n >> 2);
+    n = n | (n >> 4);
+    n = n | (n >> 8);
+    n = n | (n >>16);
+#if UINT_MAX == 4294967295U && defined __GNUC__
+    return __builtin_popcount(~n);
+#else
+    return _ss_pop32(~n);
+#endif
+}
+
+/**
+ * @internal
+ * @note Uses de Bruijn algorithm for minimal perfect hashing.
+ * @see https://en.wikipedia.org/wiki/Find_first_set
+ * @return Return most significant bit index or zero if none.
+ */
+INLINE static int
+_ss_msb32_impl(uint32_t c)
+{
+    static char map[] =
+    {
+        0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+        8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31
+    };
+
+    if (UNLIKELY(!c))
+    {
+        return 0;
+    }
+
+    c = c | (c >>  1);
+    c = c | (c >>  2);
+    c = c | (c >>  4);
+    c = c | (c >>  8);
+    c = c | (c >> 16);
+
+    return map[(c * 0x07C4ACDD) >> 27] + 1;
+}
+
+/**
+ * @internal
+ * @brief Find the number of bytes to encode the number of bits.
+ * 
+ * Bytes   bits (diff)
+ * 1  0- 7 bits
+ * 2  8-11 bits (4)
+ * 3 12-16 bits (5)
+ * 4 17-21 bits (5)
+ * 5 22-26 bits (5)
+ * 6 27-31 bits (5)
+ * 7 32-36 bits (5)
+ *
+ * Add three to the number of bits to align to fives.
+ * Divide by 5 to get the number of bytes to encode.
+ *
+ * @param c - Valid Unicode code point.
+ */
+INLINE static int
+_ss_utf8len(unicode_t c)
+{
+    return c < 128 ? 1 : ((_ss_msb32_impl(c) + 3)/5);
+}
+
+INLINE static int
+_ss_unicodetoutf8(unicode_t c, unsigned char *buf)
+{
+    if (c < 128)
+    {
+        *buf = c;
+        return 1;
+#if 0
+        /* If we want to support technically invalid utf8 output.
+         * Only listed here as a form of documentation.
+         * Stuff like this does exist in the wild.
+         */
+        if (c)
+        {
+            *buf = c;
+            return 1;
+        }
+        else
+        {
+            /* Basically, null is output as multibyte so it
+             * can be included in normal string processing stuff.
+             */
+            buf[0] = 0xC0;
+            buf[1] = 0x80;
+            return 2;
+        }
+#endif
+    }
+    else if (UNLIKELY(!ssu_isvalid(c)))
+    {
+        return 0;
+    }
+    else
+    {
+        int len = _ss_utf8len(c);
+        int i = len - 1;
+        do
+        {
+            buf[i] = (unsigned char)(c & 0x0000003F) | 0x80;
+            c >>= 6;
+            --i;
+        } while (i);
+
+        buf [0] = (0xFF ^ ((1 << (8 - len)) - 1)) | c;
+
+        return len;
+    }
+}
+
+/**
+ * @brief Copy the substring into the string.
+ * @param s
+ * @param cs - The substring.
+ * @param len - The lenght of substring.
+ */
+void
+ss_copy(SS *s, const char *cs, size_t len)
+{
+    _ss_detach(s);
+
+    if (len > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, len);
+    }
+
+    ss_memcopy(*s, cs, len);
+    _ss_setlen(*s, len);
+    (*s)[len] = 0;
+}
+
+/**
+ * @brief Concatenate the substring onto the string.
+ * @param s
+ * @param cs - The substring.
+ * @param len - The lenght of substring.
+ */
+void
+ss_cat(SS *s, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(*s);
+
+    _ss_detach_cap(s, slen + len);
+
+    if ((slen + len) > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, slen + len);
+    }
+
+    ss_memcopy(*s + slen, cs, len);
+    slen += len;
+    _ss_setlen(*s, slen);
+    (*s)[slen] = 0;
+}
+
+/**
+ * @brief Left-concatenate the substring onto the string.
+ * @param s
+ * @param cs - The substring.
+ * @param len - The lenght of substring.
+ */
+void
+ss_lcat(SS *s, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(*s);
+
+    _ss_detach(s);
+
+    if ((slen + len) > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, slen + len);
+    }
+
+    ss_memmove(*s + len, *s, slen + 1);
+    ss_memcopy(*s, cs, len);
+    _ss_setlen(*s, slen + len);
+}
+
+/**
+ * @brief Replace a substring within the string with another value.
+ * @param s
+ * @param index - The index to start searching.
+ * @param replace - The string to replace.
+ * @param rlen - The length of `replace`.
+ * @param with - The string to replace with.
+ * @param wlen - The length of `with`.
+ */
+void
+ss_replace(SS *s, size_t index, const char *replace, size_t rlen, const char *with, size_t wlen)
+{
+    _ss_detach(s);
+
+    if (!rlen)
+    {
+        return;
+    }
+
+    if (!wlen)
+    {
+        ss_remove(*s, index, replace, rlen);
+        return;
+    }
+
+    size_t slen = _ss_len(*s);
+
+    if (index >= slen)
+    {
+        return;
+    }
+
+    if (wlen <= rlen)
+    {
+        /* Replace, inplace. Easy. */
+        char *end = *s + slen;
+        char *cursor = (char *)ss_memmem(*s + index, slen - index, replace, rlen);
+
+        if (!cursor)
+        {
+            return;
+        }
+
+        char *to = cursor;
+        char *from = cursor;
+        do
+        {
+            size_t movelen = cursor - from;
+            if (movelen && to != from)
+            {
+                ss_memmove(to, from, movelen);
+            }
+            to += movelen;
+
+            ss_memcopy(to, with, wlen);
+            to += wlen;
+            from = cursor + rlen;
+        } while ((cursor = (char *)ss_memmem(from, end - from, replace, rlen)));
+
+        size_t taillen = end - from;
+        if (to != from)
+        {
+            ss_memmove(to, from, taillen + 1);
+        }
+
+        _ss_setlen(*s, (to - *s) + taillen);
+    }
+    else
+    {
+        /* Replace with possible expansion. Hard. */
+        size_t i = ss_find(*s, index, replace, rlen);
+        if (i != NPOS)
+        {
+            size_t diff = wlen - rlen;
+            size_t count = ss_count(*s, i + rlen, replace, rlen);
+            ++count;
+            size_t cap = (diff * count) + slen;
+            if (cap > _ss_cap(*s))
+            {
+                *s = _ss_realloc_grow(*s, cap);
+            }
+
+            /*
+             * *s + i is start location of first replace
+             *
+             * Replace r with ww.
+             * ccrccrcc
+             *   ^
+             * Memmove to end
+             * Memcpy
+             * ccwwfccrcc
+             *   ^
+             * we found the second one
+             * ccwwfccrcc
+             *        ^
+             * ccwwccfrcc
+             *       ^
+             * ccwwccwwcc
+             */
+            size_t movelen = (slen - (i + rlen)) + 1;
+            char *cursor = *s + i;
+            char *from = cursor + rlen + (diff * count);
+            ss_memmove(from, cursor + rlen, movelen);
+            ss_memcopy(cursor, with, wlen);
+
+            char *to = cursor + wlen;
+
+            slen += diff * count;
+            _ss_setlen(*s, slen);
+
+            const char *end = *s + slen;
+            while (--count)
+            {
+                /* Omit the NULL check since the count doesn't lie. */
+                cursor = (char *)ss_memmem(from, end - from, replace, rlen);
+
+                /* Move text to to space. */
+                movelen = cursor - from;
+                if (movelen)
+                {
+                    ss_memmove(to, from, movelen);
+                }
+                /* Advance to space. */
+                to += movelen;
+                ss_memcopy(to, with, wlen);
+                /* Advance to space. */
+                to += wlen;
+                from = cursor + rlen;
+            }
+        }
+    }
+}
+
+/*
+ * Multi-pattern replace.
+ * An Aho-Corasick automaton over the pattern bytes finds every
+ * replacement in one scan, then the output is written in one pass.
+ */
+
+typedef struct _ss_acmatch_s
+{
+    size_t start;
+    size_t pat;
+} _ss_acmatch_t;
+
+typedef struct _ss_ac_s
+{
+    /* Byte to column of the transition table, zero for bytes in no pattern. */
+    uint16_t cls[256];
+    size_t cols;
+    size_t states;
+    /* Transitions, states * cols. */
+    uint32_t *delta;
+    /* Longest pattern that is a suffix of the state; -1 if none. */
+    int32_t *match;
+    /* Length of the state's string. */
+    uint32_t *depth;
+} _ss_ac_t;
+
+/**
+ * @internal
+ * @brief Build the automaton, empty patterns are skipped.
+ */
+static void
+_ss_ac_build(_ss_ac_t *ac, const char **from, const size_t *flen, size_t n)
+{
+    size_t total = 1;
+    size_t i, j;
+
+    ss_memset(ac->cls, 0, sizeof(ac->cls));
+    ac->cols = 1;
+    for (i = 0; i < n; ++i)
+    {
+        total += flen[i];
+        for (j = 0; j < flen[i]; ++j)
+        {
+            unsigned char c = (unsigned char)from[i][j];
+            if (!ac->cls[c])
+            {
+                ac->cls[c] = (uint16_t)ac->cols++;
+            }
+        }
+    }
+
+    ac->delta = _ss_zalloc(total * ac->cols * sizeof(uint32_t));
+    ac->match = _ss_zalloc(total * sizeof(int32_t));
+    ac->depth = _ss_zalloc(total * sizeof(uint32_t));
+    ac->states = 1;
+    ac->match[0] = -1;
+
+    /* Trie, zero is "no child" since the root is nobody's child. */
+    for (i = 0; i < n; ++i)
+    {
+        uint32_t u = 0;
+        for (j = 0; j < flen[i]; ++j)
+        {
+            uint32_t *next = &ac->delta[(u * ac->cols) + ac->cls[(unsigned char)from[i][j]]];
+            if (!*next)
+            {
+                *next = (uint32_t)ac->states;
+                ac->match[ac->states] = -1;
+                ac->depth[ac->states] = (uint32_t)(j + 1);
+                ++ac->states;
+            }
+            u = *next;
+        }
+        /* Duplicates keep the first. */
+        if (flen[i] && ac->match[u] < 0)
+        {
+            ac->match[u] = (int32_t)i;
+        }
+    }
+
+    /* Breadth first, turning the trie into a full transition table. */
+    uint32_t *fail = _ss_zalloc(total * sizeof(uint32_t));
+    uint32_t *queue = _ss_zalloc(total * sizeof(uint32_t));
+    size_t head = 0;
+    size_t tail = 0;
+
+    queue[tail++] = 0;
+    while (head < tail)
+    {
+        uint32_t u = queue[head++];
+        uint32_t *row = &ac->delta[u * ac->cols];
+        const uint32_t *frow = &ac->delta[fail[u] * ac->cols];
+
+        if (u && ac->match[u] < 0)
+        {
+            ac->match[u] = ac->match[fail[u]];
+        }
+
+        size_t c;
+        for (c = 0; c < ac->cols; ++c)
+        {
+            if (row[c])
+            {
+                fail[row[c]] = u ? frow[c] : 0;
+                queue[tail++] = row[c];
+            }
+            else
+            {
+                row[c] = u ? frow[c] : 0;
+            }
+        }
+    }
+
+    _ss_zfree(fail);
+    _ss_zfree(queue);
+}
+
+/**
+ * @internal
+ * @brief Leftmost-longest, non-overlapping matches.
+ * @param count - Number of matches found.
+ * @return Matches in order; NULL if none.
+ */
+static _ss_acmatch_t *
+_ss_ac_scan(const _ss_ac_t *ac, const char *s, size_t len, const size_t *flen, size_t *count)
+{
+    _ss_acmatch_t *matches = NULL;
+    size_t mcap = 0;
+    size_t found = 0;
+    bool cand = false;
+    size_t cstart = 0;
+    size_t cpat = 0;
+    uint32_t state = 0;
+    size_t i = 0;
+
+    while (i < len || cand)
+    {
+        if (i < len)
+        {
+            state = ac->delta[(state * ac->cols) + ac->cls[(unsigned char)s[i]]];
+
+            int32_t m = ac->match[state];
+            if (m >= 0)
+            {
+                size_t start = i + 1 - flen[m];
+                if (!cand || start < cstart || (start == cstart && flen[m] > flen[cpat]))
+                {
+                    cand = true;
+                    cstart = start;
+                    cpat = (size_t)m;
+                }
+            }
+        }
+
+        /*
+         * Commit once no partial match reaches back to the candidate,
+         * so nothing can start earlier or run longer.
+         */
+        if (cand && (i >= len || i + 1 - ac->depth[state] > cstart))
+        {
+            if (found == mcap)
+            {
+                const ss_allocator_t *a = g_ss_allocator;
+                mcap = mcap ? mcap * 2 : 16;
+                matches = matches
+                          ? a->realloc(a->ctx, matches, mcap * sizeof(_ss_acmatch_t))
+                          : a->alloc(a->ctx, mcap * sizeof(_ss_acmatch_t));
+                if (UNLIKELY(!matches))
+                {
+                    _ss_abort(true, mcap * sizeof(_ss_acmatch_t));
+                }
+            }
+            matches[found].start = cstart;
+            matches[found].pat = cpat;
+            ++found;
+
+            /* Resume right after the match. */
+            cand = false;
+            state = 0;
+            i = cstart + flen[cpat];
+            continue;
+        }
+
+        ++i;
+    }
+
+    *count = found;
+    return matches;
+}
+
+/**
+ * @internal
+ * @brief Write the replaced output forward from src into dst.
+ * @note dst may be src if the output never gets ahead of the input.
+ */
+static void
+_ss_replacemany_forward(char *dst, const char *src, size_t len, const _ss_acmatch_t *matches,
+                        size_t count, const size_t *flen, const char **to, const size_t *tlen)
+{
+    size_t from = 0;
+    size_t k;
+
+    for (k = 0; k < count; ++k)
+    {
+        size_t seg = matches[k].start - from;
+        size_t p = matches[k].pat;
+
+        if (seg && dst != src + from)
+        {
+            ss_memmove(dst, src + from, seg);
+        }
+        dst += seg;
+        ss_memcopy(dst, to[p], tlen[p]);
+        dst += tlen[p];
+        from = matches[k].start + flen[p];
+    }
+
+    if (len > from)
+    {
+        ss_memmove(dst, src + from, len - from);
+    }
+}
+
+/**
+ * @brief Replace every pattern with its replacement in one pass.
+ * @note Matches are leftmost-longest and don't overlap; at the same
+ *       start the longer pattern wins and duplicates keep the first.
+ *       Replacements aren't searched again.
+ * @param s
+ * @param from - The patterns to replace, empty ones are ignored.
+ * @param flen - The lengths of the patterns.
+ * @param to - The replacements.
+ * @param tlen - The lengths of the replacements.
+ * @param n - The number of patterns.
+ */
+void
+ss_replacemany(SS *s, const char **from, size_t *flen, const char **to, size_t *tlen, size_t n)
+{
+    size_t len = _ss_len(*s);
+
+    _ss_detach(s);
+
+    if (!n || !len)
+    {
+        return;
+    }
+
+    _ss_ac_t ac;
+    _ss_ac_build(&ac, from, flen, n);
+
+    size_t count = 0;
+    _ss_acmatch_t *matches = _ss_ac_scan(&ac, *s, len, flen, &count);
+
+    _ss_zfree(ac.delta);
+    _ss_zfree(ac.match);
+    _ss_zfree(ac.depth);
+
+    if (!count)
+    {
+        return;
+    }
+
+    /* Final length, and whether the output ever gets ahead or behind the input. */
+    size_t newlen = len;
+    bool ahead = false;
+    bool behind = false;
+    size_t k;
+    for (k = 0; k < count; ++k)
+    {
+        size_t p = matches[k].pat;
+        newlen = newlen - flen[p] + tlen[p];
+        ahead = ahead || newlen > len;
+        behind = behind || newlen < len;
+    }
+
+    if (newlen > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, newlen);
+    }
+
+    char *str = *s;
+
+    if (!ahead)
+    {
+        _ss_replacemany_forward(str, str, len, matches, count, flen, to, tlen);
+    }
+    else if (!behind)
+    {
+        /* Backward, the output is never behind the input. */
+        size_t src = len;
+        size_t dst = newlen;
+        size_t kk = count;
+        while (kk--)
+        {
+            size_t p = matches[kk].pat;
+            size_t end = matches[kk].start + flen[p];
+            size_t seg = src - end;
+
+            dst -= seg;
+            ss_memmove(str + dst, str + end, seg);
+            dst -= tlen[p];
+            ss_memcopy(str + dst, to[p], tlen[p]);
+            src = matches[kk].start;
+        }
+    }
+    else
+    {
+        /* Both ways, write to the side and copy back. */
+        char *tmp = _ss_zalloc(newlen + 1);
+        _ss_replacemany_forward(tmp, str, len, matches, count, flen, to, tlen);
+        ss_memcopy(str, tmp, newlen);
+        _ss_zfree(tmp);
+    }
+
+    _ss_setlen(*s, newlen);
+    str[newlen] = 0;
+
+    _ss_zfree(matches);
+}
+
+
+/**
+ * @brief Replace a range with a substring.
+ * @param s
+ * @param start - The start of the range (inclusive).
+ * @param end - End of the range (exclusive).
+ * @param cs - The substring.
+ * @param len - The length of substring.
+ */
+void
+ss_replacerange(SS *s, size_t start, size_t end, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(*s);
+
+    _ss_detach(s);
+
+    if (end > slen)
+    {
+        end = slen;
+    }
+
+    if (start > end)
+    {
+        start = end;
+    }
+
+    size_t rlen = end - start;
+
+    if (len > rlen)
+    {
+        if ((slen + (len - rlen)) > _ss_cap(*s))
+        {
+            *s = _ss_realloc_grow(*s, slen + (len - rlen));
+        }
+    }
+
+    if (rlen != len)
+    {
+        size_t endlen = slen - end;
+        ss_memmove(*s + start + len, *s + end, endlen + 1);
+    }
+
+    ss_memcopy(*s + start, cs, len);
+    _ss_setlen(*s, (slen - rlen) + len);
+}
+
+/**
+ * @brief Insert the string at the given index.
+ * @param s
+ * @param index - Position to insert substring.
+ * @param cs - Substring.
+ * @param len - Substring length.
+ */
+void
+ss_insert(SS *s, size_t index, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(*s);
+
+    _ss_detach_cap(s, slen + len);
+
+    if (index > slen)
+    {
+        index = slen;
+    }
+
+    if ((slen + len) > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, slen + len);
+    }
+
+    char *dest = *s + index + len;
+    char *src = *s + index;
+    size_t movelen = slen - index + 1;
+    ss_memmove(dest, src, movelen);
+    ss_memcopy(src, cs, len);
+    slen += len;
+    _ss_setlen(*s, slen);
+    (*s)[slen] = 0;
+}
+
+/**
+ * @brief Places the substring over the existing string starting at the given position.
+ * @param s
+ * @param index - The start position.
+ * @param cs - Substring.
+ * @param len - Substring length.
+ */
+void
+ss_overlay(SS *s, size_t index, const char *cs, size_t len)
+{
+    size_t slen = _ss_len(*s);
+
+    _ss_detach(s);
+
+    if (index > slen)
+    {
+        index = slen;
+    }
+
+    size_t overend = index + len;
+
+    if (overend > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, overend);
+    }
+
+    ss_memcopy(*s + index, cs, len);
+    if (overend > slen)
+    {
+        _ss_setlen(*s, overend);
+        (*s)[overend] = 0;
+    }
+    else
+    {
+        _ss_unhash(*s);
+    }
+}
+
+/*
+ * Formatted output shorter than this is written to the stack first,
+ * then copied in after at most one reallocation.
+ * Define as zero to always format into the string.
+ */
+#ifndef SS_CATF_SCRATCH
+#define SS_CATF_SCRATCH (256)
+#endif
+
+/**
+ * @internal
+ * @return True if vsnprintf failed (as opposed to truncating).
+ */
+INLINE static bool
+_ss_catf_failed(int n)
+{
+    if (n < 0)
+    {
+        /*
+         * In pre glibc v2.1 libraries,
+         * -1 indicates not all bytes were written.
+         * @see https://linux.die.net/man/3/vsnprintf
+         */
+#ifdef __GNU_LIBRARY__
+#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
+        return -1 != n;
+#endif
+#endif
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @internal
+ * @note vsnprintf reports the full length, so the string grows at most
+ *       once to fit and the output is formatted at most twice.
+ */
+int
+_ss_catf(SS *s, const char *fmt, va_list *argp)
+{
+    va_list ap;
+    size_t len = _ss_len(*s);
+    size_t need = 0;
+    int n;
+
+    _ss_detach(s);
+
+#if SS_CATF_SCRATCH
+    if (_ss_cap(*s) - len < SS_CATF_SCRATCH)
+    {
+        char scratch[SS_CATF_SCRATCH];
+
+        va_copy(ap, *argp);
+        n = ss_vsnprintf(scratch, sizeof(scratch), fmt, ap);
+        va_end(ap);
+
+        if (_ss_catf_failed(n))
+        {
+            return EINVAL;
+        }
+
+        if (n >= 0 && (size_t)n < sizeof(scratch))
+        {
+            if (len + (size_t)n > _ss_cap(*s))
+            {
+                *s = _ss_realloc_grow(*s, len + (size_t)n);
+            }
+            ss_memcopy(*s + len, scratch, (size_t)n + 1);
+            _ss_setlen(*s, len + (size_t)n);
+            return 0;
+        }
+
+        need = n >= 0 ? (size_t)n : 0;
+    }
+#endif
+
+    if (!need && _ss_cap(*s) == 0)
+    {
+        /* Nowhere to format into, so just measure. */
+        va_copy(ap, *argp);
+        n = ss_vsnprintf(NULL, 0, fmt, ap);
+        va_end(ap);
+
+        if (_ss_catf_failed(n))
+        {
+            return EINVAL;
+        }
+        if (0 == n)
+        {
+            return 0;
+        }
+        need = n > 0 ? (size_t)n : 1;
+    }
+
+    for (;;)
+    {
+        if (len + need > _ss_cap(*s))
+        {
+            *s = _ss_realloc_grow(*s, len + need);
+        }
+
+        size_t avail = _ss_cap(*s) - len;
+
+        va_copy(ap, *argp);
+        n = ss_vsnprintf(*s + len, avail + 1, fmt, ap);
+        va_end(ap);
+
+        if (_ss_catf_failed(n))
+        {
+            /* The tail was written over, cached hash included. */
+            _ss_unhash(*s);
+            (*s)[len] = 0;
+            return EINVAL;
+        }
+
+        if (n >= 0 && (size_t)n <= avail)
+        {
+            _ss_setlen(*s, len + (size_t)n);
+            break;
+        }
+
+        /* Old libraries don't say how much is needed, so double. */
+        need = n >= 0 ? (size_t)n : 2 * (avail + 1);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief A very useful function to write information to the string using a
+ *        format string.
+ * @warning The contents of the buffer are not guaranteed if EINVAL returned.
+ * @note If using GCC you should get warnings for bad format strings.
+ * @param s
+ * @param fmt - Format string.
+ * @return EINVAL if bad format string; zero otherwise.
+ */
+int
+ss_copyf(SS *s, const char *fmt, ...)
+{
+    va_list argp;
+    int retval;
+
+    _ss_detach(s);
+
+    ss_clear(*s);
+
+    va_start(argp, fmt);
+    retval = _ss_catf(s, fmt, &argp);
+    va_end(argp);
+
+    return retval;
+#if 0
+    _sstring_t *m = _ss_meta(*s);
+    va_list argp;
+
+    if (m->cap == 0)
+    {
+        m = _ss_realloc_grow(m, ss_cstrlen(fmt) + 1);
+        *s = _ss_string(m);
+    }
+
+    for (;;)
+    {
+        va_start(argp, fmt);
+        int n = ss_vsnprintf(*s, m->cap, fmt, argp);
+        va_end(argp);
+
+        if (n < 0)
+        {
+            /*
+             * In pre glibc v2.1 libraries,
+             * -1 indicates not all bytes were written.
+             * @see https://linux.die.net/man/3/vsnprintf
+             */
+#ifdef __GNU_LIBRARY__
+#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
+            if (-1 != n)
+            {
+#endif
+#endif
+            (*s)[0] = 0;
+            return EINVAL;
+#ifdef __GNU_LIBRARY__
+#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
+            }
+#endif
+#endif
+        }
+
+        /* n could be -1, but this should be converted to largest value. */
+        if ((size_t)n < m->cap)
+        {
+            m->len = (size_t)n;
+            break;
+        }
+
+        m = _ss_realloc_grow(m, m->cap + 1);
+        *s = _ss_string(m);
+    }
+
+    return 0;
+#endif
+}
+
+/**
+ * @brief A very useful function to write information to the end of a string 
+ *        using a format string.
+ * @note If using GCC you should get warnings for bad format strings.
+ * @param s
+ * @param fmt - Format string.
+ * @return EINVAL if bad format string; zero otherwise.
+ */
+int
+ss_catf(SS *s, const char *fmt, ...)
+{
+    va_list argp;
+    int retval;
+
+    va_start(argp, fmt);
+    retval = _ss_catf(s, fmt, &argp);
+    va_end(argp);
+
+    return retval;
+#if 0
+    _sstring_t *m = _ss_meta(*s);
+    va_list argp;
+
+    if (m->cap == 0)
+    {
+        m = _ss_realloc_grow(m, ss_cstrlen(fmt) + 1);
+        *s = _ss_string(m);
+    }
+
+    for (;;)
+    {
+        va_start(argp, fmt);
+        int n = ss_vsnprintf(*s + m->len, m->cap - m->len + 1, fmt, argp);
+        va_end(argp);
+
+        if (n < 0)
+        {
+            /*
+             * In pre glibc v2.1 libraries,
+             * -1 indicates not all bytes were written.
+             * @see https://linux.die.net/man/3/vsnprintf
+             */
+#ifdef __GNU_LIBRARY__
+#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
+            if (-1 != n)
+            {
+#endif
+#endif
+            (*s)[m->len] = 0;
+            return EINVAL;
+#ifdef __GNU_LIBRARY__
+#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
+            }
+#endif
+#endif
+        }
+
+        /* n could be -1, but this should be converted to largest value. */
+        if ((size_t)n < (m->cap - m->len))
+        {
+            m->len += (size_t)n;
+            break;
+        }
+
+        m = _ss_realloc_grow(m, m->cap + 1);
+        *s = _ss_string(m);
+    }
+
+    return 0;
+#endif
+}
+
+/*
+ * Number formatting.
+ * The length is worked out first so digits go straight into the string,
+ * written back to front two at a time from a table of digit pairs.
+ */
+
+static const char g_ss_digitpairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* Smallest value with i + 1 digits, except the first entry. */
+static const uint64_t g_ss_pow10[20] =
+{
+    0ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+    10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+    100000000000ull, 1000000000000ull, 10000000000000ull,
+    100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull,
+    10000000000000000000ull,
+};
+
+/** @return Number of decimal digits in val. */
+INLINE static size_t
+_ss_declen(uint64_t val)
+{
+    /* 1233 / 4096 is just over log10(2). */
+    size_t t = ((size_t)(64 - __builtin_clzll(val | 1)) * 1233) >> 12;
+    return t + (val >= g_ss_pow10[t]);
+}
+
+/**
+ * @internal
+ * @brief Write the decimal digits of val to the end of buf.
+ * @return Start of the digits.
+ */
+INLINE static char *
+_ss_fmtuint64(char *end, uint64_t val)
+{
+    /* Eight digits at a time, as two independent runs of four. */
+    while (val >= 100000000)
+    {
+        uint64_t q = val / 100000000;
+        uint32_t v = (uint32_t)(val - 100000000 * q);
+        uint32_t hi = v / 10000;
+        uint32_t lo = v - 10000 * hi;
+        uint32_t h = hi / 100;
+        uint32_t l = lo / 100;
+        end -= 8;
+        ss_memcopy(end, g_ss_digitpairs + 2 * h, 2);
+        ss_memcopy(end + 2, g_ss_digitpairs + 2 * (hi - 100 * h), 2);
+        ss_memcopy(end + 4, g_ss_digitpairs + 2 * l, 2);
+        ss_memcopy(end + 6, g_ss_digitpairs + 2 * (lo - 100 * l), 2);
+        val = q;
+    }
+
+    uint32_t v = (uint32_t)val;
+    while (v >= 100)
+    {
+        uint32_t q = v / 100;
+        end -= 2;
+        ss_memcopy(end, g_ss_digitpairs + 2 * (v - 100 * q), 2);
+        v = q;
+    }
+
+    if (v >= 10)
+    {
+        end -= 2;
+        ss_memcopy(end, g_ss_digitpairs + 2 * v, 2);
+    }
+    else
+    {
+        *--end = (char)('0' + v);
+    }
+
+    return end;
+}
+
+INLINE static char
+_ss_tohexchar(unsigned char nibble)
+{
+    static char map[] =
+    {
+        '0', '1', '2', '3',
+        '4', '5', '6', '7',
+        '8', '9', 'A', 'B',
+        'C', 'D', 'E', 'F',
+    };
+    return map[nibble];
+}
+
+/**
+ * @internal
+ * @brief Grow the string by len bytes.
+ * @return Where the new bytes go.
+ */
+INLINE static char *
+_ss_catreserve(SS *s, size_t len)
+{
+    size_t slen = _ss_len(*s);
+
+    _ss_detach_cap(s, slen + len);
+
+    if ((slen + len) > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, slen + len);
+    }
+
+    _ss_setlen(*s, slen + len);
+    (*s)[slen + len] = 0;
+    return *s + slen;
+}
+
+/**
+ * @brief Concatenate the signed integral value in decimal.
+ * @param s
+ * @param val - The value to convert.
+ */
+void
+ss_catint64(SS *s, int64_t val)
+{
+    uint64_t mag = val < 0 ? (uint64_t)0 - (uint64_t)val : (uint64_t)val;
+    size_t len = _ss_declen(mag) + (val < 0);
+    char *p = _ss_catreserve(s, len);
+
+    *p = '-';
+    _ss_fmtuint64(p + len, mag);
+}
+
+/**
+ * @brief Concatenate the unsigned integral value in decimal.
+ * @param s
+ * @param val - The value to convert.
+ */
+void
+ss_catuint64(SS *s, uint64_t val)
+{
+    size_t len = _ss_declen(val);
+    char *p = _ss_catreserve(s, len);
+
+    _ss_fmtuint64(p + len, val);
+}
+
+/**
+ * @brief Concatenate the value in uppercase hexadecimal.
+ * @note No prefix or leading zeros are written.
+ * @param s
+ * @param val - The value to convert.
+ */
+void
+ss_cathex(SS *s, uint64_t val)
+{
+    size_t len = (size_t)(67 - __builtin_clzll(val | 1)) / 4;
+    char *p = _ss_catreserve(s, len) + len;
+
+    do
+    {
+        *--p = _ss_tohexchar((unsigned char)(val & 0x0F));
+        val >>= 4;
+    } while (val);
+}
+
+/*
+ * Shortest round trip doubles.
+ * This is Ryu with its small tables: the 125 bit powers of five are
+ * rebuilt from every 26th power, and the offsets correct the last bits.
+ * @see https://github.com/ulfjack/ryu
+ */
+
+#define _SS_DBL_MANTISSA_BITS (52)
+#define _SS_DBL_BIAS (1023)
+#define _SS_POW5_BITS (125)
+#define _SS_POW5_STEP (26)
+
+static const uint64_t _ss_pow5_split[13][2] =
+{
+    { 0x0000000000000000ull, 0x1000000000000000ull },
+    { 0x0000000000000000ull, 0x14adf4b7320334b9ull },
+    { 0x0e549208b31adb10ull, 0x1aba4714957d300dull },
+    { 0x6dc6ad264d8f0866ull, 0x1145b7e285bf98f5ull },
+    { 0xeb1dbd923d8596caull, 0x1652efdc6018a1fcull },
+    { 0xb4c1b80b22ae923cull, 0x1cda62055b2d9d83ull },
+    { 0x5bb28b4e8f7e4c30ull, 0x12a5568b9f52f416ull },
+    { 0xf08aed437682d4fbull, 0x1819651531f9e78full },
+    { 0xb4ee134ad99bf150ull, 0x1f25c186a6f04c28ull },
+    { 0x16499ecb70c25f03ull, 0x1420eb449c8842e6ull },
+    { 0x85a56ead360865b0ull, 0x1a03fde214caf085ull },
+    { 0x093db1d57999890bull, 0x10cfeb353a97dad8ull },
+    { 0xcf38bb735e3f36acull, 0x15baaf44fa52673eull },
+};
+static const uint32_t _ss_pow5_offsets[21] =
+{
+    0x00000000u, 0x00000000u, 0x00000000u, 0x00000000u,
+    0x40000000u, 0x59695995u, 0x55545555u, 0x56555515u,
+    0x41150504u, 0x40555410u, 0x44555145u, 0x44504540u,
+    0x45555550u, 0x40004000u, 0x96440440u, 0x55565565u,
+    0x54454045u, 0x40154151u, 0x55559155u, 0x51405555u,
+    0x00000105u,
+};
+static const uint64_t _ss_pow5_inv_split[13][2] =
+{
+    { 0x0000000000000001ull, 0x2000000000000000ull },
+    { 0x52a6c95fc0655034ull, 0x18c240c4aecb13bbull },
+    { 0x7ca8d50071dfc806ull, 0x1327fc58da0f6ff5ull },
+    { 0x6520247d3556476eull, 0x1da48ce468e7c702ull },
+    { 0x6139cdd76802e6e9ull, 0x16ef5b40c2fc7779ull },
+    { 0xf951a7ff43de8c79ull, 0x11bebdf578b2f391ull },
+    { 0x7be8bee8d6e957e8ull, 0x1b758d848fac54b0ull },
+    { 0x8bd3f9e999a423eaull, 0x153eda614071a3b7ull },
+    { 0x0848f973cb3ee3ceull, 0x10701bd527b4978cull },
+    { 0x153285ebb9efbfa2ull, 0x196fbb9bb44db44dull },
+    { 0xadeee7f86c07b696ull, 0x13ae3591f5b4d936ull },
+    { 0x4d686a4eaf182222ull, 0x1e74404f3daada91ull },
+    { 0x98c0a106e09ebd9full, 0x17900ea4fda7c257ull },
+};
+static const uint32_t _ss_pow5_inv_offsets[19] =
+{
+    0x54544554u, 0x04055545u, 0x10041000u, 0x00400414u,
+    0x40010000u, 0x41155555u, 0x00000454u, 0x00010044u,
+    0x40000000u, 0x44000041u, 0x50454450u, 0x55550054u,
+    0x51655554u, 0x40004000u, 0x01000001u, 0x00010500u,
+    0x51515411u, 0x05555554u, 0x00000000u,
+};
+static const uint64_t _ss_pow5_table[26] =
+{
+    1ull, 5ull, 25ull,
+    125ull, 625ull, 3125ull,
+    15625ull, 78125ull, 390625ull,
+    1953125ull, 9765625ull, 48828125ull,
+    244140625ull, 1220703125ull, 6103515625ull,
+    30517578125ull, 152587890625ull, 762939453125ull,
+    3814697265625ull, 19073486328125ull, 95367431640625ull,
+    476837158203125ull, 2384185791015625ull, 11920928955078125ull,
+    59604644775390625ull, 298023223876953125ull,
+};
+
+/** @return Bits in 5^e, or 1 when e is 0. */
+INLINE static int32_t
+_ss_pow5bits(int32_t e)
+{
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+/** @return floor(log10(2^e)). */
+INLINE static uint32_t
+_ss_log10pow2(int32_t e)
+{
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+/** @return floor(log10(5^e)). */
+INLINE static uint32_t
+_ss_log10pow5(int32_t e)
+{
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+/** @return Whether 5^p divides val. */
+INLINE static bool
+_ss_ispow5multiple(uint64_t val, uint32_t p)
+{
+    uint32_t count = 0;
+    while (val && !(val % 5))
+    {
+        val /= 5;
+        ++count;
+    }
+    return count >= p;
+}
+
+/** @return Whether 2^p divides val. */
+INLINE static bool
+_ss_ispow2multiple(uint64_t val, uint32_t p)
+{
+    return !(val & ((1ull << p) - 1));
+}
+
+/**
+ * @brief Set r to (m * mul) >> shift, keeping the low 128 bits.
+ * @note The shift is between 1 and 63.
+ */
+INLINE static void
+_ss_mulshift128(uint64_t m, const uint64_t *mul, uint32_t shift, uint64_t *r)
+{
+    uint64_t l0 = m, h0 = mul[0];
+    uint64_t l2 = m, h2 = mul[1];
+    _ss_hash_mul(&l0, &h0);
+    _ss_hash_mul(&l2, &h2);
+    uint64_t mid = h0 + l2;
+    uint64_t top = h2 + (mid < h0);
+    r[0] = (l0 >> shift) | (mid << (64 - shift));
+    r[1] = (mid >> shift) | (top << (64 - shift));
+}
+
+/** @brief Set r to 5^i scaled to 125 bits. */
+INLINE static void
+_ss_pow5(uint32_t i, uint64_t *r)
+{
+    uint32_t base = i / _SS_POW5_STEP;
+    uint32_t base2 = base * _SS_POW5_STEP;
+    uint32_t offset = i - base2;
+    const uint64_t *mul = _ss_pow5_split[base];
+
+    if (!offset)
+    {
+        r[0] = mul[0];
+        r[1] = mul[1];
+        return;
+    }
+
+    uint32_t delta = (uint32_t)(_ss_pow5bits((int32_t)i) - _ss_pow5bits((int32_t)base2));
+    _ss_mulshift128(_ss_pow5_table[offset], mul, delta, r);
+
+    uint64_t fix = (_ss_pow5_offsets[i / 16] >> ((i % 16) << 1)) & 3;
+    r[0] += fix;
+    r[1] += r[0] < fix;
+}
+
+/** @brief Set r to 2^k / 5^i scaled to 125 bits, rounded up. */
+INLINE static void
+_ss_pow5inv(uint32_t i, uint64_t *r)
+{
+    uint32_t base = (i + _SS_POW5_STEP - 1) / _SS_POW5_STEP;
+    uint32_t base2 = base * _SS_POW5_STEP;
+    uint32_t offset = base2 - i;
+    const uint64_t *mul = _ss_pow5_inv_split[base];
+
+    if (!offset)
+    {
+        r[0] = mul[0];
+        r[1] = mul[1];
+        return;
+    }
+
+    uint64_t down[2] = { mul[0] - 1, mul[1] };
+    uint32_t delta = (uint32_t)(_ss_pow5bits((int32_t)base2) - _ss_pow5bits((int32_t)i));
+    _ss_mulshift128(_ss_pow5_table[offset], down, delta, r);
+
+    uint64_t fix = 1 + ((_ss_pow5_inv_offsets[i / 16] >> ((i % 16) << 1)) & 3);
+    r[0] += fix;
+    r[1] += r[0] < fix;
+}
+
+/** @return (m * mul) >> j for j between 65 and 127. */
+INLINE static uint64_t
+_ss_mulshift64(uint64_t m, const uint64_t *mul, int32_t j)
+{
+    uint64_t r[2];
+    _ss_mulshift128(m, mul, (uint32_t)(j - 64), r);
+    return r[1];
+}
+
+/**
+ * @internal
+ * @brief Find the shortest decimal that reads back as the double.
+ * @param ieee - Mantissa bits of a finite, nonzero double.
+ * @param ieeeexp - Exponent bits of the double.
+ * @param exp - Set so the double is the result times 10^exp.
+ * @return Decimal digits.
+ */
+static uint64_t
+_ss_d2d(uint64_t ieee, uint32_t ieeeexp, int32_t *exp)
+{
+    int32_t e2;
+    uint64_t m2;
+
+    if (!ieeeexp)
+    {
+        e2 = 1 - _SS_DBL_BIAS - _SS_DBL_MANTISSA_BITS - 2;
+        m2 = ieee;
+    }
+    else
+    {
+        e2 = (int32_t)ieeeexp - _SS_DBL_BIAS - _SS_DBL_MANTISSA_BITS - 2;
+        m2 = (1ull << _SS_DBL_MANTISSA_BITS) | ieee;
+    }
+
+    /* Round half to even means even mantissas may use the bounds. */
+    bool accept = !(m2 & 1);
+
+    /* The interval of values that round to this double, times four. */
+    uint64_t mv = 4 * m2;
+    uint32_t mmshift = ieee || ieeeexp <= 1;
+
+    uint64_t pow[2];
+    uint64_t vr, vp, vm;
+    int32_t e10;
+    bool vmzeros = false;
+    bool vrzeros = false;
+
+    if (e2 >= 0)
+    {
+        uint32_t q = _ss_log10pow2(e2) - (e2 > 3);
+        int32_t k = _SS_POW5_BITS + _ss_pow5bits((int32_t)q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+
+        e10 = (int32_t)q;
+        _ss_pow5inv(q, pow);
+        vr = _ss_mulshift64(4 * m2, pow, i);
+        vp = _ss_mulshift64(4 * m2 + 2, pow, i);
+        vm = _ss_mulshift64(4 * m2 - 1 - mmshift, pow, i);
+
+        if (q <= 21)
+        {
+            /* Only then can the products be exact. */
+            if (!(mv % 5))
+            {
+                vrzeros = _ss_ispow5multiple(mv, q);
+            }
+            else if (accept)
+            {
+                vmzeros = _ss_ispow5multiple(mv - 1 - mmshift, q);
+            }
+            else
+            {
+                vp -= _ss_ispow5multiple(mv + 2, q);
+            }
+        }
+    }
+    else
+    {
+        uint32_t q = _ss_log10pow5(-e2) - (-e2 > 1);
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = _ss_pow5bits(i) - _SS_POW5_BITS;
+        int32_t j = (int32_t)q - k;
+
+        e10 = (int32_t)q + e2;
+        _ss_pow5((uint32_t)i, pow);
+        vr = _ss_mulshift64(4 * m2, pow, j);
+        vp = _ss_mulshift64(4 * m2 + 2, pow, j);
+        vm = _ss_mulshift64(4 * m2 - 1 - mmshift, pow, j);
+
+        if (q <= 1)
+        {
+            vrzeros = true;
+            if (accept)
+            {
+                vmzeros = mmshift == 1;
+            }
+            else
+            {
+                --vp;
+            }
+        }
+        else if (q < 63)
+        {
+            vrzeros = _ss_ispow2multiple(mv, q);
+        }
+    }
+
+    /* Drop digits while the interval still holds a shorter decimal. */
+    int32_t removed = 0;
+    uint64_t out;
+
+    if (vmzeros || vrzeros)
+    {
+        /* Exact ties, which are rare. */
+        uint32_t last = 0;
+
+        while (vp / 10 > vm / 10)
+        {
+            vmzeros &= !(vm % 10);
+            vrzeros &= !last;
+            last = (uint32_t)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+
+        if (vmzeros)
+        {
+            while (!(vm % 10))
+            {
+                vrzeros &= !last;
+                last = (uint32_t)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                ++removed;
+            }
+        }
+
+        if (vrzeros && 5 == last && !(vr & 1))
+        {
+            last = 4;
+        }
+
+        out = vr + ((vr == vm && (!accept || !vmzeros)) || last >= 5);
+    }
+    else
+    {
+        bool up = false;
+
+        if (vp / 100 > vm / 100)
+        {
+            up = (vr % 100) >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+
+        while (vp / 10 > vm / 10)
+        {
+            up = (vr % 10) >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            ++removed;
+        }
+
+        out = vr + (vr == vm || up);
+    }
+
+    *exp = e10 + removed;
+    return out;
+}
+
+/**
+ * @brief Concatenate the shortest decimal that reads back as the value.
+ * @note Output looks like JavaScript's: "100", "0.001", "1.5e+300".
+ * Exponents are used below 1e-6 and from 1e21. Special values are
+ * written as "nan", "inf", and "-inf", and -0 is written as "0".
+ * @param s
+ * @param val - The value to convert.
+ */
+void
+ss_catdouble(SS *s, double val)
+{
+    uint64_t bits;
+    ss_memcopy(&bits, &val, sizeof(bits));
+
+    bool neg = bits >> 63;
+    uint64_t ieee = bits & ((1ull << _SS_DBL_MANTISSA_BITS) - 1);
+    uint32_t ieeeexp = (uint32_t)(bits >> _SS_DBL_MANTISSA_BITS) & 0x7FF;
+
+    if (0x7FF == ieeeexp)
+    {
+        if (ieee)
+        {
+            ss_cat(s, "nan", 3);
+        }
+        else
+        {
+            ss_cat(s, neg ? "-inf" : "inf", 3 + neg);
+        }
+        return;
+    }
+
+    uint64_t digits;
+    int32_t exp;
+
+    if (!ieee && !ieeeexp)
+    {
+        /* Like JavaScript, the sign of zero is not written. */
+        neg = false;
+        digits = 0;
+        exp = 0;
+    }
+    else
+    {
+        int32_t e2 = (int32_t)ieeeexp - _SS_DBL_BIAS - _SS_DBL_MANTISSA_BITS;
+        uint64_t m2 = (1ull << _SS_DBL_MANTISSA_BITS) | ieee;
+
+        if (ieeeexp && e2 <= 0 && e2 >= -_SS_DBL_MANTISSA_BITS
+            && !(m2 & ((1ull << -e2) - 1)))
+        {
+            /* Integers are already exact, only trailing zeros go. */
+            digits = m2 >> -e2;
+            exp = 0;
+            while (!(digits % 10))
+            {
+                digits /= 10;
+                ++exp;
+            }
+        }
+        else
+        {
+            digits = _ss_d2d(ieee, ieeeexp, &exp);
+        }
+    }
+
+    /* The decimal point goes after the first point digits. */
+    int32_t k = (int32_t)_ss_declen(digits);
+    int32_t point = k + exp;
+    size_t len;
+    char *p;
+
+    if (k <= point && point <= 21)
+    {
+        len = (size_t)point + neg;
+        p = _ss_catreserve(s, len);
+        *p = '-';
+        p += neg;
+        _ss_fmtuint64(p + k, digits);
+        ss_memset(p + k, '0', (size_t)(point - k));
+    }
+    else if (0 < point && point <= 21)
+    {
+        len = (size_t)k + 1 + neg;
+        p = _ss_catreserve(s, len);
+        *p = '-';
+        p += neg;
+        _ss_fmtuint64(p + k + 1, digits);
+        ss_memmove(p, p + 1, (size_t)point);
+        p[point] = '.';
+    }
+    else if (-6 < point && point <= 0)
+    {
+        len = (size_t)(2 - point + k) + neg;
+        p = _ss_catreserve(s, len);
+        *p = '-';
+        p += neg;
+        p[0] = '0';
+        p[1] = '.';
+        ss_memset(p + 2, '0', (size_t)-point);
+        _ss_fmtuint64(p + len - neg, digits);
+    }
+    else
+    {
+        int32_t e = point - 1;
+        uint32_t mag = (uint32_t)(e < 0 ? -e : e);
+        size_t elen = _ss_declen(mag);
+
+        len = (size_t)k + (k > 1) + 2 + elen + neg;
+        p = _ss_catreserve(s, len);
+        *p = '-';
+        p += neg;
+        _ss_fmtuint64(p + k + 1, digits);
+        p[0] = p[1];
+        p[1] = '.';
+        p += k + (k > 1);
+        p[0] = 'e';
+        p[1] = e < 0 ? '-' : '+';
+        _ss_fmtuint64(p + 2 + elen, mag);
+    }
+}
+
+/*
+ * Hex and base64.
+ * Output sizes are exact so each call reserves once, then a kernel
+ * writes straight into the string. The vector kernels follow Muła and
+ * Lemire: pshufb looks up digits, multiplies shift the 6 and 4 bit
+ * fields into place, and range compares validate input a vector at a time.
+ * @see https://arxiv.org/abs/1704.00605
+ */
+
+static const char g_ss_b64chars[65] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Value of each base64 digit, 0xFF for everything else. */
+static const unsigned char g_ss_b64vals[256] =
+{
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x3E, 0xFF, 0xFF, 0xFF, 0x3F,
+        0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E,
+        0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32, 0x33, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+typedef struct _ss_codec_ops_s
+{
+    /* Writes 2 * len digits. */
+    void (*hexenc)(char *dst, const unsigned char *src, size_t len);
+    /* Writes len / 2 bytes for an even len; false on a non-digit. */
+    bool (*hexdec)(char *dst, const char *src, size_t len);
+    /* Writes the padded encoding. */
+    void (*b64enc)(char *dst, const unsigned char *src, size_t len);
+    /* Unpadded input with len % 4 not 1; false on a non-digit. */
+    bool (*b64dec)(char *dst, const char *src, size_t len);
+} _ss_codec_ops_t;
+
+/** @return The value of the hex digit, 0xFF if it isn't one. */
+INLINE static unsigned char
+_ss_hexdigit(unsigned char c)
+{
+    unsigned char d = (unsigned char)(c - '0');
+    unsigned char l = (unsigned char)((c | 0x20) - 'a');
+
+    return d < 10 ? d : l < 6 ? (unsigned char)(l + 10) : 0xFF;
+}
+
+static void
+_ss_hexenc_scalar(char *dst, const unsigned char *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i)
+    {
+        dst[2 * i] = _ss_tohexchar(src[i] >> 4);
+        dst[2 * i + 1] = _ss_tohexchar(src[i] & 0x0F);
+    }
+}
+
+static bool
+_ss_hexdec_scalar(char *dst, const char *src, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i += 2)
+    {
+        unsigned char hi = _ss_hexdigit((unsigned char)src[i]);
+        unsigned char lo = _ss_hexdigit((unsigned char)src[i + 1]);
+        if ((hi | lo) & 0x80)
+        {
+            return false;
+        }
+        *dst++ = (char)((hi << 4) | lo);
+    }
+
+    return true;
+}
+
+static void
+_ss_b64enc_scalar(char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 3 <= len; i += 3)
+    {
+        uint32_t v = ((uint32_t)src[i] << 16) | ((uint32_t)src[i + 1] << 8) | src[i + 2];
+        dst[0] = g_ss_b64chars[v >> 18];
+        dst[1] = g_ss_b64chars[(v >> 12) & 0x3F];
+        dst[2] = g_ss_b64chars[(v >> 6) & 0x3F];
+        dst[3] = g_ss_b64chars[v & 0x3F];
+        dst += 4;
+    }
+
+    if (i < len)
+    {
+        uint32_t v = (uint32_t)src[i] << 16;
+        if (i + 2 == len)
+        {
+            v |= (uint32_t)src[i + 1] << 8;
+        }
+        dst[0] = g_ss_b64chars[v >> 18];
+        dst[1] = g_ss_b64chars[(v >> 12) & 0x3F];
+        dst[2] = i + 2 == len ? g_ss_b64chars[(v >> 6) & 0x3F] : '=';
+        dst[3] = '=';
+    }
+}
+
+static bool
+_ss_b64dec_scalar(char *dst, const char *src, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)src;
+    size_t i = 0;
+
+    for (; i + 4 <= len; i += 4)
+    {
+        uint32_t a = g_ss_b64vals[p[i]], b = g_ss_b64vals[p[i + 1]];
+        uint32_t c = g_ss_b64vals[p[i + 2]], d = g_ss_b64vals[p[i + 3]];
+        if ((a | b | c | d) & 0x80)
+        {
+            return false;
+        }
+        uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+        dst[0] = (char)(v >> 16);
+        dst[1] = (char)(v >> 8);
+        dst[2] = (char)v;
+        dst += 3;
+    }
+
+    if (i < len)
+    {
+        uint32_t a = g_ss_b64vals[p[i]], b = g_ss_b64vals[p[i + 1]];
+        uint32_t c = i + 3 == len ? g_ss_b64vals[p[i + 2]] : 0;
+        if ((a | b | c) & 0x80)
+        {
+            return false;
+        }
+        uint32_t v = (a << 18) | (b << 12) | (c << 6);
+        dst[0] = (char)(v >> 16);
+        if (i + 3 == len)
+        {
+            dst[1] = (char)(v >> 8);
+        }
+    }
+
+    return true;
+}
+
+static const _ss_codec_ops_t g_ss_codec_scalar =
+{
+    _ss_hexenc_scalar,
+    _ss_hexdec_scalar,
+    _ss_b64enc_scalar,
+    _ss_b64dec_scalar,
+};
+
+#ifdef _SS_X86
+
+__attribute__((target("ssse3")))
+static void
+_ss_hexenc_ssse3(char *dst, const unsigned char *src, size_t len)
+{
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m128i low = _mm_set1_epi8(0x0F);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), low));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, low));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    _ss_hexenc_scalar(dst + 2 * i, src + i, len - i);
+}
+
+/**
+ * @internal
+ * @return Values of the hex digits; bad gets the bytes that aren't one.
+ */
+__attribute__((target("ssse3")))
+INLINE static __m128i
+_ss_hexvals_ssse3(__m128i v, __m128i *bad)
+{
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isd = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i isl = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+    *bad = _mm_or_si128(*bad, _mm_cmpeq_epi8(_mm_or_si128(isd, isl), _mm_setzero_si128()));
+    return _mm_or_si128(_mm_and_si128(isd, d),
+                        _mm_and_si128(isl, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+__attribute__((target("ssse3")))
+static bool
+_ss_hexdec_ssse3(char *dst, const char *src, size_t len)
+{
+    /* Each pair becomes high * 16 + low. */
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m128i bad = _mm_setzero_si128();
+        __m128i a = _ss_hexvals_ssse3(_mm_loadu_si128((const __m128i *)(src + i)), &bad);
+        __m128i b = _ss_hexvals_ssse3(_mm_loadu_si128((const __m128i *)(src + i + 16)), &bad);
+        if (_mm_movemask_epi8(bad))
+        {
+            return false;
+        }
+        _mm_storeu_si128((__m128i *)(dst + i / 2),
+                         _mm_packus_epi16(_mm_maddubs_epi16(a, weights),
+                                          _mm_maddubs_epi16(b, weights)));
+    }
+
+    return _ss_hexdec_scalar(dst + i / 2, src + i, len - i);
+}
+
+/** @return The 6 bit fields of 12 bytes, one per byte. */
+__attribute__((target("ssse3")))
+INLINE static __m128i
+_ss_b64split_ssse3(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00)),
+                                 _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003F03F0)),
+                                 _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+/** @return The base64 digits of 6 bit values. */
+__attribute__((target("ssse3")))
+INLINE static __m128i
+_ss_b64digits_ssse3(__m128i idx)
+{
+    /* 0..51 to 0, 52..61 to 1..10, 62 to 11, 63 to 12, then 0..25 to 13. */
+    __m128i r = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx), _mm_set1_epi8(13)));
+    const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(idx, _mm_shuffle_epi8(shift, r));
+}
+
+__attribute__((target("ssse3")))
+static void
+_ss_b64enc_ssse3(char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+
+    /* Each load reads 16 bytes and encodes 12. */
+    for (; i + 16 <= len; i += 12)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)dst, _ss_b64digits_ssse3(_ss_b64split_ssse3(in)));
+        dst += 16;
+    }
+
+    _ss_b64enc_scalar(dst, src + i, len - i);
+}
+
+/**
+ * @internal
+ * @return The 6 bit values of base64 digits; bad gets the bytes that aren't one.
+ */
+__attribute__((target("ssse3")))
+INLINE static __m128i
+_ss_b64vals_ssse3(__m128i v, __m128i *bad)
+{
+    __m128i upper = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+    __m128i lower = _mm_sub_epi8(v, _mm_set1_epi8('a'));
+    __m128i digit = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i isup = _mm_cmpeq_epi8(_mm_min_epu8(upper, _mm_set1_epi8(25)), upper);
+    __m128i islow = _mm_cmpeq_epi8(_mm_min_epu8(lower, _mm_set1_epi8(25)), lower);
+    __m128i isdig = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i isplus = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+    __m128i isslash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+
+    __m128i shift = _mm_and_si128(isup, _mm_set1_epi8(-'A'));
+    shift = _mm_or_si128(shift, _mm_and_si128(islow, _mm_set1_epi8(26 - 'a')));
+    shift = _mm_or_si128(shift, _mm_and_si128(isdig, _mm_set1_epi8(52 - '0')));
+    shift = _mm_or_si128(shift, _mm_and_si128(isplus, _mm_set1_epi8(62 - '+')));
+    shift = _mm_or_si128(shift, _mm_and_si128(isslash, _mm_set1_epi8(63 - '/')));
+
+    __m128i ok = _mm_or_si128(_mm_or_si128(isup, islow),
+                              _mm_or_si128(isdig, _mm_or_si128(isplus, isslash)));
+    *bad = _mm_or_si128(*bad, _mm_cmpeq_epi8(ok, _mm_setzero_si128()));
+    return _mm_add_epi8(v, shift);
+}
+
+/** @return 16 values of 6 bits packed into the low 12 bytes. */
+__attribute__((target("ssse3")))
+INLINE static __m128i
+_ss_b64pack_ssse3(__m128i vals)
+{
+    __m128i pairs = _mm_maddubs_epi16(vals, _mm_set1_epi32(0x01400140));
+    __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(quads, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                                 -1, -1, -1, -1));
+}
+
+__attribute__((target("ssse3")))
+static bool
+_ss_b64dec_ssse3(char *dst, const char *src, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i bad = _mm_setzero_si128();
+        __m128i vals = _ss_b64vals_ssse3(_mm_loadu_si128((const __m128i *)(src + i)), &bad);
+        if (_mm_movemask_epi8(bad))
+        {
+            return false;
+        }
+        __m128i out = _ss_b64pack_ssse3(vals);
+        uint32_t last = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(out, 8));
+        _mm_storel_epi64((__m128i *)dst, out);
+        ss_memcopy(dst + 8, &last, 4);
+        dst += 12;
+    }
+
+    return _ss_b64dec_scalar(dst, src + i, len - i);
+}
+
+static const _ss_codec_ops_t g_ss_codec_ssse3 =
+{
+    _ss_hexenc_ssse3,
+    _ss_hexdec_ssse3,
+    _ss_b64enc_ssse3,
+    _ss_b64dec_ssse3,
+};
+
+__attribute__((target("avx2")))
+static void
+_ss_hexenc_avx2(char *dst, const unsigned char *src, size_t len)
+{
+    const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                            '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+                                            '0', '1', '2', '3', '4', '5', '6', '7',
+                                            '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, low));
+        /* The unpacks work per lane, so each half holds bytes 0-7 and 16-23 or 8-15 and 24-31. */
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    _ss_hexenc_scalar(dst + 2 * i, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_hexvals_avx2(__m256i v, __m256i *bad)
+{
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    __m256i l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isd = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+    __m256i isl = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+    *bad = _mm256_or_si256(*bad, _mm256_cmpeq_epi8(_mm256_or_si256(isd, isl), _mm256_setzero_si256()));
+    return _mm256_or_si256(_mm256_and_si256(isd, d),
+                           _mm256_and_si256(isl, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+static bool
+_ss_hexdec_avx2(char *dst, const char *src, size_t len)
+{
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64)
+    {
+        __m256i bad = _mm256_setzero_si256();
+        __m256i a = _ss_hexvals_avx2(_mm256_loadu_si256((const __m256i *)(src + i)), &bad);
+        __m256i b = _ss_hexvals_avx2(_mm256_loadu_si256((const __m256i *)(src + i + 32)), &bad);
+        if (_mm256_movemask_epi8(bad))
+        {
+            return false;
+        }
+        __m256i out = _mm256_packus_epi16(_mm256_maddubs_epi16(a, weights),
+                                          _mm256_maddubs_epi16(b, weights));
+        _mm256_storeu_si256((__m256i *)(dst + i / 2), _mm256_permute4x64_epi64(out, 0xD8));
+    }
+
+    return _ss_hexdec_scalar(dst + i / 2, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_b64split_avx2(__m256i in)
+{
+    in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00)),
+                                    _mm256_set1_epi32(0x04000040));
+    __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0)),
+                                    _mm256_set1_epi32(0x01000010));
+    return _mm256_or_si256(t0, t1);
+}
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_b64digits_avx2(__m256i idx)
+{
+    __m256i r = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    r = _mm256_or_si256(r, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx),
+                                            _mm256_set1_epi8(13)));
+    const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm256_add_epi8(idx, _mm256_shuffle_epi8(shift, r));
+}
+
+__attribute__((target("avx2")))
+static void
+_ss_b64enc_avx2(char *dst, const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+
+    /* Each lane gets its own 12 bytes. */
+    for (; i + 28 <= len; i += 24)
+    {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + i))),
+            _mm_loadu_si128((const __m128i *)(src + i + 12)), 1);
+        _mm256_storeu_si256((__m256i *)dst, _ss_b64digits_avx2(_ss_b64split_avx2(in)));
+        dst += 32;
+    }
+
+    _ss_b64enc_scalar(dst, src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_b64vals_avx2(__m256i v, __m256i *bad)
+{
+    __m256i upper = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+    __m256i lower = _mm256_sub_epi8(v, _mm256_set1_epi8('a'));
+    __m256i digit = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    __m256i isup = _mm256_cmpeq_epi8(_mm256_min_epu8(upper, _mm256_set1_epi8(25)), upper);
+    __m256i islow = _mm256_cmpeq_epi8(_mm256_min_epu8(lower, _mm256_set1_epi8(25)), lower);
+    __m256i isdig = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i isplus = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('+'));
+    __m256i isslash = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('/'));
+
+    __m256i shift = _mm256_and_si256(isup, _mm256_set1_epi8(-'A'));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(islow, _mm256_set1_epi8(26 - 'a')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(isdig, _mm256_set1_epi8(52 - '0')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(isplus, _mm256_set1_epi8(62 - '+')));
+    shift = _mm256_or_si256(shift, _mm256_and_si256(isslash, _mm256_set1_epi8(63 - '/')));
+
+    __m256i ok = _mm256_or_si256(_mm256_or_si256(isup, islow),
+                                 _mm256_or_si256(isdig, _mm256_or_si256(isplus, isslash)));
+    *bad = _mm256_or_si256(*bad, _mm256_cmpeq_epi8(ok, _mm256_setzero_si256()));
+    return _mm256_add_epi8(v, shift);
+}
+
+__attribute__((target("avx2")))
+static bool
+_ss_b64dec_avx2(char *dst, const char *src, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i bad = _mm256_setzero_si256();
+        __m256i vals = _ss_b64vals_avx2(_mm256_loadu_si256((const __m256i *)(src + i)), &bad);
+        if (_mm256_movemask_epi8(bad))
+        {
+            return false;
+        }
+        __m256i pairs = _mm256_maddubs_epi16(vals, _mm256_set1_epi32(0x01400140));
+        __m256i quads = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000));
+        __m256i out = _mm256_shuffle_epi8(quads, _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        /* Close the gap between the 12 bytes of each lane. */
+        out = _mm256_permutevar8x32_epi32(out, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(out));
+        _mm_storel_epi64((__m128i *)(dst + 16), _mm256_extracti128_si256(out, 1));
+        dst += 24;
+    }
+
+    return _ss_b64dec_scalar(dst, src + i, len - i);
+}
+
+static const _ss_codec_ops_t g_ss_codec_avx2 =
+{
+    _ss_hexenc_avx2,
+    _ss_hexdec_avx2,
+    _ss_b64enc_avx2,
+    _ss_b64dec_avx2,
+};
+
+#endif /* _SS_X86 */
+
+/* NULL until the first call picks the kernels. */
+static const _ss_codec_ops_t *g_ss_codec_ops;
+
+/**
+ * @internal
+ * @return The hex and base64 kernels for this CPU.
+ */
+INLINE static const _ss_codec_ops_t *
+_ss_codec(void)
+{
+    const _ss_codec_ops_t *ops = __atomic_load_n(&g_ss_codec_ops, __ATOMIC_RELAXED);
+
+    if (UNLIKELY(!ops))
+    {
+        ops = &g_ss_codec_scalar;
+#ifdef _SS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            ops = &g_ss_codec_avx2;
+        }
+        else if (__builtin_cpu_supports("ssse3"))
+        {
+            ops = &g_ss_codec_ssse3;
+        }
+#endif
+        __atomic_store_n(&g_ss_codec_ops, ops, __ATOMIC_RELAXED);
+    }
+
+    return ops;
+}
+
+/**
+ * @internal
+ * @brief Drop the bytes a failed decode reserved.
+ * @return False.
+ */
+INLINE static bool
+_ss_decode_fail(SS s, size_t slen)
+{
+    s[slen] = 0;
+    _ss_setlen(s, slen);
+    return false;
+}
+
+/**
+ * @brief Append the bytes as uppercase hexadecimal, two digits per byte.
+ * @param s
+ * @param src - The bytes to encode, which must not be inside s.
+ * @param len - The number of bytes.
+ */
+void
+ss_hexencode(SS *s, const char *src, size_t len)
+{
+    char *p = _ss_catreserve(s, 2 * len);
+    _ss_codec()->hexenc(p, (const unsigned char *)src, len);
+}
+
+/**
+ * @brief Append the bytes that the hexadecimal digits encode.
+ * @note Upper and lowercase digits are accepted.
+ * @param s
+ * @param src - The digits, which must not be inside s.
+ * @param len - The number of digits.
+ * @return False for an odd length or a non-digit, the string is unchanged.
+ */
+bool
+ss_hexdecode(SS *s, const char *src, size_t len)
+{
+    if (len & 1)
+    {
+        return false;
+    }
+
+    size_t slen = _ss_len(*s);
+    char *p = _ss_catreserve(s, len / 2);
+    if (!_ss_codec()->hexdec(p, src, len))
+    {
+        return _ss_decode_fail(*s, slen);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Append the bytes in padded base64 (RFC 4648).
+ * @param s
+ * @param src - The bytes to encode, which must not be inside s.
+ * @param len - The number of bytes.
+ */
+void
+ss_b64encode(SS *s, const char *src, size_t len)
+{
+    char *p = _ss_catreserve(s, (len + 2) / 3 * 4);
+    _ss_codec()->b64enc(p, (const unsigned char *)src, len);
+}
+
+/**
+ * @brief Append the bytes that the base64 (RFC 4648) digits encode.
+ * @note Padding is optional; whitespace and the URL alphabet are rejected.
+ * @param s
+ * @param src - The digits, which must not be inside s.
+ * @param len - The number of digits.
+ * @return False for invalid input, the string is unchanged.
+ */
+bool
+ss_b64decode(SS *s, const char *src, size_t len)
+{
+    if (len && !(len % 4))
+    {
+        len -= '=' == src[len - 1];
+        len -= '=' == src[len - 1];
+    }
+
+    if (1 == len % 4)
+    {
+        return false;
+    }
+
+    size_t slen = _ss_len(*s);
+    char *p = _ss_catreserve(s, len / 4 * 3 + (len % 4 ? len % 4 - 1 : 0));
+    if (!_ss_codec()->b64dec(p, src, len))
+    {
+        return _ss_decode_fail(*s, slen);
+    }
+
+    return true;
+}
+
+/*
+ * Builder.
+ * Appends fill fixed-size chunks and never move bytes already written,
+ * so building a large string costs one copy instead of one per reallocation.
+ */
+
+#define _SS_BUILDER_CHUNK (64 * 1024)
+#define _SS_BUILDER_IOV (64)
+#define _SS_BUILDER_SCRATCH (256)
+
+typedef struct _ss_chunk_s
+{
+    struct _ss_chunk_s *next;
+    size_t len;
+    size_t cap;
+} _ss_chunk_t;
+
+struct ss_builder_s
+{
+    /* Allocator the chunks came from. */
+    const ss_allocator_t *alloc;
+    _ss_chunk_t *head;
+    /* Chunk being appended to, chunks after it are empty. */
+    _ss_chunk_t *tail;
+    size_t len;
+    size_t chunksize;
+};
+
+/**
+ * @internal
+ * @return Allocated, but not linked, chunk with the given capacity.
+ */
+static _ss_chunk_t *
+_ss_chunk_new(const ss_allocator_t *a, size_t cap)
+{
+    size_t bytes = sizeof(_ss_chunk_t) + cap;
+    _ss_chunk_t *c = a->alloc(a->ctx, bytes);
+    if (UNLIKELY(!c))
+    {
+        _ss_abort(true, bytes);
+    }
+    c->next = NULL;
+    c->len = 0;
+    c->cap = cap;
+    return c;
+}
+
+INLINE static char *
+_ss_chunk_data(const _ss_chunk_t *c)
+{
+    return (char *)(c + 1);
+}
+
+/**
+ * @internal
+ * @brief Move the tail to a chunk with at least min bytes free.
+ * @note Reuses the next chunk if big enough, otherwise links a new one after
+ *       the tail; any space left in the old tail is skipped.
+ */
+static _ss_chunk_t *
+_ss_builder_next(ss_builder_t *b, size_t min)
+{
+    _ss_chunk_t *next = b->tail->next;
+
+    if (!next || next->cap < min)
+    {
+        next = _ss_chunk_new(b->alloc, min > b->chunksize ? min : b->chunksize);
+        next->next = b->tail->next;
+        b->tail->next = next;
+    }
+
+    b->tail = next;
+    return next;
+}
+
+/**
+ * @brief Create a builder for assembling large strings.
+ * @note The chunks come from the global allocator.
+ * @param chunksize - Size of each chunk; zero for the default (64KiB).
+ * @return New builder.
+ */
+ss_builder_t *
+ss_builder_new(size_t chunksize)
+{
+    const ss_allocator_t *a = g_ss_allocator;
+    ss_builder_t *b = a->alloc(a->ctx, sizeof(ss_builder_t));
+    if (UNLIKELY(!b))
+    {
+        _ss_abort(true, sizeof(ss_builder_t));
+    }
+
+    b->alloc = a;
+    b->chunksize = chunksize ? chunksize : _SS_BUILDER_CHUNK;
+    b->head = _ss_chunk_new(a, b->chunksize);
+    b->tail = b->head;
+    b->len = 0;
+
+    return b;
+}
+
+/**
+ * @brief Free the builder and all of its chunks.
+ * @param b
+ */
+void
+ss_builder_free(ss_builder_t **b)
+{
+    const ss_allocator_t *a = (*b)->alloc;
+    _ss_chunk_t *c = (*b)->head;
+
+    while (c)
+    {
+        _ss_chunk_t *next = c->next;
+        a->free(a->ctx, c);
+        c = next;
+    }
+
+    a->free(a->ctx, *b);
+    *b = NULL;
+}
+
+/**
+ * @brief Empty the builder.
+ * @note Chunks are kept for reuse; use ss_builder_free to return memory.
+ * @param b
+ */
+void
+ss_builder_reset(ss_builder_t *b)
+{
+    _ss_chunk_t *c;
+
+    for (c = b->head; c; c = c->next)
+    {
+        c->len = 0;
+    }
+    b->tail = b->head;
+    b->len = 0;
+}
+
+/**
+ * @return Number of bytes appended.
+ */
+size_t
+ss_builder_len(const ss_builder_t *b)
+{
+    return b->len;
+}
+
+/**
+ * @brief Append bytes, filling the current chunk before starting another.
+ * @param b
+ * @param cs - The bytes to append.
+ * @param len - Length of `cs`.
+ */
+void
+ss_builder_append(ss_builder_t *b, const char *cs, size_t len)
+{
+    _ss_chunk_t *c = b->tail;
+
+    b->len += len;
+
+    for (;;)
+    {
+        size_t avail = c->cap - c->len;
+        size_t n = len < avail ? len : avail;
+
+        ss_memcopy(_ss_chunk_data(c) + c->len, cs, n);
+        c->len += n;
+        cs += n;
+        len -= n;
+
+        if (!len)
+        {
+            break;
+        }
+
+        c = _ss_builder_next(b, len);
+    }
+}
+
+/**
+ * @brief Append formatted output.
+ * @note Output that doesn't fit in the current chunk is formatted again,
+ *       short output through a scratch buffer and long output into a
+ *       new chunk of its own.
+ * @param b
+ * @param fmt - The format string.
+ * @return Zero on success; EINVAL if formatting failed.
+ */
+int
+ss_builder_appendf(ss_builder_t *b, const char *fmt, ...)
+{
+    va_list args;
+    va_list ap;
+    _ss_chunk_t *c = b->tail;
+    size_t avail = c->cap - c->len;
+    int n;
+
+    va_start(args, fmt);
+
+    /* vsnprintf always writes a terminator, so one byte of room is lost. */
+    va_copy(ap, args);
+    n = ss_vsnprintf(_ss_chunk_data(c) + c->len, avail, fmt, ap);
+    va_end(ap);
+
+    if (_ss_catf_failed(n))
+    {
+        va_end(args);
+        return EINVAL;
+    }
+
+    if (n >= 0 && (size_t)n < avail)
+    {
+        c->len += (size_t)n;
+        b->len += (size_t)n;
+        va_end(args);
+        return 0;
+    }
+
+    if (n < 0)
+    {
+        /* Old libraries don't say how much is needed, so measure. */
+        va_copy(ap, args);
+        n = ss_vsnprintf(NULL, 0, fmt, ap);
+        va_end(ap);
+
+        if (n < 0)
+        {
+            va_end(args);
+            return EINVAL;
+        }
+    }
+
+    if ((size_t)n < _SS_BUILDER_SCRATCH)
+    {
+        char scratch[_SS_BUILDER_SCRATCH];
+
+        va_copy(ap, args);
+        ss_vsnprintf(scratch, sizeof(scratch), fmt, ap);
+        va_end(ap);
+
+        ss_builder_append(b, scratch, (size_t)n);
+    }
+    else
+    {
+        c = _ss_builder_next(b, (size_t)n + 1);
+
+        va_copy(ap, args);
+        ss_vsnprintf(_ss_chunk_data(c), (size_t)n + 1, fmt, ap);
+        va_end(ap);
+
+        c->len = (size_t)n;
+        b->len += (size_t)n;
+    }
+
+    va_end(args);
+    return 0;
+}
+
+/**
+ * @brief Append the signed integral value in decimal.
+ * @param b
+ * @param val - The value to convert.
+ */
+void
+ss_builder_appendint(ss_builder_t *b, int64_t val)
+{
+    char buf[32];
+    char *end = buf + sizeof(buf);
+    char *p;
+
+    if (val < 0)
+    {
+        p = _ss_fmtuint64(end, (uint64_t)0 - (uint64_t)val);
+        *--p = '-';
+    }
+    else
+    {
+        p = _ss_fmtuint64(end, (uint64_t)val);
+    }
+
+    ss_builder_append(b, p, (size_t)(end - p));
+}
+
+/**
+ * @brief Append the unsigned integral value in decimal.
+ * @param b
+ * @param val - The value to convert.
+ */
+void
+ss_builder_appenduint(ss_builder_t *b, uint64_t val)
+{
+    char buf[32];
+    char *end = buf + sizeof(buf);
+    char *p = _ss_fmtuint64(end, val);
+
+    ss_builder_append(b, p, (size_t)(end - p));
+}
+
+/**
+ * @brief Copy everything appended into a new string and reset the builder.
+ * @note The string is allocated once at its final size.
+ * @param b
+ * @return New string.
+ */
+SS
+ss_builder_finish(ss_builder_t *b)
+{
+    SS s = ss_new(b->len);
+    char *p = s;
+    const _ss_chunk_t *c;
+
+    for (c = b->head; c; c = c->next)
+    {
+        ss_memcopy(p, _ss_chunk_data(c), c->len);
+        p += c->len;
+    }
+
+    _ss_setlen(s, b->len);
+    s[b->len] = 0;
+
+    ss_builder_reset(b);
+
+    return s;
+}
+
+/**
+ * @brief Write everything appended to the file descriptor without copying.
+ * @note Resumes after partial writes and retries EINTR, like ss_writev.
+ *       For non-blocking descriptors EAGAIN is returned with the cursor at
+ *       the first unwritten byte, call again with the same cursor once
+ *       writable. The builder is left unchanged.
+ * @param b
+ * @param fd - The file descriptor.
+ * @param cur - Chunk and offset to start at, updated as bytes are written;
+ *              NULL to write everything.
+ * @return Zero once everything is written; errno from writev on failure.
+ */
+int
+ss_builder_writev(const ss_builder_t *b, int fd, ss_wcursor_t *cur)
+{
+    const _ss_chunk_t *c = b->head;
+    size_t index = cur ? cur->index : 0;
+    size_t off = cur ? cur->offset : 0;
+    size_t i;
+    int err = 0;
+
+    for (i = 0; c && i < index; ++i)
+    {
+        c = c->next;
+    }
+
+    for (;;)
+    {
+        struct iovec iov[_SS_BUILDER_IOV];
+        const _ss_chunk_t *it = c;
+        size_t skip = off;
+        int count = 0;
+
+        while (it && count < _SS_BUILDER_IOV)
+        {
+            if (it->len > skip)
+            {
+                iov[count].iov_base = _ss_chunk_data(it) + skip;
+                iov[count].iov_len = it->len - skip;
+                ++count;
+            }
+            skip = 0;
+            it = it->next;
+        }
+
+        if (!count)
+        {
+            /* Anything left is empty. */
+            for (; c; c = c->next)
+            {
+                ++index;
+            }
+            off = 0;
+            break;
+        }
+
+        ssize_t n = writev(fd, iov, count);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            err = errno;
+            break;
+        }
+
+        /* Skip past what was written. */
+        size_t done = (size_t)n;
+        while (c && done >= c->len - off)
+        {
+            done -= c->len - off;
+            off = 0;
+            c = c->next;
+            ++index;
+        }
+        off += done;
+    }
+
+    if (cur)
+    {
+        cur->index = index;
+        cur->offset = off;
+    }
+    return err;
+}
+
+/*
+ * File descriptor I/O.
+ * Reads land directly in the string's spare capacity and writes hand
+ * the strings to the kernel as they are, so nothing is staged in between.
+ */
+
+#define _SS_READ_CHUNK (4096)
+#define _SS_WRITE_IOV (64)
+
+/**
+ * @internal
+ * @brief Make room for a read of up to max bytes at the end of the string.
+ * @return Bytes of room, zero if the string is at its maximum length.
+ */
+static size_t
+_ss_readroom(SS *s, size_t max)
+{
+    size_t len = _ss_len(*s);
+    size_t avail = _ss_cap(*s) - len;
+
+    _ss_detach(s);
+
+    if (!max)
+    {
+        /* Use what's reserved, or a chunk if nothing is. */
+        max = avail ? avail : _SS_READ_CHUNK;
+    }
+    if (max > _ss_cap_max() - len)
+    {
+        max = _ss_cap_max() - len;
+    }
+    if (max > avail)
+    {
+        *s = _ss_realloc_grow(*s, len + max);
+    }
+
+    return max;
+}
+
+/**
+ * @internal
+ * @brief Advance the length after n bytes were read into the tail.
+ */
+INLINE static ssize_t
+_ss_readdone(SS s, ssize_t n)
+{
+    if (n > 0)
+    {
+        size_t len = _ss_len(s) + (size_t)n;
+        _ss_setlen(s, len);
+        s[len] = 0;
+    }
+    return n;
+}
+
+/**
+ * @brief Read once from the file descriptor, appending directly
+ *        into the string's capacity.
+ * @note EINTR is retried. The string grows per its growth option when
+ *       there isn't room for max bytes.
+ * @param s
+ * @param fd - The file descriptor.
+ * @param max - Most bytes to read; zero for the reserved capacity
+ *              (see ss_reserve/ss_addcap), or 4KiB if none is reserved.
+ * @return Bytes read; zero at end of file; -1 with errno set on error.
+ */
+ssize_t
+ss_catread(SS *s, int fd, size_t max)
+{
+    ssize_t n;
+
+    max = _ss_readroom(s, max);
+    do
+    {
+        n = read(fd, *s + _ss_len(*s), max);
+    } while (n < 0 && EINTR == errno);
+
+    return _ss_readdone(*s, n);
+}
+
+/**
+ * @brief Like ss_catread, but recv(2) with flags from a socket.
+ * @param s
+ * @param fd - The socket.
+ * @param max - Most bytes to read; zero as with ss_catread.
+ * @param flags - Flags for recv, e.g. MSG_DONTWAIT.
+ * @return Bytes read; zero when the peer has shut down; -1 with errno set on error.
+ */
+ssize_t
+ss_catrecv(SS *s, int fd, size_t max, int flags)
+{
+    ssize_t n;
+
+    max = _ss_readroom(s, max);
+    do
+    {
+        n = recv(fd, *s + _ss_len(*s), max, flags);
+    } while (n < 0 && EINTR == errno);
+
+    return _ss_readdone(*s, n);
+}
+
+/**
+ * @brief Replace the string with everything read from the file
+ *        descriptor up to end of file.
+ * @note Regular files are sized up front so they're read with one allocation.
+ * @param s
+ * @param fd - The file descriptor.
+ * @return Zero on success; errno on failure, keeping what was read.
+ */
+int
+ss_readfd(SS *s, int fd)
+{
+    _ss_detach(s);
+
+    struct stat st;
+
+    ss_clear(*s);
+
+    /* One extra byte so end of file is seen without growing. */
+    if (0 == fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0
+        && (size_t)st.st_size + 1 > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, (size_t)st.st_size + 1);
+    }
+
+    for (;;)
+    {
+        size_t avail = _ss_cap(*s) - _ss_len(*s);
+        ssize_t n = ss_catread(s, fd, avail ? avail : _SS_READ_CHUNK);
+
+        if (n < 0)
+        {
+            return errno;
+        }
+        if (0 == n)
+        {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Write the string to the file descriptor.
+ * @note Resumes after partial writes and retries EINTR. For non-blocking
+ *       descriptors EAGAIN is returned with offset at the first unwritten
+ *       byte, call again with the same offset once writable.
+ * @param s
+ * @param fd - The file descriptor.
+ * @param offset - Bytes already written, updated as bytes are written;
+ *                 NULL to write the whole string.
+ * @return Zero once everything is written; errno on failure.
+ */
+int
+ss_writefd(const SS s, int fd, size_t *offset)
+{
+    size_t len = _ss_len(s);
+    size_t off = offset ? *offset : 0;
+    int err = 0;
+
+    while (off < len)
+    {
+        ssize_t n = write(fd, s + off, len - off);
+        if (n < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            err = errno;
+            break;
+        }
+        off += (size_t)n;
+    }
+
+    if (offset)
+    {
+        *offset = off;
+    }
+    return err;
+}
+
+/**
+ * @brief Write an array of strings with writev, without coalescing them.
+ * @note Resumes after partial writes and retries EINTR. For non-blocking
+ *       descriptors EAGAIN is returned with the cursor at the first
+ *       unwritten byte, call again with the same cursor once writable.
+ * @param v - The strings.
+ * @param n - Number of strings.
+ * @param fd - The file descriptor.
+ * @param cur - Where to start, updated as bytes are written;
+ *              NULL to write everything.
+ * @return Zero once everything is written; errno on failure.
+ */
+int
+ss_writev(const SS *v, size_t n, int fd, ss_wcursor_t *cur)
+{
+    size_t index = cur ? cur->index : 0;
+    size_t off = cur ? cur->offset : 0;
+    int err = 0;
+
+    for (;;)
+    {
+        struct iovec iov[_SS_WRITE_IOV];
+        size_t skip = off;
+        size_t i;
+        int count = 0;
+
+        for (i = index; i < n && count < _SS_WRITE_IOV; ++i)
+        {
+            size_t len = _ss_len(v[i]);
+            if (len > skip)
+            {
+                iov[count].iov_base = v[i] + skip;
+                iov[count].iov_len = len - skip;
+                ++count;
+            }
+            skip = 0;
+        }
+
+        if (!count)
+        {
+            /* Anything left is empty. */
+            index = n;
+            off = 0;
+            break;
+        }
+
+        ssize_t w = writev(fd, iov, count);
+        if (w < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            err = errno;
+            break;
+        }
+
+        /* Skip past what was written. */
+        size_t done = (size_t)w;
+        while (index < n && done >= _ss_len(v[index]) - off)
+        {
+            done -= _ss_len(v[index]) - off;
+            off = 0;
+            ++index;
+        }
+        off += done;
+    }
+
+    if (cur)
+    {
+        cur->index = index;
+        cur->offset = off;
+    }
+    return err;
+}
+
+/**
+ * @internal
+ * @brief Map the open file as a string.
+ * @return New mapped string; NULL with errno set on failure.
+ */
+static SS
+_ss_mapfd(int fd)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+    {
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if ((uint64_t)st.st_size > (uint64_t)_ss_cap_max())
+    {
+        errno = EFBIG;
+        return NULL;
+    }
+
+    size_t len = (size_t)st.st_size;
+    size_t page = _ss_pagesize();
+    size_t size = _ss_map_size(len);
+
+    /* Reserve the header page, the file, and zeros for the sentinel. */
+    char *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == base)
+    {
+        return NULL;
+    }
+
+    if (len)
+    {
+        int flags = MAP_PRIVATE | MAP_FIXED;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+        if (MAP_FAILED == mmap(base + page, len, PROT_READ | PROT_WRITE, flags, fd, 0))
+        {
+            int err = errno;
+            munmap(base, size);
+            errno = err;
+            return NULL;
+        }
+        madvise(base + page, len, MADV_SEQUENTIAL);
+    }
+
+    _sstring_t *m = (_sstring_t *)(base + page - sizeof(_sstring_t));
+    m->cap = len;
+    m->len = len;
+    m->type = _SSTRING_MAPPED;
+    m->hdr = _SS_HDR_FULL;
+
+    return _ss_string(m);
+}
+
+/**
+ * @brief Map a file as a string, without copying it.
+ * @note Queries run directly on the mapping. Writes in place are private
+ *       to the string, anything that grows it first copies it to the heap.
+ *       ss_free unmaps the file.
+ * @param path - The file to map.
+ * @return New mapped string; NULL with errno set on failure.
+ */
+SS
+ss_mapfile(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    SS s = _ss_mapfd(fd);
+
+    int err = errno;
+    close(fd);
+    errno = err;
+
+    return s;
+}
+
+/*
+ * Escaping.
+ * A kernel finds the next byte that needs an escape so clean runs are
+ * skipped a vector at a time. One pass counts the output, then the
+ * string is rewritten in place from the back, moving each clean run once.
+ * C escapes cover the controls, DEL, backslash, and both quotes.
+ * JSON escapes cover the controls, backslash, and the double quote.
+ * Unescaping uses the same scan to hop between backslashes.
+ */
+
+typedef struct _ss_esc_ops_s
+{
+    /* Index of the first byte needing an escape; len if none. */
+    size_t (*find)(const char *s, size_t len, bool json);
+    /* Index of the last byte needing an escape; NPOS if none. */
+    size_t (*rfind)(const char *s, size_t len, bool json);
+    /* Index of the first backslash or null byte; len if none. */
+    size_t (*unesc)(const char *s, size_t len);
+} _ss_esc_ops_t;
+
+INLINE static bool
+_ss_esc_needed(unsigned char c, bool json)
+{
+    return c < 0x20 || '\\' == c || '"' == c || (!json && ('\'' == c || 0x7F == c));
+}
+
+/**
+ * @internal
+ * @return The high bit set in each byte of the word that may need an escape.
+ * @note Borrows can flag a clean byte above one that needs an escape.
+ */
+INLINE static uint64_t
+_ss_esc_swar(uint64_t x, bool json)
+{
+    uint64_t bs = x ^ (_SS_SWAR_ONES * '\\');
+    uint64_t dq = x ^ (_SS_SWAR_ONES * '"');
+    uint64_t m = ((x - _SS_SWAR_ONES * 0x20) & ~x)
+                 | ((bs - _SS_SWAR_ONES) & ~bs)
+                 | ((dq - _SS_SWAR_ONES) & ~dq);
+
+    if (!json)
+    {
+        uint64_t sq = x ^ (_SS_SWAR_ONES * '\'');
+        uint64_t del = x ^ (_SS_SWAR_ONES * 0x7F);
+        m |= ((sq - _SS_SWAR_ONES) & ~sq) | ((del - _SS_SWAR_ONES) & ~del);
+    }
+
+    return m & _SS_SWAR_HIGH;
+}
+
+static size_t
+_ss_esc_find_scalar(const char *s, size_t len, bool json)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t x;
+        ss_memcopy(&x, s + i, 8);
+        if (_ss_esc_swar(x, json))
+        {
+            break;
+        }
+    }
+
+    for (; i < len; ++i)
+    {
+        if (_ss_esc_needed((unsigned char)s[i], json))
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+static size_t
+_ss_esc_rfind_scalar(const char *s, size_t len, bool json)
+{
+    size_t i = len;
+
+    for (; i >= 8; i -= 8)
+    {
+        uint64_t x;
+        ss_memcopy(&x, s + i - 8, 8);
+        if (_ss_esc_swar(x, json))
+        {
+            break;
+        }
+    }
+
+    while (i)
+    {
+        --i;
+        if (_ss_esc_needed((unsigned char)s[i], json))
+        {
+            return i;
+        }
+    }
+
+    return NPOS;
+}
+
+static size_t
+_ss_unesc_find_scalar(const char *s, size_t len)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t x, bs;
+        ss_memcopy(&x, s + i, 8);
+        bs = x ^ (_SS_SWAR_ONES * '\\');
+        if ((((x - _SS_SWAR_ONES) & ~x) | ((bs - _SS_SWAR_ONES) & ~bs)) & _SS_SWAR_HIGH)
+        {
+            break;
+        }
+    }
+
+    for (; i < len && s[i] && '\\' != s[i]; ++i)
+    {
+    }
+
+    return i;
+}
+
+static const _ss_esc_ops_t g_ss_esc_scalar =
+{
+    _ss_esc_find_scalar,
+    _ss_esc_rfind_scalar,
+    _ss_unesc_find_scalar,
+};
+
+#ifdef _SS_X86
+
+/** @return Mask of the bytes needing an escape, q1 and q2 are the extra quotes. */
+__attribute__((target("sse2")))
+INLINE static unsigned int
+_ss_esc_mask_sse2(__m128i v, __m128i q1, __m128i q2)
+{
+    const __m128i ctl = _mm_set1_epi8(0x1F);
+    __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v);
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, q1));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, q2));
+    return (unsigned int)_mm_movemask_epi8(m);
+}
+
+/*
+ * The last vector overlaps bytes already known to be clean,
+ * so the first or last set bit is still the answer.
+ */
+__attribute__((target("sse2")))
+static size_t
+_ss_esc_find_sse2(const char *s, size_t len, bool json)
+{
+    const __m128i q1 = _mm_set1_epi8(json ? '"' : '\'');
+    const __m128i q2 = _mm_set1_epi8(json ? '"' : 0x7F);
+    unsigned int mask;
+    size_t i = 0;
+
+    if (len < 16)
+    {
+        return _ss_esc_find_scalar(s, len, json);
+    }
+
+    for (; i + 16 <= len; i += 16)
+    {
+        mask = _ss_esc_mask_sse2(_mm_loadu_si128((const __m128i *)(s + i)), q1, q2);
+        if (mask)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    if (i == len)
+    {
+        return len;
+    }
+
+    i = len - 16;
+    mask = _ss_esc_mask_sse2(_mm_loadu_si128((const __m128i *)(s + i)), q1, q2);
+    return mask ? i + (size_t)__builtin_ctz(mask) : len;
+}
+
+__attribute__((target("sse2")))
+static size_t
+_ss_esc_rfind_sse2(const char *s, size_t len, bool json)
+{
+    const __m128i q1 = _mm_set1_epi8(json ? '"' : '\'');
+    const __m128i q2 = _mm_set1_epi8(json ? '"' : 0x7F);
+    unsigned int mask;
+    size_t i = len;
+
+    if (len < 16)
+    {
+        return _ss_esc_rfind_scalar(s, len, json);
+    }
+
+    for (; i >= 16; i -= 16)
+    {
+        mask = _ss_esc_mask_sse2(_mm_loadu_si128((const __m128i *)(s + i - 16)), q1, q2);
+        if (mask)
+        {
+            return i - 16 + (size_t)(31 - __builtin_clz(mask));
+        }
+    }
+
+    if (!i)
+    {
+        return NPOS;
+    }
+
+    mask = _ss_esc_mask_sse2(_mm_loadu_si128((const __m128i *)s), q1, q2);
+    return mask ? (size_t)(31 - __builtin_clz(mask)) : NPOS;
+}
+
+__attribute__((target("sse2")))
+static size_t
+_ss_unesc_find_sse2(const char *s, size_t len)
+{
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, bs), _mm_cmpeq_epi8(v, zero)));
+        if (mask)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + _ss_unesc_find_scalar(s + i, len - i);
+}
+
+static const _ss_esc_ops_t g_ss_esc_sse2 =
+{
+    _ss_esc_find_sse2,
+    _ss_esc_rfind_sse2,
+    _ss_unesc_find_sse2,
+};
+
+__attribute__((target("avx2")))
+INLINE static uint32_t
+_ss_esc_mask_avx2(__m256i v, __m256i q1, __m256i q2)
+{
+    const __m256i ctl = _mm256_set1_epi8(0x1F);
+    __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v);
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, q1));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, q2));
+    return (uint32_t)_mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static size_t
+_ss_esc_find_avx2(const char *s, size_t len, bool json)
+{
+    const __m256i q1 = _mm256_set1_epi8(json ? '"' : '\'');
+    const __m256i q2 = _mm256_set1_epi8(json ? '"' : 0x7F);
+    uint32_t mask;
+    size_t i = 0;
+
+    if (len < 32)
+    {
+        return _ss_esc_find_scalar(s, len, json);
+    }
+
+    for (; i + 32 <= len; i += 32)
+    {
+        mask = _ss_esc_mask_avx2(_mm256_loadu_si256((const __m256i *)(s + i)), q1, q2);
+        if (mask)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    if (i == len)
+    {
+        return len;
+    }
+
+    i = len - 32;
+    mask = _ss_esc_mask_avx2(_mm256_loadu_si256((const __m256i *)(s + i)), q1, q2);
+    return mask ? i + (size_t)__builtin_ctz(mask) : len;
+}
+
+__attribute__((target("avx2")))
+static size_t
+_ss_esc_rfind_avx2(const char *s, size_t len, bool json)
+{
+    const __m256i q1 = _mm256_set1_epi8(json ? '"' : '\'');
+    const __m256i q2 = _mm256_set1_epi8(json ? '"' : 0x7F);
+    uint32_t mask;
+    size_t i = len;
+
+    if (len < 32)
+    {
+        return _ss_esc_rfind_scalar(s, len, json);
+    }
+
+    for (; i >= 32; i -= 32)
+    {
+        mask = _ss_esc_mask_avx2(_mm256_loadu_si256((const __m256i *)(s + i - 32)), q1, q2);
+        if (mask)
+        {
+            return i - 32 + (size_t)(31 - __builtin_clz(mask));
+        }
+    }
+
+    if (!i)
+    {
+        return NPOS;
+    }
+
+    mask = _ss_esc_mask_avx2(_mm256_loadu_si256((const __m256i *)s), q1, q2);
+    return mask ? (size_t)(31 - __builtin_clz(mask)) : NPOS;
+}
+
+__attribute__((target("avx2")))
+static size_t
+_ss_unesc_find_avx2(const char *s, size_t len)
+{
+    const __m256i bs = _mm256_set1_epi8('\\');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, bs), _mm256_cmpeq_epi8(v, zero)));
+        if (mask)
+        {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+
+    return i + _ss_unesc_find_scalar(s + i, len - i);
+}
+
+static const _ss_esc_ops_t g_ss_esc_avx2 =
+{
+    _ss_esc_find_avx2,
+    _ss_esc_rfind_avx2,
+    _ss_unesc_find_avx2,
+};
+
+#endif /* _SS_X86 */
+
+/* NULL until the first call picks the kernels. */
+static const _ss_esc_ops_t *g_ss_esc_ops;
+
+/**
+ * @internal
+ * @return The escape kernels for this CPU.
+ */
+INLINE static const _ss_esc_ops_t *
+_ss_esc_ops(void)
+{
+    const _ss_esc_ops_t *ops = __atomic_load_n(&g_ss_esc_ops, __ATOMIC_RELAXED);
+
+    if (UNLIKELY(!ops))
+    {
+        ops = &g_ss_esc_scalar;
+#ifdef _SS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            ops = &g_ss_esc_avx2;
+        }
+        else if (__builtin_cpu_supports("sse2"))
+        {
+            ops = &g_ss_esc_sse2;
+        }
+#endif
+        __atomic_store_n(&g_ss_esc_ops, ops, __ATOMIC_RELAXED);
+    }
+
+    return ops;
+}
+
+/** @return The short escape letter for the byte, zero if it has none. */
+INLINE static char
+_ss_esc_letter(unsigned char c, bool json)
+{
+    switch (c)
+    {
+        case 0x08:
+            return 'b';
+        case 0x0C:
+            return 'f';
+        case 0x0A:
+            return 'n';
+        case 0x0D:
+            return 'r';
+        case 0x09:
+            return 't';
+        case 0x5C:
+            return '\\';
+        case 0x22:
+            return '"';
+        default:
+            break;
+    }
+
+    if (json)
+    {
+        return 0;
+    }
+
+    switch (c)
+    {
+        case 0x07:
+            return 'a';
+        case 0x1B:
+            return 'e';
+        case 0x0B:
+            return 'v';
+        case 0x27:
+            return '\'';
+        default:
+            return 0;
+    }
+}
+
+/** @return Length of the escape for a byte that needs one. */
+INLINE static size_t
+_ss_esc_width(unsigned char c, bool json)
+{
+    return _ss_esc_letter(c, json) ? 2 : json ? 6 : 4;
+}
+
+/**
+ * @internal
+ * @brief Write the escape for c ending at end.
+ * @return Start of the escape.
+ */
+INLINE static char *
+_ss_esc_put(char *end, unsigned char c, bool json)
+{
+    char letter = _ss_esc_letter(c, json);
+
+    if (letter)
+    {
+        end -= 2;
+        end[1] = letter;
+    }
+    else if (json)
+    {
+        end -= 6;
+        ss_memcopy(end + 1, "u00", 3);
+        end[4] = _ss_tohexchar(c >> 4);
+        end[5] = _ss_tohexchar(c & 0x0F);
+    }
+    else
+    {
+        end -= 4;
+        end[1] = 'x';
+        end[2] = _ss_tohexchar(c >> 4);
+        end[3] = _ss_tohexchar(c & 0x0F);
+    }
+
+    *end = '\\';
+    return end;
+}
+
+/**
+ * @internal
+ * @brief Escape the first len bytes, anything after them is dropped.
+ */
+static void
+_ss_esc(SS *s, size_t len, bool json)
+{
+    const _ss_esc_ops_t *ops = _ss_esc_ops();
+
+    _ss_detach(s);
+
+    const char *p = *s;
+    size_t first = ops->find(p, len, json);
+    size_t newlen = len;
+    size_t i = first;
+
+    while (i < len)
+    {
+        newlen += _ss_esc_width((unsigned char)p[i], json) - 1;
+        ++i;
+        i += ops->find(p + i, len - i, json);
+    }
+
+    if (newlen == len && len == _ss_len(*s))
+    {
+        return;
+    }
+
+    if (newlen > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, newlen);
+    }
+
+    /* Bytes before the first escape stay where they are. */
+    char *d = *s;
+    char *to = d + newlen;
+    size_t end = len;
+
+    while (to != d + end)
+    {
+        size_t last = first + ops->rfind(d + first, end - first, json);
+        size_t run = end - last - 1;
+        unsigned char c = (unsigned char)d[last];
+
+        to -= run;
+        ss_memmove(to, d + last + 1, run);
+        to = _ss_esc_put(to, c, json);
+        end = last;
+    }
+
+    d[newlen] = 0;
+    _ss_setlen(*s, newlen);
+}
+
+/**
+ * @brief Escape the characters in the given string.
+ * @note Stops at the first null byte, anything after it is dropped.
+ * @param s
+ */
+void
+ssc_esc(SS *s)
+{
+    _ss_esc(s, ss_cstrlen(*s), false);
+}
 
-        buf [0] = (0xFF ^ ((1 << (8 - len)) - 1)) | c;
+/**
+ * @brief Escape the string for use inside a JSON string literal.
+ * @note Stops at the first null byte, anything after it is dropped.
+ * Bytes from 0x80 are kept as they are; validate UTF-8 separately.
+ * @param s
+ */
+void
+ssc_esc_json(SS *s)
+{
+    _ss_esc(s, ss_cstrlen(*s), true);
+}
 
-        return len;
-    }
+/**
+ * @brief Escape the string for use inside a JSON string literal.
+ * @note Null bytes are escaped like any other control character.
+ * Bytes from 0x80 are kept as they are; validate UTF-8 separately.
+ * @param s
+ */
+void
+ss_esc_json(SS *s)
+{
+    _ss_esc(s, _ss_len(*s), true);
 }
 
 /**
@@ -2008,20 +10835,23 @@ _ss_unicodetoutf8(unicode_t c, unsigned char *buf)
 void
 ssc_unesc(SS s)
 {
+    const _ss_esc_ops_t *ops = _ss_esc_ops();
     char buf[SS_UTF8_SEQ_MAX];
     char *p = s;
     char *to = NULL;
     char *from = NULL;
-    _sstring_t *m = _ss_meta(s);
-    size_t newlen = m->len;
+    size_t slen = _ss_len(s);
+    size_t newlen = slen;
+    char *end = s + slen;
 
-    while (*p)
+    /* A backslash at the very end leaves p one past the terminator. */
+    while (p < end && *p)
     {
         if ('\\' != *p)
         {
             ++p;
-            p = ss_cstrchar(p, '\\');
-            if (!p)
+            p += ops->unesc(p, (size_t)(end - p));
+            if ('\\' != *p)
             {
                 break;
             }
@@ -2227,943 +11057,1231 @@ ssc_unesc(SS s)
         newlen -= (removed - written);
     }
 
-    if (to && to != from)
+    if (to && to != from)
+    {
+        ss_memmove(to, from, (s + slen) - from + 1);
+    }
+
+    _ss_setlen(s, newlen);
+}
+
+/**
+ * @param c - Unicode code point.
+ * @return True if the code point is a valid Unicode code point.
+ */
+bool
+ssu_isvalid(unicode_t c)
+{
+    /* The range 0xD800 to 0xDFFF is reserved for UTF-16 surrogate pairs.
+     * Anything above 0x10FFFF is outside the valid code range.
+     */
+    return c < 0x0000D800 || (c > 0x0000DFFF && c <= 0x0010FFFF);
+}
+
+/**
+ * @param c - Unicode code point.
+ * @return Length of the UTF-8 sequence that would result from the given code point.
+ */
+int
+ssu8_cpseqlen(unicode_t c)
+{
+    return ssu_isvalid(c) ? _ss_utf8len(c) : 0;
+}
+
+INLINE static int
+_ss_seqlen(const char *seq)
+{
+    /* There are only 21 bits used for the Unicode standard.
+     * This means only 4 bytes are needed, max.
+     * So everything above 111110xx are not needed.
+     */
+    unsigned char c = *((const unsigned char *)seq);
+    if (LIKELY(c < 0x80))
+    {
+        return 1;
+    }
+    if (UNLIKELY(c > 0xF7 || (c & 0xC0) == 0x80))
+    {
+        return 0;
+    }
+    else
+    {
+        /* We know that at least the leading bit is set.
+         * Flip bits in c.
+         */
+        uint32_t z = (uint32_t)0x000000FF ^ (uint32_t)c;
+        return _ss_clz32_impl(z) - 24;
+    }
+}
+
+/**
+ * @return Zero for invalid; number of bytes otherwise;
+ *         continuation bytes will return 0.
+ */
+int
+ssu8_seqlen(const char *seq)
+{
+    return _ss_seqlen(seq);
+}
+
+/**
+ * @warning This will encode invalid code points. Use ssu_isvalid to check.
+ * @return Sequence length, zero if invalid.
+ */
+int
+ssu8_cptoseq(unicode_t c, char *seq)
+{
+    return _ss_unicodetoutf8(c, (unsigned char *)seq);
+}
+
+/**
+ * @brief Convert the given sequence to a Unicode point in `cpout`.
+ * @param seq - Pointer to the UTF-8 sequence.
+ * @param cpout - Pointer to Unicode code point storage.
+ * @return The length of the sequence; zero on failure.
+ */
+int
+ssu8_seqtocp(const char *seq, unicode_t *cpout)
+{
+    const unsigned char *s = (const unsigned char *)seq;
+
+    /* z should always be > 0. */
+    int z = _ss_seqlen(seq);
+
+    unicode_t c;
+    /* 0xxxxxxx
+     * 10xxxxxx invalid
+     * 110xxxxx
+     * 1110xxxx
+     * 11110xxx
+     * 111110xx invalid
+     * 1111110x invalid
+     * 11111110 invalid
+     */
+    switch (z)
+    {
+#if 0
+        /* Moved to default case for code coverage/catch-all. */
+        case 0:
+            return 0;
+#endif
+        case 1:
+            *cpout = *s;
+            return 1;
+        case 2:
+            if (UNLIKELY((s[1] & 0xC0) != 0x80))
+            {
+                return 0;
+            }
+            c = ((0x1F & s[0]) << 6) | (0x3F & s[1]);
+            *cpout = c;
+            return 2;
+        case 3:
+            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
+                         && ((s[2] & 0xC0) != 0x80)))
+            {
+                return 0;
+            }
+            c = ((0x0F & s[0]) << 12)
+                | ((0x3F & s[1]) << 6)
+                | ((0x3F & s[2]));
+            *cpout = c;
+            return 3;
+        case 4:
+            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
+                         && ((s[2] & 0xC0) != 0x80)
+                         && ((s[3] & 0xC0) != 0x80)))
+            {
+                return 0;
+            }
+            c = ((0x07 & s[0]) << 18)
+                | ((0x3F & s[1]) << 12)
+                | ((0x3F & s[2]) << 6)
+                | ((0x3F & s[3]));
+            *cpout = c;
+            return 4;
+#if 0
+        case 5:
+            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
+                         && ((s[2] & 0xC0) != 0x80)
+                         && ((s[3] & 0xC0) != 0x80)
+                         && ((s[4] & 0xC0) != 0x80)))
+            {
+                return 0;
+            }
+            c = ((0x03 & s[0]) << 24)
+                | ((0x3F & s[1]) << 18)
+                | ((0x3F & s[2]) << 12)
+                | ((0x3F & s[3]) << 6)
+                | ((0x3F & s[4]));
+            *cpout = c;
+            return 5;
+        case 6:
+            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
+                         && ((s[2] & 0xC0) != 0x80)
+                         && ((s[3] & 0xC0) != 0x80)
+                         && ((s[4] & 0xC0) != 0x80)
+                         && ((s[5] & 0xC0) != 0x80)))
+            {
+                return 0;
+            }
+            c = ((0x01 & s[0]) << 30)
+                | ((0x3F & s[1]) << 24)
+                | ((0x3F & s[2]) << 18)
+                | ((0x3F & s[3]) << 12)
+                | ((0x3F & s[4]) << 6)
+                | ((0x3F & s[5]));
+            *cpout = c;
+            return 6;
+        case 7:
+            return 0;
+        case 8:
+            return 0;
+#endif
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/*
+ * Whole-buffer UTF-8.
+ * Validation follows Keiser and Lemire's lookup algorithm from simdjson:
+ * three 16 entry tables indexed by the nibbles of each byte and the byte
+ * before it flag every error that two bytes can show, a saturating
+ * subtract finds the positions that must be a third or fourth byte.
+ * Chunks of plain ASCII skip all of it.
+ * Counting code points counts the bytes that aren't continuations.
+ * @see https://arxiv.org/abs/2010.03090
+ */
+
+typedef struct _ss_utf8_ops_s
+{
+    bool (*validate)(const char *s, size_t len);
+    /* Number of bytes that start a code point. */
+    size_t (*count)(const char *s, size_t len);
+    /* Offset of the nth byte that starts a code point; NPOS if none. */
+    size_t (*index)(const char *s, size_t len, size_t n);
+    /* The rest expect valid input, except len16to8 which checks it. */
+    size_t (*len16)(const char *s, size_t len);
+    size_t (*to16)(const char *s, size_t len, uint16_t *out);
+    size_t (*to32)(const char *s, size_t len, uint32_t *out);
+    size_t (*len16to8)(const uint16_t *u, size_t n);
+    size_t (*from16)(const uint16_t *u, size_t n, char *out);
+    size_t (*from32)(const uint32_t *c, size_t n, char *out);
+} _ss_utf8_ops_t;
+
+/**
+ * @internal
+ * @return True if the byte is a continuation byte (10xxxxxx).
+ */
+INLINE static bool
+_ss_utf8_iscont(unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+/**
+ * @internal
+ * @return High bit set in every continuation byte of the word.
+ */
+INLINE static uint64_t
+_ss_utf8_cont_swar(uint64_t x)
+{
+    return x & ~(x << 1) & _SS_SWAR_HIGH;
+}
+
+static bool
+_ss_utf8_validate_scalar(const char *str, size_t len)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    size_t i = 0;
+
+    while (i < len)
+    {
+        if (i + 8 <= len)
+        {
+            uint64_t x;
+            ss_memcopy(&x, s + i, 8);
+            if (!(x & _SS_SWAR_HIGH))
+            {
+                i += 8;
+                continue;
+            }
+        }
+
+        unsigned char c = s[i];
+        size_t need;
+        unsigned char lo = 0x80;
+        unsigned char hi = 0xBF;
+
+        if (c < 0x80)
+        {
+            ++i;
+            continue;
+        }
+        else if (c < 0xC2)
+        {
+            /* Continuation, or an overlong two byte lead. */
+            return false;
+        }
+        else if (c < 0xE0)
+        {
+            need = 1;
+        }
+        else if (c < 0xF0)
+        {
+            need = 2;
+            lo = 0xE0 == c ? 0xA0 : 0x80;
+            hi = 0xED == c ? 0x9F : 0xBF;
+        }
+        else if (c < 0xF5)
+        {
+            need = 3;
+            lo = 0xF0 == c ? 0x90 : 0x80;
+            hi = 0xF4 == c ? 0x8F : 0xBF;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (need > len - i - 1 || s[i + 1] < lo || s[i + 1] > hi)
+        {
+            return false;
+        }
+        for (size_t k = 2; k <= need; ++k)
+        {
+            if (!_ss_utf8_iscont(s[i + k]))
+            {
+                return false;
+            }
+        }
+        i += need + 1;
+    }
+
+    return true;
+}
+
+static size_t
+_ss_utf8_count_scalar(const char *s, size_t len)
+{
+    size_t conts = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t x;
+        ss_memcopy(&x, s + i, 8);
+        conts += (size_t)__builtin_popcountll(_ss_utf8_cont_swar(x));
+    }
+    for (; i < len; ++i)
     {
-        ss_memmove(to, from, (s + m->len) - from + 1);
+        conts += _ss_utf8_iscont((unsigned char)s[i]);
     }
 
-    m->len = newlen;
+    return len - conts;
 }
 
-/**
- * @brief Copy the substring into the string.
- * @param s
- * @param cs - The substring.
- * @param len - The lenght of substring.
- */
-void
-ss_copy(SS *s, const char *cs, size_t len)
+static size_t
+_ss_utf8_index_scalar(const char *s, size_t len, size_t n)
 {
-    _sstring_t *m = _ss_meta(*s);
+    size_t i = 0;
 
-    if (len > m->cap)
+    for (; i + 8 <= len; i += 8)
     {
-        m = _ss_realloc_grow(m, len);
-        *s = _ss_string(m);
+        uint64_t x;
+        ss_memcopy(&x, s + i, 8);
+        size_t starts = 8 - (size_t)__builtin_popcountll(_ss_utf8_cont_swar(x));
+        if (n < starts)
+        {
+            break;
+        }
+        n -= starts;
+    }
+    for (; i < len; ++i)
+    {
+        if (!_ss_utf8_iscont((unsigned char)s[i]) && 0 == n--)
+        {
+            return i;
+        }
     }
 
-    ss_memcopy(*s, cs, len);
-    m->len = len;
-    (*s)[m->len] = 0;
+    return NPOS;
 }
 
+/*
+ * Transcoding.
+ * The input is checked in one pass and converted in a second that
+ * assumes it's valid, so the output is sized exactly before writing.
+ * UTF-16 and UTF-32 are in native byte order.
+ */
+
 /**
- * @brief Concatenate the substring onto the string.
- * @param s
- * @param cs - The substring.
- * @param len - The lenght of substring.
+ * @internal
+ * @brief Decode the code point at i of valid UTF-8 and step past it.
  */
-void
-ss_cat(SS *s, const char *cs, size_t len)
+INLINE static unicode_t
+_ss_utf8_decode(const unsigned char *s, size_t *i)
 {
-    _sstring_t *m = _ss_meta(*s);
+    unsigned char c = s[*i];
 
-    if ((m->len + len) > m->cap)
+    if (c < 0x80)
     {
-        m = _ss_realloc_grow(m, m->len + len);
-        *s = _ss_string(m);
+        *i += 1;
+        return c;
+    }
+    else if (c < 0xE0)
+    {
+        unicode_t cp = ((unicode_t)(c & 0x1F) << 6) | (s[*i + 1] & 0x3F);
+        *i += 2;
+        return cp;
+    }
+    else if (c < 0xF0)
+    {
+        unicode_t cp = ((unicode_t)(c & 0x0F) << 12)
+                       | ((unicode_t)(s[*i + 1] & 0x3F) << 6)
+                       | (s[*i + 2] & 0x3F);
+        *i += 3;
+        return cp;
+    }
+    else
+    {
+        unicode_t cp = ((unicode_t)(c & 0x07) << 18)
+                       | ((unicode_t)(s[*i + 1] & 0x3F) << 12)
+                       | ((unicode_t)(s[*i + 2] & 0x3F) << 6)
+                       | (s[*i + 3] & 0x3F);
+        *i += 4;
+        return cp;
     }
-
-    ss_memcopy(*s + m->len, cs, len);
-    m->len += len;
-    (*s)[m->len] = 0;
 }
 
 /**
- * @brief Left-concatenate the substring onto the string.
- * @param s
- * @param cs - The substring.
- * @param len - The lenght of substring.
+ * @internal
+ * @brief Encode a valid code point.
+ * @return Number of bytes written.
  */
-void
-ss_lcat(SS *s, const char *cs, size_t len)
+INLINE static size_t
+_ss_utf8_encode(unicode_t c, unsigned char *out)
 {
-    _sstring_t *m = _ss_meta(*s);
-
-    if ((m->len + len) > m->cap)
+    if (c < 0x80)
     {
-        m = _ss_realloc_grow(m, m->len + len);
-        *s = _ss_string(m);
+        out[0] = (unsigned char)c;
+        return 1;
+    }
+    else if (c < 0x800)
+    {
+        out[0] = (unsigned char)(0xC0 | (c >> 6));
+        out[1] = (unsigned char)(0x80 | (c & 0x3F));
+        return 2;
+    }
+    else if (c < 0x10000)
+    {
+        out[0] = (unsigned char)(0xE0 | (c >> 12));
+        out[1] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+        out[2] = (unsigned char)(0x80 | (c & 0x3F));
+        return 3;
+    }
+    else
+    {
+        out[0] = (unsigned char)(0xF0 | (c >> 18));
+        out[1] = (unsigned char)(0x80 | ((c >> 12) & 0x3F));
+        out[2] = (unsigned char)(0x80 | ((c >> 6) & 0x3F));
+        out[3] = (unsigned char)(0x80 | (c & 0x3F));
+        return 4;
     }
-
-    ss_memmove(*s + len, *s, m->len + 1);
-    ss_memcopy(*s, cs, len);
-    m->len += len;
 }
 
 /**
- * @brief Replace a substring within the string with another value.
- * @param s
- * @param index - The index to start searching.
- * @param replace - The string to replace.
- * @param rlen - The length of `replace`.
- * @param with - The string to replace with.
- * @param wlen - The length of `with`.
+ * @internal
+ * @brief Write a code point as one or two UTF-16 code units.
+ * @return Number of code units written.
  */
-void
-ss_replace(SS *s, size_t index, const char *replace, size_t rlen, const char *with, size_t wlen)
+INLINE static size_t
+_ss_utf16_encode(unicode_t c, uint16_t *out)
 {
-    if (!rlen)
-    {
-        return;
-    }
-
-    if (!wlen)
+    if (c < 0x10000)
     {
-        ss_remove(*s, index, replace, rlen);
-        return;
+        out[0] = (uint16_t)c;
+        return 1;
     }
+    c -= 0x10000;
+    out[0] = (uint16_t)(0xD800 | (c >> 10));
+    out[1] = (uint16_t)(0xDC00 | (c & 0x3FF));
+    return 2;
+}
 
-    _sstring_t *m = _ss_meta(*s);
+/**
+ * @internal
+ * @brief Decode the code point at i of UTF-16 and step past it.
+ * @return The code point; 0xFFFFFFFF for an unpaired surrogate.
+ */
+INLINE static unicode_t
+_ss_utf16_decode(const uint16_t *u, size_t n, size_t *i)
+{
+    unicode_t c = u[*i];
 
-    if (index >= m->len)
+    if ((c & 0xF800) != 0xD800)
     {
-        return;
+        *i += 1;
+        return c;
     }
-
-    if (wlen <= rlen)
+    if (c > 0xDBFF || *i + 1 >= n || (u[*i + 1] & 0xFC00) != 0xDC00)
     {
-        /* Replace, inplace. Easy. */
-        size_t newlen = m->len;
-        size_t searchlen = m->len - index;
-        char *to = NULL;
-        char *from = NULL;
-        char *cursor = *s + index;
-        for (;;)
-        {
-            if (*replace != *cursor)
-            {
-                cursor = ss_mmemchar(cursor, *replace, searchlen);
-                if (!cursor)
-                {
-                    break;
-                }
-            }
-
-            searchlen = m->len - (cursor - *s);
-
-            if (searchlen < rlen)
-            {
-                break;
-            }
-
-            if (0 == ss_memcompare(cursor, replace, rlen))
-            {
-                newlen -= (rlen - wlen);
-                if (to)
-                {
-                    size_t movelen = cursor - from;
-                    if (movelen && to != from)
-                    {
-                        ss_memmove(to, from, movelen);
-                        to += movelen;
-                    }
-                }
-                else
-                {
-                    to = cursor;
-                }
-
-                ss_memcopy(to, with, wlen);
-                to += wlen;
-                cursor += rlen;
-                searchlen -= rlen;
-                from = cursor;
-
-                if (searchlen < rlen)
-                {
-                    break;
-                }
-            }
-        }
+        return 0xFFFFFFFF;
+    }
+    c = 0x10000 + ((c & 0x3FF) << 10) + (u[*i + 1] & 0x3FF);
+    *i += 2;
+    return c;
+}
 
-        if (to && to != from)
-        {
-            ss_memmove(to, from, (*s + m->len) - from + 1);
-        }
+static size_t
+_ss_utf8_len16_scalar(const char *s, size_t len)
+{
+    size_t conts = 0;
+    size_t fours = 0;
+    size_t i = 0;
 
-        m->len = newlen;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t x;
+        ss_memcopy(&x, s + i, 8);
+        conts += (size_t)__builtin_popcountll(_ss_utf8_cont_swar(x));
+        /* Four byte leads have the top four bits set. */
+        fours += (size_t)__builtin_popcountll(x & (x << 1) & (x << 2) & (x << 3) & _SS_SWAR_HIGH);
     }
-    else
+    for (; i < len; ++i)
     {
-        /* Replace with possible expansion. Hard. */
-        size_t i = ss_find(*s, index, replace, rlen);
-        if (i != NPOS)
-        {
-            size_t diff = wlen - rlen;
-            size_t count = ss_count(*s, i + rlen, replace, rlen);
-            ++count;
-            size_t cap = (diff * count) + m->len;
-            if (cap > m->cap)
-            {
-                m = _ss_realloc_grow(m, cap);
-                *s = _ss_string(m);
-            }
-
-            /*
-             * *s + i is start location of first replace
-             *
-             * Replace r with ww.
-             * ccrccrcc
-             *   ^
-             * Memmove to end
-             * Memcpy
-             * ccwwfccrcc
-             *   ^
-             * we found the second one
-             * ccwwfccrcc
-             *        ^
-             * ccwwccfrcc
-             *       ^
-             * ccwwccwwcc
-             */
-            size_t movelen = (m->len - (i + rlen)) + 1;
-            char *cursor = *s + i;
-            char *from = cursor + rlen + (diff * count);
-            ss_memmove(from, cursor + rlen, movelen);
-            ss_memcopy(cursor, with, wlen);
-
-            char *to = cursor + wlen;
-            cursor = from;
-
-            m->len += diff * count;
+        conts += _ss_utf8_iscont((unsigned char)s[i]);
+        fours += (unsigned char)s[i] >= 0xF0;
+    }
 
-            while (--count)
-            {
-                for (;;)
-                {
-                    if (*replace != *cursor)
-                    {
-                        ++cursor;
-                        size_t searchlen = m->len - (cursor - *s);
-                        cursor = ss_memchar(cursor + 1, *replace, searchlen);
-                        /* Omit the NULL check since the count doesn't lie. */
-                    }
+    return len - conts + fours;
+}
 
-                    if (0 == ss_memcompare(cursor, replace, rlen))
-                    {
-                        /* Move text to to space. */
-                        movelen = cursor - from;
-                        if (movelen)
-                        {
-                            ss_memmove(to, from, movelen);
-                        }
-                        /* Advance to space. */
-                        to += movelen;
-                        ss_memcopy(to, with, wlen);
-                        /* Advance to space. */
-                        to += wlen;
-                        from = cursor + rlen;
-                        cursor = from;
-                        break;
-                    }
-                    else
-                    {
-                        ++cursor;
-                    }
+static size_t
+_ss_utf8_to16_scalar(const char *str, size_t len, uint16_t *out)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    size_t n = 0;
+    size_t i = 0;
 
-                }
-            }
-        }
+    while (i < len)
+    {
+        n += _ss_utf16_encode(_ss_utf8_decode(s, &i), out + n);
     }
+
+    return n;
 }
 
-/**
- * @brief Replace a range with a substring.
- * @param s
- * @param start - The start of the range (inclusive).
- * @param end - End of the range (exclusive).
- * @param cs - The substring.
- * @param len - The length of substring.
- */
-void
-ss_replacerange(SS *s, size_t start, size_t end, const char *cs, size_t len)
+static size_t
+_ss_utf8_to32_scalar(const char *str, size_t len, uint32_t *out)
 {
-    _sstring_t *m = _ss_meta(*s);
+    const unsigned char *s = (const unsigned char *)str;
+    size_t n = 0;
+    size_t i = 0;
 
-    if (end > m->len)
+    while (i < len)
     {
-        end = m->len;
+        out[n++] = _ss_utf8_decode(s, &i);
     }
 
-    if (start > end)
-    {
-        start = end;
-    }
+    return n;
+}
 
-    size_t rlen = end - start;
+static size_t
+_ss_utf16_len8_scalar(const uint16_t *u, size_t n)
+{
+    size_t len = 0;
+    size_t i = 0;
 
-    if (len > rlen)
+    while (i < n)
     {
-        if ((m->len + (len - rlen)) > m->cap)
+        unicode_t c = _ss_utf16_decode(u, n, &i);
+        if (UNLIKELY(0xFFFFFFFF == c))
         {
-            m = _ss_realloc_grow(m , m->len + (len - rlen));
-            *s = _ss_string(m);
+            return NPOS;
         }
+        len += (size_t)_ss_utf8len(c);
     }
 
-    if (rlen != len)
+    return len;
+}
+
+static size_t
+_ss_utf16_to8_scalar(const uint16_t *u, size_t n, char *out)
+{
+    size_t len = 0;
+    size_t i = 0;
+
+    while (i < n)
     {
-        size_t endlen = m->len - end;
-        ss_memmove(*s + start + len, *s + end, endlen + 1);
+        len += _ss_utf8_encode(_ss_utf16_decode(u, n, &i), (unsigned char *)out + len);
     }
 
-    ss_memcopy(*s + start, cs, len);
-    m->len = (m->len - rlen) + len;
+    return len;
 }
 
-/**
- * @brief Insert the string at the given index.
- * @param s
- * @param index - Position to insert substring.
- * @param cs - Substring.
- * @param len - Substring length.
- */
-void
-ss_insert(SS *s, size_t index, const char *cs, size_t len)
+static size_t
+_ss_utf32_to8_scalar(const uint32_t *c, size_t n, char *out)
 {
-    _sstring_t *m = _ss_meta(*s);
+    size_t len = 0;
 
-    if (index > m->len)
+    for (size_t i = 0; i < n; ++i)
     {
-        index = m->len;
+        len += _ss_utf8_encode(c[i], (unsigned char *)out + len);
     }
 
-    if ((m->len + len) > m->cap)
-    {
-        m = _ss_realloc_grow(m, m->len + len);
-        *s = _ss_string(m);
-    }
+    return len;
+}
 
-    char *dest = *s + index + len;
-    char *src = *s + index;
-    size_t movelen = m->len - index + 1;
-    ss_memmove(dest, src, movelen);
-    ss_memcopy(src, cs, len);
-    m->len += len;
-    (*s)[m->len] = 0;
+static const _ss_utf8_ops_t g_ss_utf8_scalar =
+{
+    _ss_utf8_validate_scalar,
+    _ss_utf8_count_scalar,
+    _ss_utf8_index_scalar,
+    _ss_utf8_len16_scalar,
+    _ss_utf8_to16_scalar,
+    _ss_utf8_to32_scalar,
+    _ss_utf16_len8_scalar,
+    _ss_utf16_to8_scalar,
+    _ss_utf32_to8_scalar,
+};
+
+#ifdef _SS_X86
+
+#define _SS_U8_TOO_SHORT   (1 << 0)
+#define _SS_U8_TOO_LONG    (1 << 1)
+#define _SS_U8_OVERLONG_3  (1 << 2)
+#define _SS_U8_TOO_LARGE   (1 << 3)
+#define _SS_U8_SURROGATE   (1 << 4)
+#define _SS_U8_OVERLONG_2  (1 << 5)
+/* Shared bit, the second byte tells the two apart. */
+#define _SS_U8_TOO_LARGE_1000 (1 << 6)
+#define _SS_U8_OVERLONG_4  (1 << 6)
+#define _SS_U8_TWO_CONTS   (1 << 7)
+#define _SS_U8_CARRY (_SS_U8_TOO_SHORT | _SS_U8_TOO_LONG | _SS_U8_TWO_CONTS)
+
+/* Both halves of a 256-bit table are the same 16 entries. */
+#define _SS_U8_TABLE(A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P) \
+    _mm256_setr_epi8(A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P, \
+                     A, B, C, D, E, F, G, H, I, J, K, L, M, N, O, P)
+
+/**
+ * @internal
+ * @return The chunk shifted back by n bytes, pulling in the end of prev.
+ */
+#define _SS_U8_PREV(CUR, PREV, N) \
+    _mm256_alignr_epi8((CUR), _mm256_permute2x128_si256((PREV), (CUR), 0x21), 16 - (N))
+
+/**
+ * @internal
+ * @return Nonzero bytes where the chunk isn't valid UTF-8 given the
+ *         chunk before it.
+ */
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_utf8_errors_avx2(__m256i cur, __m256i prev)
+{
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    const __m256i byte_1_high_tbl = _SS_U8_TABLE(
+        _SS_U8_TOO_LONG, _SS_U8_TOO_LONG, _SS_U8_TOO_LONG, _SS_U8_TOO_LONG,
+        _SS_U8_TOO_LONG, _SS_U8_TOO_LONG, _SS_U8_TOO_LONG, _SS_U8_TOO_LONG,
+        _SS_U8_TWO_CONTS, _SS_U8_TWO_CONTS, _SS_U8_TWO_CONTS, _SS_U8_TWO_CONTS,
+        _SS_U8_TOO_SHORT | _SS_U8_OVERLONG_2,
+        _SS_U8_TOO_SHORT,
+        _SS_U8_TOO_SHORT | _SS_U8_OVERLONG_3 | _SS_U8_SURROGATE,
+        _SS_U8_TOO_SHORT | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000 | _SS_U8_OVERLONG_4);
+    const __m256i byte_1_low_tbl = _SS_U8_TABLE(
+        _SS_U8_CARRY | _SS_U8_OVERLONG_3 | _SS_U8_OVERLONG_2 | _SS_U8_OVERLONG_4,
+        _SS_U8_CARRY | _SS_U8_OVERLONG_2,
+        _SS_U8_CARRY,
+        _SS_U8_CARRY,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000 | _SS_U8_SURROGATE,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000,
+        _SS_U8_CARRY | _SS_U8_TOO_LARGE | _SS_U8_TOO_LARGE_1000);
+    const __m256i byte_2_high_tbl = _SS_U8_TABLE(
+        _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT,
+        _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT,
+        _SS_U8_TOO_LONG | _SS_U8_OVERLONG_2 | _SS_U8_TWO_CONTS
+            | _SS_U8_OVERLONG_3 | _SS_U8_TOO_LARGE_1000 | _SS_U8_OVERLONG_4,
+        _SS_U8_TOO_LONG | _SS_U8_OVERLONG_2 | _SS_U8_TWO_CONTS
+            | _SS_U8_OVERLONG_3 | _SS_U8_TOO_LARGE,
+        _SS_U8_TOO_LONG | _SS_U8_OVERLONG_2 | _SS_U8_TWO_CONTS
+            | _SS_U8_SURROGATE | _SS_U8_TOO_LARGE,
+        _SS_U8_TOO_LONG | _SS_U8_OVERLONG_2 | _SS_U8_TWO_CONTS
+            | _SS_U8_SURROGATE | _SS_U8_TOO_LARGE,
+        _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT, _SS_U8_TOO_SHORT);
+
+    __m256i prev1 = _SS_U8_PREV(cur, prev, 1);
+    __m256i b1h = _mm256_shuffle_epi8(byte_1_high_tbl, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib));
+    __m256i b1l = _mm256_shuffle_epi8(byte_1_low_tbl, _mm256_and_si256(prev1, nib));
+    __m256i b2h = _mm256_shuffle_epi8(byte_2_high_tbl, _mm256_and_si256(_mm256_srli_epi16(cur, 4), nib));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(b1h, b1l), b2h);
+
+    /* Only 111xxxxx two back and 1111xxxx three back stay >= 0x80. */
+    __m256i third = _mm256_subs_epu8(_SS_U8_PREV(cur, prev, 2), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(_SS_U8_PREV(cur, prev, 3), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(must23, special);
 }
 
 /**
- * @brief Places the substring over the existing string starting at the given position.
- * @param s
- * @param index - The start position.
- * @param cs - Substring.
- * @param len - Substring length.
+ * @internal
+ * @return Nonzero bytes if the chunk ends inside a sequence.
  */
-void
-ss_overlay(SS *s, size_t index, const char *cs, size_t len)
+__attribute__((target("avx2")))
+INLINE static __m256i
+_ss_utf8_incomplete_avx2(__m256i cur)
 {
-    _sstring_t *m = _ss_meta(*s);
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(cur, max);
+}
+
+__attribute__((target("avx2")))
+static bool
+_ss_utf8_validate_avx2(const char *s, size_t len)
+{
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i error = _mm256_setzero_si256();
+    size_t i = 0;
 
-    if (index > m->len)
+    while (i < len)
     {
-        index = m->len;
-    }
+        __m256i cur;
 
-    size_t overend = index + len;
+        if (i + 32 <= len)
+        {
+            cur = _mm256_loadu_si256((const __m256i *)(s + i));
+        }
+        else
+        {
+            /* Pad with ASCII, a sequence cut short by the end shows as an error. */
+            char tail[32] = { 0 };
+            ss_memcopy(tail, s + i, len - i);
+            cur = _mm256_loadu_si256((const __m256i *)tail);
+        }
 
-    if (overend > m->cap)
-    {
-        m = _ss_realloc_grow(m, overend);
-        *s = _ss_string(m);
-    }
+        if (!_mm256_movemask_epi8(cur))
+        {
+            error = _mm256_or_si256(error, incomplete);
+        }
+        else
+        {
+            error = _mm256_or_si256(error, _ss_utf8_errors_avx2(cur, prev));
+            incomplete = _ss_utf8_incomplete_avx2(cur);
+        }
+        prev = cur;
+        i += 32;
 
-    ss_memcopy(*s + index, cs, len);
-    if (overend > m->len)
-    {
-        m->len = overend;
-        (*s)[overend] = 0;
+        if (UNLIKELY(!(i & 0x3FF) && !_mm256_testz_si256(error, error)))
+        {
+            return false;
+        }
     }
+
+    error = _mm256_or_si256(error, incomplete);
+    return _mm256_testz_si256(error, error);
 }
 
 /**
  * @internal
+ * @return Mask of the bytes of the chunk that start a code point.
  */
-int
-_ss_catf(SS *s, const char *fmt, va_list *argp)
+__attribute__((target("avx2")))
+INLINE static uint32_t
+_ss_utf8_starts_avx2(const char *s)
 {
-    va_list ap;
-    _sstring_t *m = _ss_meta(*s);
+    __m256i v = _mm256_loadu_si256((const __m256i *)s);
+    /* Continuations are the signed bytes -128 through -65. */
+    __m256i cont = _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), v);
+    return ~(uint32_t)_mm256_movemask_epi8(cont);
+}
 
-    if (m->cap == 0)
+__attribute__((target("avx2,popcnt")))
+static size_t
+_ss_utf8_count_avx2(const char *s, size_t len)
+{
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
     {
-        m = _ss_realloc_grow(m, ss_cstrlen(fmt) + 1);
-        *s = _ss_string(m);
+        count += (size_t)__builtin_popcount(_ss_utf8_starts_avx2(s + i));
     }
 
-    for (;;)
+    return count + _ss_utf8_count_scalar(s + i, len - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t
+_ss_utf8_index_avx2(const char *s, size_t len, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32)
     {
-        va_copy(ap, *argp);
-        int n = ss_vsnprintf(*s + m->len, m->cap - m->len + 1, fmt, ap);
-        va_end(ap);
+        uint32_t starts = _ss_utf8_starts_avx2(s + i);
+        size_t count = (size_t)__builtin_popcount(starts);
 
-        if (n < 0)
+        if (n < count)
         {
-            /*
-             * In pre glibc v2.1 libraries,
-             * -1 indicates not all bytes were written.
-             * @see https://linux.die.net/man/3/vsnprintf
-             */
-#ifdef __GNU_LIBRARY__
-#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
-            if (-1 != n)
+            while (n--)
             {
-#endif
-#endif
-            (*s)[m->len] = 0;
-            return EINVAL;
-#ifdef __GNU_LIBRARY__
-#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
+                starts &= starts - 1;
             }
-#endif
-#endif
-        }
-
-        /* n could be -1, but this should be converted to largest value. */
-        if ((size_t)n < (m->cap - m->len))
-        {
-            m->len += (size_t)n;
-            break;
+            return i + (size_t)__builtin_ctz(starts);
         }
-
-        m = _ss_realloc_grow(m, m->cap + 1);
-        *s = _ss_string(m);
+        n -= count;
     }
 
-    return 0;
+    size_t at = _ss_utf8_index_scalar(s + i, len - i, n);
+    return NPOS == at ? NPOS : i + at;
 }
 
-/**
- * @brief A very useful function to write information to the string using a
- *        format string.
- * @warning The contents of the buffer are not guaranteed if EINVAL returned.
- * @note If using GCC you should get warnings for bad format strings.
- * @param s
- * @param fmt - Format string.
- * @return EINVAL if bad format string; zero otherwise.
+/*
+ * The transcoding kernels move whole vectors of ASCII, and of UTF-16
+ * that's all two byte UTF-8, anything else goes through the scalar
+ * code up to the end of the vector.
  */
-int
-ss_copyf(SS *s, const char *fmt, ...)
+
+__attribute__((target("avx2,popcnt")))
+static size_t
+_ss_utf8_len16_avx2(const char *s, size_t len)
 {
-    va_list argp;
-    int retval;
+    size_t n = 0;
+    size_t i = 0;
 
-    ss_clear(*s);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        /* Four byte leads are the signed bytes -16 through -1. */
+        __m256i fours = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(-17)),
+                                         _mm256_cmpgt_epi8(_mm256_setzero_si256(), v));
+        n += (size_t)__builtin_popcount(_ss_utf8_starts_avx2(s + i));
+        n += (size_t)__builtin_popcount((uint32_t)_mm256_movemask_epi8(fours));
+    }
 
-    va_start(argp, fmt);
-    retval = _ss_catf(s, fmt, &argp);
-    va_end(argp);
+    return n + _ss_utf8_len16_scalar(s + i, len - i);
+}
 
-    return retval;
-#if 0
-    _sstring_t *m = _ss_meta(*s);
-    va_list argp;
+__attribute__((target("avx2")))
+static size_t
+_ss_utf8_to16_avx2(const char *str, size_t len, uint16_t *out)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    size_t n = 0;
+    size_t i = 0;
 
-    if (m->cap == 0)
+    while (i + 32 <= len)
     {
-        m = _ss_realloc_grow(m, ss_cstrlen(fmt) + 1);
-        *s = _ss_string(m);
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+
+        if (!_mm256_movemask_epi8(v))
+        {
+            _mm256_storeu_si256((__m256i *)(out + n), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+            _mm256_storeu_si256((__m256i *)(out + n + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+            n += 32;
+            i += 32;
+            continue;
+        }
+
+        for (size_t end = i + 32; i < end;)
+        {
+            n += _ss_utf16_encode(_ss_utf8_decode(s, &i), out + n);
+        }
     }
 
-    for (;;)
+    return n + _ss_utf8_to16_scalar(str + i, len - i, out + n);
+}
+
+__attribute__((target("avx2")))
+static size_t
+_ss_utf8_to32_avx2(const char *str, size_t len, uint32_t *out)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    size_t n = 0;
+    size_t i = 0;
+
+    while (i + 32 <= len)
     {
-        va_start(argp, fmt);
-        int n = ss_vsnprintf(*s, m->cap, fmt, argp);
-        va_end(argp);
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
 
-        if (n < 0)
+        if (!_mm256_movemask_epi8(v))
         {
-            /*
-             * In pre glibc v2.1 libraries,
-             * -1 indicates not all bytes were written.
-             * @see https://linux.die.net/man/3/vsnprintf
-             */
-#ifdef __GNU_LIBRARY__
-#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
-            if (-1 != n)
-            {
-#endif
-#endif
-            (*s)[0] = 0;
-            return EINVAL;
-#ifdef __GNU_LIBRARY__
-#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
-            }
-#endif
-#endif
+            __m128i lo = _mm256_castsi256_si128(v);
+            __m128i hi = _mm256_extracti128_si256(v, 1);
+            _mm256_storeu_si256((__m256i *)(out + n), _mm256_cvtepu8_epi32(lo));
+            _mm256_storeu_si256((__m256i *)(out + n + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+            _mm256_storeu_si256((__m256i *)(out + n + 16), _mm256_cvtepu8_epi32(hi));
+            _mm256_storeu_si256((__m256i *)(out + n + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+            n += 32;
+            i += 32;
+            continue;
         }
 
-        /* n could be -1, but this should be converted to largest value. */
-        if ((size_t)n < m->cap)
+        for (size_t end = i + 32; i < end;)
         {
-            m->len = (size_t)n;
-            break;
+            out[n++] = _ss_utf8_decode(s, &i);
         }
-
-        m = _ss_realloc_grow(m, m->cap + 1);
-        *s = _ss_string(m);
     }
 
-    return 0;
-#endif
+    return n + _ss_utf8_to32_scalar(str + i, len - i, out + n);
 }
 
 /**
- * @brief A very useful function to write information to the end of a string 
- *        using a format string.
- * @note If using GCC you should get warnings for bad format strings.
- * @param s
- * @param fmt - Format string.
- * @return EINVAL if bad format string; zero otherwise.
+ * @internal
+ * @return Mask, two bits per code unit, of the units at most max.
  */
-int
-ss_catf(SS *s, const char *fmt, ...)
+__attribute__((target("avx2")))
+INLINE static uint32_t
+_ss_utf16_le_avx2(__m256i v, uint16_t max)
 {
-    va_list argp;
-    int retval;
-
-    va_start(argp, fmt);
-    retval = _ss_catf(s, fmt, &argp);
-    va_end(argp);
+    __m256i m = _mm256_set1_epi16((short)max);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_min_epu16(v, m), v));
+}
 
-    return retval;
-#if 0
-    _sstring_t *m = _ss_meta(*s);
-    va_list argp;
+__attribute__((target("avx2")))
+INLINE static bool
+_ss_utf16_hassurrogate_avx2(__m256i v)
+{
+    __m256i sur = _mm256_cmpeq_epi16(_mm256_and_si256(v, _mm256_set1_epi16((short)0xF800)),
+                                     _mm256_set1_epi16((short)0xD800));
+    return !_mm256_testz_si256(sur, sur);
+}
 
-    if (m->cap == 0)
-    {
-        m = _ss_realloc_grow(m, ss_cstrlen(fmt) + 1);
-        *s = _ss_string(m);
-    }
+__attribute__((target("avx2,popcnt")))
+static size_t
+_ss_utf16_len8_avx2(const uint16_t *u, size_t n)
+{
+    size_t len = 0;
+    size_t i = 0;
 
-    for (;;)
+    while (i + 16 <= n)
     {
-        va_start(argp, fmt);
-        int n = ss_vsnprintf(*s + m->len, m->cap - m->len + 1, fmt, argp);
-        va_end(argp);
+        __m256i v = _mm256_loadu_si256((const __m256i *)(u + i));
 
-        if (n < 0)
+        if (!_ss_utf16_hassurrogate_avx2(v))
         {
-            /*
-             * In pre glibc v2.1 libraries,
-             * -1 indicates not all bytes were written.
-             * @see https://linux.die.net/man/3/vsnprintf
-             */
-#ifdef __GNU_LIBRARY__
-#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
-            if (-1 != n)
-            {
-#endif
-#endif
-            (*s)[m->len] = 0;
-            return EINVAL;
-#ifdef __GNU_LIBRARY__
-#if (__GLIBC__ < 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ == 0)
-            }
-#endif
-#endif
+            /* One byte each, plus one past 0x7F and another past 0x7FF. */
+            len += 48;
+            len -= (size_t)__builtin_popcount(_ss_utf16_le_avx2(v, 0x7F)) / 2;
+            len -= (size_t)__builtin_popcount(_ss_utf16_le_avx2(v, 0x7FF)) / 2;
+            i += 16;
+            continue;
         }
 
-        /* n could be -1, but this should be converted to largest value. */
-        if ((size_t)n < (m->cap - m->len))
+        for (size_t end = i + 16; i < end && i < n;)
         {
-            m->len += (size_t)n;
-            break;
+            unicode_t c = _ss_utf16_decode(u, n, &i);
+            if (UNLIKELY(0xFFFFFFFF == c))
+            {
+                return NPOS;
+            }
+            len += (size_t)_ss_utf8len(c);
         }
+    }
 
-        m = _ss_realloc_grow(m, m->cap + 1);
-        *s = _ss_string(m);
+    if (i < n)
+    {
+        size_t rest = _ss_utf16_len8_scalar(u + i, n - i);
+        return NPOS == rest ? NPOS : len + rest;
     }
 
-    return 0;
-#endif
+    return len;
 }
 
-/**
- * @brief Concatenate the signed integral value in decimal.
- * @param s
- * @param val - The value to convert.
- */
-void
-ss_catint64(SS *s, int64_t val)
+__attribute__((target("avx2")))
+static size_t
+_ss_utf16_to8_avx2(const uint16_t *u, size_t n, char *out)
 {
-    char buf[32];
-    char *p = buf;
+    size_t len = 0;
+    size_t i = 0;
 
-    _sstring_t *m = _ss_meta(*s);
+    while (i + 16 <= n)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(u + i));
 
-    /* Previously I was going to use the following to determine
-     * the length in advance.
-     * However, it may not be accurate/precise.
-     *
-     * int digits = (ss_bitscanforward(val) / 3) + 1;
-     */
+        if (0xFFFFFFFF == _ss_utf16_le_avx2(v, 0x7F))
+        {
+            __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storeu_si128((__m128i *)(out + len), bytes);
+            len += 16;
+            i += 16;
+            continue;
+        }
+        if (0xFFFFFFFF == _ss_utf16_le_avx2(v, 0x7FF) && !_ss_utf16_le_avx2(v, 0x7F))
+        {
+            /* 110xxxxx 10xxxxxx, lead in the low byte of each unit. */
+            __m256i lead = _mm256_or_si256(_mm256_srli_epi16(v, 6), _mm256_set1_epi16(0xC0));
+            __m256i cont = _mm256_or_si256(_mm256_and_si256(v, _mm256_set1_epi16(0x3F)),
+                                           _mm256_set1_epi16(0x80));
+            _mm256_storeu_si256((__m256i *)(out + len), _mm256_or_si256(lead, _mm256_slli_epi16(cont, 8)));
+            len += 32;
+            i += 16;
+            continue;
+        }
 
-    if (val >= 0)
-    {
-        do
+        for (size_t end = i + 16; i < end && i < n;)
         {
-            *p = '0' + (val % 10);
-            ++p;
-            val = val / 10;
-        } while (val);
+            len += _ss_utf8_encode(_ss_utf16_decode(u, n, &i), (unsigned char *)out + len);
+        }
     }
-    else
+
+    return len + _ss_utf16_to8_scalar(u + i, n - i, out + len);
+}
+
+__attribute__((target("avx2")))
+static size_t
+_ss_utf32_to8_avx2(const uint32_t *c, size_t n, char *out)
+{
+    size_t len = 0;
+    size_t i = 0;
+
+    while (i + 8 <= n)
     {
-        do
-        {
-            *p = '0' + (-1)*(val % 10);
-            ++p;
-            val = val / 10;
-        } while (val);
+        __m256i v = _mm256_loadu_si256((const __m256i *)(c + i));
+        __m256i big = _mm256_cmpgt_epi32(v, _mm256_set1_epi32(0x7F));
 
-        *p = '-';
-        ++p;
-        *p = 0;
-    }
+        if (_mm256_testz_si256(big, big))
+        {
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storel_epi64((__m128i *)(out + len), _mm_packus_epi16(words, words));
+            len += 8;
+            i += 8;
+            continue;
+        }
 
-    size_t len = p - buf;
-    if ((m->len + len) > m->cap)
-    {
-        m = _ss_realloc_grow(m, m->len + len);
-        *s = _ss_string(m);
+        for (size_t end = i + 8; i < end; ++i)
+        {
+            len += _ss_utf8_encode(c[i], (unsigned char *)out + len);
+        }
     }
 
-    m->len += len;
-    char *ss = *s;
-    ss[m->len] = 0;
-    do
-    {
-        --p;
-        *ss = *p;
-        ++ss;
-    } while (p != buf);
+    return len + _ss_utf32_to8_scalar(c + i, n - i, out + len);
 }
 
-/**
- * @brief Concatenate the unsigned integral value in decimal.
- * @param s
- * @param val - The value to convert.
- */
-void
-ss_catuint64(SS *s, uint64_t val)
+static const _ss_utf8_ops_t g_ss_utf8_avx2 =
 {
-    char buf[32];
-    char *p = buf;
+    _ss_utf8_validate_avx2,
+    _ss_utf8_count_avx2,
+    _ss_utf8_index_avx2,
+    _ss_utf8_len16_avx2,
+    _ss_utf8_to16_avx2,
+    _ss_utf8_to32_avx2,
+    _ss_utf16_len8_avx2,
+    _ss_utf16_to8_avx2,
+    _ss_utf32_to8_avx2,
+};
 
-    _sstring_t *m = _ss_meta(*s);
+#endif /* _SS_X86 */
 
-    /* Previously I was going to use the following to determine
-     * the length in advance.
-     * However, it may not be accurate/precise.
-     *
-     * int digits = (ss_bitscanforward(val) / 3) + 1;
-     */
+/* NULL until the first call picks the kernels. */
+static const _ss_utf8_ops_t *g_ss_utf8_ops;
 
-    do
-    {
-        *p = '0' + (val % 10);
-        ++p;
-        val = val / 10;
-    } while (val);
+/**
+ * @internal
+ * @return The UTF-8 kernels for this CPU.
+ */
+INLINE static const _ss_utf8_ops_t *
+_ss_utf8(void)
+{
+    const _ss_utf8_ops_t *ops = __atomic_load_n(&g_ss_utf8_ops, __ATOMIC_RELAXED);
 
-    size_t len = p - buf;
-    if ((m->len + len) > m->cap)
+    if (UNLIKELY(!ops))
     {
-        m = _ss_realloc_grow(m, m->len + len);
-        *s = _ss_string(m);
+        ops = &g_ss_utf8_scalar;
+#ifdef _SS_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            ops = &g_ss_utf8_avx2;
+        }
+#endif
+        __atomic_store_n(&g_ss_utf8_ops, ops, __ATOMIC_RELAXED);
     }
 
-    m->len += len;
-    char *ss = *s;
-    ss[m->len] = 0;
-    do
-    {
-        --p;
-        *ss = *p;
-        ++ss;
-    } while (p != buf);
+    return ops;
 }
 
-INLINE static char
-_ss_tohexchar(unsigned char nibble)
+/**
+ * @brief Check the whole string is well-formed UTF-8.
+ * @note Rejects overlong forms, surrogates, code points past 0x10FFFF,
+ *       and sequences cut short. NUL bytes are valid.
+ * @return True if valid; false otherwise.
+ */
+bool
+ssu8_validate(const SS s)
 {
-    static char map[] =
-    {
-        '0', '1', '2', '3',
-        '4', '5', '6', '7',
-        '8', '9', 'A', 'B',
-        'C', 'D', 'E', 'F',
-    };
-    return map[nibble];
+    return _ss_utf8()->validate(s, _ss_len(s));
 }
 
 /**
- * @brief Escape the characters in the given string.
- * @param s
+ * @note Counts the bytes that aren't continuation bytes,
+ *       check the string with ssu8_validate first.
+ * @return Number of code points in the string.
  */
-void
-ssc_esc(SS *s)
+size_t
+ssu8_len(const SS s)
 {
-    _sstring_t *m = _ss_meta(*s);
+    return _ss_utf8()->count(s, _ss_len(s));
+}
 
-    if (!m->len)
-    {
-        return;
-    }
+/**
+ * @note Like ssu8_len, expects valid UTF-8.
+ * @param n - Index of the code point, zero is the first.
+ * @return Byte offset of the nth code point; NPOS if there are fewer.
+ */
+size_t
+ssu8_index(const SS s, size_t n)
+{
+    return _ss_utf8()->index(s, _ss_len(s), n);
+}
 
-    SS t = ss_new(m->len * 2);
-    ss_setgrow(&t, SS_GROW100);
+/**
+ * @internal
+ * @return Bytes of UTF-8 for the code points; NPOS if one isn't valid.
+ */
+static size_t
+_ss_utf32_len8(const uint32_t *c, size_t n)
+{
+    size_t len = 0;
 
-    char *p = *s;
-    while (*p)
+    for (size_t i = 0; i < n; ++i)
     {
-        switch (*p)
+        if (UNLIKELY(!ssu_isvalid(c[i])))
         {
-            case 0x07:
-                ss_cat(&t, "\\a", 2);
-                break;
-            case 0x08:
-                ss_cat(&t, "\\b", 2);
-                break;
-            case 0x1B:
-                ss_cat(&t, "\\e", 2);
-                break;
-            case 0x0C:
-                ss_cat(&t, "\\f", 2);
-                break;
-            case 0x0A:
-                ss_cat(&t, "\\n", 2);
-                break;
-            case 0x0D:
-                ss_cat(&t, "\\r", 2);
-                break;
-            case 0x09:
-                ss_cat(&t, "\\t", 2);
-                break;
-            case 0x0B:
-                ss_cat(&t, "\\v", 2);
-                break;
-            case 0x5C:
-                ss_cat(&t, "\\\\", 2);
-                break;
-            case 0x27:
-                ss_cat(&t, "\\\'", 2);
-                break;
-            case 0x22:
-                ss_cat(&t, "\\\"", 2);
-                break;
-            default:
-                if (iscntrl(*p))
-                {
-                    char buf[4] = "\\x";
-                    buf[2] = _ss_tohexchar(((unsigned char)*p) >> 4);
-                    buf[3] = _ss_tohexchar(((unsigned char)*p) & 0x0F);
-                    ss_cat(&t, buf, 4);
-                }
-                else
-                {
-                    ss_cat(&t, p, 1);
-                }
-                break;
+            return NPOS;
         }
-        ++p;
+        len += 1 + (c[i] >= 0x80) + (c[i] >= 0x800) + (c[i] >= 0x10000);
     }
 
-    ss_copy(s, t, _ss_len(t));
-    ss_free(&t);
+    return len;
 }
 
 /**
- * @param c - Unicode code point.
- * @return True if the code point is a valid Unicode code point.
+ * @return Number of UTF-16 code units the string converts to;
+ *         NPOS if it isn't valid UTF-8.
  */
-bool
-ssu_isvalid(unicode_t c)
+size_t
+ssu8_utf16len(const SS s)
 {
-    /* The range 0xD800 to 0xDFFF is reserved for UTF-16 surrogate pairs.
-     * Anything above 0x10FFFF is outside the valid code range.
-     */
-    return c < 0x0000D800 || (c > 0x0000DFFF && c <= 0x0010FFFF);
+    const _ss_utf8_ops_t *ops = _ss_utf8();
+    size_t len = _ss_len(s);
+
+    return ops->validate(s, len) ? ops->len16(s, len) : NPOS;
 }
 
 /**
- * @param c - Unicode code point.
- * @return Length of the UTF-8 sequence that would result from the given code point.
+ * @brief Convert the string to UTF-16 in native byte order.
+ * @param out - Room for ssu8_utf16len code units.
+ * @return Number of code units written; NPOS, with nothing written,
+ *         if the string isn't valid UTF-8.
  */
-int
-ssu8_cpseqlen(unicode_t c)
+size_t
+ssu8_to_utf16(const SS s, uint16_t *out)
 {
-    return ssu_isvalid(c) ? _ss_utf8len(c) : 0;
+    const _ss_utf8_ops_t *ops = _ss_utf8();
+    size_t len = _ss_len(s);
+
+    return ops->validate(s, len) ? ops->to16(s, len, out) : NPOS;
 }
 
-INLINE static int
-_ss_seqlen(const char *seq)
+/**
+ * @brief Convert the string to UTF-32 in native byte order.
+ * @param out - Room for ssu8_len code points.
+ * @return Number of code points written; NPOS, with nothing written,
+ *         if the string isn't valid UTF-8.
+ */
+size_t
+ssu8_to_utf32(const SS s, uint32_t *out)
 {
-    /* There are only 21 bits used for the Unicode standard.
-     * This means only 4 bytes are needed, max.
-     * So everything above 111110xx are not needed.
-     */
-    unsigned char c = *((const unsigned char *)seq);
-    if (LIKELY(c < 0x80))
-    {
-        return 1;
-    }
-    if (UNLIKELY(c > 0xF7 || (c & 0xC0) == 0x80))
-    {
-        return 0;
-    }
-    else
-    {
-        /* We know that at least the leading bit is set.
-         * Flip bits in c.
-         */
-        uint32_t z = (uint32_t)0x000000FF ^ (uint32_t)c;
-        return _ss_clz32_impl(z) - 24;
-    }
+    const _ss_utf8_ops_t *ops = _ss_utf8();
+    size_t len = _ss_len(s);
+
+    return ops->validate(s, len) ? ops->to32(s, len, out) : NPOS;
 }
 
 /**
- * @return Zero for invalid; number of bytes otherwise;
- *         continuation bytes will return 0.
+ * @internal
+ * @brief Make room for exactly len bytes of new contents.
  */
-int
-ssu8_seqlen(const char *seq)
+INLINE static void
+_ss_utf8_prepare(SS *s, size_t len)
 {
-    return _ss_seqlen(seq);
+    _ss_detach(s);
+
+    if (len > _ss_cap(*s))
+    {
+        *s = _ss_realloc_grow(*s, len);
+    }
 }
 
 /**
- * @warning This will encode invalid code points. Use ssu_isvalid to check.
- * @return Sequence length, zero if invalid.
+ * @brief Replace the string with the UTF-8 form of UTF-16 in native byte order.
+ * @param s
+ * @param u - The code units.
+ * @param n - Number of code units.
+ * @return True on success; false, with the string unchanged,
+ *         if there's an unpaired surrogate.
  */
-int
-ssu8_cptoseq(unicode_t c, char *seq)
+bool
+ssu16_to_utf8(SS *s, const uint16_t *u, size_t n)
 {
-    return _ss_unicodetoutf8(c, (unsigned char *)seq);
+    const _ss_utf8_ops_t *ops = _ss_utf8();
+    size_t len = ops->len16to8(u, n);
+
+    if (NPOS == len)
+    {
+        return false;
+    }
+
+    _ss_utf8_prepare(s, len);
+    ops->from16(u, n, *s);
+    _ss_setlen(*s, len);
+    (*s)[len] = 0;
+    return true;
 }
 
 /**
- * @brief Convert the given sequence to a Unicode point in `cpout`.
- * @param seq - Pointer to the UTF-8 sequence.
- * @param cpout - Pointer to Unicode code point storage.
- * @return The length of the sequence; zero on failure.
+ * @brief Replace the string with the UTF-8 form of UTF-32 in native byte order.
+ * @param s
+ * @param c - The code points.
+ * @param n - Number of code points.
+ * @return True on success; false, with the string unchanged,
+ *         if a code point is a surrogate or past 0x10FFFF.
  */
-int
-ssu8_seqtocp(const char *seq, unicode_t *cpout)
+bool
+ssu32_to_utf8(SS *s, const uint32_t *c, size_t n)
 {
-    const unsigned char *s = (const unsigned char *)seq;
+    const _ss_utf8_ops_t *ops = _ss_utf8();
+    size_t len = _ss_utf32_len8(c, n);
 
-    /* z should always be > 0. */
-    int z = _ss_seqlen(seq);
-
-    unicode_t c;
-    /* 0xxxxxxx
-     * 10xxxxxx invalid
-     * 110xxxxx
-     * 1110xxxx
-     * 11110xxx
-     * 111110xx invalid
-     * 1111110x invalid
-     * 11111110 invalid
-     */
-    switch (z)
+    if (NPOS == len)
     {
-#if 0
-        /* Moved to default case for code coverage/catch-all. */
-        case 0:
-            return 0;
-#endif
-        case 1:
-            *cpout = *s;
-            return 1;
-        case 2:
-            if (UNLIKELY((s[1] & 0xC0) != 0x80))
-            {
-                return 0;
-            }
-            c = ((0x1F & s[0]) << 6) | (0x3F & s[1]);
-            *cpout = c;
-            return 2;
-        case 3:
-            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
-                         && ((s[2] & 0xC0) != 0x80)))
-            {
-                return 0;
-            }
-            c = ((0x0F & s[0]) << 12)
-                | ((0x3F & s[1]) << 6)
-                | ((0x3F & s[2]));
-            *cpout = c;
-            return 3;
-        case 4:
-            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
-                         && ((s[2] & 0xC0) != 0x80)
-                         && ((s[3] & 0xC0) != 0x80)))
-            {
-                return 0;
-            }
-            c = ((0x07 & s[0]) << 18)
-                | ((0x3F & s[1]) << 12)
-                | ((0x3F & s[2]) << 6)
-                | ((0x3F & s[3]));
-            *cpout = c;
-            return 4;
-#if 0
-        case 5:
-            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
-                         && ((s[2] & 0xC0) != 0x80)
-                         && ((s[3] & 0xC0) != 0x80)
-                         && ((s[4] & 0xC0) != 0x80)))
-            {
-                return 0;
-            }
-            c = ((0x03 & s[0]) << 24)
-                | ((0x3F & s[1]) << 18)
-                | ((0x3F & s[2]) << 12)
-                | ((0x3F & s[3]) << 6)
-                | ((0x3F & s[4]));
-            *cpout = c;
-            return 5;
-        case 6:
-            if (UNLIKELY(((s[1] & 0xC0) != 0x80)
-                         && ((s[2] & 0xC0) != 0x80)
-                         && ((s[3] & 0xC0) != 0x80)
-                         && ((s[4] & 0xC0) != 0x80)
-                         && ((s[5] & 0xC0) != 0x80)))
-            {
-                return 0;
-            }
-            c = ((0x01 & s[0]) << 30)
-                | ((0x3F & s[1]) << 24)
-                | ((0x3F & s[2]) << 18)
-                | ((0x3F & s[3]) << 12)
-                | ((0x3F & s[4]) << 6)
-                | ((0x3F & s[5]));
-            *cpout = c;
-            return 6;
-        case 7:
-            return 0;
-        case 8:
-            return 0;
-#endif
-        default:
-            break;
+        return false;
     }
 
-    return 0;
+    _ss_utf8_prepare(s, len);
+    ops->from32(c, n, *s);
+    _ss_setlen(*s, len);
+    (*s)[len] = 0;
+    return true;
 }
 
 /**
@@ -3185,7 +12303,7 @@ sse_msb32(uint32_t n)
 }
 
 /**
- * @return Pointer to the right-most character in the buffer; NULL if not found.
+ * @return Pointer to the right-most character in the first len bytes; NULL if not found.
  */
 const char *
 sse_memrchar(const char *buf, char find, size_t len)
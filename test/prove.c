@@ -1,9 +1,15 @@
 
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "bdd.h"
 #include "ss.h"
+#include "ss_inline.h"
 
 
 bool
@@ -18,6 +24,306 @@ eq(const SS s, const char *cs, size_t len)
     return len == ss_len(s) && 0 == s[len] && !memcmp(s, cs, len);
 }
 
+typedef struct counting_s
+{
+    int allocs;
+    int reallocs;
+    int frees;
+    /* Size of the last allocation or reallocation. */
+    size_t last;
+} counting_t;
+
+void *
+counting_alloc(void *ctx, size_t size)
+{
+    ((counting_t *)ctx)->allocs++;
+    ((counting_t *)ctx)->last = size;
+    return malloc(size);
+}
+
+void *
+counting_realloc(void *ctx, void *mem, size_t size)
+{
+    ((counting_t *)ctx)->reallocs++;
+    ((counting_t *)ctx)->last = size;
+    return realloc(mem, size);
+}
+
+void
+counting_free(void *ctx, void *mem)
+{
+    ((counting_t *)ctx)->frees++;
+    free(mem);
+}
+
+size_t
+counting_usable(void *ctx, void *mem)
+{
+    (void)ctx;
+    (void)mem;
+    /* Unknown, so capacity stays exactly what growth asked for. */
+    return 0;
+}
+
+/*
+ * Hands out extra bytes past every request and reports them as usable.
+ * Blocks keep their usable size in front and a canary past the end,
+ * checked when they are reallocated or freed.
+ */
+typedef struct roomy_s
+{
+    size_t extra;
+    int corrupt;
+} roomy_t;
+
+#define ROOMY_HEAD (16)
+#define ROOMY_CANARY (0xA5)
+
+void
+roomy_check(roomy_t *r, char *p)
+{
+    size_t n;
+    memcpy(&n, p, sizeof(n));
+    for (size_t i = 0; i < 8; ++i)
+    {
+        if ((unsigned char)p[ROOMY_HEAD + n + i] != ROOMY_CANARY)
+        {
+            r->corrupt++;
+            return;
+        }
+    }
+}
+
+void *
+roomy_place(roomy_t *r, char *p, size_t size)
+{
+    size_t n = size + r->extra;
+    if (!p)
+    {
+        return NULL;
+    }
+    memcpy(p, &n, sizeof(n));
+    memset(p + ROOMY_HEAD + n, ROOMY_CANARY, 8);
+    return p + ROOMY_HEAD;
+}
+
+void *
+roomy_alloc(void *ctx, size_t size)
+{
+    roomy_t *r = ctx;
+    return roomy_place(r, malloc(ROOMY_HEAD + size + r->extra + 8), size);
+}
+
+void *
+roomy_realloc(void *ctx, void *mem, size_t size)
+{
+    roomy_t *r = ctx;
+    char *p = (char *)mem - ROOMY_HEAD;
+    roomy_check(r, p);
+    return roomy_place(r, realloc(p, ROOMY_HEAD + size + r->extra + 8), size);
+}
+
+void
+roomy_free(void *ctx, void *mem)
+{
+    char *p = (char *)mem - ROOMY_HEAD;
+    roomy_check(ctx, p);
+    free(p);
+}
+
+size_t
+roomy_usable(void *ctx, void *mem)
+{
+    size_t n;
+    (void)ctx;
+    memcpy(&n, (char *)mem - ROOMY_HEAD, sizeof(n));
+    return n;
+}
+
+/* Grows then frees strings of many sizes, and fills new ones to capacity. */
+void
+roomy_churn(SS (*make)(size_t))
+{
+    size_t i;
+
+    for (i = 1; i < 300; i += 3)
+    {
+        char buf[300];
+        SS s = make(0);
+        memset(buf, 'g', sizeof(buf));
+        ss_setgrow(&s, SS_GROW25);
+        ss_cat(&s, buf, i);
+        ss_free(&s);
+
+        s = make(i);
+        memset(s, 'x', ss_cap(s));
+        ss_free(&s);
+    }
+}
+
+/* Global allocator of the ss_cache tests, it outlives a failed test. */
+counting_t g_cache_counting;
+ss_allocator_t g_cache_allocator =
+{
+    counting_alloc, counting_realloc, counting_free, counting_usable, &g_cache_counting
+};
+
+/* Allocates, grows, and frees one string, then exits. */
+void *
+stats_job(void *arg)
+{
+    (void)arg;
+    SS s = ss_newfrom(0, "thread", 6);
+    ss_cat(&s, " string", 7);
+    ss_free(&s);
+    return NULL;
+}
+
+typedef struct hook_count_s
+{
+    int calls;
+    size_t oldcap;
+    size_t newcap;
+} hook_count_t;
+
+void
+hook_count(void *ctx, const char *s, size_t oldcap, size_t newcap)
+{
+    hook_count_t *h = ctx;
+    (void)s;
+    h->calls++;
+    h->oldcap = oldcap;
+    h->newcap = newcap;
+}
+
+#define INTERN_KEYS (1000)
+
+typedef struct intern_job_s
+{
+    ss_intern_table_t *table;
+    int offset;
+    SS got[INTERN_KEYS];
+} intern_job_t;
+
+/* Interns every key, starting at a different one per thread. */
+void *
+intern_job(void *arg)
+{
+    intern_job_t *job = arg;
+    char buf[32];
+    int i;
+
+    for (i = 0; i < INTERN_KEYS; ++i)
+    {
+        int k = (i + job->offset) % INTERN_KEYS;
+        int n = snprintf(buf, sizeof(buf), "key:%d", k);
+        job->got[k] = ss_intern(job->table, buf, (size_t)n);
+    }
+
+    return NULL;
+}
+
+/* Reads and frees one reference to a shared string. */
+void *
+share_job(void *arg)
+{
+    SS *ref = arg;
+    if (7 != ss_len(*ref) || ss_find(*ref, 0, "out", 3) != 4)
+    {
+        abort();
+    }
+    ss_free(ref);
+    return NULL;
+}
+
+/* Hashes a string other threads hash at the same time. */
+void *
+hash_job(void *arg)
+{
+    const SS s = arg;
+    uint64_t h = ss_hash_view(ss_view_of(s, ss_len(s)));
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (h != ss_hash(s))
+        {
+            abort();
+        }
+    }
+    return NULL;
+}
+
+/* Writes in place to the shared empty string, which must stay untouched. */
+void *
+empty_job(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < 1000; ++i)
+    {
+        SS s = ss_empty();
+        ss_reverse(s);
+        ss_upper(s);
+        ss_lower(s);
+        ssc_upper(s);
+        ssc_lower(s);
+    }
+    return NULL;
+}
+
+/* Churns strings through the thread cache, then exits without a flush. */
+void *
+cache_job(void *arg)
+{
+    (void)arg;
+    ss_cache_setdepth(8);
+    for (int i = 0; i < 100; ++i)
+    {
+        SS s = ss_new((size_t)(i % 7) * 50);
+        ss_catf(&s, "%d", i);
+        ss_free(&s);
+    }
+    return NULL;
+}
+
+/* ss_compare for qsort. */
+int
+compare_ss(const void *a, const void *b)
+{
+    return ss_compare(*(const SS *)a, *(const SS *)b);
+}
+
+/* Next of a xorshift sequence. */
+uint64_t
+next_rand(uint64_t *x)
+{
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+/* The positions ss_count counts, one byte at a time. */
+size_t
+naive_find_all(const char *s, size_t slen, size_t index, const char *cs, size_t len, size_t *out)
+{
+    size_t n = 0;
+    size_t i = index;
+
+    while (len && i + len <= slen)
+    {
+        if (!memcmp(s + i, cs, len))
+        {
+            out[n++] = i;
+            i += len;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    return n;
+}
+
 spec("simple-string library")
 {
     describe("ss_new")
@@ -138,6 +444,85 @@ spec("simple-string library")
             check(ss_equal(s3, s4));
             check(0 == ss_compare(s3, s4));
         }
+
+        it("should order a prefix before the longer string")
+        {
+            SS s1 = ss_newfrom(0, "ab", 2);
+            SS s2 = ss_newfrom(0, "abc", 3);
+
+            check(0 > ss_compare(s1, s2));
+            check(0 < ss_compare(s2, s1));
+
+            ss_free(&s1);
+            ss_free(&s2);
+        }
+    }
+
+    describe("ss_inline.h")
+    {
+        it("should read every header class like the library")
+        {
+            char buf[70000];
+            memset(buf, 'i', sizeof(buf));
+
+            counting_t c = { 0, 0, 0, 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            ss_arena_t *ar = ss_arena_new(1024);
+            ss_stack(st, 40);
+            ss_cat(&st, buf, 20);
+
+            SS all[] =
+            {
+                ss_empty(),
+                st,
+                ss_newfrom(0, buf, 0),
+                ss_newfrom(0, buf, 200),
+                ss_newfrom(0, buf, 300),
+                ss_newfrom(0, buf, sizeof(buf)),
+                ss_newfrom(100, buf, 7),
+                ss_newfrom_aligned(0, buf, 33),
+                ss_newfrom_aligned(0, buf, 1000),
+                ss_newfrom_allocator(&a, 50, buf, 10),
+                ss_newfrom_arena(ar, 0, buf, 12),
+            };
+            size_t n = sizeof(all) / sizeof(all[0]);
+            size_t i, j;
+
+            for (i = 0; i < n; ++i)
+            {
+                check(ssi_len(all[i]) == ss_len(all[i]));
+                check(ssi_cap(all[i]) == ss_cap(all[i]));
+                check(ssi_isempty(all[i]) == ss_isempty(all[i]));
+                check(ssi_isaligned(all[i]) == ss_isaligned(all[i]));
+                for (j = 0; j < n; ++j)
+                {
+                    check(ssi_equal(all[i], all[j]) == ss_equal(all[i], all[j]));
+                }
+            }
+
+            for (i = 0; i < n; ++i)
+            {
+                ss_free(&all[i]);
+            }
+            ss_arena_free(&ar);
+        }
+
+        it("should use and respect the cached hash")
+        {
+            SS s1 = ss_newfrom(64, "same length one", 15);
+            SS s2 = ss_newfrom(64, "same length two", 15);
+            SS s3 = ss_dup(s1);
+
+            ss_hash(s1);
+            ss_hash(s2);
+            ss_hash(s3);
+            check(!ssi_equal(s1, s2));
+            check(ssi_equal(s1, s3));
+
+            ss_free(&s1);
+            ss_free(&s2);
+            ss_free(&s3);
+        }
     }
 
     describe("ss_setgrow")
@@ -210,6 +595,97 @@ spec("simple-string library")
             check(save100 != save50);
             ss_free(&s);
 
+            s = ss_empty();
+            ss_setgrow(&s, SS_GROWHUGE);
+            check(s != save0 && s != save100);
+            ss_cat(&s, "1", 1);
+            check(ss_getallocator(s) != NULL);
+            check(eq(s, "1", 1));
+            ss_free(&s);
+        }
+
+        it("should grow by size class")
+        {
+            SS s = ss_new(0);
+            ss_setgrow(&s, SS_GROWCLASS);
+
+            size_t cap = ss_cap(s);
+            size_t reallocs = 0;
+            size_t i;
+            for (i = 0; i < 100000; ++i)
+            {
+                ss_cat(&s, "x", 1);
+                if (ss_cap(s) != cap)
+                {
+                    check(ss_cap(s) > cap);
+                    check(ss_cap(s) - ss_len(s) >= ss_len(s) / 16);
+                    cap = ss_cap(s);
+                    ++reallocs;
+                }
+            }
+            check(reallocs < 80);
+            check(ss_len(s) == 100000);
+            ss_free(&s);
+        }
+
+        it("should grow by whole pages without the realloc limit")
+        {
+            char chunk[4096];
+            memset(chunk, 'p', sizeof(chunk));
+
+            SS s = ss_new(0);
+            ss_setgrow(&s, SS_GROWPAGE);
+
+            size_t cap = ss_cap(s);
+            size_t reallocs = 0;
+            size_t i;
+            for (i = 0; i < 4096; ++i)
+            {
+                ss_cat(&s, chunk, sizeof(chunk));
+                if (ss_cap(s) != cap)
+                {
+                    cap = ss_cap(s);
+                    ++reallocs;
+                }
+            }
+            check(reallocs < 30);
+            check(ss_len(s) == 4096 * sizeof(chunk));
+            check('p' == s[ss_len(s) - 1] && 0 == s[ss_len(s)]);
+            ss_free(&s);
+        }
+
+        it("should move huge strings into a mapping of their own")
+        {
+            SS s = ss_newfrom(0, "head", 4);
+            check(NULL == ss_getallocator(s));
+            ss_setgrow(&s, SS_GROWHUGE);
+            check(NULL != ss_getallocator(s));
+            check(eq(s, "head", 4));
+
+            char chunk[65536];
+            size_t i;
+            for (i = 0; i < 512; ++i)
+            {
+                memset(chunk, (int)('a' + i % 26), sizeof(chunk));
+                ss_cat(&s, chunk, sizeof(chunk));
+                check(ss_cap(s) >= ss_len(s));
+            }
+            check(ss_len(s) == 4 + 512 * sizeof(chunk));
+            check(!memcmp(s, "head", 4));
+            for (i = 0; i < 512; ++i)
+            {
+                check(s[4 + i * sizeof(chunk)] == (char)('a' + i % 26));
+            }
+            check(0 == s[ss_len(s)]);
+
+            ss_resize(&s, 10);
+            ss_fit(&s);
+            check(eq(s, "headaaaaaa", 10));
+
+            SS copy = ss_dup(s);
+            check(eq(copy, "headaaaaaa", 10));
+            ss_free(&copy);
+            ss_free(&s);
         }
     }
 
@@ -256,87 +732,1015 @@ spec("simple-string library")
         }
     }
 
-    describe("ss_maxcap")
-    {
-        /* Knowing the maximum buffer size is necessary for some applications. */
-        size_t m = ss_maxcap();
-        check(m > ((size_t)UINT_MAX - 32));
-        check(m < (size_t)UINT_MAX);
-    }
-
-    describe("ss_find and ss_rfind")
+    describe("ss allocators")
     {
-        it("should find the search string")
+        it("should use a per-string allocator for the string's lifetime")
         {
-            char buf[] = "asdfasdfasdf";
-            size_t len = strlen(buf);
+            counting_t c = { 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, NULL, &c };
 
-            char needle[] = "asdf";
-            size_t nlen = strlen(needle);
+            SS s = ss_newfrom_allocator(&a, 0, "hello", 5);
+            check(eq(s, "hello", 5));
+            check(ss_isheaptype(s));
+            check(&a == ss_getallocator(s));
+            check(1 == c.allocs);
 
-            SS s = ss_newfrom(0, buf, len);
+            ss_cat(&s, " world", 6);
+            check(eq(s, "hello world", 11));
+            check(1 == c.reallocs);
 
-            size_t index = ss_find(s, 0, needle, nlen);
-            check(index == 0);
-            index = ss_find(s, 1, needle, nlen);
-            check(index == 4);
-            index = ss_find(s, 5, needle, nlen);
-            check(index == 8);
-            index = ss_find(s, 9, needle, nlen);
-            check(index == NPOS);
+            SS d = ss_dup(s);
+            check(&a == ss_getallocator(d));
+            check(2 == c.allocs);
 
-            index = ss_rfind(s, ss_len(s) + 1, needle, nlen);
-            check(index == 8);
-            index = ss_rfind(s, 9, needle, nlen);
-            check(index == 4);
-            index = ss_rfind(s, 3, needle, nlen);
-            check(index == 0);
+            ss_free(&s);
+            ss_free(&d);
+            check(2 == c.frees);
+        }
 
+        it("should move strings between allocators")
+        {
+            counting_t c = { 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, NULL, &c };
+
+            SS s = ss_newfrom(10, "abc", 3);
+            check(NULL == ss_getallocator(s));
+            ss_setallocator(&s, &a);
+            check(&a == ss_getallocator(s));
+            check(eq(s, "abc", 3));
+            check(10 == ss_cap(s));
+            check(1 == c.allocs);
+
+            /* Same allocator is a no-op. */
+            SS save = s;
+            ss_setallocator(&s, &a);
+            check(save == s);
+
+            ss_setallocator(&s, NULL);
+            check(NULL == ss_getallocator(s));
+            check(eq(s, "abc", 3));
+            check(1 == c.frees);
             ss_free(&s);
+
+            ss_stack(t, 8);
+            ss_copy(&t, "stack", 5);
+            ss_setallocator(&t, &a);
+            check(ss_isheaptype(t));
+            check(eq(t, "stack", 5));
+            ss_free(&t);
+            check(2 == c.frees);
         }
 
-        it("should cover a find short-circuit case for code coverage")
+        it("should use the global allocator")
         {
-            char buf[] = "longstring";
-            size_t len = strlen(buf);
+            counting_t c = { 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            const ss_allocator_t *def = ss_getglobalallocator();
 
-            SS s = ss_newfrom(0, buf, len - 1);
+            ss_setglobalallocator(&a);
+            check(&a == ss_getglobalallocator());
 
-            size_t index = ss_find(s, 0, buf, len);
-            check(index == NPOS);
+            SS s = ss_new(4);
+            check(NULL == ss_getallocator(s));
+            ss_setgrow(&s, SS_GROW100);
+            ss_copy(&s, "abcdefgh", 8);
+            check(ss_cap(s) == 16);
+            ss_free(&s);
+            check(1 == c.allocs);
+            check(1 == c.reallocs);
+            check(1 == c.frees);
+
+            ss_setglobalallocator(NULL);
+            check(def == ss_getglobalallocator());
+        }
 
+        it("should claim usable space when growing")
+        {
+            SS s = ss_new(1);
+            ss_setgrow(&s, SS_GROW25);
+            ss_copy(&s, "abcdefghijklmnopqrstuvwxyz", 26);
+            /* At least the requested growth, maybe more. */
+            check(ss_cap(s) >= 32);
+            check(eq(s, "abcdefghijklmnopqrstuvwxyz", 26));
             ss_free(&s);
         }
+    }
 
-        it("should find the search string in reverse")
+    describe("ss_share")
+    {
+        it("should share without copying")
         {
-            char buf[] = "aszfzz";
-            size_t len = strlen(buf);
+            SS a = ss_newfrom(0, "payload", 7);
+            SS b = ss_share(&a);
+            SS c = ss_share(&b);
+
+            check(ss_issharedtype(a));
+            check(!ss_isheaptype(a));
+            check(a == b && b == c);
+            check(eq(a, "payload", 7));
+            ss_free(&a);
+            check(eq(b, "payload", 7));
+            ss_free(&c);
+            check(eq(b, "payload", 7));
+            ss_free(&b);
+        }
 
-            char needle[] = "asdf";
-            size_t nlen = strlen(needle);
+        it("should copy on write")
+        {
+            SS a = ss_newfrom(0, "payload", 7);
+            SS b = ss_share(&a);
+            SS c = ss_share(&a);
+
+            ss_cat(&b, "!", 1);
+            check(b != a && !ss_issharedtype(b));
+            check(eq(b, "payload!", 8));
+            check(eq(a, "payload", 7));
+
+            ss_copy(&c, "pay", 3);
+            check(c != a);
+            check(eq(c, "pay", 3));
+            check(eq(a, "payload", 7));
+
+            SS d = ss_share(&a);
+            ss_replace(&d, 0, "a", 1, "4", 1);
+            check(eq(d, "p4ylo4d", 7));
+            check(eq(a, "payload", 7));
+
+            SS e = ss_share(&a);
+            ss_unshare(&e);
+            ss_reverse(e);
+            check(eq(e, "daolyap", 7));
+            check(eq(a, "payload", 7));
+
+            SS f = ss_share(&a);
+            ss_setgrow(&f, SS_GROW100);
+            check(f != a);
+            ss_free(&f);
+
+            ss_free(&a);
+            ss_free(&b);
+            ss_free(&c);
+            ss_free(&d);
+            ss_free(&e);
+        }
 
-            SS s = ss_newfrom(0, buf, len);
+        it("should take over the block of the last reference")
+        {
+            counting_t c = { 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            const ss_allocator_t *def = ss_getglobalallocator();
+
+            ss_setglobalallocator(&a);
+            SS s = ss_newfrom(0, "payload", 7);
+            SS r = ss_share(&s);
+            ss_free(&r);
+            check(2 == c.allocs && 1 == c.frees);
+
+            SS at = s;
+            ss_overlay(&s, 0, "P", 1);
+            check(s == at);
+            check(ss_isheaptype(s) && !ss_issharedtype(s));
+            check(eq(s, "Payload", 7));
+            check(2 == c.allocs);
+
+            ss_cat(&s, "!", 1);
+            check(eq(s, "Payload!", 8));
+            check(2 == c.allocs && 1 == c.reallocs);
+            ss_free(&s);
+            check(2 == c.frees);
+            ss_setglobalallocator(def);
+        }
 
-            size_t index = ss_find(s, 0, needle, nlen);
-            check(index == NPOS);
+        it("should copy once to grow a string other references share")
+        {
+            counting_t c = { 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            const ss_allocator_t *def = ss_getglobalallocator();
 
-            index = ss_rfind(s, ss_len(s) + 1, needle, nlen);
-            check(index == NPOS);
+            ss_setglobalallocator(&a);
+            SS s = ss_newfrom(0, "payload", 7);
+            SS r = ss_share(&s);
+            check(2 == c.allocs);
+
+            ss_cat(&r, " and more", 9);
+            check(eq(r, "payload and more", 16));
+            check(eq(s, "payload", 7));
+            check(3 == c.allocs && 0 == c.reallocs);
+
+            SS t = ss_share(&s);
+            ss_insert(&t, 0, ">> ", 3);
+            check(eq(t, ">> payload", 10));
+            check(4 == c.allocs && 0 == c.reallocs);
 
             ss_free(&s);
+            ss_free(&r);
+            ss_free(&t);
+            check(4 == c.frees);
+            ss_setglobalallocator(def);
         }
 
-        it("should cover a rfind short-circuit case for code coverage")
+        it("should move stack and empty strings")
         {
-            char buf[] = "longstring";
-            size_t len = strlen(buf);
+            ss_stack(st, 16);
+            ss_copy(&st, "stack", 5);
+            SS orig = st;
+            SS b = ss_share(&st);
+            check(st != orig && st == b);
+            check(eq(orig, "stack", 5));
+            check(eq(b, "stack", 5));
+            ss_free(&st);
+            ss_free(&b);
 
-            SS s = ss_newfrom(0, buf + 1, len - 1);
+            SS e = ss_empty();
+            SS e2 = ss_share(&e);
+            check(e == e2 && ss_isemptytype(e2));
+            ss_cat(&e2, "x", 1);
+            check(is_empty(e));
+            ss_free(&e);
+            ss_free(&e2);
+        }
 
-            size_t index = ss_rfind(s, NPOS, buf, len);
-            check(index == NPOS);
+        it("should free once the last reference from any thread is gone")
+        {
+            counting_t c = { 0, 0, 0, 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            const ss_allocator_t *def = ss_getglobalallocator();
+            pthread_t threads[4];
+            SS refs[4];
+            int i;
 
+            ss_setglobalallocator(&a);
+            SS s = ss_newfrom(0, "fan out", 7);
+            for (i = 0; i < 4; ++i)
+            {
+                refs[i] = ss_share(&s);
+            }
+            check(2 == c.allocs && 1 == c.frees);
+            for (i = 0; i < 4; ++i)
+            {
+                check(0 == pthread_create(&threads[i], NULL, share_job, &refs[i]));
+            }
+            for (i = 0; i < 4; ++i)
+            {
+                pthread_join(threads[i], NULL);
+            }
+            check(1 == c.frees);
+            check(eq(s, "fan out", 7));
+            ss_free(&s);
+            check(2 == c.frees);
+            ss_setglobalallocator(def);
+        }
+    }
+
+    describe("ss_cache")
+    {
+        before_each()
+        {
+            memset(&g_cache_counting, 0, sizeof(g_cache_counting));
+        }
+
+        /* A failed check returns early, so restore the globals here. */
+        after_each()
+        {
+            ss_cache_setdepth(0);
+            ss_setglobalallocator(NULL);
+        }
+
+        it("should reuse freed blocks of the same class")
+        {
+            counting_t *c = &g_cache_counting;
+
+            ss_setglobalallocator(&g_cache_allocator);
+            ss_cache_setdepth(2);
+            SS s = ss_newfrom(0, "short lived", 11);
+            void *block = s;
+            check(ss_cap(s) >= 11);
+            ss_free(&s);
+            check(1 == c->allocs && 0 == c->frees);
+
+            s = ss_new(20);
+            check(block == (void *)s);
+            check(1 == c->allocs);
+            check(0 == ss_len(s) && ss_cap(s) >= 20);
+            ss_cat(&s, "still works", 11);
+            check(eq(s, "still works", 11));
+            ss_free(&s);
+
+            s = ss_new_aligned(20);
+            ss_free(&s);
+            s = ss_newfrom_aligned(0, "aligned", 7);
+            check(ss_isaligned(s));
+            check(eq(s, "aligned", 7));
+            ss_free(&s);
+
+            int frees = c->frees;
+            SS big = ss_new(4000);
+            ss_free(&big);
+            check(frees + 1 == c->frees);
+
+            ss_cache_flush();
+            check(c->allocs == c->frees);
+            ss_cache_setdepth(0);
+        }
+
+        it("should bound the depth of each class")
+        {
+            counting_t *c = &g_cache_counting;
+            SS v[5];
+            int i;
+
+            ss_setglobalallocator(&g_cache_allocator);
+            ss_cache_setdepth(3);
+            for (i = 0; i < 5; ++i)
+            {
+                v[i] = ss_new(40);
+            }
+            for (i = 0; i < 5; ++i)
+            {
+                ss_free(&v[i]);
+            }
+            check(5 == c->allocs && 2 == c->frees);
+            for (i = 0; i < 5; ++i)
+            {
+                v[i] = ss_new(40);
+            }
+            check(7 == c->allocs);
+            for (i = 0; i < 5; ++i)
+            {
+                ss_free(&v[i]);
+            }
+            ss_cache_setdepth(0);
+            check(c->allocs == c->frees);
+        }
+
+        it("should file blocks whose capacity grew to the usable size by their size")
+        {
+            roomy_t r = { 8, 0 };
+            ss_allocator_t a = { roomy_alloc, roomy_realloc, roomy_free, roomy_usable, &r };
+
+            ss_setglobalallocator(&a);
+            ss_cache_setdepth(8);
+
+            /* A 16 byte block reported as 24, then filled as a 32 byte one. */
+            SS s = ss_empty();
+            ss_setgrow(&s, SS_GROW25);
+            ss_cat(&s, "0123456789", 10);
+            ss_free(&s);
+            s = ss_new(20);
+            memset(s, 'x', ss_cap(s));
+            ss_free(&s);
+
+            roomy_churn(ss_new);
+            roomy_churn(ss_new_aligned);
+            ss_cache_setdepth(0);
+            check(0 == r.corrupt);
+        }
+
+        it("should file aligned blocks by their size")
+        {
+            /* Exactly what was asked for, aligned data still has padding. */
+            roomy_t r = { 0, 0 };
+            ss_allocator_t a = { roomy_alloc, roomy_realloc, roomy_free, roomy_usable, &r };
+
+            ss_setglobalallocator(&a);
+            ss_cache_setdepth(8);
+            roomy_churn(ss_new_aligned);
+            roomy_churn(ss_new);
+            ss_cache_setdepth(0);
+            check(0 == r.corrupt);
+        }
+
+        it("should flush when the thread exits")
+        {
+            counting_t *c = &g_cache_counting;
+            pthread_t t;
+
+            ss_setglobalallocator(&g_cache_allocator);
+            check(0 == pthread_create(&t, NULL, cache_job, NULL));
+            pthread_join(t, NULL);
+            check(c->allocs > 0);
+            check(c->allocs == c->frees);
+        }
+    }
+
+    describe("ss_stats")
+    {
+        it("should count allocations, growth, promotions, and frees")
+        {
+            ss_stats_t before, after;
+            bool on = ss_stats_thread(&before);
+
+            SS s = ss_newfrom(0, "abc", 3);
+            ss_setgrow(&s, SS_GROWFIT);
+            ss_cat(&s, "defgh", 5);
+            ss_fit(&s);
+            ss_free(&s);
+
+            ss_stack(st, 8);
+            ss_cat(&st, "0123", 4);
+            ss_cat(&st, "456789", 6);
+            ss_free(&st);
+
+            check(on == ss_stats_thread(&after));
+            if (on)
+            {
+                check(after.allocs - before.allocs == 2);
+                check(after.frees - before.frees == 2);
+                check(after.grows - before.grows >= 2);
+                check(after.promotions - before.promotions == 1);
+                check(after.bytes_copied - before.bytes_copied >= 4);
+                check(after.len_hist[4] - before.len_hist[4] == 2);
+            }
+            else
+            {
+                check(0 == after.allocs && 0 == after.frees && 0 == after.len_hist[4]);
+            }
+        }
+
+        it("should fold in the counts of exited threads")
+        {
+            ss_stats_t before, after;
+            bool on = ss_stats_snapshot(&before);
+            pthread_t t;
+
+            check(0 == pthread_create(&t, NULL, stats_job, NULL));
+            check(0 == pthread_join(t, NULL));
+
+            check(on == ss_stats_snapshot(&after));
+            if (on)
+            {
+                check(after.allocs - before.allocs >= 1);
+                check(after.frees - before.frees >= 1);
+                check(after.grows - before.grows >= 1);
+            }
+        }
+
+        it("should run the hook on each reallocation")
+        {
+            hook_count_t h = { 0, 0, 0 };
+            bool on = ss_stats_sethook(hook_count, &h);
+
+            SS s = ss_newfrom(0, "abc", 3);
+            ss_cat(&s, "defghijklmnop", 13);
+            check(on == (h.calls > 0));
+            if (on)
+            {
+                check(h.newcap == ss_cap(s));
+                check(h.oldcap < h.newcap);
+            }
+
+            int calls = h.calls;
+            ss_stats_sethook(NULL, NULL);
+            ss_reserve(&s, 1000);
+            check(calls == h.calls);
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_arena")
+    {
+        it("should create arena strings that ss_free ignores")
+        {
+            ss_arena_t *ar = ss_arena_new(0);
+            SS s = ss_newfrom_arena(ar, 0, "hello", 5);
+            SS e = ss_new_arena(ar, 10);
+
+            check(eq(s, "hello", 5));
+            check(ss_isarenatype(s));
+            check(!ss_isheaptype(s));
+            check(is_empty(e));
+            check(10 == ss_cap(e));
+
+            ss_free(&s);
+            check(!s);
+            ss_free(&e);
+            ss_arena_free(&ar);
+            check(!ar);
+        }
+
+        it("should grow the last string in place and copy others")
+        {
+            ss_arena_t *ar = ss_arena_new(256);
+            SS a = ss_newfrom_arena(ar, 0, "abc", 3);
+            SS b = ss_newfrom_arena(ar, 0, "def", 3);
+
+            SS save = b;
+            ss_cat(&b, "ghi", 3);
+            check(save == b);
+            check(eq(b, "defghi", 6));
+
+            save = a;
+            ss_cat(&a, "xyz", 3);
+            check(save != a);
+            check(ss_isarenatype(a));
+            check(eq(a, "abcxyz", 6));
+            check(eq(b, "defghi", 6));
+
+            /* Bigger than a block. */
+            char buf[1000];
+            memset(buf, 'z', sizeof(buf));
+            ss_cat(&a, buf, sizeof(buf));
+            check(ss_isarenatype(a));
+            check(1006 == ss_len(a));
+            check(0 == a[1006]);
+            check(eq(b, "defghi", 6));
+
+            ss_arena_free(&ar);
+        }
+
+        it("should reuse memory after reset")
+        {
+            ss_arena_t *ar = ss_arena_new(0);
+            SS first = ss_newfrom_arena(ar, 0, "one", 3);
+            SS save = first;
+            ss_newfrom_arena(ar, 0, "two", 3);
+
+            ss_arena_reset(ar);
+            SS again = ss_newfrom_arena(ar, 0, "three", 5);
+            check(save == again);
+            check(eq(again, "three", 5));
+
+            ss_arena_free(&ar);
+        }
+
+        it("should move arena strings to the heap")
+        {
+            ss_arena_t *ar = ss_arena_new(0);
+            SS s = ss_newfrom_arena(ar, 0, "keep", 4);
+            ss_heapify(&s);
+            ss_arena_free(&ar);
+
+            check(ss_isheaptype(s));
+            check(eq(s, "keep", 4));
+            ss_free(&s);
+        }
+    }
+
+    describe("ss aligned strings")
+    {
+        it("should keep the data aligned as the string grows and shrinks")
+        {
+            SS s = ss_new_aligned(0);
+            check(ss_isaligned(s));
+            check(0 == ((uintptr_t)s % 16));
+            check(is_empty(s));
+
+            char buf[70000];
+            memset(buf, 'q', sizeof(buf));
+            size_t sizes[] = { 5, 200, 1000, sizeof(buf) };
+            size_t i;
+            for (i = 0; i < sizeof(sizes)/sizeof(sizes[0]); ++i)
+            {
+                ss_copy(&s, buf, sizes[i]);
+                check(ss_isaligned(s));
+                check(0 == ((uintptr_t)s % 16));
+                check(sizes[i] == ss_len(s));
+                check(!memcmp(s, buf, sizes[i]));
+                check(0 == s[sizes[i]]);
+            }
+
+            ss_resize(&s, 3);
+            ss_fit(&s);
+            check(ss_isaligned(s));
+            check(0 == ((uintptr_t)s % 16));
+            check(eq(s, "qqq", 3));
+
+            SS d = ss_dup(s);
+            check(ss_isaligned(d));
+            check(ss_equal(s, d));
+
+            ss_free(&d);
+            ss_free(&s);
+        }
+
+        it("should equal and compare aligned strings")
+        {
+            const char *text = "the quick brown fox jumps over the lazy dog";
+            size_t len = strlen(text);
+            size_t i;
+
+            for (i = 0; i <= len; ++i)
+            {
+                SS a = ss_newfrom_aligned(64, text, len);
+                SS b = ss_newfrom_aligned(0, text, len);
+                check(ss_equal(a, b));
+                check(0 == ss_compare(a, b));
+
+                /* Garbage left past the length mustn't matter. */
+                ss_trunc(a, i);
+                ss_trunc(b, i);
+                if (i < len)
+                {
+                    a[i + 1] = 'x';
+                    b[i + 1] = 'y';
+                }
+                check(ss_equal(a, b));
+                check(0 == ss_compare(a, b));
+
+                if (i)
+                {
+                    b[i - 1] = '~';
+                    check(!ss_equal(a, b));
+                    check(0 > ss_compare(a, b));
+                    check(0 < ss_compare(b, a));
+                }
+
+                ss_free(&a);
+                ss_free(&b);
+            }
+        }
+
+        it("should find in aligned strings")
+        {
+            const char *text = "key=value; other=thing; last=one";
+            size_t len = strlen(text);
+            SS s = ss_newfrom_aligned(0, text, len);
+            SS u = ss_newfrom(0, text, len);
+
+            const char *needles[] = { "k", "key", "=", "; ", "one", "thing;", "e", "zzz", "last=one!" };
+            size_t i, j;
+            for (i = 0; i < sizeof(needles)/sizeof(needles[0]); ++i)
+            {
+                size_t nlen = strlen(needles[i]);
+                for (j = 0; j < len + 2; ++j)
+                {
+                    check(ss_find(u, j, needles[i], nlen) == ss_find(s, j, needles[i], nlen));
+                }
+            }
+
+            ss_free(&s);
+            ss_free(&u);
+        }
+    }
+
+    describe("ss compact headers")
+    {
+        it("should use the smallest header that holds the capacity")
+        {
+            counting_t c = { 0, 0, 0, 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, NULL, &c };
+            ss_setglobalallocator(&a);
+
+            /* cap, len, class byte, data, and sentinel; SS_ALIGN_ALL builds pad more. */
+            SS s = ss_new(10);
+            check(ss_isaligned(s) || 3 + 10 + 1 == c.last);
+            ss_free(&s);
+
+            s = ss_new(1000);
+            check(ss_isaligned(s) || 5 + 1000 + 1 == c.last);
+            ss_free(&s);
+
+            s = ss_new(70000);
+            check(ss_isaligned(s) || 9 + 70000 + 1 == c.last);
+            ss_free(&s);
+
+            ss_setglobalallocator(NULL);
+        }
+
+        it("should keep data when moving between header sizes")
+        {
+            char buf[70000];
+            size_t i;
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                buf[i] = 'a' + (i % 26);
+            }
+
+            SS s = ss_newfrom(0, buf, 200);
+            ss_cat(&s, buf + 200, 800);
+            check(1000 == ss_len(s));
+            check(!memcmp(s, buf, 1000));
+            ss_cat(&s, buf + 1000, sizeof(buf) - 1000);
+            check(sizeof(buf) == ss_len(s));
+            check(!memcmp(s, buf, sizeof(buf)));
+            check(0 == s[sizeof(buf)]);
+
+            /* Back down through every class. */
+            ss_trunc(s, 300);
+            ss_fit(&s);
+            check(300 == ss_cap(s));
+            check(!memcmp(s, buf, 300));
+            ss_resize(&s, 5);
+            check(5 == ss_len(s));
+            check(5 == ss_cap(s));
+            check(eq(s, "abcde", 5));
+
+            ss_free(&s);
+        }
+
+        it("should keep the growth option across header sizes")
+        {
+            SS s = ss_newfrom(0, "abcd", 4);
+            ss_setgrow(&s, SS_GROW100);
+
+            ss_cat(&s, "efgh", 4);
+            check(ss_cap(s) >= 16);
+
+            char buf[300];
+            memset(buf, 'x', sizeof(buf));
+            ss_cat(&s, buf, sizeof(buf));
+            check(ss_cap(s) >= 2 * 308);
+            check(308 == ss_len(s));
+            check(!memcmp(s, "abcdefgh", 8));
+
+            ss_setgrow(&s, SS_GROW0);
+            ss_cat(&s, buf, sizeof(buf));
+            ss_fit(&s);
+            ss_cat(&s, "z", 1);
+            check(609 == ss_cap(s));
+
+            ss_free(&s);
+        }
+
+        it("should store stack strings compactly when heapified")
+        {
+            ss_stack(st, 16);
+            ss_cat(&st, "on the stack", 12);
+            check(!ss_isheaptype(st));
+            ss_heapify(&st);
+            check(ss_isheaptype(st));
+            check(eq(st, "on the stack", 12));
+            ss_free(&st);
+        }
+    }
+
+    describe("ss_maxcap")
+    {
+        /* Knowing the maximum buffer size is necessary for some applications. */
+        size_t m = ss_maxcap();
+        check(m > ((size_t)UINT_MAX - 32));
+        check(m < (size_t)UINT_MAX);
+    }
+
+    describe("ss_find and ss_rfind")
+    {
+        it("should find the search string")
+        {
+            char buf[] = "asdfasdfasdf";
+            size_t len = strlen(buf);
+
+            char needle[] = "asdf";
+            size_t nlen = strlen(needle);
+
+            SS s = ss_newfrom(0, buf, len);
+
+            size_t index = ss_find(s, 0, needle, nlen);
+            check(index == 0);
+            index = ss_find(s, 1, needle, nlen);
+            check(index == 4);
+            index = ss_find(s, 5, needle, nlen);
+            check(index == 8);
+            index = ss_find(s, 9, needle, nlen);
+            check(index == NPOS);
+
+            index = ss_rfind(s, ss_len(s) + 1, needle, nlen);
+            check(index == 8);
+            index = ss_rfind(s, 9, needle, nlen);
+            check(index == 4);
+            index = ss_rfind(s, 3, needle, nlen);
+            check(index == 0);
+
+            ss_free(&s);
+        }
+
+        it("should cover a find short-circuit case for code coverage")
+        {
+            char buf[] = "longstring";
+            size_t len = strlen(buf);
+
+            SS s = ss_newfrom(0, buf, len - 1);
+
+            size_t index = ss_find(s, 0, buf, len);
+            check(index == NPOS);
+
+            ss_free(&s);
+        }
+
+        it("should find the search string in reverse")
+        {
+            char buf[] = "aszfzz";
+            size_t len = strlen(buf);
+
+            char needle[] = "asdf";
+            size_t nlen = strlen(needle);
+
+            SS s = ss_newfrom(0, buf, len);
+
+            size_t index = ss_find(s, 0, needle, nlen);
+            check(index == NPOS);
+
+            index = ss_rfind(s, ss_len(s) + 1, needle, nlen);
+            check(index == NPOS);
+
+            ss_free(&s);
+        }
+
+        it("should cover a rfind short-circuit case for code coverage")
+        {
+            char buf[] = "longstring";
+            size_t len = strlen(buf);
+
+            SS s = ss_newfrom(0, buf + 1, len - 1);
+
+            size_t index = ss_rfind(s, NPOS, buf, len);
+            check(index == NPOS);
+
+            ss_free(&s);
+        }
+
+        it("should find matches across vector block boundaries")
+        {
+            char buf[200];
+            memset(buf, 'a', sizeof(buf));
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+
+            /* Every position and needle length the vector loops touch. */
+            size_t nlen;
+            for (nlen = 2; nlen <= 40; ++nlen)
+            {
+                char needle[40];
+                memset(needle, 'a', nlen);
+                needle[nlen - 1] = 'b';
+
+                size_t pos;
+                for (pos = 0; pos + nlen <= sizeof(buf); pos += 7)
+                {
+                    s[pos + nlen - 1] = 'b';
+                    check(pos == ss_find(s, 0, needle, nlen));
+                    s[pos + nlen - 1] = 'a';
+                }
+                check(NPOS == ss_find(s, 0, needle, nlen));
+            }
+
+            ss_free(&s);
+        }
+
+        it("should find long needles (two-way search)")
+        {
+            char needle[] = "abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcX";
+            size_t nlen = strlen(needle);
+
+            SS s = ss_new(0);
+            int i;
+            for (i = 0; i < 20; ++i)
+            {
+                ss_cat(&s, "abcabcabcabcabcabcabcabcabcabcabcabcabc", 39);
+            }
+            check(NPOS == ss_find(s, 0, needle, nlen));
+
+            size_t at = ss_len(s);
+            ss_cat(&s, needle, nlen);
+            ss_cat(&s, "abc", 3);
+            check(at == ss_find(s, 0, needle, nlen));
+            check(NPOS == ss_find(s, at + 1, needle, nlen));
+
+            ss_free(&s);
+        }
+
+        it("should fall back to two-way search on adversarial input")
+        {
+            char needle[64];
+            memset(needle, 'a', sizeof(needle));
+            needle[62] = 'c';
+
+            char buf[4096];
+            memset(buf, 'a', sizeof(buf));
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+            check(NPOS == ss_find(s, 0, needle, sizeof(needle)));
+            check(0 == ss_count(s, 0, needle, sizeof(needle)));
+
+            ss_cat(&s, needle, sizeof(needle));
+            check(sizeof(buf) == ss_find(s, 0, needle, sizeof(needle)));
+            check(1 == ss_count(s, 0, needle, sizeof(needle)));
+
+            ss_free(&s);
+        }
+
+        it("should rfind the same match as a naive reverse search at every index")
+        {
+            char buf[300];
+            size_t i;
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                buf[i] = "abcab"[(i * 7 + i / 13) % 5];
+            }
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+
+            const char *needles[] = { "a", "ab", "bca", "cab", "abcabcab", "bb", "zz" };
+            size_t n;
+            for (n = 0; n < sizeof(needles) / sizeof(needles[0]); ++n)
+            {
+                const char *needle = needles[n];
+                size_t nlen = strlen(needle);
+                size_t index;
+                for (index = 0; index <= sizeof(buf); ++index)
+                {
+                    size_t expect = NPOS;
+                    size_t pos;
+                    for (pos = 0; pos + nlen <= sizeof(buf) && pos + nlen <= index + 1; ++pos)
+                    {
+                        if (0 == memcmp(buf + pos, needle, nlen))
+                        {
+                            expect = pos;
+                        }
+                    }
+                    check(expect == ss_rfind(s, index, needle, nlen));
+                }
+            }
+
+            ss_free(&s);
+        }
+
+        it("should rfind matches across vector block boundaries")
+        {
+            char buf[200];
+            memset(buf, 'a', sizeof(buf));
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+
+            size_t nlen;
+            for (nlen = 2; nlen <= 40; ++nlen)
+            {
+                char needle[40];
+                memset(needle, 'a', nlen);
+                needle[0] = 'b';
+
+                size_t pos;
+                for (pos = 0; pos + nlen <= sizeof(buf); pos += 7)
+                {
+                    s[pos] = 'b';
+                    check(pos == ss_rfind(s, NPOS, needle, nlen));
+                    check(NPOS == ss_rfind(s, pos + nlen - 2, needle, nlen));
+                    s[pos] = 'a';
+                }
+                check(NPOS == ss_rfind(s, NPOS, needle, nlen));
+            }
+
+            ss_free(&s);
+        }
+
+        it("should fall back to two-way rfind on adversarial input")
+        {
+            char needle[64];
+            memset(needle, 'a', sizeof(needle));
+            needle[1] = 'c';
+
+            char buf[4096];
+            memset(buf, 'a', sizeof(buf));
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+            check(NPOS == ss_rfind(s, NPOS, needle, sizeof(needle)));
+
+            ss_insert(&s, 0, needle, sizeof(needle));
+            check(0 == ss_rfind(s, NPOS, needle, sizeof(needle)));
+            check(NPOS == ss_rfind(s, sizeof(needle) - 2, needle, sizeof(needle)));
+
+            ss_free(&s);
+        }
+
+        it("should rfind long needles like a naive reverse search")
+        {
+            enum { SIZE = 20000 };
+            uint64_t x = 0x9E3779B97F4A7C15ULL;
+            char *buf = malloc(SIZE);
+            char needle[96];
+            size_t i;
+            int round;
+            bool same = true;
+
+            /* A few b's in a run of a's keeps the filter busy on false hits. */
+            for (i = 0; i < SIZE; ++i)
+            {
+                buf[i] = next_rand(&x) % 200 ? 'a' : 'b';
+            }
+            SS s = ss_newfrom(0, buf, SIZE);
+
+            for (round = 0; round < 60; ++round)
+            {
+                size_t nlen = 33 + next_rand(&x) % (sizeof(needle) - 33);
+                size_t index = round % 3 ? NPOS : next_rand(&x) % SIZE;
+                for (i = 0; i < nlen; ++i)
+                {
+                    needle[i] = next_rand(&x) % 40 ? 'a' : 'b';
+                }
+                if (round % 2)
+                {
+                    /* Plant a match so there is something to find. */
+                    memcpy(s + next_rand(&x) % (SIZE - nlen), needle, nlen);
+                }
+
+                size_t expect = NPOS;
+                size_t pos;
+                for (pos = 0; pos + nlen <= SIZE && (index == NPOS || pos + nlen <= index + 1); ++pos)
+                {
+                    if (0 == memcmp(s + pos, needle, nlen))
+                    {
+                        expect = pos;
+                    }
+                }
+                same = same && expect == ss_rfind(s, index, needle, nlen);
+            }
+            check(same);
+
+            free(buf);
             ss_free(&s);
         }
     }
@@ -354,60 +1758,565 @@ spec("simple-string library")
             ss_free(&s);
         }
 
-        it("should return zero when counting past the end of the string")
+        it("should return zero when counting past the end of the string")
+        {
+            char hay[] = "aaaaaaaaaa";
+            size_t hlen = strlen(hay);
+
+            SS s = ss_newfrom(0, hay, hlen);
+            size_t count = ss_count(s, hlen, "a", 1);
+            check(0 == count);
+            ss_free(&s);
+        }
+
+        it("should count single char strings fine")
+        {
+            char hay[] = "aaaaaaaaaa";
+            size_t hlen = strlen(hay);
+
+            SS s = ss_newfrom(0, hay, hlen);
+            size_t count = ss_count(s, 0, "a", 1);
+            check(count == hlen);
+            count = ss_count(s, 4, "a", 1);
+            check(count == (hlen - 4));
+            ss_free(&s);
+        }
+
+        it("should count multi char strings fine")
+        {
+            char hay[] = "asdfzzzasdzzzasdfzzzzasdasdf";
+            size_t hlen = strlen(hay);
+            char needle[] = "asdf";
+            size_t nlen = strlen(needle);
+            size_t expect = 3;
+
+            SS s = ss_newfrom(0, hay, hlen);
+            size_t count = ss_count(s, 0, needle, nlen);
+            check(count == expect);
+            count = ss_count(s, 4, needle, nlen);
+            check(count == (expect - 1));
+            count = ss_count(s, 0, "hello", 5);
+            check(!count);
+            ss_free(&s);
+        }
+
+        it("should short-circuit when remaining chars are too short")
+        {
+            char hay[] = "longstrin";
+            size_t hlen = strlen(hay);
+            char needle[] = "longstring";
+            size_t nlen = strlen(needle);
+            size_t expect = 0;
+
+            SS s = ss_newfrom(0, hay, hlen);
+            size_t count = ss_count(s, 0, needle, nlen);
+            check(count == expect);
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_sort")
+    {
+        it("should leave short arrays alone")
+        {
+            SS one = ss_newfrom(0, "one", 3);
+            ss_sort(NULL, 0);
+            ss_sort(&one, 1);
+            check(eq(one, "one", 3));
+            ss_free(&one);
+        }
+
+        it("should order prefixes, zero bytes, and high bytes like ss_compare")
+        {
+            const char *words[] = { "abc", "", "ab", "ab\0", "abcdefgh", "abcdefgh\0",
+                                    "abcdefghi", "\xff", "a\x80", "abcdefg", "b", "ab" };
+            const size_t lens[] = { 3, 0, 2, 3, 8, 9, 9, 1, 2, 7, 1, 2 };
+            enum { N = sizeof(lens) / sizeof(lens[0]) };
+            SS arr[N];
+            SS want[N];
+            size_t i;
+
+            for (i = 0; i < N; ++i)
+            {
+                arr[i] = ss_newfrom(0, words[i], lens[i]);
+                want[i] = arr[i];
+            }
+            qsort(want, N, sizeof(SS), compare_ss);
+            ss_sort(arr, N);
+            for (i = 0; i < N; ++i)
+            {
+                check(0 == ss_compare(arr[i], want[i]));
+            }
+            for (i = 0; i < N; ++i)
+            {
+                ss_free(&arr[i]);
+            }
+        }
+
+        it("should match qsort on random strings with long shared prefixes")
+        {
+            enum { N = 5000 };
+            SS *arr = malloc(N * sizeof(SS));
+            SS *want = malloc(N * sizeof(SS));
+            uint64_t x = 0x9E3779B97F4A7C15ULL;
+            size_t i;
+            bool same = true;
+
+            for (i = 0; i < N; ++i)
+            {
+                /* Few distinct bytes so digits tie often and runs go deep. */
+                size_t prefix = next_rand(&x) % 40;
+                size_t tail = next_rand(&x) % 12;
+                arr[i] = ss_new(prefix + tail);
+                while (prefix--)
+                {
+                    ss_cat(&arr[i], "k", 1);
+                }
+                while (tail--)
+                {
+                    char c = "ab\0\xff"[next_rand(&x) % 4];
+                    ss_cat(&arr[i], &c, 1);
+                }
+                want[i] = arr[i];
+            }
+            qsort(want, N, sizeof(SS), compare_ss);
+            ss_sort(arr, N);
+            for (i = 0; i < N; ++i)
+            {
+                same = same && 0 == ss_compare(arr[i], want[i]);
+            }
+            check(same);
+            for (i = 0; i < N; ++i)
+            {
+                ss_free(&arr[i]);
+            }
+            free(arr);
+            free(want);
+        }
+    }
+
+    describe("ss_count_parallel")
+    {
+        it("should return zero for empty needles and past the end")
+        {
+            SS s = ss_newfrom(0, "aaaa", 4);
+            check(0 == ss_count_parallel(s, 0, "", 0));
+            check(0 == ss_count_parallel(s, 4, "a", 1));
+            check(0 == ss_find_all_parallel(s, 0, "", 0, NULL, 0));
+            ss_free(&s);
+        }
+
+        it("should count matches that straddle chunks like ss_count")
+        {
+            const char *needles[] = { "a", "ab", "aa", "aba", "abab", "aaaaa", "bbbbbbbbbbbb" };
+            enum { SIZE = 5000, NEEDLES = sizeof(needles) / sizeof(needles[0]) };
+            uint64_t x = 0x2545F4914F6CDD1DULL;
+            SS s = ss_new(SIZE);
+            size_t chunk;
+            size_t k;
+            bool same = true;
+
+            for (k = 0; k < SIZE; ++k)
+            {
+                /* Runs of a's so self overlapping needles cross the seams. */
+                char c = next_rand(&x) % 5 ? 'a' : 'b';
+                ss_cat(&s, &c, 1);
+            }
+
+            for (chunk = 1; chunk <= 67; chunk += 3)
+            {
+                ss_parallel_setchunk(chunk);
+                for (k = 0; k < NEEDLES; ++k)
+                {
+                    size_t len = strlen(needles[k]);
+                    same = same && ss_count(s, 0, needles[k], len)
+                                   == ss_count_parallel(s, 0, needles[k], len);
+                    same = same && ss_count(s, 13, needles[k], len)
+                                   == ss_count_parallel(s, 13, needles[k], len);
+                }
+            }
+            ss_parallel_setchunk(0);
+            check(same);
+            check(ss_count(s, 0, "aa", 2) == ss_count_parallel(s, 0, "aa", 2));
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_find_all_parallel")
+    {
+        it("should find the positions ss_count counts")
+        {
+            enum { SIZE = 3000 };
+            uint64_t x = 0x9E3779B97F4A7C15ULL;
+            SS s = ss_new(SIZE);
+            size_t *got = malloc(SIZE * sizeof(size_t));
+            size_t *want = malloc(SIZE * sizeof(size_t));
+            size_t chunk;
+            size_t k;
+            bool same = true;
+
+            for (k = 0; k < SIZE; ++k)
+            {
+                char c = "aab"[next_rand(&x) % 3];
+                ss_cat(&s, &c, 1);
+            }
+
+            for (chunk = 1; chunk <= 40; chunk += 7)
+            {
+                ss_parallel_setchunk(chunk);
+                for (k = 2; k <= 5; ++k)
+                {
+                    const char *needle = "aaaaa";
+                    size_t n = naive_find_all(s, SIZE, 1, needle, k, want);
+                    size_t i;
+                    same = same && n == ss_find_all_parallel(s, 1, needle, k, got, SIZE);
+                    for (i = 0; i < n; ++i)
+                    {
+                        same = same && got[i] == want[i];
+                    }
+                }
+            }
+            ss_parallel_setchunk(0);
+            check(same);
+            free(got);
+            free(want);
+            ss_free(&s);
+        }
+
+        it("should write at most max positions and return the total")
+        {
+            SS s = ss_newfrom(0, "xaxaxaxax", 9);
+            size_t got[2] = { NPOS, NPOS };
+            ss_parallel_setchunk(2);
+            check(4 == ss_find_all_parallel(s, 0, "a", 1, got, 1));
+            check(1 == got[0] && NPOS == got[1]);
+            check(4 == ss_find_all_parallel(s, 0, "a", 1, NULL, 0));
+            ss_parallel_setchunk(0);
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_hash")
+    {
+        it("should not write to the shared empty string")
+        {
+            pthread_t t[4];
+            int i;
+
+            for (i = 0; i < 4; ++i)
+            {
+                check(0 == pthread_create(&t[i], NULL, empty_job, NULL));
+            }
+            for (i = 0; i < 4; ++i)
+            {
+                pthread_join(t[i], NULL);
+            }
+
+            SS s = ss_empty();
+            check(is_empty(s) && ss_isemptytype(s));
+            check(ss_hash(s) == ss_hash_view(ss_view_of("", 0)));
+        }
+
+        it("should hash equal bytes equally across string kinds")
+        {
+            ss_stack(st, 32);
+            ss_copy(&st, "hash me", 7);
+            SS h = ss_newfrom(0, "hash me", 7);
+            SS big = ss_newfrom(100, "hash me", 7);
+
+            check(ss_hash(st) == ss_hash(h));
+            check(ss_hash(big) == ss_hash(h));
+            check(ss_hash(big) == ss_hash_view(ss_view_of("hash me", 7)));
+            check(ss_hash(h) != ss_hash_view(ss_view_of("hash mf", 7)));
+            check(ss_hash_view(ss_view_of("", 0)) == ss_hash(ss_empty()));
+            check(eq(big, "hash me", 7));
+            ss_free(&st);
+            ss_free(&h);
+            ss_free(&big);
+        }
+
+        it("should not collide on short prefixes")
+        {
+            char buf[200];
+            uint64_t seen[200];
+            size_t i, j;
+            memset(buf, 'q', sizeof(buf));
+            for (i = 0; i < 200; ++i)
+            {
+                seen[i] = ss_hash_view(ss_view_of(buf, i));
+                for (j = 0; j < i; ++j)
+                {
+                    check(seen[i] != seen[j]);
+                }
+            }
+        }
+
+        it("should recompute the cached hash after changes")
+        {
+            SS s = ss_new(64);
+            ss_copy(&s, "hello", 5);
+            uint64_t h = ss_hash(s);
+            check(h == ss_hash(s));
+
+            ss_cat(&s, " world", 6);
+            check(ss_hash(s) == ss_hash_view(ss_view_of("hello world", 11)));
+            ssc_upper(s);
+            check(ss_hash(s) == ss_hash_view(ss_view_of("HELLO WORLD", 11)));
+            ss_reverse(s);
+            check(ss_hash(s) == ss_hash_view(ss_view_of("DLROW OLLEH", 11)));
+            ss_overlay(&s, 0, "dl", 2);
+            check(ss_hash(s) == ss_hash_view(ss_view_of("dlROW OLLEH", 11)));
+            ss_setlen(s, 2);
+            check(ss_hash(s) == ss_hash_view(ss_view_of("dl", 2)));
+            ss_copy(&s, "hello", 5);
+            check(h == ss_hash(s));
+
+            /* Shrinking the capacity drops the cache. */
+            ss_resize(&s, 5);
+            check(h == ss_hash(s));
+            ss_free(&s);
+        }
+
+        it("should fast reject in ss_equal without false negatives")
+        {
+            SS a = ss_newfrom(32, "abcd", 4);
+            SS b = ss_newfrom(32, "abce", 4);
+            ss_hash(a);
+            ss_hash(b);
+            check(!ss_equal(a, b));
+
+            ss_overlay(&b, 3, "d", 1);
+            check(ss_equal(a, b));
+            ss_hash(b);
+            check(ss_equal(a, b));
+            ss_free(&a);
+            ss_free(&b);
+        }
+
+        it("should cache the same hash from several threads")
+        {
+            pthread_t threads[4];
+            SS s = ss_newfrom(64, "hashed by everyone", 18);
+            int i;
+
+            for (i = 0; i < 4; ++i)
+            {
+                check(0 == pthread_create(&threads[i], NULL, hash_job, s));
+            }
+            for (i = 0; i < 4; ++i)
+            {
+                pthread_join(threads[i], NULL);
+            }
+            check(ss_hash(s) == ss_hash_view(ss_view_of("hashed by everyone", 18)));
+            ss_free(&s);
+        }
+
+        it("should drop the cached hash when a pack fails")
+        {
+            SS a = ss_newfrom(32, "abcd", 4);
+            SS b = ss_newfrom(32, "abcd", 4);
+            ss_hash(a);
+            ss_hash(b);
+
+            check(NPOS == ss_catpackBE(&a, "IIz", 1u, 2u));
+            check(4 == ss_len(a));
+            check(ss_equal(a, b));
+            check(ss_hash(a) == ss_hash(b));
+
+            check(NPOS == ss_catpackLE(&b, "Hz", 3));
+            check(ss_equal(a, b));
+            check(ss_hash(a) == ss_hash(b));
+            ss_free(&a);
+            ss_free(&b);
+        }
+    }
+
+    describe("ss_intern")
+    {
+        it("should give one string per distinct value")
+        {
+            ss_intern_table_t *it = ss_intern_new(0);
+            SS a = ss_intern(it, "metric.cpu", 10);
+            SS b = ss_intern(it, "metric.cpu", 10);
+            SS c = ss_intern(it, "metric.mem", 10);
+            SS key = ss_newfrom(0, "metric.mem", 10);
+
+            check(a == b);
+            check(a != c);
+            check(eq(a, "metric.cpu", 10));
+            check(c == ss_intern_ss(it, key));
+            check(ss_hash(c) == ss_hash(key));
+            check(a == ss_intern_find(it, "metric.cpu", 10));
+            check(NULL == ss_intern_find(it, "metric.net", 10));
+            check(2 == ss_intern_count(it));
+
+            SS e = ss_intern(it, "", 0);
+            check(e == ss_intern(it, "", 0));
+            check(0 == ss_len(e) && 0 == e[0]);
+            check(3 == ss_intern_count(it));
+
+            ss_free(&key);
+            ss_intern_free(&it);
+            check(NULL == it);
+        }
+
+        it("should grow its shards")
+        {
+            ss_intern_table_t *it = ss_intern_new(3);
+            SS first[2000];
+            char buf[32];
+            size_t i;
+
+            for (i = 0; i < 2000; ++i)
+            {
+                int n = snprintf(buf, sizeof(buf), "tag-%zu", i);
+                first[i] = ss_intern(it, buf, (size_t)n);
+            }
+            check(2000 == ss_intern_count(it));
+            for (i = 0; i < 2000; ++i)
+            {
+                int n = snprintf(buf, sizeof(buf), "tag-%zu", i);
+                check(first[i] == ss_intern_find(it, buf, (size_t)n));
+                check(first[i] == ss_intern(it, buf, (size_t)n));
+                check(eq(first[i], buf, (size_t)n));
+            }
+            check(2000 == ss_intern_count(it));
+            ss_intern_free(&it);
+        }
+
+        it("should agree across threads")
+        {
+            intern_job_t jobs[4];
+            pthread_t threads[4];
+            ss_intern_table_t *it = ss_intern_new(4);
+            int i, k;
+
+            for (i = 0; i < 4; ++i)
+            {
+                jobs[i].table = it;
+                jobs[i].offset = i * 97;
+                check(0 == pthread_create(&threads[i], NULL, intern_job, &jobs[i]));
+            }
+            for (i = 0; i < 4; ++i)
+            {
+                pthread_join(threads[i], NULL);
+            }
+
+            check(INTERN_KEYS == ss_intern_count(it));
+            for (i = 1; i < 4; ++i)
+            {
+                for (k = 0; k < INTERN_KEYS; ++k)
+                {
+                    check(jobs[0].got[k] == jobs[i].got[k]);
+                }
+            }
+            ss_intern_free(&it);
+        }
+    }
+
+    describe("ss_view")
+    {
+        it("should query views like strings")
         {
-            char hay[] = "aaaaaaaaaa";
-            size_t hlen = strlen(hay);
-
-            SS s = ss_newfrom(0, hay, hlen);
-            size_t count = ss_count(s, hlen, "a", 1);
-            check(0 == count);
+            SS s = ss_newfrom(0, "abcabcabc", 9);
+            ss_view_t v = ss_view(s);
+            ss_view_t sub = ss_view_sub(v, 3, 8);
+
+            check(v.ptr == s && 9 == v.len);
+            check(ss_find(s, 1, "abc", 3) == ss_find_view(v, 1, "abc", 3));
+            check(ss_rfind(s, NPOS, "abc", 3) == ss_rfind_view(v, NPOS, "abc", 3));
+            check(ss_count(s, 0, "abc", 3) == ss_count_view(v, 0, "abc", 3));
+            check(5 == sub.len && !memcmp(sub.ptr, "abcab", 5));
+            check(0 == ss_find_view(sub, 0, "abc", 3));
+            check(NPOS == ss_find_view(sub, 1, "abc", 3));
+            check(0 == ss_rfind_view(sub, NPOS, "abc", 3));
+            check(1 == ss_count_view(sub, 0, "abc", 3));
+            check(0 == ss_view_sub(v, 7, 3).len);
+            check(0 == ss_view_sub(v, 20, 30).len);
             ss_free(&s);
         }
 
-        it("should count single char strings fine")
+        it("should compare views")
         {
-            char hay[] = "aaaaaaaaaa";
-            size_t hlen = strlen(hay);
+            ss_view_t a = ss_view_of("abc", 3);
+            ss_view_t b = ss_view_of("abcd", 4);
+
+            check(ss_equal_view(a, ss_view_sub(b, 0, 3)));
+            check(!ss_equal_view(a, b));
+            check(ss_compare_view(a, b) < 0);
+            check(ss_compare_view(b, a) > 0);
+            check(ss_compare_view(ss_view_of("abd", 3), b) > 0);
+            check(0 == ss_compare_view(a, ss_view_of("abc", 3)));
+            check(0 == ss_compare_view(ss_view_of("", 0), ss_view_of(NULL, 0)));
+        }
+    }
 
-            SS s = ss_newfrom(0, hay, hlen);
-            size_t count = ss_count(s, 0, "a", 1);
-            check(count == hlen);
-            count = ss_count(s, 4, "a", 1);
-            check(count == (hlen - 4));
-            ss_free(&s);
+    describe("ss_split_next")
+    {
+        it("should split into every field")
+        {
+            const char *want[] = { "a", "bc", "", "d", "" };
+            ss_split_t it;
+            ss_view_t f;
+            size_t n = 0;
+
+            ss_split_init(&it, ss_view_of("a,bc,,d,", 8));
+            while (ss_split_next(&it, ",", 1, &f))
+            {
+                check(n < 5);
+                check(ss_equal_view(f, ss_view_of(want[n], strlen(want[n]))));
+                ++n;
+            }
+            check(5 == n);
+            check(!ss_split_next(&it, ",", 1, &f));
         }
 
-        it("should count multi char strings fine")
+        it("should split on long delimiters and change them mid-way")
         {
-            char hay[] = "asdfzzzasdzzzasdfzzzzasdasdf";
-            size_t hlen = strlen(hay);
-            char needle[] = "asdf";
-            size_t nlen = strlen(needle);
-            size_t expect = 3;
+            ss_split_t it;
+            ss_view_t f;
+
+            ss_split_init(&it, ss_view_of("k: v\r\nx: y\r\n\r\nbody", 18));
+            check(ss_split_next(&it, ": ", 2, &f) && 1 == f.len && 'k' == f.ptr[0]);
+            check(ss_split_next(&it, "\r\n", 2, &f) && 1 == f.len && 'v' == f.ptr[0]);
+            check(ss_split_next(&it, "\r\n\r\n", 4, &f) && 4 == f.len);
+            check(ss_split_next(&it, "", 0, &f) && 4 == f.len && !memcmp(f.ptr, "body", 4));
+            check(!ss_split_next(&it, "\r\n", 2, &f));
+        }
 
-            SS s = ss_newfrom(0, hay, hlen);
-            size_t count = ss_count(s, 0, needle, nlen);
-            check(count == expect);
-            count = ss_count(s, 4, needle, nlen);
-            check(count == (expect - 1));
-            count = ss_count(s, 0, "hello", 5);
-            check(!count);
-            ss_free(&s);
+        it("should give one empty field for an empty view")
+        {
+            ss_split_t it;
+            ss_view_t f;
+
+            ss_split_init(&it, ss_view_of("", 0));
+            check(ss_split_next(&it, ",", 1, &f) && 0 == f.len);
+            check(!ss_split_next(&it, ",", 1, &f));
         }
 
-        it("should short-circuit when remaining chars are too short")
+        it("should parse a CSV line without allocating")
         {
-            char hay[] = "longstrin";
-            size_t hlen = strlen(hay);
-            char needle[] = "longstring";
-            size_t nlen = strlen(needle);
-            size_t expect = 0;
+            counting_t c = { 0, 0, 0, 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            const ss_allocator_t *def = ss_getglobalallocator();
+            const char line[] = "id,name,email,created,score,active,notes,country";
+            ss_split_t it;
+            ss_view_t f;
+            size_t n = 0;
+            size_t bytes = 0;
+
+            ss_setglobalallocator(&a);
+            ss_split_init(&it, ss_view_of(line, strlen(line)));
+            while (ss_split_next(&it, ",", 1, &f))
+            {
+                ++n;
+                bytes += f.len;
+            }
+            ss_setglobalallocator(def);
 
-            SS s = ss_newfrom(0, hay, hlen);
-            size_t count = ss_count(s, 0, needle, nlen);
-            check(count == expect);
-            ss_free(&s);
+            check(8 == n);
+            check(strlen(line) - 7 == bytes);
+            check(0 == c.allocs && 0 == c.reallocs && 0 == c.frees);
         }
     }
 
@@ -706,6 +2615,27 @@ spec("simple-string library")
             ss_free(&s);
         }
 
+        it("should copy long clean runs between escapes")
+        {
+            char buf[] = "a long enough run of clean text\\tthen another long run of clean text\\n"
+                         "and a final run of clean text long enough for vectors\\\\";
+            char ans[] = "a long enough run of clean text\tthen another long run of clean text\n"
+                         "and a final run of clean text long enough for vectors\\";
+
+            SS s = ss_newfrom(0, buf, sizeof(buf) - 1);
+            ssc_unesc(s);
+            check(eq(s, ans, sizeof(ans) - 1));
+            ss_free(&s);
+        }
+
+        it("should keep a backslash at the end")
+        {
+            SS s = ss_newfrom(0, "clean text that ends with a backslash\\", 38);
+            ssc_unesc(s);
+            check(eq(s, "clean text that ends with a backslash\\", 38));
+            ss_free(&s);
+        }
+
         it("should overcome a false positive")
         {
             char buf[] = "\\z";
@@ -743,6 +2673,252 @@ spec("simple-string library")
             check(eq(s, ans, alen));
             ss_free(&s);
         }
+
+        it("should escape in place when the capacity allows")
+        {
+            SS s = ss_newfrom(64, "tab\there", 8);
+            SS save = s;
+            ssc_esc(&s);
+            check(save == s);
+            check(eq(s, "tab\\there", 9));
+            ss_free(&s);
+        }
+
+        it("should stop at a null byte")
+        {
+            SS s = ss_newfrom(0, "a\nb\0c\n", 6);
+            ssc_esc(&s);
+            check(eq(s, "a\\nb", 4));
+            ss_free(&s);
+        }
+
+        it("should match a byte at a time across vector boundaries")
+        {
+            char buf[300];
+            char ans[1200];
+            size_t off[301];
+            size_t alen = 0;
+            size_t i;
+            uint64_t x = 0x2545F4914F6CDD1DULL;
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                off[i] = alen;
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                /* Mostly clean text, with runs of every length in between. */
+                buf[i] = (x & 7) ? (char)('a' + (x >> 8) % 26) : (char)(1 + (x >> 16) % 255);
+                unsigned char c = (unsigned char)buf[i];
+                if (c < 0x20 || 0x7F == c || '\\' == c || '\'' == c || '"' == c)
+                {
+                    const char *named = strchr("\a\b\x1B\f\n\r\t\v\\\'\"", c);
+                    ans[alen++] = '\\';
+                    if (named)
+                    {
+                        ans[alen++] = "abefnrtv\\\'\""[named - "\a\b\x1B\f\n\r\t\v\\\'\""];
+                    }
+                    else
+                    {
+                        alen += (size_t)sprintf(ans + alen, "x%02X", c);
+                    }
+                }
+                else
+                {
+                    ans[alen++] = buf[i];
+                }
+            }
+
+            off[sizeof(buf)] = alen;
+
+            for (i = 0; i <= sizeof(buf); i += 7)
+            {
+                SS s = ss_newfrom(0, buf, i);
+                ssc_esc(&s);
+                check(eq(s, ans, off[i]));
+                ss_free(&s);
+            }
+        }
+    }
+
+    describe("ssc_esc_json and ss_esc_json")
+    {
+        it("should escape for a JSON string literal")
+        {
+            char buf[] = "say \"hi\"\\\b\f\n\r\t\x01\x1F'\x7F\xC3\xA9";
+            char ans[] = "say \\\"hi\\\"\\\\\\b\\f\\n\\r\\t\\u0001\\u001F'\x7F\xC3\xA9";
+            SS s = ss_newfrom(0, buf, sizeof(buf) - 1);
+            ssc_esc_json(&s);
+            check(eq(s, ans, sizeof(ans) - 1));
+            ss_free(&s);
+        }
+
+        it("should escape embedded null bytes")
+        {
+            SS s = ss_newfrom(0, "a\0b", 3);
+            SS t = ss_dup(s);
+            ss_esc_json(&s);
+            check(eq(s, "a\\u0000b", 8));
+            ssc_esc_json(&t);
+            check(eq(t, "a", 1));
+            ss_free(&s);
+            ss_free(&t);
+        }
+
+        it("should leave clean strings alone")
+        {
+            SS s = ss_newfrom(0, "plain text that is long enough for a vector", 43);
+            SS save = s;
+            ss_esc_json(&s);
+            check(save == s);
+            check(eq(s, "plain text that is long enough for a vector", 43));
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_hexencode and ss_hexdecode")
+    {
+        it("should append uppercase digits and decode either case")
+        {
+            SS s = ss_newfrom(0, "id=", 3);
+            ss_hexencode(&s, "\x00\x7F\xAB\xff", 4);
+            check(eq(s, "id=007FABFF", 11));
+
+            ss_clear(s);
+            check(ss_hexdecode(&s, "48656c6C6F", 10));
+            check(eq(s, "Hello", 5));
+            check(ss_hexdecode(&s, "", 0));
+            check(eq(s, "Hello", 5));
+            ss_free(&s);
+        }
+
+        it("should reject odd lengths and non-digits without changing the string")
+        {
+            SS s = ss_newfrom(0, "keep", 4);
+            check(!ss_hexdecode(&s, "ABC", 3));
+            check(!ss_hexdecode(&s, "0g", 2));
+            check(!ss_hexdecode(&s, "000102030405060708090A0B0C0D0E0F"
+                                    "101112131415161718191A1B1C1D1E1F"
+                                    "2021222324252627282930313233343:", 96));
+            check(eq(s, "keep", 4));
+            ss_free(&s);
+        }
+
+        it("should round trip every length across vector boundaries")
+        {
+            char buf[200];
+            size_t i;
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                buf[i] = (char)(i * 37 + 11);
+            }
+
+            for (i = 0; i <= sizeof(buf); ++i)
+            {
+                SS hex = ss_empty();
+                SS back = ss_empty();
+                size_t k;
+                ss_hexencode(&hex, buf, i);
+                check(ss_len(hex) == 2 * i);
+                for (k = 0; k < i; ++k)
+                {
+                    check(hex[2 * k] == "0123456789ABCDEF"[(unsigned char)buf[k] >> 4]);
+                    check(hex[2 * k + 1] == "0123456789ABCDEF"[buf[k] & 0x0F]);
+                }
+                check(ss_hexdecode(&back, hex, ss_len(hex)));
+                check(eq(back, buf, i));
+                if (i)
+                {
+                    /* A bad digit in any position is found. */
+                    hex[(i * 7) % (2 * i)] = 'x';
+                    check(!ss_hexdecode(&back, hex, ss_len(hex)));
+                    check(eq(back, buf, i));
+                }
+                ss_free(&hex);
+                ss_free(&back);
+            }
+        }
+    }
+
+    describe("ss_b64encode and ss_b64decode")
+    {
+        it("should match the RFC 4648 test vectors")
+        {
+            static const char *plain[] = { "", "f", "fo", "foo", "foob", "fooba", "foobar" };
+            static const char *coded[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+            size_t i;
+            for (i = 0; i < 7; ++i)
+            {
+                SS s = ss_empty();
+                ss_b64encode(&s, plain[i], strlen(plain[i]));
+                check(eq(s, coded[i], strlen(coded[i])));
+                ss_clear(s);
+                check(ss_b64decode(&s, coded[i], strlen(coded[i])));
+                check(eq(s, plain[i], strlen(plain[i])));
+                ss_free(&s);
+            }
+        }
+
+        it("should accept missing padding and reject invalid input")
+        {
+            SS s = ss_newfrom(0, ">", 1);
+            check(ss_b64decode(&s, "Zm9vYg", 6));
+            check(ss_b64decode(&s, "Zm9vYmE", 7));
+            check(eq(s, ">foobfooba", 10));
+            check(!ss_b64decode(&s, "Zm9vY", 5));
+            check(!ss_b64decode(&s, "Zm9v Yg==", 9));
+            check(!ss_b64decode(&s, "Zg=", 3));
+            check(!ss_b64decode(&s, "Z===", 4));
+            check(!ss_b64decode(&s, "Zm-_", 4));
+            check(eq(s, ">foobfooba", 10));
+            ss_free(&s);
+        }
+
+        it("should round trip every length across vector boundaries")
+        {
+            static const char digits[] =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            unsigned char buf[200];
+            char ref[280];
+            size_t i;
+            uint64_t x = 0x853C49E6748FEA9BULL;
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                buf[i] = (unsigned char)x;
+            }
+
+            for (i = 0; i <= sizeof(buf); ++i)
+            {
+                SS b64 = ss_empty();
+                SS back = ss_empty();
+                size_t k, r = 0;
+                for (k = 0; k < i; k += 3)
+                {
+                    uint32_t v = (uint32_t)buf[k] << 16;
+                    v |= k + 1 < i ? (uint32_t)buf[k + 1] << 8 : 0;
+                    v |= k + 2 < i ? buf[k + 2] : 0;
+                    ref[r++] = digits[v >> 18];
+                    ref[r++] = digits[(v >> 12) & 0x3F];
+                    ref[r++] = k + 1 < i ? digits[(v >> 6) & 0x3F] : '=';
+                    ref[r++] = k + 2 < i ? digits[v & 0x3F] : '=';
+                }
+
+                ss_b64encode(&b64, (const char *)buf, i);
+                check(eq(b64, ref, r));
+                check(ss_b64decode(&back, b64, ss_len(b64)));
+                check(eq(back, (const char *)buf, i));
+                if (r > 4)
+                {
+                    b64[(i * 5) % (r - 4)] = '*';
+                    check(!ss_b64decode(&back, b64, ss_len(b64)));
+                    check(eq(back, (const char *)buf, i));
+                }
+                ss_free(&b64);
+                ss_free(&back);
+            }
+        }
     }
 
     describe("ss_copy")
@@ -932,6 +3108,14 @@ spec("simple-string library")
             ss_free(&s);
         }
 
+        it("should ignore false positive when replacing same-sized strings")
+        {
+            SS s = ss_newfrom(0, "abacab", 6);
+            ss_replace(&s, 0, "ab", 2, "zz", 2);
+            check(eq(s, "zzaczz", 6));
+            ss_free(&s);
+        }
+
         it("should short-circuit if replace len is 0 (code coverage)")
         {
             SS s = ss_newfrom(0, "asdf", 4);
@@ -965,6 +3149,144 @@ spec("simple-string library")
         }
     }
 
+    describe("ss_replacemany")
+    {
+        it("should replace several patterns in one pass")
+        {
+            const char *from[] = { "cat", "dog", "a" };
+            size_t flen[] = { 3, 3, 1 };
+            const char *to[] = { "lion", "ox", "A" };
+            size_t tlen[] = { 4, 2, 1 };
+            const char ans[] = "the lion And the ox Ate";
+
+            SS s = ss_newfrom(0, "the cat and the dog ate", 23);
+            ss_replacemany(&s, from, flen, to, tlen, 3);
+            check(eq(s, ans, strlen(ans)));
+            check(s[ss_len(s)] == 0);
+            ss_free(&s);
+        }
+
+        it("should shrink in place")
+        {
+            const char *from[] = { "abc", "de" };
+            size_t flen[] = { 3, 2 };
+            const char *to[] = { "x", "" };
+            size_t tlen[] = { 1, 0 };
+
+            SS s = ss_newfrom(0, "abcdeabcfde", 11);
+            SS save = s;
+            ss_replacemany(&s, from, flen, to, tlen, 2);
+            check(s == save);
+            check(eq(s, "xxf", 3));
+            ss_free(&s);
+        }
+
+        it("should grow with a single reallocation")
+        {
+            const char *from[] = { "a", "b" };
+            size_t flen[] = { 1, 1 };
+            const char *to[] = { "aaaa", "bbbb" };
+            size_t tlen[] = { 4, 4 };
+
+            SS s = ss_newfrom(0, "abab", 4);
+            ss_replacemany(&s, from, flen, to, tlen, 2);
+            check(eq(s, "aaaabbbbaaaabbbb", 16));
+            ss_free(&s);
+        }
+
+        it("should handle output that moves both ahead and behind")
+        {
+            const char *from[] = { "aaaa", "b" };
+            size_t flen[] = { 4, 1 };
+            const char *to[] = { "", "bbbbbbbb" };
+            size_t tlen[] = { 0, 8 };
+
+            SS s = ss_newfrom(0, "aaaaxbyaaaab", 12);
+            ss_replacemany(&s, from, flen, to, tlen, 2);
+            check(eq(s, "xbbbbbbbbybbbbbbbb", 18));
+            ss_free(&s);
+        }
+
+        it("should prefer the leftmost then the longest match")
+        {
+            const char *from[] = { "bc", "abcd", "ab", "abc" };
+            size_t flen[] = { 2, 4, 2, 3 };
+            const char *to[] = { "1", "2", "3", "4" };
+            size_t tlen[] = { 1, 1, 1, 1 };
+
+            SS s = ss_newfrom(0, "abcdabcxbc", 10);
+            ss_replacemany(&s, from, flen, to, tlen, 4);
+            check(eq(s, "24x1", 4));
+            ss_free(&s);
+        }
+
+        it("should not search replacements again")
+        {
+            const char *from[] = { "a", "b" };
+            size_t flen[] = { 1, 1 };
+            const char *to[] = { "b", "a" };
+            size_t tlen[] = { 1, 1 };
+
+            SS s = ss_newfrom(0, "aabb", 4);
+            ss_replacemany(&s, from, flen, to, tlen, 2);
+            check(eq(s, "bbaa", 4));
+            ss_free(&s);
+        }
+
+        it("should ignore empty patterns and leave unmatched strings alone")
+        {
+            const char *from[] = { "", "zz" };
+            size_t flen[] = { 0, 2 };
+            const char *to[] = { "x", "y" };
+            size_t tlen[] = { 1, 1 };
+
+            SS s = ss_newfrom(0, "asdf", 4);
+            SS save = s;
+            ss_replacemany(&s, from, flen, to, tlen, 2);
+            check(s == save);
+            check(eq(s, "asdf", 4));
+            ss_replacemany(&s, from, flen, to, tlen, 0);
+            check(eq(s, "asdf", 4));
+            ss_free(&s);
+        }
+
+        it("should move stack strings to the heap when growing")
+        {
+            const char *from[] = { "o" };
+            size_t flen[] = { 1 };
+            const char *to[] = { "0000" };
+            size_t tlen[] = { 4 };
+
+            ss_stack(s, 8);
+            ss_copy(&s, "foo", 3);
+            ss_replacemany(&s, from, flen, to, tlen, 1);
+            check(ss_isheaptype(s));
+            check(eq(s, "f00000000", 9));
+            ss_free(&s);
+        }
+
+        it("should match ss_replace for distinct tokens")
+        {
+            const char *from[] = { "{name}", "{age}", "{city}" };
+            size_t flen[] = { 6, 5, 6 };
+            const char *to[] = { "Ada", "36", "London" };
+            size_t tlen[] = { 3, 2, 6 };
+            const char tmpl[] = "{name} is {age}, {name} lives in {city} at {age}";
+
+            SS a = ss_newfrom(0, tmpl, strlen(tmpl));
+            SS b = ss_newfrom(0, tmpl, strlen(tmpl));
+            size_t i;
+            for (i = 0; i < 3; ++i)
+            {
+                ss_replace(&a, 0, from[i], flen[i], to[i], tlen[i]);
+            }
+            ss_replacemany(&b, from, flen, to, tlen, 3);
+            check(ss_equal(a, b));
+            ss_free(&a);
+            ss_free(&b);
+        }
+    }
+
     describe("ss_replacerange")
     {
         it("should replace with long string and empty string")
@@ -1187,6 +3509,30 @@ spec("simple-string library")
             check(!memcmp(s, ans, len));
             ss_free(&s);
         }
+
+        it("should reverse every length the vector loops touch")
+        {
+            char buf[200];
+            size_t len;
+            for (len = 0; len <= sizeof(buf); ++len)
+            {
+                size_t i;
+                for (i = 0; i < len; ++i)
+                {
+                    buf[i] = (char)(i * 31 + 7);
+                }
+
+                SS s = ss_newfrom(0, buf, len);
+                ss_reverse(s);
+                check(ss_len(s) == len);
+                check(s[len] == 0);
+                for (i = 0; i < len; ++i)
+                {
+                    check(s[i] == buf[len - 1 - i]);
+                }
+                ss_free(&s);
+            }
+        }
     }
 
     describe("ss_trim")
@@ -1373,6 +3719,163 @@ spec("simple-string library")
             check(is_empty(s));
             ss_free(&s);
         }
+
+        it("should convert every byte by length, past a NUL")
+        {
+            char buf[] = "Content-Type";
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+            ss_upper(s);
+            check(eq(s, "CONTENT-TYPE", sizeof(buf)));
+            ss_lower(s);
+            check(eq(s, "content-type", sizeof(buf)));
+            ss_free(&s);
+        }
+
+        it("should only change ASCII letters at any length")
+        {
+            char buf[300];
+            char up[300];
+            char low[300];
+            size_t i;
+
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                unsigned char c = (unsigned char)(i * 7 + 3);
+                buf[i] = (char)c;
+                up[i] = (char)((c >= 'a' && c <= 'z') ? c - 32 : c);
+                low[i] = (char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+            }
+            for (i = 0; i < 70; ++i)
+            {
+                SS s = ss_newfrom(0, buf + i, sizeof(buf) - 2 * i);
+                ss_upper(s);
+                check(eq(s, up + i, sizeof(buf) - 2 * i));
+                ss_lower(s);
+                check(eq(s, low + i, sizeof(buf) - 2 * i));
+                ss_free(&s);
+            }
+            for (i = 0; i < 70; ++i)
+            {
+                SS s = ss_newfrom(0, buf + 60, i);
+                ss_upper(s);
+                check(eq(s, up + 60, i));
+                ss_lower(s);
+                check(eq(s, low + 60, i));
+                ss_free(&s);
+            }
+        }
+    }
+
+    describe("ss_casefind, ss_casecompare, and ss_caseequal")
+    {
+        it("should compare ignoring ASCII case")
+        {
+            SS a = ss_newfrom(0, "Content-Length", 14);
+            SS b = ss_newfrom(0, "content-length", 14);
+            SS c = ss_newfrom(0, "content-type", 12);
+            SS d = ss_newfrom(0, "content", 7);
+
+            check(ss_caseequal(a, b));
+            check(!ss_equal(a, b));
+            check(0 == ss_casecompare(a, b));
+            check(!ss_caseequal(a, c));
+            check(ss_casecompare(a, c) < 0);
+            check(ss_casecompare(c, a) > 0);
+            check(ss_casecompare(d, a) < 0);
+            check(ss_casecompare(a, d) > 0);
+            /* Letters fold to lowercase like strcasecmp, 'A' sorts after '['. */
+            ss_copy(&c, "[", 1);
+            ss_copy(&d, "A", 1);
+            check(ss_casecompare(d, c) > 0);
+            check(!ss_caseequal(c, d));
+            ss_free(&a);
+            ss_free(&b);
+            ss_free(&c);
+            ss_free(&d);
+        }
+
+        it("should find mismatches at every position")
+        {
+            char buf[200];
+            size_t i;
+
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                buf[i] = (char)('a' + i % 26);
+            }
+            SS a = ss_newfrom(0, buf, sizeof(buf));
+            SS b = ss_dup(a);
+            ss_upper(b);
+            check(ss_caseequal(a, b));
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                b[i] = '@';
+                check(!ss_caseequal(a, b));
+                check(ss_casecompare(a, b) > 0);
+                b[i] = (char)(buf[i] - 32);
+            }
+            check(0 == ss_casecompare(a, b));
+            ss_free(&a);
+            ss_free(&b);
+        }
+
+        it("should find ignoring ASCII case")
+        {
+            SS s = ss_newfrom(0, "Host: x\r\nCONTENT-LENGTH: 42\r\nAccept: */*\r\n", 43);
+
+            check(9 == ss_casefind(s, 0, "content-length", 14));
+            check(9 == ss_casefind(s, 9, "Content-Length", 14));
+            check(NPOS == ss_casefind(s, 10, "content-length", 14));
+            check(0 == ss_casefind(s, 0, "h", 1));
+            check(29 == ss_casefind(s, 1, "a", 1));
+            check(NPOS == ss_casefind(s, 0, "", 0));
+            check(NPOS == ss_casefind(s, 0, "accept: */*\r\n!", 14));
+            check(29 == ss_casefind(s, 0, "accept: */*\r\n", 13));
+            check(NPOS == ss_casefind(s, 100, "a", 1));
+            ss_free(&s);
+        }
+
+        it("should find at every offset across vector widths")
+        {
+            char buf[160];
+            size_t i;
+
+            memset(buf, '-', sizeof(buf));
+            for (i = 0; i + 5 <= sizeof(buf); ++i)
+            {
+                SS s = ss_newfrom(0, buf, sizeof(buf));
+                memcpy(s + i, "XyZzY", 5);
+                check(i == ss_casefind(s, 0, "xYzZy", 5));
+                check(i == ss_casefind(s, i, "XYZZY", 5));
+                check(NPOS == ss_casefind(s, i + 1, "xyzzy", 5));
+                check(i == ss_casefind(s, 0, "x", 1));
+                check(i == ss_casefind(s, 0, "xy", 2));
+                ss_free(&s);
+            }
+        }
+
+        it("should fall back to two-way search on adversarial input")
+        {
+            char needle[81];
+            memset(needle, 'a', sizeof(needle));
+            needle[40] = 'b';
+
+            char buf[16384];
+            memset(buf, 'a', sizeof(buf));
+            SS s = ss_newfrom(0, buf, sizeof(buf));
+            check(NPOS == ss_casefind(s, 0, needle, sizeof(needle)));
+
+            memset(needle, 'A', sizeof(needle));
+            needle[40] = 'B';
+            ss_cat(&s, needle, sizeof(needle));
+            ss_cat(&s, "aBa", 3);
+            memset(needle, 'a', sizeof(needle));
+            needle[40] = 'b';
+            check(sizeof(buf) == ss_casefind(s, 0, needle, sizeof(needle)));
+            check(NPOS == ss_casefind(s, sizeof(buf) + 1, needle, sizeof(needle)));
+
+            ss_free(&s);
+        }
     }
 
     describe("ss_copyf")
@@ -1426,6 +3929,41 @@ spec("simple-string library")
             check(eq(s, buf, len));
             ss_free(&s);
         }
+
+        it("should grow once to fit long output")
+        {
+            counting_t c = { 0, 0, 0, 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, NULL, &c };
+            ss_setglobalallocator(&a);
+
+            static char big[70000];
+            memset(big, 'w', sizeof(big) - 1);
+            big[sizeof(big) - 1] = 0;
+
+            SS s = ss_empty();
+            ss_setgrow(&s, SS_GROW0);
+            check(!ss_catf(&s, "[%s]", big));
+            check(ss_len(s) == sizeof(big) + 1);
+            check('[' == s[0] && ']' == s[sizeof(big)]);
+            check(0 == s[sizeof(big) + 1]);
+            check(1 == c.allocs + c.reallocs);
+
+            ss_catf(&s, "%d:%s", 42, big + 60000);
+            check(ss_len(s) == sizeof(big) + 1 + 3 + 9999);
+            check(!memcmp(s + sizeof(big) + 1, "42:www", 6));
+            check(2 == c.allocs + c.reallocs);
+
+            /* Short output goes through the scratch buffer. */
+            ss_clear(s);
+            ss_fit(&s);
+            int before = c.allocs + c.reallocs;
+            ss_catf(&s, "%s-%d", "short", 7);
+            check(eq(s, "short-7", 7));
+            check(before + 1 == c.allocs + c.reallocs);
+
+            ss_free(&s);
+            ss_setglobalallocator(NULL);
+        }
     }
 
     describe("ss_catint64")
@@ -1484,6 +4022,36 @@ spec("simple-string library")
             check(eq(s, buf, len));
             ss_free(&s);
         }
+
+        it("should append after the existing content")
+        {
+            SS s = ss_newfrom(0, "n=", 2);
+            ss_catint64(&s, -1234567890123LL);
+            ss_catint64(&s, 42);
+            check(eq(s, "n=-123456789012342", 18));
+            ss_free(&s);
+        }
+
+        it("should write every length")
+        {
+            char buf[32];
+            int64_t n = 1;
+            int i;
+            SS s = ss_empty();
+            for (i = 0; i < 19; ++i)
+            {
+                ss_clear(s);
+                ss_catint64(&s, n - 1);
+                snprintf(buf, sizeof(buf), "%lld", (long long)(n - 1));
+                check(eq(s, buf, strlen(buf)));
+                ss_clear(s);
+                ss_catint64(&s, -n);
+                snprintf(buf, sizeof(buf), "%lld", (long long)-n);
+                check(eq(s, buf, strlen(buf)));
+                n = i < 18 ? n * 10 : n;
+            }
+            ss_free(&s);
+        }
     }
 
     describe("ss_catuint64")
@@ -1520,6 +4088,467 @@ spec("simple-string library")
             check(eq(s, buf, len));
             ss_free(&s);
         }
+
+        it("should append after the existing content")
+        {
+            SS s = ss_newfrom(0, "[", 1);
+            ss_catuint64(&s, 100000000ULL);
+            ss_cat(&s, "]", 1);
+            check(eq(s, "[100000000]", 11));
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_cathex")
+    {
+        it("should append uppercase hexadecimal without leading zeros")
+        {
+            SS s = ss_newfrom(0, "0x", 2);
+            ss_cathex(&s, 0);
+            check(eq(s, "0x0", 3));
+            ss_clear(s);
+            ss_cathex(&s, 0xDEADBEEFULL);
+            ss_cat(&s, ",", 1);
+            ss_cathex(&s, 0x10ULL);
+            ss_cat(&s, ",", 1);
+            ss_cathex(&s, 0xFFFFFFFFFFFFFFFFULL);
+            check(eq(s, "DEADBEEF,10,FFFFFFFFFFFFFFFF", 28));
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_catdouble")
+    {
+        it("should append the shortest digits that read back")
+        {
+            static const struct { double val; const char *s; } cases[] =
+            {
+                { 0.0, "0" },
+                { -0.0, "0" },
+                { 1.0, "1" },
+                { 100.0, "100" },
+                { 1.5, "1.5" },
+                { -2.5, "-2.5" },
+                { 0.1, "0.1" },
+                { 0.3, "0.3" },
+                { 0.1 + 0.2, "0.30000000000000004" },
+                { 123.456, "123.456" },
+                { 0.000001, "0.000001" },
+                { 1e-7, "1e-7" },
+                { 1e20, "100000000000000000000" },
+                { 1e21, "1e+21" },
+                { 123456789012345680.0, "123456789012345680" },
+                { 5e-324, "5e-324" },
+                { 2.2250738585072014e-308, "2.2250738585072014e-308" },
+                { 1.7976931348623157e308, "1.7976931348623157e+308" },
+            };
+            size_t i;
+            SS s = ss_empty();
+            for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+            {
+                ss_clear(s);
+                ss_catdouble(&s, cases[i].val);
+                check(eq(s, cases[i].s, strlen(cases[i].s)));
+            }
+
+            ss_copy(&s, "x=", 2);
+            ss_catdouble(&s, 1.0 / 0.0);
+            ss_cat(&s, ",", 1);
+            ss_catdouble(&s, -1.0 / 0.0);
+            ss_cat(&s, ",", 1);
+            ss_catdouble(&s, 0.0 / 0.0);
+            check(eq(s, "x=inf,-inf,nan", 14));
+            ss_free(&s);
+        }
+
+        it("should round trip random values")
+        {
+            uint64_t x = 0x9E3779B97F4A7C15ULL;
+            int i;
+            SS s = ss_empty();
+            for (i = 0; i < 10000; ++i)
+            {
+                double d, r;
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                memcpy(&d, &x, sizeof(d));
+                if (d != d || d - d != 0)
+                {
+                    continue;
+                }
+                ss_clear(s);
+                ss_catdouble(&s, d);
+                r = strtod(s, NULL);
+                check(!memcmp(&r, &d, sizeof(d)));
+            }
+            ss_free(&s);
+        }
+    }
+
+    describe("ss_builder")
+    {
+        it("should split appends across chunks")
+        {
+            const char abc[] = "abcdefghijklmnopqrstuvwxyz";
+            ss_builder_t *b = ss_builder_new(8);
+            ss_builder_append(b, abc, 5);
+            ss_builder_append(b, abc + 5, 21);
+            ss_builder_append(b, "", 0);
+            check(ss_builder_len(b) == 26);
+            SS s = ss_builder_finish(b);
+            check(eq(s, abc, 26));
+            check(ss_builder_len(b) == 0);
+            ss_free(&s);
+            ss_builder_free(&b);
+            check(NULL == b);
+        }
+
+        it("should append formatted output and integers")
+        {
+            ss_builder_t *b = ss_builder_new(8);
+            check(0 == ss_builder_appendf(b, "%s=%d;", "ab", 12));
+            check(0 == ss_builder_appendf(b, "%s", "long enough to need a new chunk"));
+            check(0 == ss_builder_appendf(b, "%s", ""));
+            ss_builder_appendint(b, (-9223372036854775807LL) - 1);
+            ss_builder_append(b, ",", 1);
+            ss_builder_appendint(b, 0);
+            ss_builder_append(b, ",", 1);
+            ss_builder_appenduint(b, 0xFFFFFFFFFFFFFFFFULL);
+            const char ans[] = "ab=12;long enough to need a new chunk"
+                               "-9223372036854775808,0,18446744073709551615";
+            SS s = ss_builder_finish(b);
+            check(eq(s, ans, strlen(ans)));
+            ss_free(&s);
+            ss_builder_free(&b);
+        }
+
+        it("should format long output into its own chunk")
+        {
+            char big[600];
+            memset(big, 'x', sizeof(big) - 1);
+            big[sizeof(big) - 1] = 0;
+            ss_builder_t *b = ss_builder_new(16);
+            ss_builder_append(b, "<", 1);
+            check(0 == ss_builder_appendf(b, "%s", big));
+            ss_builder_append(b, ">", 1);
+            SS s = ss_builder_finish(b);
+            check(ss_len(s) == sizeof(big) + 1);
+            check(s[0] == '<' && s[sizeof(big)] == '>');
+            check(s[1] == 'x' && s[sizeof(big) - 1] == 'x');
+            ss_free(&s);
+            ss_builder_free(&b);
+        }
+
+        it("should be reusable after finish")
+        {
+            ss_builder_t *b = ss_builder_new(4);
+            ss_builder_append(b, "first build", 11);
+            SS s = ss_builder_finish(b);
+            check(eq(s, "first build", 11));
+            ss_free(&s);
+            ss_builder_append(b, "second", 6);
+            s = ss_builder_finish(b);
+            check(eq(s, "second", 6));
+            ss_free(&s);
+            s = ss_builder_finish(b);
+            check(eq(s, "", 0));
+            ss_free(&s);
+            ss_builder_free(&b);
+        }
+
+        it("should write the chunks to a file descriptor")
+        {
+            ss_builder_t *b = ss_builder_new(3);
+            int i;
+            for (i = 0; i < 100; ++i)
+            {
+                ss_builder_appendint(b, i);
+                ss_builder_append(b, " ", 1);
+            }
+            FILE *f = tmpfile();
+            check(f);
+            int fd = fileno(f);
+            check(0 == ss_builder_writev(b, fd, NULL));
+            check(EBADF == ss_builder_writev(b, -1, NULL));
+
+            SS want = ss_builder_finish(b);
+            char buf[512];
+            check(0 == lseek(fd, 0, SEEK_SET));
+            ssize_t n = read(fd, buf, sizeof(buf));
+            check(n == (ssize_t)ss_len(want));
+            check(!memcmp(buf, want, ss_len(want)));
+            fclose(f);
+            ss_free(&want);
+            ss_builder_free(&b);
+        }
+    }
+
+    describe("ss fd I/O")
+    {
+        it("should read into the reserved capacity")
+        {
+            int p[2];
+            check(0 == pipe(p));
+            check(5 == write(p[1], "hello", 5));
+
+            SS s = ss_newfrom(0, "say ", 4);
+            ss_reserve(&s, 64);
+            SS save = s;
+            check(5 == ss_catread(&s, p[0], 0));
+            check(s == save);
+            check(eq(s, "say hello", 9));
+
+            /* Grows when there isn't room for max. */
+            check(3 == write(p[1], "!!!", 3));
+            check(3 == ss_catread(&s, p[0], 1000));
+            check(eq(s, "say hello!!!", 12));
+            check(ss_cap(s) >= 1009);
+
+            close(p[1]);
+            check(0 == ss_catread(&s, p[0], 0));
+            check(eq(s, "say hello!!!", 12));
+            check(-1 == ss_catread(&s, -1, 0) && EBADF == errno);
+            close(p[0]);
+            ss_free(&s);
+        }
+
+        it("should read a whole file")
+        {
+            FILE *f = tmpfile();
+            int fd = fileno(f);
+            char buf[10000];
+            size_t i;
+            for (i = 0; i < sizeof(buf); ++i)
+            {
+                buf[i] = (char)('a' + (i % 26));
+            }
+            check(sizeof(buf) == (size_t)write(fd, buf, sizeof(buf)));
+            check(0 == lseek(fd, 0, SEEK_SET));
+
+            SS s = ss_newfrom(0, "replaced", 8);
+            check(0 == ss_readfd(&s, fd));
+            check(eq(s, buf, sizeof(buf)));
+            check(EBADF == ss_readfd(&s, -1));
+            fclose(f);
+            ss_free(&s);
+        }
+
+        it("should size a regular file up front into a string with spare capacity")
+        {
+            counting_t c = { 0 };
+            ss_allocator_t a = { counting_alloc, counting_realloc, counting_free, counting_usable, &c };
+            FILE *f = tmpfile();
+            int fd = fileno(f);
+            size_t size = 1024 * 1024;
+            char *buf = malloc(size);
+            size_t i;
+            for (i = 0; i < size; ++i)
+            {
+                buf[i] = (char)('a' + (i % 26));
+            }
+            check(size == (size_t)write(fd, buf, size));
+            check(0 == lseek(fd, 0, SEEK_SET));
+
+            SS s = ss_newfrom_allocator(&a, 64, "hello", 5);
+            check(0 == ss_readfd(&s, fd));
+            check(eq(s, buf, size));
+            check(1 == c.allocs && 1 == c.reallocs);
+            fclose(f);
+            free(buf);
+            ss_free(&s);
+        }
+
+        it("should write a string from an offset")
+        {
+            int p[2];
+            check(0 == pipe(p));
+            SS s = ss_newfrom(0, "abcdef", 6);
+            size_t off = 2;
+            check(0 == ss_writefd(s, p[1], &off));
+            check(6 == off);
+            check(0 == ss_writefd(s, p[1], NULL));
+            close(p[1]);
+
+            SS r = ss_empty();
+            check(0 == ss_readfd(&r, p[0]));
+            check(eq(r, "cdefabcdef", 10));
+            close(p[0]);
+            ss_free(&s);
+            ss_free(&r);
+        }
+
+        it("should resume builder writev on a non-blocking descriptor")
+        {
+            int p[2];
+            check(0 == pipe(p));
+            check(0 == fcntl(p[1], F_SETFL, O_NONBLOCK));
+
+            ss_builder_t *b = ss_builder_new(0);
+            char line[100];
+            memset(line, 'x', sizeof(line));
+            int i;
+            for (i = 0; i < 3000; ++i)
+            {
+                line[0] = (char)('a' + i % 26);
+                ss_builder_append(b, line, sizeof(line));
+            }
+
+            ss_wcursor_t cur = { 0, 0 };
+            SS r = ss_empty();
+            int err;
+            int blocked = 0;
+            while ((err = ss_builder_writev(b, p[1], &cur)))
+            {
+                check(EAGAIN == err || EWOULDBLOCK == err);
+                ++blocked;
+                check(ss_catread(&r, p[0], 65536) > 0);
+            }
+            check(blocked > 0);
+            check(0 == cur.offset);
+            check(0 == ss_builder_writev(b, p[1], &cur));
+            close(p[1]);
+            while (ss_catread(&r, p[0], 0) > 0)
+            {
+            }
+            close(p[0]);
+
+            SS want = ss_builder_finish(b);
+            check(ss_equal(r, want));
+            ss_free(&want);
+            ss_free(&r);
+            ss_builder_free(&b);
+        }
+
+        it("should resume writev on a non-blocking descriptor")
+        {
+            int p[2];
+            check(0 == pipe(p));
+            check(0 == fcntl(p[1], F_SETFL, O_NONBLOCK));
+
+            SS v[4];
+            v[0] = ss_newfrom(0, "head:", 5);
+            v[1] = ss_new(200000);
+            ss_setlen(v[1], 200000);
+            memset(v[1], 'x', 200000);
+            v[2] = ss_empty();
+            v[3] = ss_newfrom(0, ":tail", 5);
+
+            ss_wcursor_t cur = { 0, 0 };
+            SS r = ss_empty();
+            int err;
+            int blocked = 0;
+            while ((err = ss_writev(v, 4, p[1], &cur)))
+            {
+                check(EAGAIN == err || EWOULDBLOCK == err);
+                ++blocked;
+                check(ss_catread(&r, p[0], 65536) > 0);
+            }
+            check(blocked > 0);
+            check(4 == cur.index && 0 == cur.offset);
+            close(p[1]);
+            while (ss_catread(&r, p[0], 0) > 0)
+            {
+            }
+            close(p[0]);
+
+            check(ss_len(r) == 200010);
+            check(!memcmp(r, "head:x", 6));
+            check(!memcmp(r + 200004, "x:tail", 6));
+            ss_free(&r);
+            int i;
+            for (i = 0; i < 4; ++i)
+            {
+                ss_free(&v[i]);
+            }
+        }
+    }
+
+    describe("ss_mapfile")
+    {
+        it("should query a mapped file in place")
+        {
+            char path[] = "/tmp/ss_mapXXXXXX";
+            int fd = mkstemp(path);
+            check(fd >= 0);
+            check(23 == write(fd, "the cat sat on the mat\n", 23));
+            close(fd);
+
+            SS s = ss_mapfile(path);
+            check(s);
+            check(ss_ismappedtype(s));
+            check(!ss_isheaptype(s));
+            check(eq(s, "the cat sat on the mat\n", 23));
+            check(4 == ss_find(s, 0, "cat", 3));
+            check(3 == ss_count(s, 0, "at", 2));
+            check(19 == ss_rfind(s, NPOS, "mat", 3));
+            ss_free(&s);
+            check(NULL == s);
+            unlink(path);
+        }
+
+        it("should keep writes private and copy to the heap on growth")
+        {
+            char path[] = "/tmp/ss_mapXXXXXX";
+            int fd = mkstemp(path);
+            check(fd >= 0);
+            check(5 == write(fd, "hello", 5));
+
+            SS s = ss_mapfile(path);
+            s[0] = 'j';
+            check(eq(s, "jello", 5));
+            ss_cat(&s, " world", 6);
+            check(ss_isheaptype(s));
+            check(!ss_ismappedtype(s));
+            check(eq(s, "jello world", 11));
+            ss_free(&s);
+
+            SS r = ss_empty();
+            check(0 == lseek(fd, 0, SEEK_SET));
+            check(0 == ss_readfd(&r, fd));
+            check(eq(r, "hello", 5));
+            ss_free(&r);
+
+            s = ss_mapfile(path);
+            ss_heapify(&s);
+            check(ss_isheaptype(s));
+            check(eq(s, "hello", 5));
+            ss_free(&s);
+            close(fd);
+            unlink(path);
+        }
+
+        it("should have a sentinel for page sized and empty files")
+        {
+            char page[4096];
+            memset(page, 'p', sizeof(page));
+            char path[] = "/tmp/ss_mapXXXXXX";
+            int fd = mkstemp(path);
+            check(fd >= 0);
+
+            SS s = ss_mapfile(path);
+            check(s);
+            check(0 == ss_len(s) && 0 == s[0]);
+            ss_free(&s);
+
+            check(sizeof(page) == (size_t)write(fd, page, sizeof(page)));
+            s = ss_mapfile(path);
+            check(ss_len(s) == sizeof(page));
+            check(0 == s[sizeof(page)]);
+            check(!memcmp(s, page, sizeof(page)));
+            ss_free(&s);
+            close(fd);
+            unlink(path);
+        }
+
+        it("should fail for missing paths and non-files")
+        {
+            errno = 0;
+            check(NULL == ss_mapfile("/nonexistent/ss_map"));
+            check(ENOENT == errno);
+            check(NULL == ss_mapfile("/tmp"));
+            check(EINVAL == errno);
+        }
     }
 
     describe("ss_packBE and ss_unpackBE")
@@ -1673,6 +4702,191 @@ spec("simple-string library")
         }
     }
 
+    describe("ss_packLE and array packing")
+    {
+        it("should encode and decode little-endian values")
+        {
+            SS s = ss_empty();
+
+            size_t written = ss_packLE(&s, "hIQ?", -2, 0x01020304, (uint64_t)0x1122334455667788, 1);
+            check(15 == written);
+            check(eq(s, "\xFE\xFF\x04\x03\x02\x01\x88\x77\x66\x55\x44\x33\x22\x11\x01", 15));
+
+            int16_t h;
+            uint32_t i;
+            uint64_t q;
+            bool b;
+            check(15 == ss_unpackLE(s, "hIQ?", &h, &i, &q, &b));
+            check(-2 == h);
+            check(0x01020304 == i);
+            check(0x1122334455667788 == q);
+            check(b);
+
+            check(6 == ss_catpackLE(&s, "H4B", 0xABCD, "wxyz"));
+            check(21 == ss_len(s));
+            check(!memcmp(s + 15, "\xCD\xAB" "wxyz", 6));
+            uint16_t u;
+            check(2 == ssb_unpackLE(6, (unsigned char *)s + 15, "H", &u));
+            check(0xABCD == u);
+
+            ss_free(&s);
+        }
+
+        it("should pack arrays in both byte orders")
+        {
+            uint16_t h[37];
+            uint32_t w[37];
+            uint64_t q[37];
+            bool flags[3] = { true, false, true };
+            size_t n;
+            for (n = 0; n < 37; ++n)
+            {
+                h[n] = (uint16_t)(0x0102 + n);
+                w[n] = 0x01020304u + (uint32_t)n;
+                q[n] = 0x0102030405060708ull + n;
+            }
+
+            SS be = ss_empty();
+            SS le = ss_empty();
+            size_t size = 37 * (2 + 4 + 8) + 3;
+            check(size == ss_packBE(&be, "37H37I37Q3?", h, w, q, flags));
+            check(size == ss_packLE(&le, "37H37I37Q3?", h, w, q, flags));
+
+            /* Same bytes as packing one at a time. */
+            SS one = ss_empty();
+            for (n = 0; n < 37; ++n)
+            {
+                ss_catpackBE(&one, "H", h[n]);
+            }
+            check(!memcmp(be, one, 37 * 2));
+            check(!memcmp(be + 37 * 2, "\x01\x02\x03\x04", 4));
+            check(!memcmp(le + 37 * 2, "\x04\x03\x02\x01", 4));
+            check(!memcmp(be + 37 * 6 + 8 * 36, "\x01\x02\x03\x04\x05\x06\x07\x2C", 8));
+            check(!memcmp(be + size - 3, "\x01\x00\x01", 3));
+
+            uint16_t h2[37];
+            uint32_t w2[37];
+            uint64_t q2[37];
+            bool flags2[3];
+            check(size == ss_unpackBE(be, "37H37I37Q3?", h2, w2, q2, flags2));
+            check(!memcmp(h, h2, sizeof(h)) && !memcmp(w, w2, sizeof(w)) && !memcmp(q, q2, sizeof(q)));
+            check(flags2[0] && !flags2[1] && flags2[2]);
+
+            memset(w2, 0, sizeof(w2));
+            check(size == ss_unpackLE(le, "37H37I37Q3?", h2, w2, q2, flags2));
+            check(!memcmp(w, w2, sizeof(w)));
+
+            /* Too short, and a count with no type. */
+            check(NPOS == ss_unpackBE(be, "1000I", w2));
+            check(NPOS == ss_packBE(&one, "12", w));
+
+            ss_free(&be);
+            ss_free(&le);
+            ss_free(&one);
+        }
+    }
+
+    describe("ss_packplan")
+    {
+        it("should pack the same bytes as ss_packBE")
+        {
+            ss_packplan_t *plan = ss_packplan_compile("cbB?hHiIqQ");
+            check(plan);
+            check(1 + 1 + 1 + 1 + 2 + 2 + 4 + 4 + 8 + 8 == ss_packplan_size(plan));
+
+            SS s1 = ss_empty();
+            SS s2 = ss_empty();
+
+            size_t w1 = ss_packBE(&s1, "cbB?hHiIqQ", 'x', -3, 250, 7, -1234, 0xBEEF,
+                                  -123456, 0xDEADBEEF, (int64_t)-1, (uint64_t)0x0102030405060708);
+            size_t w2 = ss_packplan_exec(&s2, plan, 'x', -3, 250, 7, -1234, 0xBEEF,
+                                         -123456, 0xDEADBEEF, (int64_t)-1, (uint64_t)0x0102030405060708);
+            check(w1 == w2);
+            check(ss_equal(s1, s2));
+            check(0 == s2[w2]);
+
+            char c;
+            signed char b;
+            unsigned char B;
+            bool q;
+            int16_t h;
+            uint16_t H;
+            int32_t i;
+            uint32_t I;
+            int64_t q64;
+            uint64_t Q64;
+            check(w2 == ss_unpackplan_exec(s2, plan, &c, &b, &B, &q, &h, &H, &i, &I, &q64, &Q64));
+            check('x' == c);
+            check(-3 == b);
+            check(250 == B);
+            check(q);
+            check(-1234 == h);
+            check(0xBEEF == H);
+            check(-123456 == i);
+            check(0xDEADBEEF == I);
+            check(-1 == q64);
+            check(0x0102030405060708 == Q64);
+
+            ss_free(&s1);
+            ss_free(&s2);
+            ss_packplan_free(&plan);
+            check(!plan);
+        }
+
+        it("should append, and refuse short input and bad formats")
+        {
+            check(!ss_packplan_compile("HxI"));
+
+            ss_packplan_t *plan = ss_packplan_compile("HI");
+            SS s = ss_newfrom(0, "hdr:", 4);
+
+            check(6 == ss_catpackplan_exec(&s, plan, 0x0102, 0x03040506));
+            check(eq(s, "hdr:\x01\x02\x03\x04\x05\x06", 10));
+
+            uint16_t h;
+            uint32_t i;
+            check(6 == ssb_unpackplan_exec(6, (unsigned char *)s + 4, plan, &h, &i));
+            check(0x0102 == h);
+            check(0x03040506 == i);
+            check(NPOS == ssb_unpackplan_exec(5, (unsigned char *)s + 4, plan, &h, &i));
+
+            ss_trunc(s, 5);
+            check(NPOS == ss_unpackplan_exec(s, plan, &h, &i));
+
+            ss_free(&s);
+            ss_packplan_free(&plan);
+        }
+
+        it("should compile byte orders and arrays")
+        {
+            uint32_t w[5] = { 1, 2, 3, 4, 5 };
+            uint32_t r[5];
+            uint16_t h;
+
+            ss_packplan_t *le = ss_packplan_compile("<H5I");
+            ss_packplan_t *be = ss_packplan_compile("!H5I");
+            check(22 == ss_packplan_size(le));
+
+            SS s1 = ss_empty();
+            SS s2 = ss_empty();
+            ss_packplan_exec(&s1, le, 7, w);
+            ss_packLE(&s2, "H5I", 7, w);
+            check(ss_equal(s1, s2));
+            check(22 == ss_unpackplan_exec(s1, le, &h, r));
+            check(7 == h);
+            check(!memcmp(w, r, sizeof(w)));
+
+            ss_packplan_exec(&s1, be, 7, w);
+            ss_packBE(&s2, "H5I", 7, w);
+            check(ss_equal(s1, s2));
+
+            ss_free(&s1);
+            ss_free(&s2);
+            ss_packplan_free(&le);
+            ss_packplan_free(&be);
+        }
+    }
+
     describe("ssu_isvalid")
     {
         it("should pass valid points")
@@ -1872,6 +5086,215 @@ spec("simple-string library")
         }
     }
 
+    describe("ssu8_validate, ssu8_len, and ssu8_index")
+    {
+        it("should accept well-formed UTF-8")
+        {
+            /* "aé€😀", one code point of each length. */
+            SS s = ss_newfrom(0, "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", 10);
+            check(ssu8_validate(s));
+            check(4 == ssu8_len(s));
+            check(0 == ssu8_index(s, 0));
+            check(1 == ssu8_index(s, 1));
+            check(3 == ssu8_index(s, 2));
+            check(6 == ssu8_index(s, 3));
+            check(NPOS == ssu8_index(s, 4));
+            ss_free(&s);
+
+            s = ss_empty();
+            check(ssu8_validate(s));
+            check(0 == ssu8_len(s));
+            check(NPOS == ssu8_index(s, 0));
+            ss_free(&s);
+
+            s = ss_newfrom(0, "\0\x7F\xEF\xBF\xBF\xF4\x8F\xBF\xBF\xED\x9F\xBF\xEE\x80\x80", 15);
+            check(ssu8_validate(s));
+            check(6 == ssu8_len(s));
+            ss_free(&s);
+        }
+
+        it("should reject malformed UTF-8 anywhere in long strings")
+        {
+            const char *bad[] =
+            {
+                "\x80",             /* Lone continuation. */
+                "\xBF",
+                "\xC0\x80",         /* Overlong. */
+                "\xC1\xBF",
+                "\xE0\x80\x80",
+                "\xE0\x9F\xBF",
+                "\xF0\x80\x80\x80",
+                "\xF0\x8F\xBF\xBF",
+                "\xED\xA0\x80",     /* Surrogates. */
+                "\xED\xBF\xBF",
+                "\xF4\x90\x80\x80", /* Past 0x10FFFF. */
+                "\xF5\x80\x80\x80",
+                "\xFF",
+                "\xC3",             /* Cut short. */
+                "\xE2\x82",
+                "\xF0\x9F\x98",
+                "\xC3\xA9\xA9",     /* Too long. */
+                "\xE2\x82\xAC\x80",
+                "\xE2\x41\xAC",
+            };
+            char buf[100];
+
+            for (size_t b = 0; b < sizeof(bad) / sizeof(bad[0]); ++b)
+            {
+                size_t blen = strlen(bad[b]);
+                for (size_t at = 0; at + blen <= sizeof(buf); ++at)
+                {
+                    memset(buf, 'x', sizeof(buf));
+                    memcpy(buf + at, bad[b], blen);
+                    SS s = ss_newfrom(0, buf, sizeof(buf));
+                    check(!ssu8_validate(s), "bad[%zu] at %zu", b, at);
+                    ss_free(&s);
+
+                    /* And at the very end of the string. */
+                    s = ss_newfrom(0, buf, at + blen);
+                    check(!ssu8_validate(s), "bad[%zu] ending at %zu", b, at + blen);
+                    ss_free(&s);
+                }
+            }
+        }
+
+        it("should agree with sequence decoding on generated text")
+        {
+            uint64_t seed = 0x9E3779B97F4A7C15ull;
+            unicode_t cps[] = { 'a', 0x7F, 0x80, 0xE9, 0x7FF, 0x800, 0x20AC, 0xD7FF, 0xE000, 0xFFFF, 0x10000, 0x1F600, 0x10FFFF };
+
+            for (int round = 0; round < 200; ++round)
+            {
+                SS s = ss_empty();
+                size_t n = 0;
+                size_t offsets[300];
+
+                while (ss_len(s) < 200 + (size_t)round)
+                {
+                    char seq[SS_UTF8_SEQ_MAX];
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+                    /* Mostly ASCII runs, like real text. */
+                    unicode_t cp = (seed % 4) ? (unicode_t)('a' + seed % 26)
+                                              : cps[(seed >> 8) % (sizeof(cps) / sizeof(cps[0]))];
+                    offsets[n++] = ss_len(s);
+                    ss_cat(&s, seq, (size_t)ssu8_cptoseq(cp, seq));
+                }
+
+                check(ssu8_validate(s));
+                check(n == ssu8_len(s));
+                for (size_t k = 0; k < n; k += 7)
+                {
+                    check(offsets[k] == ssu8_index(s, k));
+                }
+                check(offsets[n - 1] == ssu8_index(s, n - 1));
+                check(NPOS == ssu8_index(s, n));
+                ss_free(&s);
+            }
+        }
+    }
+
+    describe("ssu8_to_utf16, ssu8_to_utf32, and back")
+    {
+        it("should convert each sequence length")
+        {
+            /* "aé€😀" */
+            SS s = ss_newfrom(0, "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", 10);
+            uint16_t u16[8];
+            uint32_t u32[8];
+
+            check(5 == ssu8_utf16len(s));
+            check(5 == ssu8_to_utf16(s, u16));
+            check(u16[0] == 'a' && u16[1] == 0xE9 && u16[2] == 0x20AC);
+            check(u16[3] == 0xD83D && u16[4] == 0xDE00);
+            check(4 == ssu8_to_utf32(s, u32));
+            check(u32[0] == 'a' && u32[1] == 0xE9 && u32[2] == 0x20AC && u32[3] == 0x1F600);
+
+            SS t = ss_empty();
+            check(ssu16_to_utf8(&t, u16, 5));
+            check(ss_equal(s, t));
+            ss_clear(t);
+            check(ssu32_to_utf8(&t, u32, 4));
+            check(ss_equal(s, t));
+            check(ssu16_to_utf8(&t, u16, 0));
+            check(0 == ss_len(t));
+            ss_free(&s);
+            ss_free(&t);
+        }
+
+        it("should reject invalid input and leave the output alone")
+        {
+            SS s = ss_newfrom(0, "ab\xC3", 3);
+            uint16_t u16[4] = { 0x1234, 0, 0, 0 };
+            uint32_t u32[4] = { 0x1234, 0, 0, 0 };
+
+            check(NPOS == ssu8_utf16len(s));
+            check(NPOS == ssu8_to_utf16(s, u16));
+            check(NPOS == ssu8_to_utf32(s, u32));
+            check(0x1234 == u16[0] && 0x1234 == u32[0]);
+            ss_free(&s);
+
+            SS t = ss_newfrom(0, "keep", 4);
+            uint16_t lone_high[] = { 'a', 0xD800 };
+            uint16_t lone_low[] = { 0xDC00, 'a' };
+            uint16_t bad_pair[] = { 0xD800, 'a' };
+            uint32_t surrogate[] = { 'a', 0xDFFF };
+            uint32_t large[] = { 0x110000 };
+            check(!ssu16_to_utf8(&t, lone_high, 2));
+            check(!ssu16_to_utf8(&t, lone_low, 2));
+            check(!ssu16_to_utf8(&t, bad_pair, 2));
+            check(!ssu32_to_utf8(&t, surrogate, 2));
+            check(!ssu32_to_utf8(&t, large, 1));
+            check(eq(t, "keep", 4));
+            ss_free(&t);
+        }
+
+        it("should round trip runs of every kind across vector widths")
+        {
+            unicode_t ranges[][2] =
+            {
+                { 0x20, 0x7F }, { 0x80, 0x800 }, { 0x800, 0xD800 }, { 0x10000, 0x110000 },
+            };
+            uint64_t seed = 0x2545F4914F6CDD1Dull;
+
+            for (int round = 0; round < 300; ++round)
+            {
+                uint32_t cps[200];
+                size_t n = (size_t)round % 200;
+
+                for (size_t i = 0; i < n; ++i)
+                {
+                    seed ^= seed << 13;
+                    seed ^= seed >> 7;
+                    seed ^= seed << 17;
+                    /* Long runs of one kind, sometimes mixed. */
+                    size_t kind = (round % 5 == 4) ? (seed >> 32) % 4 : (size_t)round % 4;
+                    cps[i] = ranges[kind][0] + (unicode_t)(seed % (ranges[kind][1] - ranges[kind][0]));
+                }
+
+                SS s = ss_empty();
+                check(ssu32_to_utf8(&s, cps, n));
+                check(ssu8_validate(s));
+                check(n == ssu8_len(s));
+
+                size_t units = ssu8_utf16len(s);
+                uint16_t *u16 = malloc((units + 1) * sizeof(*u16));
+                uint32_t back[200];
+                check(units == ssu8_to_utf16(s, u16));
+                check(n == ssu8_to_utf32(s, back));
+                check(0 == memcmp(cps, back, n * sizeof(*cps)));
+
+                SS t = ss_empty();
+                check(ssu16_to_utf8(&t, u16, units));
+                check(ss_equal(s, t));
+                free(u16);
+                ss_free(&s);
+                ss_free(&t);
+            }
+        }
+    }
+
     describe("sse_clz32")
     {
         it("should count leading zeros")
@@ -1926,6 +5349,23 @@ spec("simple-string library")
             check(&buf[4] == sse_memrchar(buf, 'a', len));
             check(&buf[3] == sse_memrchar(buf, 'f', len - 2));
         }
+
+        it("should search only the first len bytes of long buffers")
+        {
+            char buf[300];
+            memset(buf, 'a', sizeof(buf));
+
+            size_t pos;
+            for (pos = 0; pos < sizeof(buf); ++pos)
+            {
+                buf[pos] = 'b';
+                check(&buf[pos] == sse_memrchar(buf, 'b', sizeof(buf)));
+                check(&buf[pos] == sse_memrchar(buf, 'b', pos + 1));
+                check(NULL == sse_memrchar(buf, 'b', pos));
+                buf[pos] = 'a';
+            }
+            check(NULL == sse_memrchar(buf, 'b', sizeof(buf)));
+        }
     }
 }
 
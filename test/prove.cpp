@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include "ss.hpp"
+
+/* bdd.h is C only, this is the part of it the wrapper tests need. */
+static int g_failed = 0;
+static int g_total = 0;
+
+#define spec(name) int main() { std::printf("%s\n", name);
+#define describe(name) std::printf("  %s\n", name);
+#define it(name) std::printf("    %s\n", name);
+#define check(cond) \
+    do { \
+        ++g_total; \
+        if (!(cond)) \
+        { \
+            ++g_failed; \
+            std::printf("      FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+spec("ss.hpp")
+{
+    describe("ss::string")
+    {
+        it("should own the string and free it")
+        {
+            ss::string s("hello");
+            check(5 == s.size());
+            check(std::string_view("hello") == s);
+            check(0 == s.c_str()[5]);
+
+            s += " world";
+            s += '!';
+            check(s == std::string_view("hello world!"));
+            check(6 == s.find("world"));
+        }
+
+        it("should move by taking the pointer")
+        {
+            ss::string a("moved without copying");
+            const char *p = a.data();
+
+            ss::string b(std::move(a));
+            check(b.data() == p);
+            check(a.empty());
+            check(ss_isemptytype(a.get()));
+
+            ss::string c;
+            c = std::move(b);
+            check(c.data() == p);
+            check(b.empty());
+        }
+
+        it("should free the old value when move assigned over")
+        {
+            ss::string a("the new value");
+            ss::string b("the old value");
+            const char *p = a.data();
+
+            b = std::move(a);
+            check(b.data() == p);
+            check(b == std::string_view("the new value"));
+            check(a.empty());
+            check(ss_isemptytype(a.get()));
+
+            ss::string &self = b;
+            b = std::move(self);
+            check(b == std::string_view("the new value"));
+        }
+
+        it("should convert to string_view without copying")
+        {
+            ss::string s(std::string_view("with\0nul", 8));
+            std::string_view v = s;
+            check(v.data() == s.data());
+            check(8 == v.size());
+        }
+
+        it("should adopt, release, and clone")
+        {
+            ss::string s = ss::string::adopt(ss_newfrom(0, "adopted", 7));
+            ss::string copy = s.clone();
+            check(copy == s);
+            check(copy.data() != s.data());
+
+            SS raw = s.release();
+            check(s.empty());
+            check(7 == ss_len(raw));
+            ss_free(&raw);
+        }
+
+        it("should work with C functions through ptr")
+        {
+            ss::string s("x");
+            ss_catint64(s.ptr(), 42);
+            check(s == std::string_view("x42"));
+            ss_upper(s.get());
+            check(s == std::string_view("X42"));
+        }
+
+        it("should hash with the cached hash")
+        {
+            ss::string a("key");
+            ss::string b("key");
+            ss::string c("other");
+            std::hash<ss::string> h;
+            check(h(a) == h(b));
+            check(h(a) == ss_hash(a.get()));
+            check(h(a) != h(c));
+
+            std::unordered_set<ss::string> set;
+            set.insert(std::move(a));
+            set.insert(std::move(c));
+            check(1 == set.count(b));
+            check(0 == set.count(ss::string("missing")));
+        }
+
+        it("should drop the cached hash when written in place")
+        {
+            ss::string a("key");
+            ss::string b("kez");
+            a.reserve(16);
+            b.reserve(16);
+            std::hash<ss::string> h;
+            std::uint64_t before = h(a);
+            h(b);
+            check(!(a == b));
+
+            a[2] = 'z';
+            check(a == b);
+            check(h(a) == h(b));
+            check(h(a) != before);
+
+            char *p = a.data();
+            h(a);
+            p[0] = 'j';
+            ssi_unhash(a.get());
+            check(h(a) == ss_hash(ss::string("jez").get()));
+        }
+    }
+
+    describe("ss::stack_string")
+    {
+        it("should stay in the object until it outgrows it")
+        {
+            ss::stack_string<16> s("short");
+            check(s.on_stack());
+            check(s == std::string_view("short"));
+            check(16 == s.capacity());
+
+            s += " but now longer than sixteen bytes";
+            check(!s.on_stack());
+            check(s == std::string_view("short but now longer than sixteen bytes"));
+        }
+
+        it("should compare and hash like ss::string")
+        {
+            ss::stack_string<32> a("same");
+            ss::string b("same");
+            check(a == b);
+            check(std::hash<ss::stack_string<32>>()(a) == std::hash<ss::string>()(b));
+        }
+    }
+}
+    std::printf("%d of %d checks passed\n", g_total - g_failed, g_total);
+    return g_failed ? 1 : 0;
+}